@@ -0,0 +1,97 @@
+/*
+#  用法: concurrent <脚本> [每个线程的执行次数] [线程数...]
+#
+#  同一个编译好的 Program 交给多个线程, 每个线程用自己的 Interpreter 反复执行, 输出写进各自的缓冲区.
+#  每次的输出都要与单线程执行的结果一致, 否则以非零值退出; 并报告每种线程数下每秒完成的执行次数
+*/
+#include "MiLang.hpp"
+#include "lexer/Lexer.hpp"
+#include "interpreter/InnerMethod.hpp"
+#include "binop/BinOp.hpp"
+#include "parser/Parser.hpp"
+#include "resolver/Resolver.hpp"
+#include "optimizer/Optimizer.hpp"
+#include "optimizer/Purity.hpp"
+#include "optimizer/Types.hpp"
+#include "interpreter/Interpreter.hpp"
+#include "evaluate.hpp"
+#include "Program.hpp"
+#include "utils.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+static string execute(const Program& program) {
+    ostringstream out;
+    Interpreter interpreter;
+    interpreter.setThreads(1);
+    interpreter.setOutput(out);
+    interpreter.run(program);
+    return out.str();
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "usage: concurrent <file.mi> [runs] [threads...]" << endl;
+        return 2;
+    }
+    int runs = argc > 2 ? stoi(argv[2]) : 200;
+    vector<int> threadCounts;
+    for (int i = 3; i < argc; i++) {
+        threadCounts.push_back(stoi(argv[i]));
+    }
+    if (threadCounts.empty()) {
+        threadCounts = {1, 2, 4, 8};
+    }
+
+    try {
+        auto program = Program::compile(readFile(argv[1]));
+        const string expected = execute(*program);
+        cout << "cores: " << thread::hardware_concurrency() << endl;
+
+        double base = 0;
+        bool mismatch = false;
+        for (int threads : threadCounts) {
+            atomic<int> failures{0};
+            vector<string> errors(threads);
+            auto start = chrono::steady_clock::now();
+            vector<thread> workers;
+            for (int t = 0; t < threads; t++) {
+                workers.emplace_back([&, t] {
+                    try {
+                        for (int i = 0; i < runs; i++) {
+                            if (execute(*program) != expected) {
+                                failures++;
+                            }
+                        }
+                    } catch (const exception& e) {
+                        errors[t] = e.what();
+                        failures++;
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            double rate = threads * runs / elapsed;
+            base = base > 0 ? base : rate;
+            printf("threads=%-2d %8.3fs  %9.1f runs/s  scaling %5.2fx  mismatches %d\n", threads, elapsed, rate,
+                   rate / base, failures.load());
+            for (const auto& error : errors) {
+                if (!error.empty()) {
+                    cerr << "Error: " << error << endl;
+                }
+            }
+            mismatch = mismatch || failures > 0;
+        }
+        return mismatch ? 1 : 0;
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,80 @@
+/*
+#  用法: host [脚本]    (默认 example/host.mi)
+#  编译: clang++ example/host.cpp -o host -std=c++20 -pthread -Isrc
+#
+#  嵌入解释器的宿主程序: 用 Interpreter::bind 把普通的 C++ 函数注册成内置函数, 再执行脚本.
+#  参数个数和类型由函数签名决定 (见 interpreter/Native.hpp), 脚本传错时和其他内置函数一样报错
+*/
+#include "MiLang.hpp"
+#include "lexer/Lexer.hpp"
+#include "interpreter/InnerMethod.hpp"
+#include "binop/BinOp.hpp"
+#include "parser/Parser.hpp"
+#include "resolver/Resolver.hpp"
+#include "optimizer/Optimizer.hpp"
+#include "optimizer/Purity.hpp"
+#include "optimizer/Types.hpp"
+#include "interpreter/Interpreter.hpp"
+#include "evaluate.hpp"
+#include "Program.hpp"
+#include "utils.hpp"
+
+#include <cmath>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+static double hypotenuse(double x, double y) {
+    return sqrt(x * x + y * y);
+}
+
+int main(int argc, char* argv[]) {
+    string path = argc > 1 ? argv[1] : "example/host.mi";
+    vector<string> events;
+
+    Interpreter interpreter;
+    // 编译期已知的函数; int 实参按 double 接收
+    interpreter.bind<&hypotenuse>("hypot");
+    // 末尾的 optional 参数可以不传
+    interpreter.bind("repeat", [](const string& text, optional<int> times) {
+        string result;
+        for (int i = 0; i < times.value_or(2); i++) {
+            result += text;
+        }
+        return result;
+    });
+    interpreter.bind("clamp", [](long long value, long long low, long long high) {
+        return value < low ? low : value > high ? high : value;
+    });
+    // 没有返回值的函数在脚本里返回 Null
+    interpreter.bind("record", [&events](string_view event) {
+        events.emplace_back(event);
+    });
+
+    try {
+        Lexer lexer(readFile(path));
+        Parser parser(lexer);
+        auto program = parser.parseProgram();
+        PassManager passes;
+        AnalysisOptions options;
+        options.isBuiltin = [&interpreter](const string& name) {
+            return interpreter.isBuiltinFunction(name);
+        };
+        if (auto types = analyzeProgram(*program, passes, options)) {
+            interpreter.setSpecializer(types);
+        }
+        interpreter.execute(std::move(program));
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
+    cout << "recorded " << events.size() << " events:";
+    for (const auto& event : events) {
+        cout << ' ' << event;
+    }
+    cout << endl;
+    return 0;
+}
@@ -0,0 +1,15 @@
+#!/bin/bash
+# 用法: scripts/bench.sh [mi 可执行文件] [引擎...]
+# 依次用各个引擎运行 bench/ 下的脚本并输出耗时
+MI=${1:-./mi}
+shift
+ENGINES=${@:-tree vm}
+
+for script in bench/*.mi; do
+    for engine in $ENGINES; do
+        start=$(date +%s.%N)
+        output=$("$MI" --engine="$engine" "$script" 2>&1 | tail -n 2 | head -n 1)
+        end=$(date +%s.%N)
+        printf "%-24s %-6s %8.3fs  %s\n" "$(basename "$script")" "$engine" "$(awk "BEGIN { print $end - $start }")" "$output"
+    done
+done
@@ -0,0 +1,26 @@
+#!/bin/bash
+# 用法: scripts/bench_aot.sh [mi 可执行文件]
+# 比较树遍历引擎、字节码引擎和 --aot 编译后的程序; 先运行一次 --aot 填好编译缓存, 只计运行时间.
+# --emit-cpp 不支持的脚本 (生成器、spawn 等) 跳过, 并列出原因
+MI=${1:-./mi}
+
+elapsed() {
+    local start end
+    start=$(date +%s.%N)
+    "$@" > /dev/null 2>&1
+    end=$(date +%s.%N)
+    awk "BEGIN { print $end - $start }"
+}
+
+for script in bench/*.mi; do
+    if ! reason=$("$MI" --emit-cpp "$script" 2>&1 > /dev/null); then
+        printf "%-16s skipped: %s\n" "$(basename "$script")" "$(echo "$reason" | head -n 1)"
+        continue
+    fi
+    "$MI" --aot "$script" > /dev/null 2>&1
+    tree=$(elapsed "$MI" "$script")
+    vm=$(elapsed "$MI" --engine=vm "$script")
+    aot=$(elapsed "$MI" --aot "$script")
+    printf "%-16s tree %7.3fs  vm %7.3fs  aot %7.3fs  %5.1fx\n" "$(basename "$script")" "$tree" "$vm" "$aot" \
+        "$(awk "BEGIN { print $tree / $aot }")"
+done
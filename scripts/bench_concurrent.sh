@@ -0,0 +1,10 @@
+#!/bin/bash
+# 用法: scripts/bench_concurrent.sh [每个线程的执行次数] [编译参数...]
+# 编译 bench/concurrent.cpp, 以 1/2/4/8 个线程同时执行 bench/concurrent.mi, 核对每次的输出并报告吞吐量
+RUNS=${1:-200}
+shift
+BIN=$(mktemp)
+trap 'rm -f "$BIN"' EXIT
+
+"${CXX:-clang++}" bench/concurrent.cpp -o "$BIN" -std=c++20 -O2 -pthread -Isrc "$@" || exit 1
+"$BIN" bench/concurrent.mi "$RUNS" 1 2 4 8
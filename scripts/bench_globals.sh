@@ -0,0 +1,30 @@
+#!/bin/bash
+# 用法: scripts/bench_globals.sh [mi 可执行文件] [引擎]
+# 先定义 N 个全局变量, 再调用函数 CALLS 次; 减去只定义变量的耗时, 得到每次调用的开销
+MI=${1:-./mi}
+ENGINE=${2:-tree}
+CALLS=100000
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+run() {
+    local start end
+    start=$(date +%s.%N)
+    "$MI" --engine="$ENGINE" "$1" > /dev/null 2>&1
+    end=$(date +%s.%N)
+    awk "BEGIN { print $end - $start }"
+}
+
+for n in 0 100 1000 10000; do
+    : > "$TMP/base.mi"
+    for ((i = 0; i < n; i++)); do
+        printf 'g%d = %d\n' "$i" "$i" >> "$TMP/base.mi"
+    done
+    printf 'fx f(x):\n    return x + 1\n' >> "$TMP/base.mi"
+    cp "$TMP/base.mi" "$TMP/calls.mi"
+    printf 'i = 0\nwhile i < %d:\n    i = f(i)\n' "$CALLS" >> "$TMP/calls.mi"
+
+    base=$(run "$TMP/base.mi")
+    total=$(run "$TMP/calls.mi")
+    printf "globals=%-6d %8.3fs  %6.0f ns/call\n" "$n" "$total" "$(awk "BEGIN { print ($total - $base) * 1e9 / $CALLS }")"
+done
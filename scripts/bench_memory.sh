@@ -0,0 +1,17 @@
+#!/bin/bash
+# 用法: scripts/bench_memory.sh [mi 可执行文件] [引擎...]
+# 依次运行 bench/ 下的脚本, 输出峰值常驻内存 (需要 python3 读取子进程的 ru_maxrss)
+MI=${1:-./mi}
+shift
+ENGINES=${@:-tree vm}
+
+for script in bench/*.mi; do
+    for engine in $ENGINES; do
+        rss=$(python3 -c '
+import resource, subprocess, sys
+subprocess.run(sys.argv[1:], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+print(resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss // 1024)
+' "$MI" --engine="$engine" "$script")
+        printf "%-24s %-6s %6s MB\n" "$(basename "$script")" "$engine" "$rss"
+    done
+done
@@ -0,0 +1,22 @@
+#!/bin/bash
+# 用法: scripts/bench_numeric.sh [编译器] [引擎...]
+# 分别以 double (默认) 和 -DMI_LONG_DOUBLE 编译 mi, 比较两种浮点档位运行 bench/float.mi 的耗时
+CXX=${1:-clang++}
+shift
+ENGINES=${@:-tree vm}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+"$CXX" src/MiMain.cpp -o "$TMP/mi_double" -std=c++20 -pthread -O2 || exit 1
+"$CXX" src/MiMain.cpp -o "$TMP/mi_long_double" -std=c++20 -pthread -O2 -DMI_LONG_DOUBLE || exit 1
+
+for engine in $ENGINES; do
+    for jit in "" --jit; do
+        for profile in double long_double; do
+            start=$(date +%s.%N)
+            output=$("$TMP/mi_$profile" --engine="$engine" $jit bench/float.mi 2>&1 | tail -n 2 | head -n 1)
+            end=$(date +%s.%N)
+            printf "%-12s %-6s %-6s %8.3fs  %s\n" "$profile" "$engine" "$jit" "$(awk "BEGIN { print $end - $start }")" "$output"
+        done
+    done
+done
@@ -0,0 +1,21 @@
+#!/bin/bash
+# 用法: scripts/bench_output.sh [mi 可执行文件...]
+# 运行 bench/output.mi, 输出分别写进管道和文件, 报告每秒输出的行数; 给出多个可执行文件时依次比较
+BINS=${@:-./mi}
+OUT=$(mktemp)
+trap 'rm -f "$OUT"' EXIT
+
+for MI in $BINS; do
+    for target in pipe file; do
+        start=$(date +%s.%N)
+        if [ "$target" = pipe ]; then
+            "$MI" bench/output.mi | cat > "$OUT"
+        else
+            "$MI" bench/output.mi > "$OUT"
+        fi
+        end=$(date +%s.%N)
+        lines=$(wc -l < "$OUT")
+        printf "%-24s %-5s %8.3fs %8s lines %12.0f lines/s\n" "$MI" "$target" "$(awk "BEGIN { print $end - $start }")" \
+            "$lines" "$(awk "BEGIN { print $lines / ($end - $start) }")"
+    done
+done
@@ -0,0 +1,18 @@
+#!/bin/bash
+# 用法: scripts/bench_parallel.sh [mi 可执行文件] [脚本] [引擎参数...]
+# 以 --threads=1/2/4/8 运行脚本 (默认 bench/parallel.mi; spawn 用 bench/tree_sum.mi), 报告耗时和相对单线程的加速比
+MI=${1:-./mi}
+shift
+SCRIPT=${1:-bench/parallel.mi}
+shift
+BASE=""
+
+echo "cores: $(nproc 2>/dev/null || echo unknown)"
+for threads in 1 2 4 8; do
+    start=$(date +%s.%N)
+    output=$("$MI" "$@" --threads=$threads "$SCRIPT" 2>&1 | tail -n 2 | head -n 1)
+    end=$(date +%s.%N)
+    elapsed=$(awk "BEGIN { print $end - $start }")
+    BASE=${BASE:-$elapsed}
+    printf "threads=%-2s %8.3fs  speedup %5.2fx  %s\n" "$threads" "$elapsed" "$(awk "BEGIN { print $BASE / $elapsed }")" "$output"
+done
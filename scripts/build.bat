@@ -1 +1 @@
-clang++ src/MiMain.cpp -o mi.exe -std=c++20
\ No newline at end of file
+clang++ src/MiMain.cpp -o mi.exe -std=c++20 %*
\ No newline at end of file
@@ -1 +1 @@
-clang++ src/MiMain.cpp -o mi -std=c++20
\ No newline at end of file
+clang++ src/MiMain.cpp -o mi -std=c++20 -pthread "$@"
\ No newline at end of file
@@ -1,433 +1,1057 @@
-#ifndef MILANG_HPP
-    #define MILANG_HPP
-
-    #include <iostream>
-    #include <cstdlib>
-    #include <fstream>
-    #include <string>
-    #include <vector>
-    #include <unordered_map>
-    #include <variant>
-    #include <sstream>
-    #include <regex>
-    #include <stdexcept>
-    #include <cmath>
-    #include <functional>
-    #include <algorithm>
-    #include <iomanip>
-    #include <memory>
-    #include <stack>
-    #include <utility>
-    #include <cstdint>
-
-    using namespace std;
-
-    using IntType = intmax_t;
-    using FloatType = long double;
-    using StringType = string;
-    using BoolType = bool;
-    using NullType = std::monostate;
-
-    extern bool DEBUG; // Under Development
-    const int MAX_DEAD_LOOP = 200000;
-
-    struct FunctionType;
-    using FunctionTypePtr = std::shared_ptr<FunctionType>;
-
-    using Value = variant<IntType, FloatType, StringType, BoolType, FunctionTypePtr, NullType>;
-
-    enum class TokenType {
-        INTEGER,      // 整数
-        FLOAT,        // 浮点数
-        STRING,       // 字符串
-        BOOLEAN,      // 布尔值
-        NULL_TYPE,         // 空值
-
-        IDENTIFIER,   // 标识符(变量名或函数名)
-        ASSIGN,       // =
-        LPAREN,       // (
-        RPAREN,       // )
-        COMMA,        // ,
-        LBRACE,       // {
-        RBRACE,       // }
-        PLUS,         // +
-        MINUS,        // -
-        MULTIPLY,     // *
-        DIVIDE,       // /
-        POWER,        // ^ (乘方)
-        PYPOWER,      // ** (Pythonic Power)
-        /*
-        :: 比较运算符
-        */
-        EQ,           // ==
-        NEQ,          // !=
-        GT,           // >
-        LT,           // <
-        GTE,          // >=
-        LTE,          // <=
-        NOT_GT,       // !> 等价于 <=
-        NOT_LT,       // !< 等价于 >=
-        NOT,          // !  非运算符
-
-        SEMICOLON,    // ; 分号
-        COLON,        // :
-
-        WHILE,
-        FOR,
-        DEF,
-        RETURN,
-
-        IF,
-        ELIF,
-        ELSE,
-
-        BREAK,
-        CONTINUE,
-
-        INDENT,       // 缩进
-        DEDENT,       // 解除缩进
-        EOF_TOKEN,    // 文件结束
-        COUNT,        // C++ 自动计数器
-    };
-
-
-    class Lexer;
-    class Parser;
-    class InnerMethod;
-    class Interpreter;
-
-    struct Token {
-        TokenType type;
-        std::string value;
-        int line;
-        Token(TokenType type, const string& value, int line)
-            : type(type), value(value), line(line) {}
-    };
-
-
-    struct ASTNode {
-        virtual ~ASTNode() = default;
-        virtual Value evaluate(Interpreter& interpreter) = 0;
-    };
-
-
-    struct NumberNode : ASTNode {
-        Value value;
-
-        NumberNode(IntType val) : value(val) {}
-        NumberNode(FloatType val) : value(val) {}
-
-        Value evaluate(Interpreter& interpreter) override {
-            return value;
-        }
-    };
-
-
-    struct StringNode : ASTNode {
-        StringType value;
-
-        StringNode(const StringType& val) : value(val) {}
-
-        Value evaluate(Interpreter& interpreter) override {
-            return value;
-        }
-    };
-
-    struct BooleanNode : ASTNode {
-        BoolType value;
-
-        BooleanNode(BoolType val) : value(val) {}
-
-        Value evaluate(Interpreter& interpreter) override {
-            return value;
-        }
-    };
-
-
-    struct VariableNode : ASTNode {
-        std::string name;
-
-        VariableNode(const string& name) : name(name) {}
-
-        Value evaluate(Interpreter& interpreter) override;
-    };
-
-
-//     struct CallNode : ASTNode {
-//         std::string name;
-//         vector<unique_ptr<ASTNode>> arguments;
-//
-//         CallNode(const string& name, vector<unique_ptr<ASTNode>> args)
-//             : name(name), arguments(std::move(args)) {}
-//
-//         Value evaluate(Interpreter& interpreter) override;
-//     };
-// MiLang.hpp
-    struct CallNode : ASTNode {
-        std::string name;
-        vector<unique_ptr<ASTNode>> positionalArguments;
-        std::unordered_map<std::string, std::unique_ptr<ASTNode>> namedArguments;
-
-        CallNode(const string& name, vector<unique_ptr<ASTNode>> args)
-            : name(name), positionalArguments(std::move(args)) {}
-
-        CallNode(const string& name,
-                 vector<unique_ptr<ASTNode>> positionalArgs,
-                 std::unordered_map<std::string, std::unique_ptr<ASTNode>> namedArgs)
-            : name(name), positionalArguments(std::move(positionalArgs)), namedArguments(std::move(namedArgs)) {}
-
-        Value evaluate(Interpreter& interpreter) override;
-    };
-
-
-    struct AssignNode : ASTNode {
-        std::string varName;
-        unique_ptr<ASTNode> expr;
-
-        AssignNode(const string& name, unique_ptr<ASTNode> expr)
-            : varName(name), expr(std::move(expr)) {}
-
-        Value evaluate(Interpreter& interpreter) override;
-    };
-
-
-    struct BinOpNode : ASTNode {
-        unique_ptr<ASTNode> left;
-        Token op;
-        unique_ptr<ASTNode> right;
-
-        BinOpNode(unique_ptr<ASTNode> left, Token op, unique_ptr<ASTNode> right)
-            : left(std::move(left)), op(op), right(std::move(right)) {}
-
-        Value evaluate(Interpreter& interpreter) override;
-    };
-
-
-    class ReturnException : public std::exception {
-        public:
-            Value value;
-            int line;
-
-            ReturnException(Value value, int line) : value(value), line(line) {}
-
-            const char* what() const noexcept override {
-                return "Return statement";
-            }
-        };
-
-
-    struct BlockNode : ASTNode {
-        vector<unique_ptr<ASTNode>> statements;
-
-        BlockNode(vector<unique_ptr<ASTNode>> stmts)
-            : statements(std::move(stmts)) {}
-
-        Value evaluate(Interpreter& interpreter) override {
-            Value lastResult;
-            for (auto& stmt : statements) {
-                try {
-                    lastResult = stmt->evaluate(interpreter);
-                } catch (const ReturnException& e) {
-                    throw;
-                } catch (const std::exception& e) {
-                    throw;
-                }
-            }
-            return lastResult;
-        }
-    };
-
-    struct Parameter {
-        std::string name;
-        std::shared_ptr<ASTNode> defaultValue;  // 改为 shared_ptr
-        bool hasDefault;
-
-        Parameter(const std::string& name)
-            : name(name), hasDefault(false) {}
-
-        Parameter(const std::string& name, std::shared_ptr<ASTNode> defaultValue)  // 相应修改
-            : name(name), defaultValue(std::move(defaultValue)), hasDefault(true) {}
-    };
-
-    struct FunctionDefinitionNode : ASTNode {
-        std::string name;
-        std::vector<Parameter> parameters;
-        std::unique_ptr<BlockNode> body;
-
-        FunctionDefinitionNode(const std::string& name,
-                              const std::vector<Parameter>& parameters,
-                              std::unique_ptr<BlockNode> body)
-            : name(name), parameters(parameters), body(std::move(body)) {}
-
-        Value evaluate(Interpreter& interpreter) override;
-    };
-
-
-
-    struct FunctionType {
-        std::string name;
-        std::vector<Parameter> parameters;
-        std::unique_ptr<BlockNode> body;
-
-        // 添加构造函数
-        FunctionType(const std::string& name,
-                     const std::vector<Parameter>& parameters,
-                     std::unique_ptr<BlockNode> body)
-            : name(name), parameters(parameters), body(std::move(body)) {}
-        explicit FunctionType(const std::string& name)
-                : name(name) {}
-    };
-
-
-
-    struct ReturnNode : ASTNode {
-        unique_ptr<ASTNode> expr;
-        int line;
-
-        ReturnNode(unique_ptr<ASTNode> expr, int line)
-            : expr(std::move(expr)), line(line) {}
-
-        Value evaluate(Interpreter& interpreter) override;
-    };
-
-    struct NullNode : ASTNode {
-        Value evaluate(Interpreter& interpreter) override {
-            return NullType();
-        }
-    };
-
-    struct WhileNode : ASTNode {
-        unique_ptr<ASTNode> condition;
-        unique_ptr<BlockNode> body;
-        int line;
-
-        WhileNode(unique_ptr<ASTNode> condition, unique_ptr<BlockNode> body, int line)
-            : condition(std::move(condition)), body(std::move(body)), line(line) {}
-
-        Value evaluate(Interpreter& interpreter) override;
-    };
-
-    struct ForNode : ASTNode {
-        unique_ptr<ASTNode> init;
-        unique_ptr<ASTNode> condition;
-        unique_ptr<ASTNode> update;
-        unique_ptr<BlockNode> body;
-        int line;
-
-        ForNode(unique_ptr<ASTNode> init, unique_ptr<ASTNode> condition,
-                unique_ptr<ASTNode> update, unique_ptr<BlockNode> body, int line)
-            : init(std::move(init)), condition(std::move(condition)),
-              update(std::move(update)), body(std::move(body)), line(line) {}
-
-        Value evaluate(Interpreter& interpreter) override;
-    };
-
-    struct IfNode : ASTNode {
-        struct Branch {
-            unique_ptr<ASTNode> condition;
-            unique_ptr<BlockNode> body;
-        };
-        vector<Branch> branches;
-        unique_ptr<BlockNode> elseBlock;
-
-        IfNode(vector<Branch> branches, unique_ptr<BlockNode> elseBlock)
-            : branches(std::move(branches)), elseBlock(std::move(elseBlock)) {}
-
-        Value evaluate(Interpreter& interpreter) override;
-    };
-
-    struct BreakNode : ASTNode {
-        int line;
-
-        BreakNode(int line) : line(line) {}
-
-        Value evaluate(Interpreter& interpreter) override;
-    };
-
-    struct ContinueNode : ASTNode {
-        int line;
-
-        ContinueNode(int line) : line(line) {}
-
-        Value evaluate(Interpreter& interpreter) override;
-    };
-
-
-
-
-    struct Frame {
-        unordered_map<string, Value> variables;
-        Frame* parent;
-
-        Frame(Frame* parent = nullptr) : parent(parent) {}
-
-        bool find(const string& name, Value& outValue) const {
-            auto it = variables.find(name);
-            if (it != variables.end()) {
-                outValue = it->second;
-                return true;
-            }
-
-            if (parent) {
-                return parent->find(name, outValue);
-            }
-            return false;
-        }
-
-        bool existsInCurrentScope(const string& name) const {
-            return variables.find(name) != variables.end();
-        }
-
-        void set(const string& name, const Value& value) {
-
-            Value tmp;
-            if (find(name, tmp)) {
-                Frame* target = findFrameContaining(name);
-                if (target) {
-                    target->variables[name] = value;
-                    return;
-                }
-            }
-
-            variables[name] = value;
-        }
-
-    private:
-        Frame* findFrameContaining(const string& name) const {
-            if (variables.find(name) != variables.end()) {
-                return const_cast<Frame*>(this);
-            }
-
-            if (parent) {
-                return parent->findFrameContaining(name);
-            }
-
-            return nullptr;
-        }
-    };
-
-
-    template<typename F>
-    auto wrapIMFunc(F&& func) {
-        /*
-        #  包装、注册内置函数
-        */
-        return [func = std::forward<F>(func)](InnerMethod& i, const std::vector<Value>& args) {
-            return (i.*func)(args);
-        };
-    }
-
-    template<typename F, typename Arg1>
-    auto wrapIMFuncWithArg(F&& func, Arg1&& arg1) {
-        /*
-        #  同上, 但是可带参数
-        */
-        return [func = std::forward<F>(func), arg1 = std::forward<Arg1>(arg1)](
-            InnerMethod& i, const std::vector<Value>& args
-        ) {
-            return (i.*func)(args, arg1);
-        };
-    }
-
-
+#ifndef MILANG_HPP
+    #define MILANG_HPP
+
+    #include <iostream>
+    #include <cstdlib>
+    #include <fstream>
+    #include <string>
+    #include <vector>
+    #include <unordered_map>
+    #include <variant>
+    #include <sstream>
+    #include <regex>
+    #include <stdexcept>
+    #include <cmath>
+    #include <functional>
+    #include <algorithm>
+    #include <iomanip>
+    #include <memory>
+    #include <stack>
+    #include <utility>
+    #include <cstdint>
+    #include <optional>
+    #include <limits>
+    #include <atomic>
+    #include <mutex>
+    #include <span>
+
+    #include "value/Value.hpp"
+
+    using namespace std;
+
+    const int MAX_DEAD_LOOP = 200000;
+    /*
+    #  默认的最大调用深度, 可用 --max-depth 修改
+    #  树遍历引擎每层调用都占用 C++ 栈, 另外在栈快用完时报错 (见 Stack.hpp); 字节码引擎的调用栈在堆上
+    */
+    const size_t TREE_MAX_DEPTH = 2000000;
+    const size_t VM_MAX_DEPTH = 2000000;
+    const size_t MEMO_CAPACITY = 4096;  // --memo 时每个纯函数缓存的结果数, 可用 --memo=N 修改
+    const uint32_t JIT_THRESHOLD = 1000; // --jit 时函数被调用这么多次后编译, 可用 --jit=N 修改
+    const uint16_t QUICKEN_THRESHOLD = 8;  // 节点连续这么多次看到相同的类型后特化
+    const uint8_t QUICKEN_MAX_DEOPTS = 4;  // 守卫失败这么多次后不再特化, 固定走通用路径
+    const size_t MAX_SPECIALIZATIONS = 4;  // 每个函数最多按这么多种实参类型组合特化函数体
+    const size_t PARALLEL_CHUNKS = 256;    // parallel for 把迭代范围切成的块数, 与线程数无关, 归约结果因此固定
+    const size_t MAX_TASK_THREADS = 64;    // spawn 的任务池最多创建的工作线程数
+    const size_t SPAWN_WRITE_LOG = 256;    // 两次 spawn 之间最多记录这么多次全局变量的写入, 去重后仍超过一半时重新复制全部
+    const size_t BUILTIN_INLINE_ARGS = 4;  // 不超过这么多实参的内置函数调用, 实参放在栈上的数组里
+
+
+    enum class TokenType {
+        INTEGER,      // 整数
+        FLOAT,        // 浮点数
+        STRING,       // 字符串
+        BOOLEAN,      // 布尔值
+        NULL_TYPE,         // 空值
+
+        IDENTIFIER,   // 标识符(变量名或函数名)
+        ASSIGN,       // =
+        LPAREN,       // (
+        RPAREN,       // )
+        COMMA,        // ,
+        LBRACE,       // {
+        RBRACE,       // }
+        PLUS,         // +
+        MINUS,        // -
+        MULTIPLY,     // *
+        DIVIDE,       // /
+        POWER,        // ^ (乘方)
+        PYPOWER,      // ** (Pythonic Power)
+        /*
+        :: 比较运算符
+        */
+        EQ,           // ==
+        NEQ,          // !=
+        GT,           // >
+        LT,           // <
+        GTE,          // >=
+        LTE,          // <=
+        NOT_GT,       // !> 等价于 <=
+        NOT_LT,       // !< 等价于 >=
+        NOT,          // !  非运算符
+
+        SEMICOLON,    // ; 分号
+        COLON,        // :
+        ARROW,        // -> 返回值类型注解
+
+        WHILE,
+        FOR,
+        DEF,
+        RETURN,
+        YIELD,        // 函数体里出现 yield 时函数成为生成器
+
+        IF,
+        ELIF,
+        ELSE,
+
+        BREAK,
+        CONTINUE,
+
+        INDENT,       // 缩进
+        DEDENT,       // 解除缩进
+        EOF_TOKEN,    // 文件结束
+        COUNT,        // C++ 自动计数器
+    };
+
+
+    class Lexer;
+    class Parser;
+    class InnerMethod;
+    class Interpreter;
+    struct Chunk;
+    struct Frame;
+    class MemoCache;
+    struct JitSource;
+    struct JitCode;
+
+    struct Token {
+        TokenType type;
+        std::string value;
+        int line;
+        Token(TokenType type, const string& value, int line)
+            : type(type), value(value), line(line) {}
+    };
+
+
+    /*
+    #  变量引用的静态解析结果, 由 Resolver 填写
+    #  slots 为 (层数, 槽位) 候选, 由内向外排列, 运行时取第一个已绑定的槽;
+    #  都未绑定且 global 为 true 时按名字查找全局变量
+    */
+    struct SlotRef {
+        int32_t depth;
+        int32_t slot;
+    };
+
+    struct Resolution {
+        std::vector<SlotRef> slots;
+        bool global = true;
+    };
+
+
+    /*
+    #  运行时类型反馈 (quickening), 只用于树遍历引擎
+    #
+    #  节点先按通用路径执行并记录看到的类型 (或调用目标), 连续 QUICKEN_THRESHOLD 次
+    #  相同时把 state 换成对应的特化版本. 特化版本先检查守卫, 守卫失败时回到观察状态;
+    #  失败 QUICKEN_MAX_DEOPTS 次后固定为 GENERIC. site 是 --stats 的记录, 不开启时为 nullptr
+    */
+    enum class Quick : uint8_t {
+        WARMUP,
+        GENERIC,
+        // BinOpNode
+        INT_ADD, INT_SUB, INT_MUL,
+        INT_EQ, INT_NEQ, INT_GT, INT_LT, INT_GTE, INT_LTE,
+        KERNEL,        // 其余类型组合, 直接调用分派表里的运算函数
+        // VariableNode
+        LOCAL,         // 总是候选槽位里的变量
+        GLOBAL,        // 总是全局变量, 缓存变量的地址
+        // CallNode
+        BUILTIN,
+        DIRECT,        // 总是同一个用户函数
+        // While / For / If 的条件
+        BOOL_CONDITION,
+        INT_CONDITION,
+    };
+
+    struct QuickSite;
+
+    struct Quickening {
+        Quick state = Quick::WARMUP;
+        uint8_t deopts = 0;
+        uint16_t runs = 0;
+        uintptr_t observed = 0;  // 观察到的类型组合或调用目标
+        QuickSite* site = nullptr;
+    };
+
+    struct FunctionType;
+
+    /*
+    #  调用点对某个用户函数的实参绑定方案, 第一次以这个函数为目标时算好:
+    #  命名实参按出现的顺序各自对应一个参数槽, 之后不再按名字查找, 也不再数必需的参数.
+    #  只为合法、且每个必需参数都有实参的调用建立方案; 其余调用每次都走原来的检查,
+    #  报错和求值顺序不变. 树遍历引擎和虚拟机都以 matches 为准, 回退的条件相同
+    */
+    struct BindingPlan {
+        uint64_t function = 0;               // FunctionType::id, 0 表示没有方案
+        std::vector<uint32_t> namedSlots;
+
+        bool matches(const FunctionType& func) const;
+        bool build(const FunctionType& func, size_t positional, const std::vector<const std::string*>& names);
+    };
+
+    /*
+    #  树遍历引擎执行时写入的状态 (类型反馈、缓存的地址、绑定方案、降低后的 JIT 函数体) 不放在节点里,
+    #  由执行它的解释器按节点的 NodeSite 保存 (见 Interpreter::state), 编译好的树可以同时交给多个解释器执行.
+    #
+    #  index 在存活的节点之间不重复, 节点释放后回收给新的节点, 解释器的状态表按它存取;
+    #  serial 永不重复, 表项的 serial 与节点不同时 (节点已经换了) 先清空再用.
+    #  复制出的节点 (特化的函数体、并行执行的副本) 有自己的 NodeSite, 状态从头开始
+    */
+    class NodeSite {
+    private:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        struct Pool {
+            std::mutex lock;
+            std::vector<uint32_t> released;
+            uint32_t next = 0;
+        };
+
+        // 不析构: 进程退出时静态存储期的节点仍可能归还编号
+        static Pool& pool() {
+            static Pool* instance = new Pool();
+            return *instance;
+        }
+
+        static uint32_t acquire() {
+            Pool& sites = pool();
+            std::lock_guard<std::mutex> guard(sites.lock);
+            if (sites.released.empty()) {
+                return sites.next++;
+            }
+            uint32_t index = sites.released.back();
+            sites.released.pop_back();
+            return index;
+        }
+
+        static uint64_t nextSerial() {
+            static std::atomic<uint64_t> serials{0};
+            return serials.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+
+    public:
+        uint32_t index;
+        uint64_t serial;
+
+        // 分配过的编号都小于它, 解释器按它确定状态表的大小
+        static uint32_t limit() {
+            Pool& sites = pool();
+            std::lock_guard<std::mutex> guard(sites.lock);
+            return sites.next;
+        }
+
+        NodeSite() : index(acquire()), serial(nextSerial()) {}
+        NodeSite(const NodeSite&) : NodeSite() {}
+        NodeSite(NodeSite&& other) noexcept : index(other.index), serial(other.serial) { other.index = NONE; }
+        NodeSite& operator=(const NodeSite&) { return *this; }
+        NodeSite& operator=(NodeSite&& other) noexcept {
+            std::swap(index, other.index);
+            std::swap(serial, other.serial);
+            return *this;
+        }
+
+        ~NodeSite() {
+            if (index != NONE) {
+                Pool& sites = pool();
+                std::lock_guard<std::mutex> guard(sites.lock);
+                sites.released.push_back(index);
+            }
+        }
+    };
+
+    struct NodeState {
+        uint64_t serial = 0;                  // 表项属于哪个节点, 见 NodeSite
+        Quickening quick;
+        int32_t cachedBuiltin = -1;           // CallNode, Quick::BUILTIN 时内置函数表的下标
+        Value* cachedGlobal = nullptr;        // Quick::GLOBAL / DIRECT 时变量在全局帧里的地址
+        const Frame* cachedFrame = nullptr;   // 以及这个全局帧
+        Value (*kernel)(const Value&, const Value&, int line) = nullptr;  // BinOpNode, Quick::KERNEL 的运算函数
+        BindingPlan plan;                     // CallNode
+        std::shared_ptr<JitSource> jitSource; // FunctionDefinitionNode, 第一次执行定义时降低, 之后复用
+    };
+
+    // 内置函数的实参: 调用方的数组或栈上的一段, 只在调用期间有效
+    using BuiltinArgs = span<const Value>;
+
+    /*
+    #  内置函数表里的一项. 编译期已知的宿主函数 (bind<&fn>) 存成函数指针, 调用时不经过类型擦除,
+    #  名字只在报错时使用; 其余 (内置函数的包装、运行时注册的可调用对象) 存在 std::function 里
+    */
+    class BuiltinFunction {
+    public:
+        using Thunk = Value (*)(const string& name, InnerMethod&, BuiltinArgs);
+
+        BuiltinFunction() = default;
+
+        template<typename F>
+            requires(!is_same_v<decay_t<F>, BuiltinFunction> && is_invocable_r_v<Value, F&, InnerMethod&, BuiltinArgs>)
+        BuiltinFunction(F&& func) : closure(std::forward<F>(func)) {}
+
+        BuiltinFunction(string name, Thunk thunk) : thunk(thunk), name(std::move(name)) {}
+
+        Value operator()(InnerMethod& method, BuiltinArgs args) const {
+            return thunk ? thunk(name, method, args) : closure(method, args);
+        }
+
+    private:
+        Thunk thunk = nullptr;
+        string name;
+        function<Value(InnerMethod&, BuiltinArgs)> closure;
+    };
+
+
+    struct ASTNode {
+        virtual ~ASTNode() = default;
+        virtual Value evaluate(Interpreter& interpreter) = 0;
+    };
+
+
+    /*
+    #  数字字面量存放原始的数, 每次求值时构造 Value: long double 档位的浮点数装箱,
+    #  引用计数不是原子的, 多个解释器同时执行同一棵树时不能共用节点里的一个 Value
+    */
+    struct NumberNode : ASTNode {
+        bool isFloat;
+        IntType intValue = 0;
+        FloatType floatValue = 0;
+
+        NumberNode(IntType val) : isFloat(false), intValue(val) {}
+        NumberNode(FloatType val) : isFloat(true), floatValue(val) {}
+
+        Value::Type type() const { return isFloat ? Value::FLOAT : Value::INT; }
+        Value value() const { return isFloat ? Value(floatValue) : Value(intValue); }
+
+        Value evaluate(Interpreter& interpreter) override {
+            return value();
+        }
+    };
+
+
+    struct StringNode : ASTNode {
+        StringType value;
+
+        StringNode(const StringType& val) : value(val) {}
+
+        Value evaluate(Interpreter& interpreter) override {
+            return value;
+        }
+    };
+
+    struct BooleanNode : ASTNode {
+        BoolType value;
+
+        BooleanNode(BoolType val) : value(val) {}
+
+        Value evaluate(Interpreter& interpreter) override {
+            return value;
+        }
+    };
+
+
+    struct VariableNode : ASTNode {
+        std::string name;
+        Resolution resolution;
+        int line = 0;
+        NodeSite site;
+
+        VariableNode(const string& name) : name(name) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+
+    private:
+        void quicken(Interpreter& interpreter, NodeState& state, Value* value);
+    };
+
+
+//     struct CallNode : ASTNode {
+//         std::string name;
+//         vector<unique_ptr<ASTNode>> arguments;
+//
+//         CallNode(const string& name, vector<unique_ptr<ASTNode>> args)
+//             : name(name), arguments(std::move(args)) {}
+//
+//         Value evaluate(Interpreter& interpreter) override;
+//     };
+// MiLang.hpp
+    // 命名实参按源码中出现的顺序保存, 各引擎和复制出的函数体都按这个顺序求值
+    using NamedArguments = std::vector<std::pair<std::string, std::unique_ptr<ASTNode>>>;
+
+    struct CallNode : ASTNode {
+        std::string name;
+        vector<unique_ptr<ASTNode>> positionalArguments;
+        NamedArguments namedArguments;
+        Resolution resolution;
+        bool tailCall = false;  // 形如 return f(...), 由 Resolver 标记
+        int line = 0;
+        NodeSite site;
+
+        CallNode(const string& name, vector<unique_ptr<ASTNode>> args)
+            : name(name), positionalArguments(std::move(args)) {}
+
+        CallNode(const string& name,
+                 vector<unique_ptr<ASTNode>> positionalArgs,
+                 NamedArguments namedArgs)
+            : name(name), positionalArguments(std::move(positionalArgs)), namedArguments(std::move(namedArgs)) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+        unique_ptr<Frame> bindArguments(Interpreter& interpreter, const FunctionType& func);
+
+    private:
+        Value evaluateGeneric(Interpreter& interpreter, NodeState& state);
+        Value callBuiltin(Interpreter& interpreter, size_t builtin);
+        Value callFunction(Interpreter& interpreter, FunctionTypePtr func);
+        bool planBinding(BindingPlan& plan, const FunctionType& func);
+        unique_ptr<Frame> bindChecked(Interpreter& interpreter, const FunctionType& func);
+        void quicken(Interpreter& interpreter, NodeState& state, int32_t builtin, Value* funcValue);
+    };
+
+    /*
+    #  只有一个实参的 int / float / bool / string / type 调用, 由 intrinsics pass 从 CallNode 改写而来:
+    #  不查内置函数表, 不建实参数组. call 是原来的调用, 实参是 call->positionalArguments[0]
+    */
+    struct ConvertNode : ASTNode {
+        enum Kind : uint8_t { INT, FLOAT, BOOL, STRING, TYPE };
+
+        Kind kind;
+        unique_ptr<CallNode> call;
+
+        ConvertNode(Kind kind, unique_ptr<CallNode> call) : kind(kind), call(std::move(call)) {}
+
+        ASTNode* argument() const { return call->positionalArguments[0].get(); }
+
+        Value evaluate(Interpreter& interpreter) override;
+
+        // 字节码 CONVERT 也用这个; 类型已经对时原样返回, 其余情况与对应的内置函数相同
+        static Value apply(Kind kind, const Value& value, InnerMethod& inner);
+    };
+
+    inline optional<ConvertNode::Kind> intrinsicKind(const string& name) {
+        if (name == "int") {
+            return ConvertNode::INT;
+        } else if (name == "float") {
+            return ConvertNode::FLOAT;
+        } else if (name == "bool") {
+            return ConvertNode::BOOL;
+        } else if (name == "string") {
+            return ConvertNode::STRING;
+        } else if (name == "type") {
+            return ConvertNode::TYPE;
+        }
+        return nullopt;
+    }
+
+
+    struct AssignNode : ASTNode {
+        std::string varName;
+        unique_ptr<ASTNode> expr;
+        Resolution resolution;
+
+        AssignNode(const string& name, unique_ptr<ASTNode> expr)
+            : varName(name), expr(std::move(expr)) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+
+    struct BinOpNode : ASTNode {
+        unique_ptr<ASTNode> left;
+        Token op;
+        unique_ptr<ASTNode> right;
+        NodeSite site;
+        Value (*kernel)(const Value&, const Value&, int line) = nullptr;  // TypedBinOpNode 的运算函数
+
+        BinOpNode(unique_ptr<ASTNode> left, Token op, unique_ptr<ASTNode> right)
+            : left(std::move(left)), op(op), right(std::move(right)) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+
+    private:
+        void quicken(Interpreter& interpreter, NodeState& state, const Value& leftVal, const Value& rightVal);
+    };
+
+
+    /*
+    #  语句执行后的控制流状态, 由解释器保存;
+    #  break / continue / return 只设置状态, 外层的块、循环和调用逐层检查,
+    #  异常只用于真正的错误
+    */
+    enum class Completion {
+        NORMAL,
+        BREAK,
+        CONTINUE,
+        RETURN,
+        TAIL_CALL,  // return f(...), 由外层的调用换帧后继续执行
+    };
+
+
+    /*
+    #  exit() 只结束当前程序, 不结束整个进程; 由调用解释器的一方决定怎样退出
+    #  不继承 std::exception, 不会被当作运行时错误报告
+    */
+    struct ProgramExit {
+        int code = 0;
+    };
+
+
+    struct BlockNode : ASTNode {
+        vector<unique_ptr<ASTNode>> statements;
+        bool yields = false;  // 块里 (不含内层函数定义) 有 yield, 由 Parser 标记
+
+        BlockNode(vector<unique_ptr<ASTNode>> stmts)
+            : statements(std::move(stmts)) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+    struct Parameter {
+        std::string name;
+        std::shared_ptr<ASTNode> defaultValue;  // 改为 shared_ptr
+        bool hasDefault;
+        Value::Type type = Value::EMPTY;  // 类型注解, 没有注解时为 EMPTY
+
+        Parameter(const std::string& name)
+            : name(name), hasDefault(false) {}
+
+        Parameter(const std::string& name, std::shared_ptr<ASTNode> defaultValue)  // 相应修改
+            : name(name), defaultValue(std::move(defaultValue)), hasDefault(true) {}
+    };
+
+    inline const char* typeName(Value::Type type) {
+        switch (type) {
+            case Value::INT:      return "int";
+            case Value::FLOAT:    return "float";
+            case Value::STRING:   return "string";
+            case Value::BOOL:     return "bool";
+            case Value::NONE:     return "Null";
+            case Value::FUNCTION: return "function";
+            case Value::GENERATOR: return "generator";
+            case Value::FUTURE:   return "future";
+            case Value::COUNTER:  return "counter";
+            default:              return "unknown";
+        }
+    }
+
+    /*
+    #  类型注解的检查, 在函数入口检查参数、在返回时检查返回值
+    #  int 可以传给 float 注解, 转换成 float; 其余类型必须一致
+    */
+    inline bool conformsTo(Value& value, Value::Type type) {
+        if (value.type() == type) {
+            return true;
+        }
+        if (type == Value::FLOAT && value.type() == Value::INT) {
+            value = static_cast<FloatType>(value.asInt());
+            return true;
+        }
+        return false;
+    }
+
+    [[noreturn]] inline void annotationError(const Value& value, Value::Type type, const std::string& what) {
+        throw runtime_error("Type error: " + what + " expects " + typeName(type) + ", got " + typeName(value.type()));
+    }
+
+    struct FunctionDefinitionNode : ASTNode {
+        std::string name;
+        std::vector<Parameter> parameters;
+        std::shared_ptr<BlockNode> body;  // 与执行定义时创建的函数共用, 定义可以执行多次
+        Resolution resolution;
+        int32_t frameSize = 0;  // 参数和局部变量的槽位数
+        bool pure = false;      // 由 PurityAnalysis 标记
+        bool generator = false; // 函数体里有 yield, 调用时返回生成器
+        Value::Type returnType = Value::EMPTY;  // -> 类型注解
+        NodeSite site;
+
+        FunctionDefinitionNode(const std::string& name,
+                              const std::vector<Parameter>& parameters,
+                              std::unique_ptr<BlockNode> body)
+            : name(name), parameters(parameters), body(std::move(body)) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+
+
+    inline std::atomic<uint64_t> functionIds{0};
+
+    struct FunctionType {
+        uint32_t refs = 0;
+        // 调用点缓存以编号为键: 函数释放后地址可能分配给新的函数, 编号不会重复
+        uint64_t id = functionIds.fetch_add(1, std::memory_order_relaxed) + 1;
+        std::string name;
+        std::vector<Parameter> parameters;
+        std::shared_ptr<BlockNode> body;
+        int32_t frameSize = 0;
+        std::shared_ptr<Chunk> chunk;  // 字节码引擎编译后的函数体
+        bool pure = false;
+        bool generator = false;
+        Value::Type returnType = Value::EMPTY;
+        std::shared_ptr<MemoCache> memo;  // --memo 时纯函数的结果缓存
+        std::shared_ptr<JitSource> jitSource;  // --jit 时可以编译的函数体, 放弃编译后清空
+        std::shared_ptr<JitCode> jitCode;
+        uint32_t jitCalls = 0;
+
+        // 按实参类型特化的函数体; signature 每 4 位是一个参数的类型, 未传入 (用默认值) 时为 EMPTY
+        struct Specialization {
+            uint64_t signature;
+            std::unique_ptr<BlockNode> body;
+        };
+        std::vector<Specialization> specializations;
+        bool specializable = true;  // 参数太多或函数体里有函数定义时为 false
+
+        // 添加构造函数
+        FunctionType(const std::string& name,
+                     const std::vector<Parameter>& parameters,
+                     std::shared_ptr<BlockNode> body)
+            : name(name), parameters(parameters), body(std::move(body)) {}
+        explicit FunctionType(const std::string& name)
+                : name(name) {}
+    };
+
+
+
+    inline bool BindingPlan::matches(const FunctionType& func) const {
+        return function == func.id;
+    }
+
+    // 检查与 CallNode::bindChecked 相同, 任何一项不通过就不建立方案
+    inline bool BindingPlan::build(const FunctionType& func, size_t positional,
+                                   const std::vector<const std::string*>& names) {
+        const auto& params = func.parameters;
+        function = 0;
+        namedSlots.clear();
+        if (positional > params.size()) {
+            return false;
+        }
+
+        size_t minArgs = 0;
+        for (const auto& param : params) {
+            if (!param.hasDefault) {
+                minArgs++;
+            }
+        }
+        size_t providedRequired = positional;
+        std::vector<bool> named(params.size(), false);
+        for (const std::string* name : names) {
+            size_t index = 0;
+            while (index < params.size() && params[index].name != *name) {
+                index++;
+            }
+            if (index == params.size() || index < positional) {
+                return false;
+            }
+            if (!params[index].hasDefault) {
+                providedRequired++;
+            }
+            named[index] = true;
+            namedSlots.push_back(static_cast<uint32_t>(index));
+        }
+        if (positional < minArgs && providedRequired < minArgs) {
+            namedSlots.clear();
+            return false;
+        }
+
+        for (size_t i = positional; i < params.size(); i++) {
+            if (!named[i] && !params[i].hasDefault) {
+                namedSlots.clear();
+                return false;
+            }
+        }
+        function = func.id;
+        return true;
+    }
+
+    inline void retain(FunctionType* func) {
+        if (func) {
+            func->refs++;
+        }
+    }
+
+    inline void release(FunctionType* func) {
+        if (func && --func->refs == 0) {
+            delete func;
+        }
+    }
+
+
+    /*
+    #  生成器: 调用带 yield 的函数得到的惰性序列
+    #
+    #  每次 next 从上次挂起的 yield 处继续执行函数体, 到下一个 yield 再挂起;
+    #  函数体结束 (落到末尾或 return) 后生成器结束. 挂起的状态由各引擎的子类保存:
+    #  树遍历引擎是一个 C++20 协程加上函数和循环的帧, 字节码引擎是槽位和指令位置.
+    #  has_next 需要先执行到下一个 yield, 取到的值缓存起来交给随后的 next
+    */
+    struct GeneratorType {
+        uint32_t refs = 0;
+        std::string name;
+
+        explicit GeneratorType(const std::string& name) : name(name) {}
+        virtual ~GeneratorType() = default;
+
+        // 取下一个值; 已经结束时返回 false
+        bool next(Value& out) {
+            if (peeked) {
+                peeked = false;
+                out = std::move(buffered);
+                return true;
+            }
+            return advance(out);
+        }
+
+        bool hasNext() {
+            if (!peeked) {
+                peeked = advance(buffered);
+            }
+            return peeked;
+        }
+
+    protected:
+        // 执行到下一个 yield 并返回 true; 函数体结束时返回 false
+        virtual bool resume(Value& out) = 0;
+
+    private:
+        Value buffered;
+        bool peeked = false;
+        bool running = false;
+        bool finished = false;
+
+        bool advance(Value& out) {
+            if (finished) {
+                return false;
+            }
+            if (running) {
+                throw runtime_error("Generator " + name + " is already running");
+            }
+            running = true;
+            try {
+                finished = !resume(out);
+            } catch (...) {
+                // 出错的生成器不能再继续
+                running = false;
+                finished = true;
+                throw;
+            }
+            running = false;
+            return !finished;
+        }
+    };
+
+    inline void retain(GeneratorType* gen) {
+        if (gen) {
+            gen->refs++;
+        }
+    }
+
+    inline void release(GeneratorType* gen) {
+        if (gen && --gen->refs == 0) {
+            delete gen;
+        }
+    }
+
+
+    /*
+    #  future: spawn f(...) 的结果, 对应任务池里的一个任务
+    #
+    #  future 和计数器是仅有的在线程之间共享的值, 引用计数是原子的.
+    #  join 等任务结束 (或者自己执行还没开始的任务), 返回结果在当前线程的副本;
+    #  任务出错时在 join 的线程里重新抛出
+    */
+    struct FutureType {
+        std::atomic<uint32_t> refs{0};
+        std::string name;
+
+        explicit FutureType(const std::string& name) : name(name) {}
+        virtual ~FutureType() = default;
+
+        virtual Value join() = 0;
+    };
+
+    inline void retain(FutureType* future) {
+        if (future) {
+            future->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    inline void release(FutureType* future) {
+        if (future && future->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete future;
+        }
+    }
+
+    // counter(n) 创建的原子计数器, 传给任务时共享同一个
+    struct CounterType {
+        std::atomic<uint32_t> refs{0};
+        std::atomic<IntType> value;
+
+        explicit CounterType(IntType value) : value(value) {}
+    };
+
+    inline void retain(CounterType* counter) {
+        if (counter) {
+            counter->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    inline void release(CounterType* counter) {
+        if (counter && counter->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete counter;
+        }
+    }
+
+
+
+    struct ReturnNode : ASTNode {
+        unique_ptr<ASTNode> expr;
+        int line;
+
+        ReturnNode(unique_ptr<ASTNode> expr, int line)
+            : expr(std::move(expr)), line(line) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+    // yield expr: 只能出现在函数体里, 由生成器逐条执行函数体时处理, 不会被直接求值
+    struct YieldNode : ASTNode {
+        unique_ptr<ASTNode> expr;
+        int line;
+
+        YieldNode(unique_ptr<ASTNode> expr, int line)
+            : expr(std::move(expr)), line(line) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+    /*
+    #  spawn f(...): 实参在调用方求值, 调用交给任务池, 立即得到 future
+    #  只能 spawn 用户定义的普通函数, 不能是内置函数或生成器函数
+    */
+    struct SpawnNode : ASTNode {
+        unique_ptr<CallNode> call;
+        int line;
+        bool writesGlobals = false;  // 调用的函数可能给全局变量赋值, 由 GlobalWriteAnalysis 标记
+
+        SpawnNode(unique_ptr<CallNode> call, int line)
+            : call(std::move(call)), line(line) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+    struct NullNode : ASTNode {
+        Value evaluate(Interpreter& interpreter) override {
+            return NullType();
+        }
+    };
+
+    struct WhileNode : ASTNode {
+        unique_ptr<ASTNode> condition;
+        unique_ptr<BlockNode> body;
+        int line;
+        int32_t frameSize = 0;
+        bool boolCondition = false;  // 条件一定是 bool, 由 TypeInference 标记
+        NodeSite site;
+
+        WhileNode(unique_ptr<ASTNode> condition, unique_ptr<BlockNode> body, int line)
+            : condition(std::move(condition)), body(std::move(body)), line(line) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+    struct ForNode : ASTNode {
+        unique_ptr<ASTNode> init;
+        unique_ptr<ASTNode> condition;
+        unique_ptr<ASTNode> update;
+        unique_ptr<BlockNode> body;
+        int line;
+        int32_t frameSize = 0;
+        bool boolCondition = false;
+        NodeSite site;
+
+        ForNode(unique_ptr<ASTNode> init, unique_ptr<ASTNode> condition,
+                unique_ptr<ASTNode> update, unique_ptr<BlockNode> body, int line)
+            : init(std::move(init)), condition(std::move(condition)),
+              update(std::move(update)), body(std::move(body)), line(line) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+    /*
+    #  parallel for (i = a; i < b; i = i + step) reduce(+: total, max: best):
+    #
+    #  迭代范围在进入循环时算好, 切成 PARALLEL_CHUNKS 块分给工作线程, 每个线程有自己的解释器和帧;
+    #  每块从归约的单位元开始, 结束后按块的顺序合并回外层变量. 循环体不能写其他外层变量,
+    #  不能 return, 不能在循环这一层 break, 这些由语法分析和运行时检查.
+    #  其余的遍历 (优化、类型推导、字节码、AOT) 把它当作普通的 for 循环, 按顺序执行
+    */
+    struct ParallelForNode : ForNode {
+        enum class Reduce { ADD, MUL, MIN, MAX };
+
+        // 在循环作用域里解析的名字, 由 Resolver 填写
+        struct Name {
+            std::string name;
+            Resolution resolution;
+        };
+
+        struct Reduction {
+            Reduce op;
+            Name var;
+        };
+
+        Name counter;
+        vector<Reduction> reductions;
+        vector<std::string> assigned;  // 循环体 (含内层循环) 赋值的其他名字, 外层已有时由 Resolver 报错
+        bool writesGlobals = false;    // 循环体调用的函数可能给全局变量赋值, 由 GlobalWriteAnalysis 标记
+
+        ParallelForNode(unique_ptr<ASTNode> init, unique_ptr<ASTNode> condition,
+                        unique_ptr<ASTNode> update, unique_ptr<BlockNode> body, int line)
+            : ForNode(std::move(init), std::move(condition), std::move(update), std::move(body), line) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+
+    private:
+        void run(Interpreter& interpreter);
+    };
+
+    /*
+    #  for (x in gen): 依次取生成器的值赋给 x, 生成器结束时退出循环
+    #  x 属于循环作用域, 与循环体里赋值的名字一样在循环帧里占一个槽
+    */
+    struct ForInNode : ASTNode {
+        std::string varName;
+        Resolution resolution;
+        unique_ptr<ASTNode> iterable;
+        unique_ptr<BlockNode> body;
+        int line;
+        int32_t frameSize = 0;
+
+        ForInNode(const std::string& varName, unique_ptr<ASTNode> iterable, unique_ptr<BlockNode> body, int line)
+            : varName(varName), iterable(std::move(iterable)), body(std::move(body)), line(line) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+    struct IfNode : ASTNode {
+        struct Branch {
+            unique_ptr<ASTNode> condition;
+            unique_ptr<BlockNode> body;
+            bool boolCondition = false;
+            int line = 0;
+            NodeSite site;
+        };
+        vector<Branch> branches;
+        unique_ptr<BlockNode> elseBlock;
+
+        IfNode(vector<Branch> branches, unique_ptr<BlockNode> elseBlock)
+            : branches(std::move(branches)), elseBlock(std::move(elseBlock)) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+    struct BreakNode : ASTNode {
+        int line;
+
+        BreakNode(int line) : line(line) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+    struct ContinueNode : ASTNode {
+        int line;
+
+        ContinueNode(int line) : line(line) {}
+
+        Value evaluate(Interpreter& interpreter) override;
+    };
+
+    // 语句里 (不含内层函数定义) 是否有 yield; 生成器只需要逐条执行这样的语句
+    inline bool yields(const ASTNode* node) {
+        if (dynamic_cast<const YieldNode*>(node)) {
+            return true;
+        } else if (auto* block = dynamic_cast<const BlockNode*>(node)) {
+            return block->yields;
+        } else if (auto* ifNode = dynamic_cast<const IfNode*>(node)) {
+            for (const auto& branch : ifNode->branches) {
+                if (branch.body->yields) {
+                    return true;
+                }
+            }
+            return ifNode->elseBlock && ifNode->elseBlock->yields;
+        } else if (auto* whileNode = dynamic_cast<const WhileNode*>(node)) {
+            return whileNode->body->yields;
+        } else if (auto* forNode = dynamic_cast<const ForNode*>(node)) {
+            return forNode->body->yields;
+        } else if (auto* forIn = dynamic_cast<const ForInNode*>(node)) {
+            return forIn->body->yields;
+        }
+        return false;
+    }
+
+
+
+
+    /*
+    #  全局帧用 variables 按名字存放变量;
+    #  函数和循环的帧只用 slots, 大小由 Resolver 预先算好
+    */
+    struct Frame {
+        unordered_map<string, Value> variables;
+        vector<Value> slots;  // 未绑定的槽为 Value::unbound()
+        Frame* parent;
+
+        Frame(Frame* parent = nullptr) : parent(parent) {}
+
+        bool find(const string& name, Value& outValue) const {
+            auto it = variables.find(name);
+            if (it != variables.end()) {
+                outValue = it->second;
+                return true;
+            }
+
+            if (parent) {
+                return parent->find(name, outValue);
+            }
+            return false;
+        }
+
+        bool existsInCurrentScope(const string& name) const {
+            return variables.find(name) != variables.end();
+        }
+
+        // 写回最近的同名变量, 都不存在时在当前帧创建
+        void set(const string& name, const Value& value) {
+            for (Frame* frame = this; frame; frame = frame->parent) {
+                auto it = frame->variables.find(name);
+                if (it != frame->variables.end()) {
+                    it->second = value;
+                    return;
+                }
+            }
+            variables[name] = value;
+        }
+    };
+
+
+    template<typename F>
+    auto wrapIMFunc(F&& func) {
+        /*
+        #  包装、注册内置函数
+        */
+        return [func = std::forward<F>(func)](InnerMethod& i, BuiltinArgs args) {
+            return (i.*func)(args);
+        };
+    }
+
+    template<typename F, typename Arg1>
+    auto wrapIMFuncWithArg(F&& func, Arg1&& arg1) {
+        /*
+        #  同上, 但是可带参数
+        */
+        return [func = std::forward<F>(func), arg1 = std::forward<Arg1>(arg1)](
+            InnerMethod& i, BuiltinArgs args
+        ) {
+            return (i.*func)(args, arg1);
+        };
+    }
+
+
 #endif
\ No newline at end of file
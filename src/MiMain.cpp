@@ -9,36 +9,149 @@
 #include "interpreter/InnerMethod.hpp"
 #include "binop/BinOp.hpp"
 #include "parser/Parser.hpp"
+#include "resolver/Resolver.hpp"
+#include "optimizer/Optimizer.hpp"
+#include "optimizer/Purity.hpp"
+#include "optimizer/Types.hpp"
 #include "interpreter/Interpreter.hpp"
 #include "Title.hpp"
 #include "evaluate.hpp"
+#include "Program.hpp"
 #include "utils.hpp"
 #include "colors.hpp"
+#include "vm/VM.hpp"
+#include "aot/Emitter.hpp"
+#include "aot/Build.hpp"
 
 using namespace std;
 
-using IntType = intmax_t;
-using FloatType = long double;
-using StringType = string;
-using BoolType = bool;
 const string prompt      = ">>> ";
 const string wait_prompt = "  > ";
 
 
-int main(int argc, char* argv[]) {
+static int run(int argc, char* argv[]) {
     bool isREPL;
     std::string source;
     std::string filename = "Default.mi";
+    std::string engine = "tree";
+    size_t maxDepth = 0;
+    size_t memoCapacity = 0;
+    size_t jitThreshold = 0;
+    size_t threads = max<size_t>(thread::hardware_concurrency(), 1);
+    bool emitCpp = false;
+    bool aot = false;
+    bool stats = false;
+    PassManager passes;
     int EXIT_NUM = 0;
+    vector<string> files;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--engine=", 0) == 0) {
+            engine = arg.substr(9);
+            if (engine != "tree" && engine != "vm") {
+                cerr << "Unknown engine: " << engine << " (expected tree or vm)" << endl;
+                return 1;
+            }
+        } else if (arg.rfind("--max-depth=", 0) == 0) {
+            try {
+                maxDepth = stoul(arg.substr(12));
+            } catch (const exception& e) {
+                maxDepth = 0;
+            }
+            if (maxDepth == 0) {
+                cerr << "Invalid max depth: " << arg.substr(12) << endl;
+                return 1;
+            }
+        } else if (arg == "--memo") {
+            memoCapacity = MEMO_CAPACITY;
+        } else if (arg.rfind("--memo=", 0) == 0) {
+            try {
+                memoCapacity = stoul(arg.substr(7));
+            } catch (const exception& e) {
+                memoCapacity = 0;
+            }
+            if (memoCapacity == 0) {
+                cerr << "Invalid memo capacity: " << arg.substr(7) << endl;
+                return 1;
+            }
+        } else if (arg == "--jit") {
+            jitThreshold = JIT_THRESHOLD;
+        } else if (arg.rfind("--jit=", 0) == 0) {
+            try {
+                jitThreshold = stoul(arg.substr(6));
+            } catch (const exception& e) {
+                jitThreshold = 0;
+            }
+            if (jitThreshold == 0 || jitThreshold > UINT32_MAX) {
+                cerr << "Invalid JIT threshold: " << arg.substr(6) << endl;
+                return 1;
+            }
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            try {
+                threads = stoul(arg.substr(10));
+            } catch (const exception& e) {
+                threads = 0;
+            }
+            if (threads == 0) {
+                cerr << "Invalid thread count: " << arg.substr(10) << endl;
+                return 1;
+            }
+        } else if (arg == "--emit-cpp") {
+            emitCpp = true;
+        } else if (arg == "--aot") {
+            aot = true;
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "-O0" || arg == "-O1" || arg == "-O2") {
+            passes.setLevel(arg[2] - '0');
+        } else if (arg.rfind("-fno-", 0) == 0 || arg.rfind("-f", 0) == 0) {
+            bool enable = arg.rfind("-fno-", 0) != 0;
+            string pass = arg.substr(enable ? 2 : 5);
+            if (!PassManager::isPass(pass)) {
+                cerr << "Unknown optimization pass: " << pass << endl;
+                return 1;
+            }
+            if (enable) {
+                passes.enable(pass);
+            } else {
+                passes.disable(pass);
+            }
+        } else {
+            files.push_back(arg);
+        }
+    }
+
     Interpreter interpreter;
+    VM vm(interpreter);
+    if (maxDepth > 0) {
+        interpreter.setMaxDepth(maxDepth);
+        vm.setMaxDepth(maxDepth);
+    }
+    if (memoCapacity > 0) {
+        interpreter.enableMemo(memoCapacity);
+    }
+    if (jitThreshold > 0) {
+        interpreter.getJit().enable(static_cast<uint32_t>(jitThreshold));
+    }
+    interpreter.setQuickening(passes.isEnabled("quicken"));
+    interpreter.setThreads(threads);
+    if (stats) {
+        interpreter.enableQuickStats();
+    }
 
-    if (argc != 2) {
+    if ((emitCpp || aot) && files.size() != 1) {
+        cerr << "--emit-cpp and --aot need exactly one source file" << endl;
+        return 1;
+    }
+
+    if (files.size() != 1) {
         isREPL = true;
         title();
         cout << "Type \"inner()\" for built-in function's list " << endl;
     } else {
         isREPL = false;
-        filename = argv[1];
+        filename = files[0];
         try {
             source = readFile(filename);
         } catch (const runtime_error& e) {
@@ -79,14 +192,46 @@ int main(int argc, char* argv[]) {
 
             Parser parser(lexer);
             auto program = parser.parseProgram();
+            AnalysisOptions options;
+            options.isBuiltin = [&interpreter](const string& name) {
+                return interpreter.isBuiltinFunction(name);
+            };
+            options.isExternalGlobal = [&](const string& name) {
+                return interpreter.getGlobalFrame()->variables.count(name) > 0 || vm.hasGlobal(name);
+            };
+            options.purity = memoCapacity > 0;
+            options.types = !isREPL;
+            if (auto types = analyzeProgram(*program, passes, options)) {
+                interpreter.setSpecializer(types);
+            }
+
+            if (emitCpp || aot) {
+                CppEmitter emitter([&interpreter](const string& name) {
+                    return interpreter.isBuiltinFunction(name);
+                });
+                string code = emitter.emit(*program, filename);
+                if (emitCpp) {
+                    cout << code;
+                    return 0;
+                }
+                return AotBuilder::run(AotBuilder::build(code));
+            }
 
-            Value result = interpreter.execute(std::move(program));
+            Value result;
+            if (engine == "vm") {
+                result = vm.execute(*program);
+            } else {
+                result = interpreter.execute(std::move(program));
+            }
             if (isREPL) {
                 if (holds_alternative<IntType>(result)       ||
                     holds_alternative<FloatType>(result) ||
                     holds_alternative<BoolType>(result)  ||
                     holds_alternative<NullType>(result)  ||
                     holds_alternative<FunctionTypePtr>(result)  ||
+                    holds_alternative<GeneratorPtr>(result)  ||
+                    holds_alternative<FuturePtr>(result)  ||
+                    holds_alternative<CounterPtr>(result)  ||
                     !get<StringType>(result).empty()) {
                         std::string returns = interpreter.getInnerMethod().valueToString(result);
                         if (!returns.empty()) {
@@ -96,6 +241,8 @@ int main(int argc, char* argv[]) {
                 continue;
             }
             break;
+        } catch (const ProgramExit& request) {
+            return request.code;
         } catch (const exception& e) {
             cerr << e.what() << endl;
             if (isREPL) {
@@ -107,5 +254,18 @@ int main(int argc, char* argv[]) {
     }
 
     cout << RESET << endl;
+    if (stats) {
+        // 各节点的特化状态, 只有树遍历引擎会特化
+        if (engine == "tree") {
+            cerr << interpreter.quickReport() << endl << interpreter.specializationReport() << endl;
+        } else {
+            cerr << "quicken: off (tree engine only)" << endl << "specialize: off (tree engine only)" << endl;
+        }
+    }
     return EXIT_NUM;
 }
+
+// 树遍历引擎的深递归占用 C++ 栈, 在大栈的线程里执行
+int main(int argc, char* argv[]) {
+    return runOnLargeStack([argc, argv] { return run(argc, argv); });
+}
@@ -0,0 +1,101 @@
+#ifndef PROGRAM_HPP
+    #define PROGRAM_HPP
+
+    #include "MiLang.hpp"
+    #include "lexer/Lexer.hpp"
+    #include "parser/Parser.hpp"
+    #include "resolver/Resolver.hpp"
+    #include "optimizer/Optimizer.hpp"
+    #include "optimizer/Purity.hpp"
+    #include "optimizer/Types.hpp"
+    #include "interpreter/Interpreter.hpp"
+    #include <unordered_set>
+
+    using namespace std;
+
+    // 分析程序时需要的外部信息
+    struct AnalysisOptions {
+        function<bool(const string&)> isBuiltin;
+        function<bool(const string&)> isExternalGlobal;  // 之前的输入里已经存在的全局变量, 交互模式用
+        bool purity = false;  // --memo 时标记纯函数
+        bool types = true;    // 类型推导和按实参类型特化, 交互模式下不做
+    };
+
+    /*
+    #  语法分析之后的各遍: 优化、纯函数分析、变量解析、全局变量写入分析、类型推导.
+    #  开启 specialize 时返回类型推导的结果, 由解释器在运行时按实参类型特化函数体, 否则返回 nullptr
+    */
+    inline shared_ptr<TypeInference> analyzeProgram(BlockNode& program, PassManager& passes,
+                                                    const AnalysisOptions& options) {
+        passes.run(program);
+        if (options.purity) {
+            PurityAnalysis purity(options.isExternalGlobal);
+            purity.run(program);
+        }
+        Resolver resolver(options.isExternalGlobal);
+        resolver.resolve(program);
+        GlobalWriteAnalysis writes(options.isBuiltin, options.isExternalGlobal);
+        writes.run(program);
+        if (options.types && (passes.isEnabled("types") || passes.isEnabled("specialize"))) {
+            auto types = make_shared<TypeInference>(options.isBuiltin);
+            types->run(program, passes.isEnabled("types"));
+            if (passes.isEnabled("specialize")) {
+                return types;
+            }
+        }
+        return nullptr;
+    }
+
+    /*
+    #  编译好的程序, 建好之后只读, 可以同时交给多个线程里的解释器执行
+    #
+    #  执行时的状态 (类型反馈、缓存的变量地址、降低后的 JIT 函数体) 由各解释器按 NodeSite 保存,
+    #  执行不修改语法树, Interpreter::run 直接执行这棵树, 不再复制;
+    #  类型推导的结果在特化函数体时会写入中间状态, 每个解释器一份
+    */
+    class Program {
+    private:
+        friend class Interpreter;
+
+        unique_ptr<BlockNode> tree;
+        shared_ptr<const TypeInference> types;
+
+        // 新解释器的内置函数, 名字表复制进判断函数里, 不引用任何解释器
+        static function<bool(const string&)> builtinNames() {
+            Interpreter probe;
+            unordered_set<string> names;
+            for (const auto& [name, func] : probe.getFuncList()) {
+                names.insert(name);
+            }
+            return [names](const string& name) { return names.count(name) > 0; };
+        }
+
+    public:
+        Program(unique_ptr<BlockNode> tree, shared_ptr<const TypeInference> types)
+            : tree(std::move(tree)), types(std::move(types)) {}
+
+        static shared_ptr<const Program> compile(const string& source, PassManager passes = PassManager(),
+                                                 bool purity = false) {
+            Lexer lexer(source);
+            Parser parser(lexer);
+            auto tree = parser.parseProgram();
+            AnalysisOptions options;
+            options.isBuiltin = builtinNames();
+            options.purity = purity;
+            auto types = analyzeProgram(*tree, passes, options);
+            return make_shared<const Program>(std::move(tree), std::move(types));
+        }
+
+        const BlockNode& ast() const { return *tree; }
+
+        const TypeInference* specializer() const { return types.get(); }
+    };
+
+    inline Value Interpreter::run(const Program& program) {
+        if (const TypeInference* types = program.specializer()) {
+            specializer = make_shared<TypeInference>(*types);
+        }
+        return execute(*program.tree);
+    }
+
+#endif
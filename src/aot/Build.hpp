@@ -0,0 +1,200 @@
+#ifndef AOT_BUILD_HPP
+    #define AOT_BUILD_HPP
+
+    #include "../MiLang.hpp"
+    #include <filesystem>
+    #include <cstdio>
+    #include <set>
+    #if defined(__unix__) || defined(__APPLE__)
+        #include <unistd.h>
+    #endif
+    #ifdef __APPLE__
+        #include <mach-o/dyld.h>
+    #endif
+    #ifdef _WIN32
+        #include <process.h>
+    #endif
+
+    using namespace std;
+
+    /*
+    #  --aot: 用系统的 C++ 编译器编译 --emit-cpp 的输出, 然后运行
+    #
+    #  编译结果按 (生成的代码, 编译命令, 运行时头文件的内容) 的哈希缓存, 源文件不变时直接运行缓存的程序;
+    #  生成的代码由源文件决定, 换了 mi 的版本或改了运行时 (aot/Runtime.hpp 及它 include 的头文件) 都会重新编译.
+    #  CXX 指定编译器 (默认 c++), MI_AOT_CACHE 指定缓存目录,
+    #  MI_RUNTIME_DIR 指定 aot/Runtime.hpp 所在的源码目录, 默认在 mi 可执行文件旁边的 src 里找
+    #  (build.sh 把 mi 放在仓库根目录), 找不到时再试编译 mi 时的源码目录.
+    */
+    class AotBuilder {
+    private:
+        static string env(const char* name, const string& fallback = "") {
+            const char* value = getenv(name);
+            return value && *value ? value : fallback;
+        }
+
+        static string hash(const string& text) {
+            uint64_t h = 14695981039346656037ull;  // FNV-1a
+            for (unsigned char c : text) {
+                h = (h ^ c) * 1099511628211ull;
+            }
+            stringstream ss;
+            ss << hex << setw(16) << setfill('0') << h;
+            return ss.str();
+        }
+
+        static filesystem::path cacheDirectory() {
+            string dir = env("MI_AOT_CACHE");
+            if (!dir.empty()) {
+                return dir;
+            }
+            if (string xdg = env("XDG_CACHE_HOME"); !xdg.empty()) {
+                return filesystem::path(xdg) / "milang";
+            }
+            if (string home = env("HOME"); !home.empty()) {
+                return filesystem::path(home) / ".cache" / "milang";
+            }
+            return filesystem::temp_directory_path() / "milang-aot";
+        }
+
+        // 当前可执行文件的路径, 取不到时为空
+        static filesystem::path executablePath() {
+            error_code error;
+        #if defined(__APPLE__)
+            char buffer[4096];
+            uint32_t size = sizeof(buffer);
+            if (_NSGetExecutablePath(buffer, &size) == 0) {
+                return filesystem::canonical(buffer, error);
+            }
+        #elif defined(__unix__)
+            return filesystem::read_symlink("/proc/self/exe", error);
+        #endif
+            return {};
+        }
+
+        static filesystem::path runtimeDirectory() {
+            if (string dir = env("MI_RUNTIME_DIR"); !dir.empty()) {
+                if (!filesystem::exists(filesystem::path(dir) / "aot" / "Runtime.hpp")) {
+                    throw runtime_error("AOT: cannot find aot/Runtime.hpp under " + dir + " (MI_RUNTIME_DIR)");
+                }
+                return filesystem::absolute(dir);
+            }
+            vector<filesystem::path> candidates;
+            if (filesystem::path exe = executablePath(); !exe.empty()) {
+                filesystem::path bin = exe.parent_path();
+                candidates = {bin / "src", bin.parent_path() / "src", bin};
+            }
+            candidates.push_back(filesystem::path(__FILE__).parent_path().parent_path());
+            for (const auto& dir : candidates) {
+                if (filesystem::exists(dir / "aot" / "Runtime.hpp")) {
+                    return filesystem::absolute(dir);
+                }
+            }
+            throw runtime_error("AOT: cannot find aot/Runtime.hpp next to the mi executable (set MI_RUNTIME_DIR)");
+        }
+
+        /*
+        #  aot/Runtime.hpp 和它直接、间接 include 的仓库内头文件 ("..." 形式) 的内容, 按路径排序后拼接;
+        #  作为缓存键的一部分, 运行时改了之后不会再用旧的程序
+        */
+        static string runtimeSources(const filesystem::path& root) {
+            set<filesystem::path> seen;
+            vector<filesystem::path> pending = {root / "aot" / "Runtime.hpp"};
+            while (!pending.empty()) {
+                filesystem::path file = filesystem::weakly_canonical(pending.back());
+                pending.pop_back();
+                if (!seen.insert(file).second) {
+                    continue;
+                }
+                ifstream in(file, ios::binary);
+                string line;
+                while (getline(in, line)) {
+                    size_t start = line.find_first_not_of(" \t");
+                    if (start == string::npos || line.compare(start, 8, "#include") != 0) {
+                        continue;
+                    }
+                    size_t open = line.find('"', start);
+                    size_t close = open == string::npos ? string::npos : line.find('"', open + 1);
+                    if (close != string::npos) {
+                        pending.push_back(file.parent_path() / line.substr(open + 1, close - open - 1));
+                    }
+                }
+            }
+            string sources;
+            for (const auto& file : seen) {
+                ifstream in(file, ios::binary);
+                sources += file.string() + "\n";
+                sources.append(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+            }
+            return sources;
+        }
+
+        static long processId() {
+        #ifdef _WIN32
+            return _getpid();
+        #else
+            return getpid();
+        #endif
+        }
+
+        static string quote(const filesystem::path& path) {
+            return "\"" + path.string() + "\"";
+        }
+
+    public:
+        // 返回可执行文件的路径, 缓存里没有时先编译
+        static filesystem::path build(const string& code) {
+            filesystem::path dir = cacheDirectory();
+            filesystem::create_directories(dir);
+            string compiler = env("CXX", "c++");
+            filesystem::path runtime = runtimeDirectory();
+            string flags = "-std=c++20 -O2 -pthread -w -I" + quote(runtime);
+        #ifdef MI_LONG_DOUBLE
+            flags += " -DMI_LONG_DOUBLE";  // 生成的程序与 mi 使用同一浮点档位
+        #endif
+            string key = hash(compiler + "\n" + flags + "\n" + runtimeSources(runtime) + code);
+
+            filesystem::path binary = dir / key;
+        #ifdef _WIN32
+            binary += ".exe";
+        #endif
+            if (filesystem::exists(binary)) {
+                return binary;
+            }
+
+            // 同时编译同一个程序的几个 mi 各用自己的临时文件, 只有最后的改名落在同一个路径上
+            string unique = key + "." + to_string(processId());
+            filesystem::path source = dir / (unique + ".cpp");
+            {
+                ofstream file(source, ios::binary);
+                file << code;
+                if (!file) {
+                    throw runtime_error("AOT: cannot write " + source.string());
+                }
+            }
+            // 先编译到临时文件再改名, 同时运行的另一个 mi 不会看到写了一半的程序
+            filesystem::path partial = dir / (unique + ".tmp");
+            string command = compiler + " " + flags + " " + quote(source) + " -o " + quote(partial);
+            if (system(command.c_str()) != 0) {
+                error_code ignored;
+                filesystem::remove(partial, ignored);
+                throw runtime_error("AOT: compilation failed: " + command);
+            }
+            filesystem::remove(source);
+            filesystem::rename(partial, binary);
+            return binary;
+        }
+
+        static int run(const filesystem::path& binary) {
+            cout.flush();
+        #if defined(__unix__) || defined(__APPLE__)
+            string path = binary.string();
+            execl(path.c_str(), path.c_str(), static_cast<char*>(nullptr));
+            throw runtime_error("AOT: cannot run " + path);
+        #else
+            return system(quote(binary).c_str()) == 0 ? 0 : 1;
+        #endif
+        }
+    };
+
+#endif
@@ -0,0 +1,728 @@
+#ifndef AOT_EMITTER_HPP
+    #define AOT_EMITTER_HPP
+
+    #include "../MiLang.hpp"
+    #include "../parser/Parser.hpp"
+    #include <limits>
+    #include <unordered_set>
+
+    using namespace std;
+
+    /*
+    #  --emit-cpp: 把名字解析之后的语法树翻译成 C++
+    #
+    #  生成的程序 include aot/Runtime.hpp, 值、运算和内置函数与解释器共用.
+    #  每个函数定义对应一个 C++ 函数, 它的帧是调用方准备好的 Value 数组;
+    #  循环帧是循环开头的局部数组, 变量按 Resolver 给出的候选槽访问, 全局变量是 C++ 全局变量.
+    #  顶层只定义一次、从不被赋值的函数直接调用, 其余按值经 aot::Call 调用.
+    #  return f(...) 与树遍历引擎一样不加深调用: 调用自身时跳回函数开头, 其他函数交给 aot::finish.
+    */
+    class CppEmitter {
+    private:
+        struct Expr {
+            string code;
+            bool constant = false;  // 字面量: 求值没有副作用, 也不会出错
+            bool calls = false;     // 含有函数调用, 求值可能改变变量
+        };
+
+        struct Loop {
+            string next;  // for 循环里 continue 跳到的标签; while 循环为空, 直接用 C++ 的 continue
+            bool continued = false;
+        };
+
+        function<bool(const string&)> isBuiltin;
+
+        string constants;    // 字面量和内置函数句柄
+        string infos;        // aot::Function 描述
+        string definitions;  // 函数体
+        unordered_map<string, string> globals;
+        vector<string> globalOrder;
+        unordered_map<string, string> builtins;
+        unordered_map<FunctionDefinitionNode*, int> functionIds;
+        unordered_set<FunctionDefinitionNode*> defined;
+        unordered_map<string, FunctionDefinitionNode*> direct;  // 可以直接调用的顶层函数
+        unordered_map<string, int> definitionCounts;
+        unordered_set<string> assigned;
+        int counter = 0;
+
+        // 正在生成的函数, 顶层代码时为 nullptr
+        FunctionDefinitionNode* current = nullptr;
+        vector<string> frames;  // 从外到内可见的帧, 最后一个是当前帧
+        vector<Loop> loops;
+        bool selfTail = false;
+        string out;
+        int indent = 1;
+
+        void line(const string& text) {
+            out += string(indent * 4, ' ') + text + "\n";
+        }
+
+        string fresh(const string& prefix) {
+            return prefix + to_string(counter++);
+        }
+
+        static string literal(const string& text) {
+            string result = "\"";
+            for (unsigned char c : text) {
+                if (c == '"' || c == '\\') {
+                    result += '\\';
+                    result += static_cast<char>(c);
+                } else if (c >= 0x20 && c < 0x7F) {
+                    result += static_cast<char>(c);
+                } else {
+                    // 八进制转义最多三位, 不会吞掉后面的字符
+                    char buffer[5];
+                    snprintf(buffer, sizeof(buffer), "\\%03o", c);
+                    result += buffer;
+                }
+            }
+            return result + "\"";
+        }
+
+        static string intLiteral(IntType value) {
+            if (value == numeric_limits<IntType>::min()) {
+                return "numeric_limits<IntType>::min()";
+            }
+            return "IntType(" + to_string(value) + ")";
+        }
+
+        static string floatLiteral(FloatType value) {
+            if (isnan(value)) {
+                return signbit(value) ? "-numeric_limits<FloatType>::quiet_NaN()" : "numeric_limits<FloatType>::quiet_NaN()";
+            }
+            if (isinf(value)) {
+                return value > 0 ? "numeric_limits<FloatType>::infinity()" : "-numeric_limits<FloatType>::infinity()";
+            }
+            // 十六进制浮点数字面量, 不丢精度
+            stringstream ss;
+            ss << hexfloat << static_cast<long double>(value) << "L";
+            return "FloatType(" + ss.str() + ")";
+        }
+
+        string constant(const string& init) {
+            string name = fresh("k");
+            constants += "static const Value " + name + " = " + init + ";\n";
+            return name;
+        }
+
+        string globalRef(const string& name) {
+            auto it = globals.find(name);
+            if (it != globals.end()) {
+                return it->second;
+            }
+            string id = fresh("g");
+            id += "_";
+            for (unsigned char c : name) {
+                id += isalnum(c) ? static_cast<char>(c) : '_';
+            }
+            globals[name] = id;
+            globalOrder.push_back(name);
+            return id;
+        }
+
+        string builtinRef(const string& name) {
+            auto it = builtins.find(name);
+            if (it != builtins.end()) {
+                return it->second;
+            }
+            string id = fresh("b");
+            constants += "static const size_t " + id + " = aot::runtime().builtin(" + literal(name) + ");\n";
+            builtins[name] = id;
+            return id;
+        }
+
+        string slotRef(const SlotRef& ref) const {
+            return frames[frames.size() - 1 - ref.depth] + "[" + to_string(ref.slot) + "]";
+        }
+
+        // 取第一个已绑定的候选槽, 都未绑定时取全局变量, 再没有就调用 fallback 报错
+        string lookup(const Resolution& resolution, const string& name, const string& fallback) {
+            if (resolution.slots.size() == 1 && !resolution.global) {
+                return slotRef(resolution.slots[0]);  // 函数参数, 一定已绑定
+            }
+            string code = "(";
+            for (const auto& ref : resolution.slots) {
+                string slot = slotRef(ref);
+                code += slot + ".isBound() ? " + slot + " : ";
+            }
+            if (resolution.global) {
+                string global = globalRef(name);
+                code += global + ".isBound() ? " + global + " : ";
+            }
+            return code + fallback + "(" + literal(name) + "))";
+        }
+
+        // 写回第一个已绑定的候选, 都未绑定时写当前作用域的槽 (或创建全局变量)
+        string target(const Resolution& resolution, const string& name) {
+            if (resolution.slots.empty()) {
+                return globalRef(name);
+            }
+            if (resolution.slots.size() == 1 && !resolution.global) {
+                return slotRef(resolution.slots[0]);
+            }
+            string code = "(";
+            for (const auto& ref : resolution.slots) {
+                string slot = slotRef(ref);
+                code += slot + ".isBound() ? " + slot + " : ";
+            }
+            if (resolution.global) {
+                string global = globalRef(name);
+                code += global + ".isBound() ? " + global + " : ";
+            }
+            return code + slotRef(resolution.slots.front()) + ")";
+        }
+
+        void assignTo(const Resolution& resolution, const string& name, const string& value, const string& sink) {
+            string dest = target(resolution, name);
+            bool plain = resolution.slots.empty() || (resolution.slots.size() == 1 && !resolution.global);
+            if (plain && sink.empty()) {
+                line(dest + " = " + value + ";");
+                return;
+            }
+            // 先求值, 再选择写入哪个变量
+            string tmp = fresh("v");
+            line("{");
+            indent++;
+            line("Value " + tmp + " = " + value + ";");
+            if (!sink.empty()) {
+                line(sink + " = " + tmp + ";");
+            }
+            line(dest + " = std::move(" + tmp + ");");
+            indent--;
+            line("}");
+        }
+
+        static string join(const vector<string>& parts) {
+            string result;
+            for (size_t i = 0; i < parts.size(); i++) {
+                result += (i ? ", " : "") + parts[i];
+            }
+            return result;
+        }
+
+        Expr binary(BinOpNode* binop) {
+            Expr left = expr(binop->left.get());
+            Expr right = expr(binop->right.get());
+            string head = "binop::dispatch(TokenType::" + TokenTypePrint(binop->op.type) + ", " +
+                          to_string(binop->op.line) + ", ";
+            Expr result;
+            result.calls = left.calls || right.calls;
+            if (left.constant || right.constant) {
+                result.code = head + left.code + ", " + right.code + ")";
+                result.constant = left.constant && right.constant;
+                return result;
+            }
+            // 参数的求值顺序在 C++ 里不确定, 先在 lambda 里求出左边;
+            // 右边含有调用时左边要复制一份, 调用可能改写左边的变量
+            string tmp = fresh("l");
+            result.code = "[&]() -> Value { " + string(right.calls ? "Value " : "const Value& ") + tmp +
+                          " = " + left.code + "; return " + head + tmp + ", " + right.code + "); }()";
+            return result;
+        }
+
+        // 按函数定义静态绑定实参; 个数或名字不对时返回 false, 交给 aot::Call 在运行时报错
+        bool bindStatically(CallNode* call, FunctionDefinitionNode* def, vector<string>& frame) {
+            const auto& params = def->parameters;
+            if (call->positionalArguments.size() > params.size()) {
+                return false;
+            }
+            size_t size = max(static_cast<size_t>(def->frameSize), params.size());
+            frame.assign(size, "Value::unbound()");
+            vector<bool> provided(params.size(), false);
+            for (size_t i = 0; i < call->positionalArguments.size(); i++) {
+                provided[i] = true;
+            }
+            vector<pair<size_t, ASTNode*>> named;
+            for (auto& [argName, arg] : call->namedArguments) {
+                size_t index = 0;
+                while (index < params.size() && params[index].name != argName) {
+                    index++;
+                }
+                if (index == params.size() || provided[index]) {
+                    return false;
+                }
+                provided[index] = true;
+                named.push_back({index, arg.get()});
+            }
+            for (size_t i = 0; i < params.size(); i++) {
+                if (!provided[i] && !params[i].hasDefault) {
+                    return false;
+                }
+            }
+            sort(named.begin(), named.end());
+            for (size_t i = 0; i < call->positionalArguments.size(); i++) {
+                frame[i] = expr(call->positionalArguments[i].get()).code;
+            }
+            for (auto [index, arg] : named) {
+                frame[index] = expr(arg).code;
+            }
+            return true;
+        }
+
+        FunctionDefinitionNode* directTarget(CallNode* call) {
+            auto it = direct.find(call->name);
+            if (it == direct.end() || !call->resolution.slots.empty()) {
+                return nullptr;
+            }
+            return it->second;
+        }
+
+        // tail 为 true 时生成尾调用: 用户函数不在这里执行, 由调用方的 aot::finish 接着执行
+        Expr callExpr(CallNode* call, bool tail = false) {
+            Expr result;
+            result.calls = true;
+            if (isBuiltin(call->name)) {
+                // 内置函数只接受位置参数, 命名参数不求值
+                vector<string> args;
+                for (auto& arg : call->positionalArguments) {
+                    args.push_back(expr(arg.get()).code);
+                }
+                result.code = "aot::runtime().callBuiltin(" + builtinRef(call->name) + ", {" + join(args) + "})";
+                return result;
+            }
+
+            vector<string> frame;
+            if (FunctionDefinitionNode* def = directTarget(call); def && bindStatically(call, def, frame)) {
+                string args = frame.empty() ? "nullptr"
+                    : "std::array<Value, " + to_string(frame.size()) + ">{{" + join(frame) + "}}.data()";
+                string entry = "fn" + to_string(functionIds[def]);
+                string callee = "aot::callee(" + globalRef(call->name) + ", " + literal(call->name) + ")";
+                if (tail) {
+                    result.code = "(" + callee + ", aot::tail(" + entry + ", {" + join(frame) + "}))";
+                } else {
+                    result.code = "(" + callee + ", aot::finish(" + entry + "(" + args + ")))";
+                }
+                return result;
+            }
+
+            string name = literal(call->name);
+            string tmp = fresh("c");
+            vector<string> namedNames;
+            for (auto& [argName, arg] : call->namedArguments) {
+                namedNames.push_back(literal(argName));
+            }
+            string code = "[&]() -> Value { aot::Call " + tmp + "(aot::callee(" +
+                          lookup(call->resolution, call->name, "aot::unknownFunction") + ", " + name + "), " + name +
+                          ", " + to_string(call->positionalArguments.size()) + ", {" + join(namedNames) + "}); ";
+            for (size_t i = 0; i < call->positionalArguments.size(); i++) {
+                code += tmp + "[" + to_string(i) + "] = " + expr(call->positionalArguments[i].get()).code + "; ";
+            }
+            if (!call->namedArguments.empty()) {
+                code += "if (" + tmp + ".isUser()) { ";
+                for (auto& [argName, arg] : call->namedArguments) {
+                    string slot = fresh("s");
+                    code += "{ Value& " + slot + " = " + tmp + ".named(" + literal(argName) + "); " + slot + " = " +
+                            expr(arg.get()).code + "; } ";
+                }
+                code += "} ";
+            }
+            result.code = code + "return " + tmp + (tail ? ".invokeTail(); }()" : ".invoke(); }()");
+            return result;
+        }
+
+        Expr expr(ASTNode* node) {
+            Expr result;
+            if (auto* number = dynamic_cast<NumberNode*>(node)) {
+                result.constant = true;
+                if (!number->isFloat) {
+                    result.code = "Value(" + intLiteral(number->intValue) + ")";
+                } else {
+                    result.code = constant("Value(" + floatLiteral(number->floatValue) + ")");
+                }
+            } else if (auto* str = dynamic_cast<StringNode*>(node)) {
+                result.constant = true;
+                result.code = constant("Value(StringType(" + literal(str->value) + ", " + to_string(str->value.size()) + "))");
+            } else if (auto* boolean = dynamic_cast<BooleanNode*>(node)) {
+                result.constant = true;
+                result.code = boolean->value ? "Value(true)" : "Value(false)";
+            } else if (dynamic_cast<NullNode*>(node)) {
+                result.constant = true;
+                result.code = "Value(NullType())";
+            } else if (auto* var = dynamic_cast<VariableNode*>(node)) {
+                result.code = lookup(var->resolution, var->name, "aot::undefined");
+            } else if (auto* unary = dynamic_cast<UnaryOpNode*>(node)) {
+                Expr operand = expr(unary->expr.get());
+                result.code = "aot::unary(TokenType::" + TokenTypePrint(unary->op.type) + ", " + operand.code + ")";
+                result.calls = operand.calls;
+            } else if (auto* binop = dynamic_cast<BinOpNode*>(node)) {
+                result = binary(binop);
+            } else if (auto* call = dynamic_cast<CallNode*>(node)) {
+                result = callExpr(call);
+            } else if (auto* convert = dynamic_cast<ConvertNode*>(node)) {
+                static const char* const kinds[] = {"INT", "FLOAT", "BOOL", "STRING", "TYPE"};
+                Expr operand = expr(convert->argument());
+                result.code = "aot::runtime().convert(ConvertNode::" + string(kinds[convert->kind]) + ", " +
+                              operand.code + ")";
+                result.calls = operand.calls;
+            } else if (auto* spawn = dynamic_cast<SpawnNode*>(node)) {
+                throw runtime_error("emit-cpp: spawn at line " + to_string(spawn->line) + " is not supported");
+            } else {
+                throw runtime_error("emit-cpp: unsupported expression");
+            }
+            return result;
+        }
+
+        string condition(ASTNode* node, const string& kind, int lineNumber) {
+            return "aot::truthy(" + expr(node).code + ", aot::Condition::" + kind + ", " + to_string(lineNumber) + ")";
+        }
+
+        // 循环帧: 槽位都从未绑定开始
+        string loopFrame(int32_t size) {
+            string name = fresh("l");
+            frames.push_back(name);
+            if (size > 0) {
+                vector<string> slots(size, "Value::unbound()");
+                line("Value " + name + "[" + to_string(size) + "] = {" + join(slots) + "};");
+            }
+            return name;
+        }
+
+        void loopCheck(const string& count, int lineNumber) {
+            line("if (++" + count + " > MAX_DEAD_LOOP) {");
+            line("    aot::fail(\"Possible infinite loop detected at line " + to_string(lineNumber) + "\");");
+            line("}");
+        }
+
+        void whileLoop(WhileNode* node, const string& sink) {
+            line("{");
+            indent++;
+            loopFrame(node->frameSize);
+            string count = fresh("n");
+            line("int " + count + " = 0;");
+            line("for (;;) {");
+            indent++;
+            line("if (!" + condition(node->condition.get(), "WHILE", node->line) + ") {");
+            line("    break;");
+            line("}");
+            loops.push_back({});
+            block(node->body.get(), "");
+            loops.pop_back();
+            loopCheck(count, node->line);
+            indent--;
+            line("}");
+            frames.pop_back();
+            indent--;
+            line("}");
+            if (!sink.empty()) {
+                line(sink + " = Value(IntType(0));");
+            }
+        }
+
+        void forLoop(ForNode* node, const string& sink) {
+            line("{");
+            indent++;
+            loopFrame(node->frameSize);
+            if (node->init) {
+                statement(node->init.get(), "");
+            }
+            string count = fresh("n");
+            line("int " + count + " = 0;");
+            line("for (;;) {");
+            indent++;
+            line("if (!" + condition(node->condition.get(), "FOR", node->line) + ") {");
+            line("    break;");
+            line("}");
+            Loop loop;
+            if (node->update) {
+                loop.next = fresh("next");
+            }
+            loops.push_back(loop);
+            line("{");
+            indent++;
+            block(node->body.get(), "");
+            indent--;
+            line("}");
+            loop = loops.back();
+            loops.pop_back();
+            if (node->update) {
+                statement(node->update.get(), "");
+            }
+            loopCheck(count, node->line);
+            if (loop.continued) {
+                // continue 之后执行更新语句, 但不计入循环次数
+                line("continue;");
+                indent--;
+                line(loop.next + ":");
+                indent++;
+                statement(node->update.get(), "");
+            }
+            indent--;
+            line("}");
+            frames.pop_back();
+            indent--;
+            line("}");
+            if (!sink.empty()) {
+                line(sink + " = Value(IntType(0));");
+            }
+        }
+
+        void ifStatement(IfNode* node, const string& sink) {
+            for (size_t i = 0; i < node->branches.size(); i++) {
+                auto& branch = node->branches[i];
+                line(string(i ? "} else if (" : "if (") + condition(branch.condition.get(), "IF", 0) + ") {");
+                indent++;
+                block(branch.body.get(), sink);
+                indent--;
+            }
+            if (node->elseBlock) {
+                line("} else {");
+                indent++;
+                block(node->elseBlock.get(), sink);
+                indent--;
+            } else if (!sink.empty()) {
+                line("} else {");
+                line("    " + sink + " = Value(IntType(0));");
+            }
+            line("}");
+        }
+
+        void returnStatement(ReturnNode* node) {
+            if (!current) {
+                line("(void)" + expr(node->expr.get()).code + ";");
+                line("aot::fail(\"Return statement\");");
+                return;
+            }
+            auto* call = dynamic_cast<CallNode*>(node->expr.get());
+            vector<string> frame;
+            if (call && call->tailCall && !isBuiltin(call->name) && directTarget(call) == current &&
+                bindStatically(call, current, frame)) {
+                // return 调用自身: 换上新的实参后跳回函数开头
+                selfTail = true;
+                line("{");
+                indent++;
+                line("aot::callee(" + globalRef(call->name) + ", " + literal(call->name) + ");");
+                if (!frame.empty()) {
+                    string next = fresh("t");
+                    line("Value " + next + "[" + to_string(frame.size()) + "] = {" + join(frame) + "};");
+                    line("for (size_t i = 0; i < " + to_string(frame.size()) + "; i++) {");
+                    line("    f[i] = std::move(" + next + "[i]);");
+                    line("}");
+                }
+                line("goto entry;");
+                indent--;
+                line("}");
+                return;
+            }
+            if (call && call->tailCall && !isBuiltin(call->name)) {
+                line("return " + callExpr(call, true).code + ";");
+                return;
+            }
+            line("return " + checkedResult(expr(node->expr.get()).code) + ";");
+        }
+
+        static string typeConstant(Value::Type type) {
+            switch (type) {
+                case Value::INT:    return "Value::INT";
+                case Value::FLOAT:  return "Value::FLOAT";
+                case Value::BOOL:   return "Value::BOOL";
+                default:            return "Value::STRING";
+            }
+        }
+
+        // 带返回值注解的函数在返回前检查
+        string checkedResult(const string& value) {
+            if (!current || current->returnType == Value::EMPTY) {
+                return value;
+            }
+            return "aot::checked(" + value + ", " + typeConstant(current->returnType) + ", " +
+                   literal("return value of " + current->name) + ")";
+        }
+
+        void block(BlockNode* node, const string& sink) {
+            if (node->statements.empty()) {
+                if (!sink.empty()) {
+                    line(sink + " = Value();");
+                }
+                return;
+            }
+            for (size_t i = 0; i < node->statements.size(); i++) {
+                statement(node->statements[i].get(), i + 1 == node->statements.size() ? sink : "");
+            }
+        }
+
+        // sink 不为空时, 语句的值写入 sink (函数体最后一条语句的值是函数落到末尾时的返回值)
+        void statement(ASTNode* node, const string& sink) {
+            if (auto* inner = dynamic_cast<BlockNode*>(node)) {
+                block(inner, sink);
+            } else if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                assignTo(assign->resolution, assign->varName, expr(assign->expr.get()).code, sink);
+            } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+                string info = defineFunction(def);
+                assignTo(def->resolution, def->name, "aot::runtime().functionValue(" + info + ")", "");
+                if (!sink.empty()) {
+                    line(sink + " = " + constant("Value(StringType())") + ";");
+                }
+            } else if (auto* ret = dynamic_cast<ReturnNode*>(node)) {
+                returnStatement(ret);
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                whileLoop(whileNode, sink);
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                forLoop(forNode, sink);
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                ifStatement(ifNode, sink);
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                throw runtime_error("emit-cpp: for-in loop at line " + to_string(forIn->line) + " is not supported");
+            } else if (auto* breakNode = dynamic_cast<BreakNode*>(node)) {
+                if (loops.empty()) {
+                    line("aot::fail(\"Break outside of loop at line " + to_string(breakNode->line) + "\");");
+                } else {
+                    line("break;");
+                }
+            } else if (auto* continueNode = dynamic_cast<ContinueNode*>(node)) {
+                if (loops.empty()) {
+                    line("aot::fail(\"Continue outside of loop at line " + to_string(continueNode->line) + "\");");
+                } else if (loops.back().next.empty()) {
+                    line("continue;");
+                } else {
+                    loops.back().continued = true;
+                    line("goto " + loops.back().next + ";");
+                }
+            } else {
+                Expr value = expr(node);
+                line(sink.empty() ? "(void)" + value.code + ";" : sink + " = " + value.code + ";");
+            }
+        }
+
+        string defineFunction(FunctionDefinitionNode* def) {
+            string id = "fn" + to_string(functionIds[def]);
+            string info = id + "_info";
+            if (def->body == nullptr) {
+                throw runtime_error("emit-cpp: function body of " + def->name + " is missing");
+            }
+            if (def->generator) {
+                throw runtime_error("emit-cpp: generator " + def->name + " is not supported");
+            }
+            if (!defined.insert(def).second) {
+                return info;
+            }
+
+            FunctionDefinitionNode* savedCurrent = current;
+            vector<string> savedFrames = std::move(frames);
+            vector<Loop> savedLoops = std::move(loops);
+            bool savedSelfTail = selfTail;
+            string savedOut = std::move(out);
+            int savedIndent = indent;
+            current = def;
+            frames = {"f"};
+            loops.clear();
+            selfTail = false;
+            out.clear();
+            indent = 1;
+
+            for (size_t i = 0; i < def->parameters.size(); i++) {
+                const auto& param = def->parameters[i];
+                string slot = "f[" + to_string(i) + "]";
+                line("if (!" + slot + ".isBound()) {");
+                indent++;
+                if (param.hasDefault) {
+                    line(slot + " = " + expr(param.defaultValue.get()).code + ";");
+                } else {
+                    line("aot::fail(" + literal("Missing argument for parameter: " + param.name) + ");");
+                }
+                indent--;
+                line("}");
+                if (param.type != Value::EMPTY) {
+                    line("aot::expect(" + slot + ", " + typeConstant(param.type) + ", " +
+                         literal("parameter '" + param.name + "' of " + def->name) + ");");
+                }
+            }
+            block(def->body.get(), "result");
+
+            string code = "static Value " + id + "(Value* f) {\n";
+            code += "    aot::CallDepth depth;\n";
+            code += "    Value result;\n";
+            if (selfTail) {
+                code += "entry:;\n";
+            }
+            code += out;
+            code += "    return " + checkedResult("result") + ";\n}\n\n";
+            definitions += code;
+
+            vector<string> names, defaults;
+            for (const auto& param : def->parameters) {
+                names.push_back(literal(param.name));
+                defaults.push_back(param.hasDefault ? "true" : "false");
+            }
+            infos += "static const aot::Function " + info + " = {" + literal(def->name) + ", {" + join(names) + "}, {" +
+                     join(defaults) + "}, " + to_string(max(static_cast<size_t>(def->frameSize), def->parameters.size())) +
+                     ", " + id + "};\n";
+
+            current = savedCurrent;
+            frames = std::move(savedFrames);
+            loops = std::move(savedLoops);
+            selfTail = savedSelfTail;
+            out = std::move(savedOut);
+            indent = savedIndent;
+            return info;
+        }
+
+        // 给所有函数定义编号, 记录每个名字的定义次数和是否被赋值
+        void collect(ASTNode* node) {
+            if (!node) {
+                return;
+            }
+            if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                assigned.insert(assign->varName);
+            } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+                functionIds.emplace(def, static_cast<int>(functionIds.size()));
+                definitionCounts[def->name]++;
+                collect(def->body.get());
+            } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                for (auto& stmt : block->statements) {
+                    collect(stmt.get());
+                }
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                collect(whileNode->body.get());
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                collect(forNode->init.get());
+                collect(forNode->update.get());
+                collect(forNode->body.get());
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                for (auto& branch : ifNode->branches) {
+                    collect(branch.body.get());
+                }
+                collect(ifNode->elseBlock.get());
+            }
+        }
+
+    public:
+        explicit CppEmitter(function<bool(const string&)> isBuiltin) : isBuiltin(std::move(isBuiltin)) {}
+
+        string emit(BlockNode& program, const string& filename) {
+            collect(&program);
+            for (auto& stmt : program.statements) {
+                auto* def = dynamic_cast<FunctionDefinitionNode*>(stmt.get());
+                if (def && definitionCounts[def->name] == 1 && !assigned.count(def->name) && !isBuiltin(def->name)) {
+                    direct[def->name] = def;
+                }
+            }
+
+            out.clear();
+            indent = 1;
+            block(&program, "");
+            string main = std::move(out);
+
+            string code = "// Generated by mi --emit-cpp from " + filename + "\n";
+            code += "#include \"aot/Runtime.hpp\"\n\n";
+            code += constants + "\n";
+            for (const auto& name : globalOrder) {
+                code += "static Value " + globals[name] + " = " +
+                        (isBuiltin(name) ? "aot::Runtime::builtinValue(" + literal(name) + ")" : "Value::unbound()") + ";\n";
+            }
+            code += "\n";
+            vector<pair<int, FunctionDefinitionNode*>> ordered;
+            for (auto [def, id] : functionIds) {
+                ordered.push_back({id, def});
+            }
+            sort(ordered.begin(), ordered.end());
+            for (auto [id, def] : ordered) {
+                code += "static Value fn" + to_string(id) + "(Value* f);\n";
+            }
+            code += "\n" + infos + "\n" + definitions;
+            code += "static void program() {\n" + main + "}\n\n";
+            code += "int main() {\n    return aot::run(program);\n}\n";
+            return code;
+        }
+    };
+
+#endif
@@ -0,0 +1,350 @@
+#ifndef AOT_RUNTIME_HPP
+    #define AOT_RUNTIME_HPP
+
+    #include "../MiLang.hpp"
+    #include "../interpreter/InnerMethod.hpp"
+    #include "../interpreter/Stack.hpp"
+    #include "../binop/Kernels.hpp"
+    #include "../colors.hpp"
+    #include <cstring>
+    #include <limits>
+
+    using namespace std;
+
+    /*
+    #  --emit-cpp 生成的程序链接的运行时
+    #
+    #  值、运算和内置函数与解释器共用 (Value, binop, InnerMethod),
+    #  这里只补上解释器在 Interpreter 里做的部分: 内置函数表、函数值、
+    #  按名字调用时的参数绑定、调用深度和条件判断.
+    */
+    namespace aot {
+        using Builtin = BuiltinFunction;
+
+        // 生成的用户函数: 实参和局部变量都在 frame 里, 未绑定的槽为 Value::unbound()
+        struct Function {
+            const char* name;
+            vector<const char*> parameters;
+            vector<bool> defaults;  // 对应的参数是否有默认值
+            int32_t frameSize;
+            Value (*entry)(Value* frame);
+        };
+
+        class Runtime {
+        private:
+            InnerMethod innermethod;
+            FuncVector builtins;
+            unordered_map<string, size_t> builtinIndex;
+            unordered_map<const Function*, Value> values;
+            unordered_map<const FunctionType*, const Function*> functions;
+
+            void add(const string& name, Builtin func) {
+                builtinIndex[name] = builtins.size();
+                builtins.push_back({name, std::move(func)});
+            }
+
+        public:
+            // 与 Interpreter 的内置函数表顺序一致, inner() 按这个顺序列出
+            Runtime() {
+                add("int",     wrapIMFunc(&InnerMethod::intFunction));
+                add("float",   wrapIMFunc(&InnerMethod::floatFunction));
+                add("bool",    wrapIMFunc(&InnerMethod::boolFunction));
+                add("string",  wrapIMFunc(&InnerMethod::stringFunction));
+                add("type",    wrapIMFunc(&InnerMethod::typeFunction));
+                add("receive", wrapIMFunc(&InnerMethod::receiveFunction));
+                add("clear",   wrapIMFunc(&InnerMethod::cleanScreen));
+                add("exit",    wrapIMFunc(&InnerMethod::exitFunction));
+                add("writeln", wrapIMFuncWithArg(&InnerMethod::writelnFunction, true));
+                add("write",   wrapIMFuncWithArg(&InnerMethod::writelnFunction, false));
+                add("println", wrapIMFuncWithArg(&InnerMethod::printlnFunction, true));
+                add("print",   wrapIMFuncWithArg(&InnerMethod::printlnFunction, false));
+                add("flush",   wrapIMFunc(&InnerMethod::flushFunction));
+                add("next",    wrapIMFunc(&InnerMethod::nextFunction));
+                add("has_next", wrapIMFunc(&InnerMethod::hasNextFunction));
+                add("join",    wrapIMFunc(&InnerMethod::joinFunction));
+                add("counter", wrapIMFunc(&InnerMethod::counterFunction));
+                add("counter_add", wrapIMFunc(&InnerMethod::counterAddFunction));
+                add("counter_get", wrapIMFunc(&InnerMethod::counterGetFunction));
+                auto getFuncList = [this]() -> const FuncVector& {
+                    return builtins;
+                };
+                add("inner", wrapIMFuncWithArg(&InnerMethod::funcList, getFuncList));
+                add("memo_stats", [](InnerMethod&, BuiltinArgs) -> Value {
+                    return StringType("memo: off (run with --memo)");
+                });
+                add("jit_stats", [](InnerMethod&, BuiltinArgs) -> Value {
+                    return StringType("jit: off (run with --jit)");
+                });
+            }
+
+            size_t builtin(const string& name) const {
+                auto it = builtinIndex.find(name);
+                if (it == builtinIndex.end()) {
+                    throw runtime_error("Unknown function: " + name);
+                }
+                return it->second;
+            }
+
+            Value callBuiltin(size_t index, BuiltinArgs args) {
+                return builtins[index].second(innermethod, args);
+            }
+
+            // 生成的代码传入 {a, b}, 实参数组在调用的表达式里, 不在堆上分配
+            Value callBuiltin(size_t index, initializer_list<Value> args) {
+                return callBuiltin(index, BuiltinArgs(args.begin(), args.size()));
+            }
+
+            Value convert(ConvertNode::Kind kind, const Value& value) {
+                return ConvertNode::apply(kind, value, innermethod);
+            }
+
+            // 全局变量里的内置函数, 与解释器一样是没有函数体的 FunctionType
+            static Value builtinValue(const char* name) {
+                return makeRef<FunctionType>(name);
+            }
+
+            /*
+            #  函数定义每执行一次, 解释器就创建一个新的函数值;
+            #  函数值之间不能比较, 这里每个定义只创建一个, 并记住它对应的生成函数
+            */
+            const Value& functionValue(const Function& func) {
+                auto it = values.find(&func);
+                if (it == values.end()) {
+                    Value value = makeRef<FunctionType>(func.name);
+                    functions[value.functionPtr()] = &func;
+                    it = values.emplace(&func, std::move(value)).first;
+                }
+                return it->second;
+            }
+
+            // 没有对应的生成函数时是内置函数
+            const Function* userFunction(const FunctionType* func) const {
+                auto it = functions.find(func);
+                return it == functions.end() ? nullptr : it->second;
+            }
+
+            InnerMethod& getInnerMethod() { return innermethod; }
+        };
+
+        inline Runtime& runtime() {
+            static Runtime instance;
+            return instance;
+        }
+
+        [[noreturn]] inline void fail(const string& message) {
+            throw runtime_error(message);
+        }
+
+        [[noreturn]] inline Value& undefined(const char* name) {
+            fail(string("Undefined variable: ") + name);
+        }
+
+        [[noreturn]] inline Value& unknownFunction(const char* name) {
+            fail(string("Unknown function: ") + name);
+        }
+
+        inline Value& global(Value& value, const char* name) {
+            return value.isBound() ? value : undefined(name);
+        }
+
+        // 调用目标: 已绑定且是函数
+        inline Value& callee(Value& value, const char* name) {
+            if (!value.isBound()) {
+                unknownFunction(name);
+            }
+            if (value.type() != Value::FUNCTION) {
+                fail(string(name) + " is not a function");
+            }
+            return value;
+        }
+
+        // 与树遍历引擎相同的调用深度限制, 尾调用不加深
+        inline size_t callDepth = 0;
+
+        struct CallDepth {
+            CallDepth() {
+                if (++callDepth > TREE_MAX_DEPTH) {
+                    callDepth--;
+                    fail("Maximum recursion depth exceeded (" + to_string(TREE_MAX_DEPTH) + ")");
+                }
+                if (stackExhausted()) {
+                    size_t depth = callDepth--;
+                    fail("Maximum recursion depth exceeded (stack exhausted at depth " + to_string(depth) + ")");
+                }
+            }
+            ~CallDepth() { callDepth--; }
+            CallDepth(const CallDepth&) = delete;
+            CallDepth& operator=(const CallDepth&) = delete;
+        };
+
+        enum class Condition { IF, WHILE, FOR };
+
+        inline bool truthy(const Value& value, Condition kind, int line) {
+            switch (value.type()) {
+                case Value::BOOL:   return value.asBool();
+                case Value::INT:    return value.asInt() != 0;
+                case Value::FLOAT:  return value.asFloat() != 0.0;
+                case Value::STRING: return !value.asString().empty();
+                default:
+                    if (kind == Condition::IF) {
+                        fail("Type error in if condition");
+                    }
+                    fail(string("Type error in ") + (kind == Condition::WHILE ? "while" : "for") +
+                         " condition at line " + to_string(line));
+            }
+        }
+
+        // 类型注解: 参数在函数入口检查, 返回值在 return 时检查
+        inline void expect(Value& value, Value::Type type, const char* what) {
+            if (!conformsTo(value, type)) {
+                annotationError(value, type, what);
+            }
+        }
+
+        inline Value checked(Value value, Value::Type type, const char* what) {
+            expect(value, type, what);
+            return value;
+        }
+
+        inline Value unary(TokenType type, const Value& value) {
+            return binop::unary(type, value, runtime().getInnerMethod());
+        }
+
+        /*
+        #  尾调用: 函数体以 return g(...) 结束时只记下 g 和它的帧, 返回到调用点后再执行,
+        #  与树遍历引擎一样不加深调用; 每个调用用户函数的地方都经过 finish
+        */
+        struct TailCall {
+            Value (*entry)(Value* frame) = nullptr;
+            vector<Value> frame;
+        };
+
+        inline TailCall tailCall;
+
+        inline Value finish(Value result) {
+            while (tailCall.entry) {
+                auto entry = tailCall.entry;
+                vector<Value> frame = std::move(tailCall.frame);
+                tailCall.entry = nullptr;
+                result = entry(frame.data());
+            }
+            return result;
+        }
+
+        inline Value tail(Value (*entry)(Value* frame), vector<Value> frame) {
+            tailCall.entry = entry;
+            tailCall.frame = std::move(frame);
+            return Value();
+        }
+
+        /*
+        #  通过变量调用函数: 编译时不知道调用的是哪个函数,
+        #  参数个数和命名参数的检查与 CallNode::bindArguments 一致
+        */
+        class Call {
+        private:
+            const char* name;
+            const Function* func = nullptr;  // 为 nullptr 时是内置函数
+            size_t builtin = 0;
+            size_t positional;
+            vector<Value> args;
+
+        public:
+            Call(const Value& target, const char* name, size_t positional, initializer_list<const char*> named)
+                : name(name), positional(positional) {
+                const FunctionType* funcType = target.functionPtr();
+                func = runtime().userFunction(funcType);
+                if (!func) {
+                    // 保存在变量里的内置函数, 只接受位置参数
+                    builtin = runtime().builtin(funcType->name);
+                    args.resize(positional);
+                    return;
+                }
+
+                size_t minArgs = 0;
+                size_t maxArgs = func->parameters.size();
+                for (bool hasDefault : func->defaults) {
+                    if (!hasDefault) {
+                        minArgs++;
+                    }
+                }
+                if (positional > maxArgs) {
+                    fail(string("Too many positional arguments for function ") + name +
+                         ": expected at most " + to_string(maxArgs) + ", got " + to_string(positional));
+                }
+                if (positional < minArgs) {
+                    size_t providedRequired = positional;
+                    for (size_t i = 0; i < maxArgs; i++) {
+                        if (func->defaults[i]) {
+                            continue;
+                        }
+                        for (const char* argName : named) {
+                            if (strcmp(argName, func->parameters[i]) == 0) {
+                                providedRequired++;
+                                break;
+                            }
+                        }
+                    }
+                    if (providedRequired < minArgs) {
+                        fail(string("Not enough arguments for function ") + name +
+                             ": expected at least " + to_string(minArgs) + ", got " + to_string(providedRequired));
+                    }
+                }
+                args.resize(func->frameSize, Value::unbound());
+            }
+
+            bool isUser() const { return func != nullptr; }
+
+            Value& operator[](size_t index) { return args[index]; }
+
+            Value& named(const char* paramName) {
+                size_t index = 0;
+                while (index < func->parameters.size() && strcmp(func->parameters[index], paramName) != 0) {
+                    index++;
+                }
+                if (index == func->parameters.size()) {
+                    fail(string("Unknown parameter '") + paramName + "' for function " + name);
+                }
+                if (index < positional) {
+                    fail(string("Parameter '") + paramName + "' already set by positional argument");
+                }
+                return args[index];
+            }
+
+            Value invoke() {
+                if (!func) {
+                    return runtime().callBuiltin(builtin, args);
+                }
+                return finish(func->entry(args.data()));
+            }
+
+            // return f(...) 通过变量调用时, 用户函数交给调用点的 finish 执行
+            Value invokeTail() {
+                if (!func) {
+                    return runtime().callBuiltin(builtin, args);
+                }
+                return tail(func->entry, std::move(args));
+            }
+        };
+
+        // 与 mi 一样在大栈的线程里执行
+        inline int run(void (*program)()) {
+            return runOnLargeStack([program] {
+                int exitCode = 0;
+                try {
+                    program();
+                } catch (const ProgramExit& request) {
+                    return request.code;
+                } catch (const exception& e) {
+                    runtime().getInnerMethod().output().flush();
+                    cerr << e.what() << endl;
+                    exitCode = 1;
+                }
+                runtime().getInnerMethod().output().flush();
+                cout << RESET << endl;
+                return exitCode;
+            });
+        }
+    }
+
+#endif
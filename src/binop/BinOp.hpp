@@ -1,221 +1,165 @@
-#ifndef BINOP_HPP
-#define BINOP_HPP
-
-#include "../MiLang.hpp"
-#include "../interpreter/InnerMethod.hpp"
-#include "../interpreter/Interpreter.hpp"
-
-using namespace std;
-
-
-Value BinOpNode::evaluate(Interpreter& interpreter) {
-    Value leftVal = left->evaluate(interpreter);
-    Value rightVal = right->evaluate(interpreter);
-    InnerMethod& innermethod = interpreter.getInnerMethod();
-
-    switch (op.type) {
-        case TokenType::NOT: {
-            if (holds_alternative<IntType>(rightVal)) {
-                return get<IntType>(rightVal) == 0;
-            } else if (holds_alternative<FloatType>(rightVal)) {
-                return get<FloatType>(rightVal) == 0.0;
-            } else if (holds_alternative<BoolType>(rightVal)) {
-                return !get<BoolType>(rightVal);
-            } else if (holds_alternative<StringType>(rightVal)) {
-                return get<StringType>(rightVal).empty();
-            }
-            throw runtime_error("Type error: Cannot apply '!' to this type");
-        }
-        case TokenType::PLUS: {
-            auto [a, b] = innermethod.convertToNumbers(leftVal, rightVal);
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<IntType>(leftVal) + get<IntType>(rightVal);
-            }
-            return a + b;
-        }
-        case TokenType::MINUS: {
-            auto [a, b] = innermethod.convertToNumbers(leftVal, rightVal);
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<IntType>(leftVal) - get<IntType>(rightVal);
-            }
-            return (FloatType)(a - b);
-        }
-        case TokenType::MULTIPLY: {
-            auto [a, b] = innermethod.convertToNumbers(leftVal, rightVal);
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<IntType>(leftVal) * get<IntType>(rightVal);
-            }
-            return (FloatType)a * (FloatType)b;
-        }
-        case TokenType::DIVIDE: {
-            auto [a, b] = innermethod.convertToNumbers(leftVal, rightVal);
-            if (b == 0) {
-                throw runtime_error("Division by zero (line " + to_string(op.line) + ")");
-            }
-            return (FloatType)((FloatType)a / (FloatType)b);
-        }
-        case TokenType::PYPOWER:
-        case TokenType::POWER: {
-            auto [a, b] = innermethod.convertToNumbers(leftVal, rightVal);
-            return (FloatType)pow((FloatType)a, (FloatType)b);
-        }
-        default:
-            break;
-    }
-
-    switch (op.type) {
-        case TokenType::EQ: { // ==
-            if (!innermethod.canCompare(leftVal, rightVal)) {
-                throw runtime_error("Type error: Cannot compare different types");
-            }
-
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<IntType>(leftVal) == get<IntType>(rightVal);
-            }
-            if (holds_alternative<FloatType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return get<FloatType>(leftVal) == get<FloatType>(rightVal);
-            }
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return static_cast<float>(get<IntType>(leftVal)) == get<FloatType>(rightVal);
-            }
-            if (holds_alternative<FloatType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<FloatType>(leftVal) == static_cast<float>(get<IntType>(rightVal));
-            }
-            if (holds_alternative<StringType>(leftVal) && holds_alternative<StringType>(rightVal)) {
-                return get<StringType>(leftVal) == get<StringType>(rightVal);
-            }
-            if (holds_alternative<BoolType>(leftVal) && holds_alternative<BoolType>(rightVal)) {
-                return get<BoolType>(leftVal) == get<BoolType>(rightVal);
-            }
-            return false;
-        }
-
-        case TokenType::NEQ: {
-                if (holds_alternative<IntType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                    return get<IntType>(leftVal) != get<IntType>(rightVal);
-                } else if (holds_alternative<FloatType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                    return get<FloatType>(leftVal) != get<FloatType>(rightVal);
-                } else if (holds_alternative<IntType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                    return static_cast<float>(get<IntType>(leftVal)) != get<FloatType>(rightVal);
-                } else if (holds_alternative<FloatType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                    return get<FloatType>(leftVal) != static_cast<float>(get<IntType>(rightVal));
-                } else if (holds_alternative<StringType>(leftVal) && holds_alternative<StringType>(rightVal)) {
-                    return get<StringType>(leftVal) != get<StringType>(rightVal);
-                } else if (holds_alternative<BoolType>(leftVal) && holds_alternative<BoolType>(rightVal)) {
-                    return get<BoolType>(leftVal) != get<BoolType>(rightVal);
-                }
-            throw runtime_error("Unsupported types for inequality comparison (line " + to_string(op.line) + ")");
-        }
-
-        case TokenType::GT: { // >
-            if (!innermethod.canCompare(leftVal, rightVal)) {
-                throw runtime_error("Type error: Cannot compare different types");
-            }
-
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<IntType>(leftVal) > get<IntType>(rightVal);
-            }
-            if (holds_alternative<FloatType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return get<FloatType>(leftVal) > get<FloatType>(rightVal);
-            }
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return static_cast<float>(get<IntType>(leftVal)) > get<FloatType>(rightVal);
-            }
-            if (holds_alternative<FloatType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<FloatType>(leftVal) > static_cast<float>(get<IntType>(rightVal));
-            }
-            if (holds_alternative<StringType>(leftVal) && holds_alternative<StringType>(rightVal)) {
-                return get<StringType>(leftVal) > get<StringType>(rightVal);
-            }
-            throw runtime_error("Type error: Strings do not support > operator");
-        }
-
-        case TokenType::LT: { // <
-            if (!innermethod.canCompare(leftVal, rightVal)) {
-                throw runtime_error("Type error: Cannot compare different types");
-            }
-
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<IntType>(leftVal) < get<IntType>(rightVal);
-            }
-            if (holds_alternative<FloatType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return get<FloatType>(leftVal) < get<FloatType>(rightVal);
-            }
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return static_cast<float>(get<IntType>(leftVal)) < get<FloatType>(rightVal);
-            }
-            if (holds_alternative<FloatType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<FloatType>(leftVal) < static_cast<float>(get<IntType>(rightVal));
-            }
-            if (holds_alternative<StringType>(leftVal) && holds_alternative<StringType>(rightVal)) {
-                return get<StringType>(leftVal) < get<StringType>(rightVal);
-            }
-            throw runtime_error("Type error: Strings do not support < operator");
-        }
-
-        case TokenType::GTE: {
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<IntType>(leftVal) >= get<IntType>(rightVal);
-            } else if (holds_alternative<FloatType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return get<FloatType>(leftVal) >= get<FloatType>(rightVal);
-            } else if (holds_alternative<IntType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return static_cast<float>(get<IntType>(leftVal)) >= get<FloatType>(rightVal);
-            } else if (holds_alternative<FloatType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<FloatType>(leftVal) >= static_cast<float>(get<IntType>(rightVal));
-            } else if (holds_alternative<StringType>(leftVal) && holds_alternative<StringType>(rightVal)) {
-                return get<StringType>(leftVal) >= get<StringType>(rightVal);
-            }
-            throw runtime_error("Unsupported types for greater-than-or-equal comparison (line " + to_string(op.line) + ")");
-        }
-
-        case TokenType::LTE: {
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<IntType>(leftVal) <= get<IntType>(rightVal);
-            } else if (holds_alternative<FloatType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return get<FloatType>(leftVal) <= get<FloatType>(rightVal);
-            } else if (holds_alternative<IntType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return static_cast<float>(get<IntType>(leftVal)) <= get<FloatType>(rightVal);
-            } else if (holds_alternative<FloatType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<FloatType>(leftVal) <= static_cast<float>(get<IntType>(rightVal));
-            } else if (holds_alternative<StringType>(leftVal) && holds_alternative<StringType>(rightVal)) {
-                return get<StringType>(leftVal) <= get<StringType>(rightVal);
-            }
-            throw runtime_error("Unsupported types for less-than-or-equal comparison (line " + to_string(op.line) + ")");
-        }
-
-        case TokenType::NOT_GT: {
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<IntType>(leftVal) <= get<IntType>(rightVal);
-            } else if (holds_alternative<FloatType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return get<FloatType>(leftVal) <= get<FloatType>(rightVal);
-            } else if (holds_alternative<IntType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return static_cast<float>(get<IntType>(leftVal)) <= get<FloatType>(rightVal);
-            } else if (holds_alternative<FloatType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<FloatType>(leftVal) <= static_cast<float>(get<IntType>(rightVal));
-            } else if (holds_alternative<StringType>(leftVal) && holds_alternative<StringType>(rightVal)) {
-                return get<StringType>(leftVal) <= get<StringType>(rightVal);
-            }
-            throw runtime_error("Unsupported types for not-greater-than comparison (line " + to_string(op.line) + ")");
-        }
-
-        case TokenType::NOT_LT: {
-            if (holds_alternative<IntType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<IntType>(leftVal) >= get<IntType>(rightVal);
-            } else if (holds_alternative<FloatType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return get<FloatType>(leftVal) >= get<FloatType>(rightVal);
-            } else if (holds_alternative<IntType>(leftVal) && holds_alternative<FloatType>(rightVal)) {
-                return static_cast<float>(get<IntType>(leftVal)) >= get<FloatType>(rightVal);
-            } else if (holds_alternative<FloatType>(leftVal) && holds_alternative<IntType>(rightVal)) {
-                return get<FloatType>(leftVal) >= static_cast<float>(get<IntType>(rightVal));
-            } else if (holds_alternative<StringType>(leftVal) && holds_alternative<StringType>(rightVal)) {
-                return get<StringType>(leftVal) >= get<StringType>(rightVal);
-            }
-            throw runtime_error("Unsupported types for not-less-than comparison (line " + to_string(op.line) + ")");
-        }
-
-        default:
-            throw runtime_error("Unsupported operator (line " + to_string(op.line) + ")");
-    }
-}
-
-#endif
\ No newline at end of file
+#ifndef BINOP_HPP
+#define BINOP_HPP
+
+#include "../MiLang.hpp"
+#include "../interpreter/InnerMethod.hpp"
+#include "../interpreter/Interpreter.hpp"
+#include "Kernels.hpp"
+
+using namespace std;
+
+
+Value binaryOperation(InnerMethod& innermethod, const Token& op, const Value& leftVal, const Value& rightVal) {
+    if (op.type == TokenType::NOT) {
+        if (holds_alternative<IntType>(rightVal)) {
+            return get<IntType>(rightVal) == 0;
+        } else if (holds_alternative<FloatType>(rightVal)) {
+            return get<FloatType>(rightVal) == 0.0;
+        } else if (holds_alternative<BoolType>(rightVal)) {
+            return !get<BoolType>(rightVal);
+        } else if (holds_alternative<StringType>(rightVal)) {
+            return get<StringType>(rightVal).empty();
+        }
+        throw runtime_error("Type error: Cannot apply '!' to this type");
+    }
+    return binop::dispatch(op.type, op.line, leftVal, rightVal);
+}
+
+/*
+#  二元运算的 quickening: 观察左右两侧的类型组合, 稳定后
+#  整数的 + - * 和比较特化为 IntAdd、IntLessThan 等直接计算的版本,
+#  其余组合特化为分派表里对应的运算函数; 守卫是两侧的类型.
+*/
+Value BinOpNode::evaluate(Interpreter& interpreter) {
+    Value leftVal = left->evaluate(interpreter);
+    Value rightVal = right->evaluate(interpreter);
+    bool ints = leftVal.type() == Value::INT && rightVal.type() == Value::INT;
+    NodeState& state = interpreter.state(site);
+    switch (state.quick.state) {
+        case Quick::INT_ADD:
+            if (ints) return leftVal.asInt() + rightVal.asInt();
+            break;
+        case Quick::INT_SUB:
+            if (ints) return leftVal.asInt() - rightVal.asInt();
+            break;
+        case Quick::INT_MUL:
+            if (ints) return leftVal.asInt() * rightVal.asInt();
+            break;
+        case Quick::INT_EQ:
+            if (ints) return leftVal.asInt() == rightVal.asInt();
+            break;
+        case Quick::INT_NEQ:
+            if (ints) return leftVal.asInt() != rightVal.asInt();
+            break;
+        case Quick::INT_GT:
+            if (ints) return leftVal.asInt() > rightVal.asInt();
+            break;
+        case Quick::INT_LT:
+            if (ints) return leftVal.asInt() < rightVal.asInt();
+            break;
+        case Quick::INT_GTE:
+            if (ints) return leftVal.asInt() >= rightVal.asInt();
+            break;
+        case Quick::INT_LTE:
+            if (ints) return leftVal.asInt() <= rightVal.asInt();
+            break;
+        case Quick::KERNEL:
+            if (leftVal.index() * binop::TYPE_COUNT + rightVal.index() == state.quick.observed) {
+                return state.kernel(leftVal, rightVal, op.line);
+            }
+            break;
+        case Quick::WARMUP:
+            quicken(interpreter, state, leftVal, rightVal);
+            return binop::dispatch(op.type, op.line, leftVal, rightVal);
+        default:
+            return binop::dispatch(op.type, op.line, leftVal, rightVal);
+    }
+    interpreter.deoptimize(state.quick);
+    return binop::dispatch(op.type, op.line, leftVal, rightVal);
+}
+
+namespace binop {
+    inline const char* quickOpName(Op op) {
+        static const char* const names[] = {
+            "Add", "Sub", "Mul", "Div", "Pow",
+            "Equal", "NotEqual", "GreaterThan", "LessThan", "GreaterEqual", "LessEqual",
+        };
+        return names[op];
+    }
+
+    inline string quickTypeName(Value::Type type) {
+        string name = typeName(type);
+        name[0] = static_cast<char>(toupper(name[0]));
+        return name;
+    }
+}
+
+void BinOpNode::quicken(Interpreter& interpreter, NodeState& state, const Value& leftVal, const Value& rightVal) {
+    auto describe = [this] {
+        return "binop '" + op.value + "' line " + to_string(op.line);
+    };
+    Quickening& quick = state.quick;
+    if (!interpreter.observe(quick, leftVal.index() * binop::TYPE_COUNT + rightVal.index(), describe)) {
+        return;
+    }
+    binop::Op row = binop::opRows[static_cast<size_t>(op.type)];
+    state.kernel = row == binop::NONE ? nullptr
+                 : binop::kernels[(row * binop::TYPE_COUNT + leftVal.index()) * binop::TYPE_COUNT + rightVal.index()];
+    if (!state.kernel) {
+        // 这个组合会报错, 留给通用路径给出原来的错误
+        interpreter.specialize(quick, Quick::GENERIC, "Generic", describe);
+        return;
+    }
+
+    static const Quick intStates[] = {
+        Quick::INT_ADD, Quick::INT_SUB, Quick::INT_MUL, Quick::KERNEL, Quick::KERNEL,
+        Quick::INT_EQ, Quick::INT_NEQ, Quick::INT_GT, Quick::INT_LT, Quick::INT_GTE, Quick::INT_LTE,
+    };
+    Value::Type leftType = leftVal.type();
+    Value::Type rightType = rightVal.type();
+    Quick quickState = leftType == Value::INT && rightType == Value::INT ? intStates[row] : Quick::KERNEL;
+    string name = binop::quickTypeName(leftType);
+    if (rightType != leftType) {
+        name += binop::quickTypeName(rightType);
+    }
+    interpreter.specialize(quick, quickState, name + binop::quickOpName(row), describe);
+}
+
+
+/*
+#  两侧类型已由 TypeInference 证明的二元运算, 不再按类型分派;
+#  整数的 + - * 和比较直接计算, 其余组合直接调用表中对应的运算函数
+*/
+struct TypedBinOpNode : BinOpNode {
+    TypedBinOpNode(unique_ptr<ASTNode> left, Token op, unique_ptr<ASTNode> right, binop::Kernel kernel)
+        : BinOpNode(std::move(left), op, std::move(right)) {
+        this->kernel = kernel;
+    }
+
+    Value evaluate(Interpreter& interpreter) override {
+        Value leftVal = left->evaluate(interpreter);
+        Value rightVal = right->evaluate(interpreter);
+        return kernel(leftVal, rightVal, op.line);
+    }
+};
+
+template<binop::Op OP>
+struct IntBinOpNode : BinOpNode {
+    using BinOpNode::BinOpNode;
+
+    Value evaluate(Interpreter& interpreter) override {
+        IntType a = left->evaluate(interpreter).asInt();
+        IntType b = right->evaluate(interpreter).asInt();
+        if constexpr (OP == binop::ADD) {
+            return a + b;
+        } else if constexpr (OP == binop::SUB) {
+            return a - b;
+        } else if constexpr (OP == binop::MUL) {
+            return a * b;
+        } else {
+            return binop::compare<OP>(a, b);
+        }
+    }
+};
+
+#endif
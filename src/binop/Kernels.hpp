@@ -0,0 +1,309 @@
+#ifndef BINOP_KERNELS_HPP
+#define BINOP_KERNELS_HPP
+
+#include "../MiLang.hpp"
+#include "../interpreter/InnerMethod.hpp"
+#include <array>
+
+using namespace std;
+
+/*
+#  二元运算的分派表
+#
+#  每个 (运算符, 左类型, 右类型) 组合在编译期生成一个运算函数,
+#  按 Value::index() 直接下标取出; 表里为空的组合才进入报错路径.
+#  整数与整数的运算全程不经过浮点数.
+*/
+namespace binop {
+    enum Op : uint8_t {
+        ADD, SUB, MUL, DIV, POW,
+        EQ, NEQ, GT, LT, GTE, LTE,
+        OP_COUNT,
+        NONE = OP_COUNT,
+    };
+
+    constexpr size_t TYPE_COUNT = Value::EMPTY + 1;
+
+    using Kernel = Value (*)(const Value&, const Value&, int line);
+
+    // TokenType -> 表中的运算符行; !> 与 <= 相同, !< 与 >= 相同
+    constexpr auto opRows = [] {
+        std::array<Op, static_cast<size_t>(TokenType::COUNT)> rows{};
+        rows.fill(NONE);
+        rows[static_cast<size_t>(TokenType::PLUS)] = ADD;
+        rows[static_cast<size_t>(TokenType::MINUS)] = SUB;
+        rows[static_cast<size_t>(TokenType::MULTIPLY)] = MUL;
+        rows[static_cast<size_t>(TokenType::DIVIDE)] = DIV;
+        rows[static_cast<size_t>(TokenType::POWER)] = POW;
+        rows[static_cast<size_t>(TokenType::PYPOWER)] = POW;
+        rows[static_cast<size_t>(TokenType::EQ)] = EQ;
+        rows[static_cast<size_t>(TokenType::NEQ)] = NEQ;
+        rows[static_cast<size_t>(TokenType::GT)] = GT;
+        rows[static_cast<size_t>(TokenType::LT)] = LT;
+        rows[static_cast<size_t>(TokenType::GTE)] = GTE;
+        rows[static_cast<size_t>(TokenType::NOT_LT)] = GTE;
+        rows[static_cast<size_t>(TokenType::LTE)] = LTE;
+        rows[static_cast<size_t>(TokenType::NOT_GT)] = LTE;
+        return rows;
+    }();
+
+    constexpr bool isNumeric(Value::Type type) {
+        return type == Value::INT || type == Value::FLOAT;
+    }
+
+    // 比较时整数与浮点数混合, 整数一侧转换为 FloatType
+    template<Value::Type T>
+    inline auto compareOperand(const Value& value) {
+        if constexpr (T == Value::INT) {
+            return value.asInt();
+        } else if constexpr (T == Value::FLOAT) {
+            return value.asFloat();
+        } else if constexpr (T == Value::STRING) {
+            return std::cref(value.asString());
+        } else {
+            return value.asBool();
+        }
+    }
+
+    template<Value::Type T>
+    inline FloatType numberOperand(const Value& value) {
+        if constexpr (T == Value::INT) {
+            return static_cast<FloatType>(value.asInt());
+        } else {
+            return value.asFloat();
+        }
+    }
+
+    // 平方求幂; 溢出时返回 false, 由调用方退回到 pow
+    inline bool integerPower(IntType base, IntType exponent, IntType& result) {
+        IntType acc = 1;
+        while (exponent > 0) {
+            if ((exponent & 1) && __builtin_mul_overflow(acc, base, &acc)) {
+                return false;
+            }
+            exponent >>= 1;
+            if (exponent > 0 && __builtin_mul_overflow(base, base, &base)) {
+                return false;
+            }
+        }
+        result = acc;
+        return true;
+    }
+
+    template<Op op, Value::Type L, Value::Type R>
+    constexpr Kernel arithmeticKernel() {
+        if constexpr (L == Value::INT && R == Value::INT) {
+            if constexpr (op == ADD) {
+                return [](const Value& a, const Value& b, int) -> Value { return a.asInt() + b.asInt(); };
+            } else if constexpr (op == SUB) {
+                return [](const Value& a, const Value& b, int) -> Value { return a.asInt() - b.asInt(); };
+            } else if constexpr (op == MUL) {
+                return [](const Value& a, const Value& b, int) -> Value { return a.asInt() * b.asInt(); };
+            } else if constexpr (op == DIV) {
+                return [](const Value& a, const Value& b, int line) -> Value {
+                    if (b.asInt() == 0) {
+                        throw runtime_error("Division by zero (line " + to_string(line) + ")");
+                    }
+                    return static_cast<FloatType>(a.asInt()) / static_cast<FloatType>(b.asInt());
+                };
+            } else {
+                // 乘方的结果仍是 float, 非负整数指数时按整数精确计算
+                return [](const Value& a, const Value& b, int) -> Value {
+                    IntType result;
+                    if (b.asInt() >= 0 && integerPower(a.asInt(), b.asInt(), result)) {
+                        return static_cast<FloatType>(result);
+                    }
+                    return static_cast<FloatType>(pow(static_cast<FloatType>(a.asInt()),
+                                                      static_cast<FloatType>(b.asInt())));
+                };
+            }
+        } else {
+            return [](const Value& left, const Value& right, int line) -> Value {
+                FloatType a = numberOperand<L>(left);
+                FloatType b = numberOperand<R>(right);
+                if constexpr (op == ADD) {
+                    return a + b;
+                } else if constexpr (op == SUB) {
+                    return a - b;
+                } else if constexpr (op == MUL) {
+                    return a * b;
+                } else if constexpr (op == DIV) {
+                    if (b == 0) {
+                        throw runtime_error("Division by zero (line " + to_string(line) + ")");
+                    }
+                    return a / b;
+                } else {
+                    return static_cast<FloatType>(pow(a, b));
+                }
+            };
+        }
+    }
+
+    template<Op op, typename A, typename B>
+    inline BoolType compare(const A& a, const B& b) {
+        if constexpr (op == EQ) {
+            return a == b;
+        } else if constexpr (op == NEQ) {
+            return a != b;
+        } else if constexpr (op == GT) {
+            return a > b;
+        } else if constexpr (op == LT) {
+            return a < b;
+        } else if constexpr (op == GTE) {
+            return a >= b;
+        } else {
+            return a <= b;
+        }
+    }
+
+    template<Op op, Value::Type L, Value::Type R>
+    constexpr Kernel comparisonKernel() {
+        return [](const Value& left, const Value& right, int) -> Value {
+            auto a = compareOperand<L>(left);
+            auto b = compareOperand<R>(right);
+            if constexpr (L == Value::INT && R == Value::FLOAT) {
+                return compare<op>(static_cast<FloatType>(a), b);
+            } else if constexpr (L == Value::FLOAT && R == Value::INT) {
+                return compare<op>(a, static_cast<FloatType>(b));
+            } else if constexpr (L == Value::STRING) {
+                return compare<op>(a.get(), b.get());
+            } else {
+                return compare<op>(a, b);
+            }
+        };
+    }
+
+    // 表中为空 (nullptr) 的组合交给 miss 处理
+    template<Op op, Value::Type L, Value::Type R>
+    constexpr Kernel kernel() {
+        if constexpr (op <= POW) {
+            if constexpr (isNumeric(L) && isNumeric(R)) {
+                return arithmeticKernel<op, L, R>();
+            } else {
+                return nullptr;
+            }
+        } else if constexpr (isNumeric(L) && isNumeric(R)) {
+            return comparisonKernel<op, L, R>();
+        } else if constexpr (L == Value::STRING && R == Value::STRING) {
+            return comparisonKernel<op, L, R>();
+        } else if constexpr (L == Value::BOOL && R == Value::BOOL && (op == EQ || op == NEQ)) {
+            return comparisonKernel<op, L, R>();
+        } else {
+            return nullptr;
+        }
+    }
+
+    template<size_t... I>
+    constexpr auto buildKernels(std::index_sequence<I...>) {
+        return std::array<Kernel, sizeof...(I)>{
+            kernel<static_cast<Op>(I / (TYPE_COUNT * TYPE_COUNT)),
+                   static_cast<Value::Type>(I / TYPE_COUNT % TYPE_COUNT),
+                   static_cast<Value::Type>(I % TYPE_COUNT)>()...
+        };
+    }
+
+    constexpr auto kernels = buildKernels(std::make_index_sequence<OP_COUNT * TYPE_COUNT * TYPE_COUNT>{});
+
+    inline bool comparable(const Value& a, const Value& b) {
+        if (a.type() == Value::BOOL || b.type() == Value::BOOL) {
+            return a.type() == b.type();
+        }
+        if (a.type() == Value::STRING || b.type() == Value::STRING) {
+            return a.type() == b.type();
+        }
+        return true;
+    }
+
+    // 没有对应运算函数的组合: 给出与各运算符原有一致的错误
+    [[gnu::noinline]] inline Value miss(TokenType type, int line, const Value& left, const Value& right) {
+        switch (type) {
+            case TokenType::PLUS:
+            case TokenType::MINUS:
+            case TokenType::MULTIPLY:
+            case TokenType::DIVIDE:
+            case TokenType::POWER:
+            case TokenType::PYPOWER:
+                throw runtime_error("Type error: Cannot perform math operation on string/boolean");
+            case TokenType::EQ:
+                if (!comparable(left, right)) {
+                    throw runtime_error("Type error: Cannot compare different types");
+                }
+                return false;
+            case TokenType::NEQ:
+                throw runtime_error("Unsupported types for inequality comparison (line " + to_string(line) + ")");
+            case TokenType::GT:
+            case TokenType::LT:
+                if (!comparable(left, right)) {
+                    throw runtime_error("Type error: Cannot compare different types");
+                }
+                throw runtime_error(string("Type error: Strings do not support ") +
+                                    (type == TokenType::GT ? ">" : "<") + " operator");
+            case TokenType::GTE:
+                throw runtime_error("Unsupported types for greater-than-or-equal comparison (line " + to_string(line) + ")");
+            case TokenType::LTE:
+                throw runtime_error("Unsupported types for less-than-or-equal comparison (line " + to_string(line) + ")");
+            case TokenType::NOT_GT:
+                throw runtime_error("Unsupported types for not-greater-than comparison (line " + to_string(line) + ")");
+            case TokenType::NOT_LT:
+                throw runtime_error("Unsupported types for not-less-than comparison (line " + to_string(line) + ")");
+            default:
+                throw runtime_error("Unsupported operator (line " + to_string(line) + ")");
+        }
+    }
+
+    inline Value dispatch(TokenType type, int line, const Value& left, const Value& right) {
+        Op op = opRows[static_cast<size_t>(type)];
+        // 最常见的整数运算在调用点展开, 不经过函数指针
+        if (left.type() == Value::INT && right.type() == Value::INT) {
+            IntType a = left.asInt();
+            IntType b = right.asInt();
+            switch (op) {
+                case ADD: return a + b;
+                case SUB: return a - b;
+                case MUL: return a * b;
+                case EQ:  return a == b;
+                case NEQ: return a != b;
+                case GT:  return a > b;
+                case LT:  return a < b;
+                case GTE: return a >= b;
+                case LTE: return a <= b;
+                default:  break;
+            }
+        }
+        if (op != NONE) {
+            Kernel fn = kernels[(op * TYPE_COUNT + left.index()) * TYPE_COUNT + right.index()];
+            if (fn) {
+                return fn(left, right, line);
+            }
+        }
+        return miss(type, line, left, right);
+    }
+
+    // 一元运算; 优化器折叠常量和 --emit-cpp 生成的代码也用这里的规则
+    inline Value unary(TokenType type, const Value& val, InnerMethod& innermethod) {
+        if (type == TokenType::NOT) {
+            if (holds_alternative<IntType>(val)) {
+                return get<IntType>(val) == 0;
+            } else if (holds_alternative<FloatType>(val)) {
+                return get<FloatType>(val) == 0.0;
+            } else if (holds_alternative<BoolType>(val)) {
+                return !get<BoolType>(val);
+            } else if (holds_alternative<StringType>(val)) {
+                return get<StringType>(val).empty();
+            }
+            throw runtime_error("Type error: Cannot apply '!' to type " + innermethod.getTypeName(val));
+        }
+        if (type == TokenType::MINUS) {
+            // 与 0 - x 的结果一致
+            if (holds_alternative<IntType>(val)) {
+                return IntType(0) - get<IntType>(val);
+            } else if (holds_alternative<FloatType>(val)) {
+                return FloatType(0) - get<FloatType>(val);
+            }
+            throw runtime_error("Type error: Cannot perform math operation on string/boolean");
+        }
+        throw runtime_error("Unknown unary operator");
+    }
+}
+
+#endif
@@ -1,284 +1,1027 @@
-#ifndef EVALUATE_HPP
-#define EVALUATE_HPP
-    #include "MiLang.hpp"
-    #include "interpreter/Interpreter.hpp"
-    using namespace std;
-
-    Value VariableNode::evaluate(Interpreter& interpreter) {
-        Value value;
-        if (interpreter.getVariable(name, value)) {
-            return value;
-        }
-        throw runtime_error("Undefined variable: " + name);
-    }
-
-    Value CallNode::evaluate(Interpreter& interpreter) {
-        if (interpreter.isBuiltinFunction(name)) {
-            vector<Value> args;
-            for (auto& argNode : positionalArguments) {
-                args.push_back(argNode->evaluate(interpreter));
-            }
-            return interpreter.callBuiltin(name, args);
-        }
-        
-        Value funcValue;
-        if (!interpreter.getVariable(name, funcValue)) {
-            throw runtime_error("Unknown function: " + name);
-        }
-        if (holds_alternative<FunctionTypePtr>(funcValue)) {
-            auto func = get<FunctionTypePtr>(funcValue);
-            
-            size_t minArgs = 0;
-            size_t maxArgs = func->parameters.size();
-            
-            for (const auto& param : func->parameters) {
-                if (!param.hasDefault) {
-                    minArgs++;
-                }
-            }
-            
-            if (positionalArguments.size() > maxArgs) {
-                throw runtime_error("Too many positional arguments for function " + name +
-                                   ": expected at most " + std::to_string(maxArgs) +
-                                   ", got " + std::to_string(positionalArguments.size()));
-            }
-            if (positionalArguments.size() < minArgs) {
-                
-                size_t providedRequired = positionalArguments.size();
-                for (const auto& param : func->parameters) {
-                    if (!param.hasDefault && namedArguments.find(param.name) != namedArguments.end()) {
-                        providedRequired++;
-                    }
-                }
-                if (providedRequired < minArgs) {
-                    throw runtime_error("Not enough arguments for function " + name +
-                                       ": expected at least " + std::to_string(minArgs) +
-                                       ", got " + std::to_string(providedRequired));
-                }
-            }
-            
-            interpreter.pushFrame();
-            
-            for (size_t i = 0; i < positionalArguments.size(); i++) {
-                Value argValue = positionalArguments[i]->evaluate(interpreter);
-                interpreter.setVariable(func->parameters[i].name, argValue);
-            }
-            
-            for (const auto& namedArg : namedArguments) {
-                const std::string& paramName = namedArg.first;
-                bool found = false;
-                
-                for (const auto& param : func->parameters) {
-                    if (param.name == paramName) {
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found) {
-                    throw runtime_error("Unknown parameter '" + paramName + "' for function " + name);
-                }
-                
-                size_t paramIndex = 0;
-                for (const auto& param : func->parameters) {
-                    if (param.name == paramName) {
-                        if (paramIndex < positionalArguments.size()) {
-                            throw runtime_error("Parameter '" + paramName +
-                                               "' already set by positional argument");
-                        }
-                        break;
-                    }
-                    paramIndex++;
-                }
-                
-                Value argValue = namedArg.second->evaluate(interpreter);
-                interpreter.setVariable(paramName, argValue);
-            }
-            
-            for (size_t i = positionalArguments.size(); i < func->parameters.size(); i++) {
-                const auto& param = func->parameters[i];
-                
-                if (namedArguments.find(param.name) != namedArguments.end()) {
-                    continue;
-                }
-                if (param.hasDefault) {
-                    Value defaultValue = param.defaultValue->evaluate(interpreter);
-                    interpreter.setVariable(param.name, defaultValue);
-                } else {
-                    
-                    if (namedArguments.find(param.name) == namedArguments.end()) {
-                        throw runtime_error("Missing argument for parameter: " + param.name);
-                    }
-                }
-            }
-            
-            Value result;
-            try {
-                result = func->body->evaluate(interpreter);
-            } catch (const ReturnException& e) {
-                result = e.value; 
-            }
-            
-            interpreter.popFrame();
-            return result;
-        } else {
-            throw runtime_error(name + " is not a function");
-        }
-    }
-
-
-    Value ReturnNode::evaluate(Interpreter& interpreter) {
-        Value value = expr->evaluate(interpreter);
-        throw ReturnException(value, line); 
-    }
-
-
-    Value AssignNode::evaluate(Interpreter& interpreter) {
-        Value value = expr->evaluate(interpreter);
-        interpreter.setVariable(varName, value);
-        return value;
-    }
-
-
-    Value WhileNode::evaluate(Interpreter& interpreter) {
-        interpreter.pushFrame();
-        int loopCount = 0;
-        while (true) {
-            try{
-                Value condValue = condition->evaluate(interpreter);
-                InnerMethod& inner = interpreter.getInnerMethod();
-                bool conditionTrue = false;
-                if (holds_alternative<IntType>(condValue)) {
-                    conditionTrue = (get<IntType>(condValue) != 0);
-                } else if (holds_alternative<FloatType>(condValue)) {
-                    conditionTrue = (get<FloatType>(condValue) != 0.0);
-                } else if (holds_alternative<BoolType>(condValue)) {
-                    conditionTrue = get<BoolType>(condValue);
-                } else if (holds_alternative<StringType>(condValue)) {
-                    conditionTrue = !get<StringType>(condValue).empty();
-                } else {
-                    throw runtime_error("Type error in while condition at line " + to_string(line));
-                }
-                if (!conditionTrue) {
-                    break;
-                }
-                body->evaluate(interpreter);
-            } catch (const runtime_error& e) {
-                string errMsg = e.what();
-                if (errMsg.find("Break outside of loop") != string::npos) {
-                    break;
-                } else if (errMsg.find("Continue outside of loop") != string::npos) {
-                    continue;
-                } else {
-                    throw;
-                }
-            }
-            if (++loopCount > MAX_DEAD_LOOP) {
-                throw runtime_error("Possible infinite loop detected at line " + to_string(line));
-            }
-        }
-
-        interpreter.popFrame();
-        
-        return 0; 
-    }
-    
-    Value ForNode::evaluate(Interpreter& interpreter) {
-        interpreter.pushFrame();
-        try {
-            
-            if (init) {
-                init->evaluate(interpreter);
-            }
-            int loopCount = 0;
-            while (true) {
-                try {
-                    Value condValue = condition->evaluate(interpreter);
-                    InnerMethod& inner = interpreter.getInnerMethod();
-                    bool conditionTrue = false;
-                    if (holds_alternative<IntType>(condValue)) {
-                        conditionTrue = (get<IntType>(condValue) != 0);
-                    } else if (holds_alternative<FloatType>(condValue)) {
-                        conditionTrue = (get<FloatType>(condValue) != 0.0);
-                    } else if (holds_alternative<BoolType>(condValue)) {
-                        conditionTrue = get<BoolType>(condValue);
-                    } else if (holds_alternative<StringType>(condValue)) {
-                        conditionTrue = !get<StringType>(condValue).empty();
-                    } else {
-                        throw runtime_error("Type error in for condition at line " + to_string(line));
-                    }
-                    if (!conditionTrue) {
-                        break;
-                    }
-                    body->evaluate(interpreter);
-                } catch (const runtime_error& e) {
-                    string errMsg = e.what();
-                    if (errMsg.find("Break outside of loop") != string::npos) {
-                        break;
-                    } else if (errMsg.find("Continue outside of loop") != string::npos) {
-                        if (update) {
-                            update->evaluate(interpreter);
-                        }
-                        continue;
-                    } else {
-                        throw;
-                    }
-                }
-                if (update) {
-                    update->evaluate(interpreter);
-                }
-                if (++loopCount > MAX_DEAD_LOOP) {
-                    throw runtime_error("Possible infinite loop detected at line " + to_string(line));
-                }
-            }
-        } catch (...) {
-            interpreter.popFrame(); 
-            throw;
-        }
-        
-        interpreter.popFrame();
-        return 0; 
-    }
-
-    Value IfNode::evaluate(Interpreter& interpreter) {
-        for (auto& branch : branches) {
-            Value conditionValue = branch.condition->evaluate(interpreter);
-            InnerMethod& inner = interpreter.getInnerMethod();
-            
-            bool conditionTrue = false;
-            if (holds_alternative<IntType>(conditionValue)) {
-                conditionTrue = (get<IntType>(conditionValue) != 0);
-            } else if (holds_alternative<FloatType>(conditionValue)) {
-                conditionTrue = (get<FloatType>(conditionValue) != 0.0);
-            } else if (holds_alternative<BoolType>(conditionValue)) {
-                conditionTrue = get<BoolType>(conditionValue);
-            } else if (holds_alternative<StringType>(conditionValue)) {
-                conditionTrue = !get<StringType>(conditionValue).empty();
-            } else {
-                throw runtime_error("Type error in if condition");
-            }
-            if (conditionTrue) {
-                return branch.body->evaluate(interpreter);
-            }
-        }
-        if (elseBlock) {
-            return elseBlock->evaluate(interpreter);
-        }
-        return 0; 
-    }
-
-    Value BreakNode::evaluate(Interpreter& interpreter) {
-        throw runtime_error("Break outside of loop at line " + to_string(line));
-    }
-
-    Value ContinueNode::evaluate(Interpreter& interpreter) {
-        throw runtime_error("Continue outside of loop at line " + to_string(line));
-    }
-
-    Value FunctionDefinitionNode::evaluate(Interpreter& interpreter) {
-        
-        auto func = std::make_shared<FunctionType>(name, parameters, std::move(body));
-        interpreter.setVariable(name, func);
-        
-        return StringType("");
-    }
-#endif
+#ifndef EVALUATE_HPP
+#define EVALUATE_HPP
+    #include "MiLang.hpp"
+    #include "interpreter/Interpreter.hpp"
+    #include "interpreter/Generator.hpp"
+    #include "jit/Lower.hpp"
+    #include "optimizer/Types.hpp"
+    #include "optimizer/Clone.hpp"
+    #include "parallel/Pool.hpp"
+    #include "parallel/Worker.hpp"
+    #include "parallel/Task.hpp"
+    using namespace std;
+
+    /*
+    #  变量的 quickening: 总是命中候选槽位时特化为 Local, 不再查找全局变量;
+    #  总是落到全局变量时特化为 Global, 缓存变量在全局帧里的地址 (全局变量不会被删除),
+    #  守卫是候选槽位都未绑定
+    */
+    Value VariableNode::evaluate(Interpreter& interpreter) {
+        NodeState& state = interpreter.state(site);
+        switch (state.quick.state) {
+            case Quick::LOCAL:
+                if (Value* value = interpreter.lookupSlots(resolution)) {
+                    return *value;
+                }
+                interpreter.deoptimize(state.quick);
+                break;
+            case Quick::GLOBAL:
+                if (state.cachedFrame == interpreter.getGlobalFrame() && !interpreter.lookupSlots(resolution)) {
+                    return *state.cachedGlobal;
+                }
+                interpreter.deoptimize(state.quick);
+                break;
+            default:
+                break;
+        }
+        Value* value = interpreter.lookup(resolution, name);
+        if (!value) {
+            throw runtime_error("Undefined variable: " + name);
+        }
+        if (state.quick.state == Quick::WARMUP) {
+            quicken(interpreter, state, value);
+        }
+        return *value;
+    }
+
+    void VariableNode::quicken(Interpreter& interpreter, NodeState& state, Value* value) {
+        auto describe = [this] {
+            return "variable " + name + " line " + to_string(line);
+        };
+        Quickening& quick = state.quick;
+        bool global = interpreter.lookupSlots(resolution) == nullptr;
+        if (!interpreter.observe(quick, global, describe)) {
+            return;
+        }
+        if (global) {
+            state.cachedGlobal = value;
+            state.cachedFrame = interpreter.getGlobalFrame();
+            interpreter.specialize(quick, Quick::GLOBAL, "Global", describe);
+        } else {
+            interpreter.specialize(quick, Quick::LOCAL, "Local", describe);
+        }
+    }
+
+    Value BlockNode::evaluate(Interpreter& interpreter) {
+        Value lastResult;
+        for (auto& stmt : statements) {
+            lastResult = stmt->evaluate(interpreter);
+            if (interpreter.interrupted()) {
+                break;
+            }
+        }
+        return lastResult;
+    }
+
+    static void checkReturn(const FunctionType& func, Value& result) {
+        if (func.returnType != Value::EMPTY && !conformsTo(result, func.returnType)) {
+            annotationError(result, func.returnType, "return value of " + func.name);
+        }
+    }
+
+    /*
+    #  按这次调用的实参类型选择函数体: 第一次遇到一种类型组合时复制函数体, 按这些类型特化;
+    #  每个函数最多 MAX_SPECIALIZATIONS 种, 之后新的组合使用原来的函数体
+    */
+    static BlockNode* specializedBody(Interpreter& interpreter, FunctionType& func, const Frame& frame) {
+        TypeInference* types = interpreter.getSpecializer();
+        if (!types || !func.specializable) {
+            return func.body.get();
+        }
+        size_t count = func.parameters.size();
+        if (count > 16) {
+            func.specializable = false;
+            return func.body.get();
+        }
+        uint64_t signature = 0;
+        for (size_t i = 0; i < count; i++) {
+            signature |= static_cast<uint64_t>(frame.slots[i].type()) << (4 * i);
+        }
+        for (auto& spec : func.specializations) {
+            if (spec.signature == signature) {
+                return spec.body.get();
+            }
+        }
+        if (func.specializations.size() >= MAX_SPECIALIZATIONS) {
+            return func.body.get();
+        }
+
+        TreeCloner cloner;
+        auto body = cloner.cloneBlock(func.body.get());
+        if (!cloner.ok()) {
+            func.specializable = false;
+            return func.body.get();
+        }
+        vector<Value::Type> argTypes;
+        for (size_t i = 0; i < count; i++) {
+            argTypes.push_back(frame.slots[i].type());
+        }
+        types->specializeBody(func.parameters, argTypes, *body);
+        interpreter.noteSpecialization(func, argTypes);
+        func.specializations.push_back({signature, std::move(body)});
+        return func.specializations.back().body.get();
+    }
+
+    // 未传入的参数取默认值 (在被调函数的帧里求值), 带类型注解的参数只在入口检查一次
+    static void bindDefaults(Interpreter& interpreter, const FunctionType& func, Frame& frame) {
+        for (size_t i = 0; i < func.parameters.size(); i++) {
+            const auto& param = func.parameters[i];
+
+            if (!frame.slots[i].isBound()) {
+                if (param.hasDefault) {
+                    frame.slots[i] = param.defaultValue->evaluate(interpreter);
+                } else {
+                    throw runtime_error("Missing argument for parameter: " + param.name);
+                }
+            }
+            // 函数体内按证明的类型执行
+            if (param.type != Value::EMPTY && !conformsTo(frame.slots[i], param.type)) {
+                annotationError(frame.slots[i], param.type, "parameter '" + param.name + "' of " + func.name);
+            }
+        }
+    }
+
+    /*
+    #  执行用户函数, 被调函数帧里已经装好实参;
+    #  函数体以尾调用结束时不再嵌套求值, 换上新函数和新帧后在这里继续循环
+    */
+    static Value invokeFunction(Interpreter& interpreter, FunctionTypePtr func, unique_ptr<Frame> callee) {
+        // 纯函数先查结果缓存; 以传入的实参为键, 尾调用得到的结果也记在最初的函数下
+        MemoCache* memo = interpreter.memoFor(*func);
+        FunctionTypePtr memoOwner;
+        MemoKey memoKey;
+        if (memo) {
+            memoKey.assign(callee->slots.begin(), callee->slots.begin() + func->parameters.size());
+            if (const Value* cached = memo->find(memoKey)) {
+                interpreter.recycleFrame(std::move(callee));
+                return *cached;
+            }
+            memoOwner = func;
+        }
+
+        interpreter.enterCall();
+        while (true) {
+            // 编译过的函数直接执行机器码, 守卫失败时照常解释执行
+            Value result;
+            if (interpreter.jitCall(*func, *callee, result)) {
+                interpreter.recycleFrame(std::move(callee));
+                interpreter.leaveCall();
+                checkReturn(*func, result);
+                if (memo) {
+                    memo->insert(std::move(memoKey), result);
+                }
+                return result;
+            }
+
+            Frame* frame = callee.get();
+            BlockNode* body = specializedBody(interpreter, *func, *frame);
+            interpreter.pushFrame(std::move(callee));
+            bindDefaults(interpreter, *func, *frame);
+
+            result = body->evaluate(interpreter);
+            if (interpreter.getCompletion() == Completion::TAIL_CALL) {
+                func = interpreter.takeTailCall(callee);
+                interpreter.popFrame();
+                continue;
+            }
+            if (interpreter.getCompletion() == Completion::RETURN) {
+                result = interpreter.takeReturnValue();
+            } else if (interpreter.interrupted()) {
+                interpreter.raiseStrayCompletion();
+            }
+
+            interpreter.popFrame();
+            interpreter.leaveCall();
+            checkReturn(*func, result);
+            if (memo) {
+                memo->insert(std::move(memoKey), result);
+            }
+            return result;
+        }
+    }
+
+    /*
+    #  调用的 quickening: 内置函数特化为 Builtin, 缓存内置函数表里的入口;
+    #  总是调用同一个用户函数时特化为 Direct, 函数是全局变量时缓存它的地址,
+    #  不再判断内置函数、也不再按名字查找, 守卫是调用目标不变
+    */
+    Value CallNode::evaluate(Interpreter& interpreter) {
+        NodeState& state = interpreter.state(site);
+        switch (state.quick.state) {
+            case Quick::BUILTIN:
+                return callBuiltin(interpreter, state.cachedBuiltin);
+            case Quick::DIRECT: {
+                Value* funcValue = interpreter.lookupSlots(resolution);
+                if (!funcValue) {
+                    funcValue = state.cachedGlobal && state.cachedFrame == interpreter.getGlobalFrame()
+                              ? state.cachedGlobal : interpreter.lookup(resolution, name);
+                }
+                if (funcValue && funcValue->type() == Value::FUNCTION &&
+                    reinterpret_cast<uintptr_t>(funcValue->functionPtr()) == state.quick.observed) {
+                    return callFunction(interpreter, get<FunctionTypePtr>(*funcValue));
+                }
+                interpreter.deoptimize(state.quick);
+                break;
+            }
+            default:
+                break;
+        }
+        return evaluateGeneric(interpreter, state);
+    }
+
+    Value CallNode::evaluateGeneric(Interpreter& interpreter, NodeState& state) {
+        int32_t builtin = interpreter.findBuiltin(name);
+        if (builtin >= 0) {
+            if (state.quick.state == Quick::WARMUP) {
+                quicken(interpreter, state, builtin, nullptr);
+            }
+            return callBuiltin(interpreter, builtin);
+        }
+        
+        Value* funcValue = interpreter.lookup(resolution, name);
+        if (!funcValue) {
+            throw runtime_error("Unknown function: " + name);
+        }
+        if (!holds_alternative<FunctionTypePtr>(*funcValue)) {
+            throw runtime_error(name + " is not a function");
+        }
+        if (state.quick.state == Quick::WARMUP) {
+            quicken(interpreter, state, -1, funcValue);
+        }
+        return callFunction(interpreter, get<FunctionTypePtr>(*funcValue));
+    }
+
+    void CallNode::quicken(Interpreter& interpreter, NodeState& state, int32_t builtin, Value* funcValue) {
+        auto describe = [this] {
+            return "call " + name + " line " + to_string(line);
+        };
+        Quickening& quick = state.quick;
+        FunctionType* target = builtin >= 0 ? nullptr : funcValue->functionPtr();
+        if (!interpreter.observe(quick, reinterpret_cast<uintptr_t>(target), describe)) {
+            return;
+        }
+        if (builtin >= 0) {
+            state.cachedBuiltin = builtin;
+            interpreter.specialize(quick, Quick::BUILTIN, "Builtin", describe);
+        } else if (!target->body) {
+            interpreter.specialize(quick, Quick::GENERIC, "Generic", describe);
+        } else {
+            state.cachedGlobal = interpreter.lookupSlots(resolution) ? nullptr : funcValue;
+            state.cachedFrame = interpreter.getGlobalFrame();
+            interpreter.specialize(quick, Quick::DIRECT, "Direct", describe);
+        }
+    }
+
+    // 实参不多时放在栈上的数组里, 不在堆上分配
+    static Value evaluateBuiltinCall(Interpreter& interpreter, const vector<unique_ptr<ASTNode>>& arguments,
+                                     size_t builtin) {
+        size_t count = arguments.size();
+        if (count <= BUILTIN_INLINE_ARGS) {
+            Value args[BUILTIN_INLINE_ARGS];
+            for (size_t i = 0; i < count; i++) {
+                args[i] = arguments[i]->evaluate(interpreter);
+            }
+            return interpreter.callBuiltin(builtin, BuiltinArgs(args, count));
+        }
+        vector<Value> args;
+        args.reserve(count);
+        for (auto& argNode : arguments) {
+            args.push_back(argNode->evaluate(interpreter));
+        }
+        return interpreter.callBuiltin(builtin, args);
+    }
+
+    Value CallNode::callBuiltin(Interpreter& interpreter, size_t builtin) {
+        return evaluateBuiltinCall(interpreter, positionalArguments, builtin);
+    }
+
+    // 调用生成器函数: 实参已经绑定进帧, 函数体在第一次 next 时才开始执行
+    [[gnu::noinline]] static Value makeGenerator(Interpreter& interpreter, FunctionTypePtr func, unique_ptr<Frame> frame) {
+        return GeneratorPtr(new TreeGenerator(interpreter, std::move(func), std::move(frame)));
+    }
+
+    Value CallNode::callFunction(Interpreter& interpreter, FunctionTypePtr func) {
+        if (!func->body) {
+            // 保存在变量里的内置函数, 只接受位置参数
+            int32_t builtin = interpreter.findBuiltin(func->name);
+            if (builtin < 0) {
+                throw runtime_error("Unknown function: " + func->name);
+            }
+            return evaluateBuiltinCall(interpreter, positionalArguments, builtin);
+        }
+
+        auto callee = bindArguments(interpreter, *func);
+        if (func->generator) {
+            return makeGenerator(interpreter, std::move(func), std::move(callee));
+        }
+        if (tailCall) {
+            interpreter.completeTailCall(std::move(func), std::move(callee));
+            return 0;
+        }
+        return invokeFunction(interpreter, std::move(func), std::move(callee));
+    }
+
+    /*
+    #  有绑定方案时实参直接写进方案里的槽; 目标函数换了就重新计算方案,
+    #  命名实参和默认值的调用与只有位置实参的调用开销相同
+    */
+    unique_ptr<Frame> CallNode::bindArguments(Interpreter& interpreter, const FunctionType& func) {
+        BindingPlan* plan = &interpreter.state(site).plan;
+        if (!plan->matches(func) && !planBinding(*plan, func)) {
+            return bindChecked(interpreter, func);
+        }
+
+        // 实参在调用方的作用域里求值, 直接写进被调函数帧的前几个槽
+        auto callee = interpreter.acquireFrame(interpreter.getGlobalFrame(), func.frameSize);
+        for (size_t i = 0; i < positionalArguments.size(); i++) {
+            callee->slots[i] = positionalArguments[i]->evaluate(interpreter);
+        }
+        size_t index = 0;
+        for (const auto& namedArg : namedArguments) {
+            Value value = namedArg.second->evaluate(interpreter);
+            // 实参求值后状态表可能扩大过, 重新取方案; 实参里递归执行到这个调用点、
+            // 换了目标时方案会被改掉, 对同一个函数重新计算的结果不变
+            plan = &interpreter.state(site).plan;
+            if (!plan->matches(func)) {
+                planBinding(*plan, func);
+            }
+            callee->slots[plan->namedSlots[index++]] = std::move(value);
+        }
+        return callee;
+    }
+
+    bool CallNode::planBinding(BindingPlan& plan, const FunctionType& func) {
+        vector<const std::string*> names;
+        names.reserve(namedArguments.size());
+        for (const auto& namedArg : namedArguments) {
+            names.push_back(&namedArg.first);
+        }
+        return plan.build(func, positionalArguments.size(), names);
+    }
+
+    // 不合法的调用: 逐项检查, 在第一个错误处报错
+    unique_ptr<Frame> CallNode::bindChecked(Interpreter& interpreter, const FunctionType& func) {
+        size_t minArgs = 0;
+        size_t maxArgs = func.parameters.size();
+
+        for (const auto& param : func.parameters) {
+            if (!param.hasDefault) {
+                minArgs++;
+            }
+        }
+
+        if (positionalArguments.size() > maxArgs) {
+            throw runtime_error("Too many positional arguments for function " + name +
+                               ": expected at most " + std::to_string(maxArgs) +
+                               ", got " + std::to_string(positionalArguments.size()));
+        }
+        if (positionalArguments.size() < minArgs) {
+
+            size_t providedRequired = positionalArguments.size();
+            for (const auto& param : func.parameters) {
+                if (!param.hasDefault && any_of(namedArguments.begin(), namedArguments.end(),
+                                                [&param](const auto& namedArg) { return namedArg.first == param.name; })) {
+                    providedRequired++;
+                }
+            }
+            if (providedRequired < minArgs) {
+                throw runtime_error("Not enough arguments for function " + name +
+                                   ": expected at least " + std::to_string(minArgs) +
+                                   ", got " + std::to_string(providedRequired));
+            }
+        }
+
+        // 实参在调用方的作用域里求值, 直接写进被调函数帧的前几个槽
+        auto callee = interpreter.acquireFrame(interpreter.getGlobalFrame(), func.frameSize);
+        for (size_t i = 0; i < positionalArguments.size(); i++) {
+            callee->slots[i] = positionalArguments[i]->evaluate(interpreter);
+        }
+
+        for (const auto& namedArg : namedArguments) {
+            const std::string& paramName = namedArg.first;
+            size_t paramIndex = 0;
+            while (paramIndex < func.parameters.size() && func.parameters[paramIndex].name != paramName) {
+                paramIndex++;
+            }
+            if (paramIndex == func.parameters.size()) {
+                throw runtime_error("Unknown parameter '" + paramName + "' for function " + name);
+            }
+            if (paramIndex < positionalArguments.size()) {
+                throw runtime_error("Parameter '" + paramName +
+                                   "' already set by positional argument");
+            }
+            callee->slots[paramIndex] = namedArg.second->evaluate(interpreter);
+        }
+        return callee;
+    }
+
+
+    Value ConvertNode::evaluate(Interpreter& interpreter) {
+        return apply(kind, argument()->evaluate(interpreter), interpreter.getInnerMethod());
+    }
+
+    Value ReturnNode::evaluate(Interpreter& interpreter) {
+        Value value = expr->evaluate(interpreter);
+        if (!interpreter.interrupted()) {  // 尾调用已经设置了 TAIL_CALL
+            interpreter.completeReturn(value, line);
+        }
+        return value;
+    }
+
+
+    Value AssignNode::evaluate(Interpreter& interpreter) {
+        Value value = expr->evaluate(interpreter);
+        interpreter.assign(resolution, varName, value);
+        return value;
+    }
+
+
+    /*
+    #  条件的真值, 不能判断的类型返回 -1, 由调用方给出各自的错误;
+    #  条件一直是 bool (或 int) 时特化为只检查这一种类型
+    */
+    static int conditionTruth(Interpreter& interpreter, Quickening& quick, const Value& value,
+                              const char* kind, int line) {
+        switch (quick.state) {
+            case Quick::BOOL_CONDITION:
+                if (value.type() == Value::BOOL) {
+                    return value.asBool();
+                }
+                interpreter.deoptimize(quick);
+                break;
+            case Quick::INT_CONDITION:
+                if (value.type() == Value::INT) {
+                    return value.asInt() != 0;
+                }
+                interpreter.deoptimize(quick);
+                break;
+            default:
+                break;
+        }
+        if (quick.state == Quick::WARMUP) {
+            auto describe = [kind, line] {
+                return string(kind) + " condition line " + to_string(line);
+            };
+            if (interpreter.observe(quick, value.type(), describe)) {
+                if (value.type() == Value::BOOL) {
+                    interpreter.specialize(quick, Quick::BOOL_CONDITION, "BoolCondition", describe);
+                } else if (value.type() == Value::INT) {
+                    interpreter.specialize(quick, Quick::INT_CONDITION, "IntCondition", describe);
+                } else {
+                    interpreter.specialize(quick, Quick::GENERIC, "Generic", describe);
+                }
+            }
+        }
+        switch (value.type()) {
+            case Value::INT:    return value.asInt() != 0;
+            case Value::FLOAT:  return value.asFloat() != 0.0;
+            case Value::BOOL:   return value.asBool();
+            case Value::STRING: return !value.asString().empty();
+            default:            return -1;
+        }
+    }
+
+    // while / for 的条件; 不能判断真假的类型报错
+    static bool loopCondition(Interpreter& interpreter, ASTNode* condition, bool boolCondition, const NodeSite& site,
+                              const char* kind, int line) {
+        Value condValue = condition->evaluate(interpreter);
+        if (boolCondition) {
+            return condValue.asBool();
+        }
+        int truth = conditionTruth(interpreter, interpreter.state(site).quick, condValue, kind, line);
+        if (truth < 0) {
+            throw runtime_error(string("Type error in ") + kind + " condition at line " + to_string(line));
+        }
+        return truth;
+    }
+
+    static bool branchTaken(Interpreter& interpreter, IfNode::Branch& branch) {
+        Value conditionValue = branch.condition->evaluate(interpreter);
+        if (branch.boolCondition) {
+            return conditionValue.asBool();
+        }
+        int truth = conditionTruth(interpreter, interpreter.state(branch.site).quick, conditionValue, "if", branch.line);
+        if (truth < 0) {
+            throw runtime_error("Type error in if condition");
+        }
+        return truth;
+    }
+
+    Value WhileNode::evaluate(Interpreter& interpreter) {
+        interpreter.pushFrame(nullptr, frameSize);
+        int loopCount = 0;
+        while (loopCondition(interpreter, condition.get(), boolCondition, site, "while", line)) {
+            body->evaluate(interpreter);
+            if (interpreter.interrupted()) {
+                Completion kind = interpreter.getCompletion();
+                if (kind == Completion::BREAK) {
+                    interpreter.clearCompletion();
+                    break;
+                } else if (kind == Completion::CONTINUE) {
+                    interpreter.clearCompletion();
+                    continue;
+                }
+                break;  // return 交给外层的函数调用处理
+            }
+            if (++loopCount > MAX_DEAD_LOOP) {
+                throw runtime_error("Possible infinite loop detected at line " + to_string(line));
+            }
+        }
+
+        interpreter.popFrame();
+        
+        return 0; 
+    }
+    
+    Value ForNode::evaluate(Interpreter& interpreter) {
+        interpreter.pushFrame(nullptr, frameSize);
+        try {
+            
+            if (init) {
+                init->evaluate(interpreter);
+            }
+            int loopCount = 0;
+            while (loopCondition(interpreter, condition.get(), boolCondition, site, "for", line)) {
+                body->evaluate(interpreter);
+                if (interpreter.interrupted()) {
+                    Completion kind = interpreter.getCompletion();
+                    if (kind == Completion::BREAK) {
+                        interpreter.clearCompletion();
+                        break;
+                    } else if (kind == Completion::CONTINUE) {
+                        interpreter.clearCompletion();
+                        if (update) {
+                            update->evaluate(interpreter);
+                        }
+                        continue;
+                    }
+                    break;  // return 交给外层的函数调用处理
+                }
+                if (update) {
+                    update->evaluate(interpreter);
+                }
+                if (++loopCount > MAX_DEAD_LOOP) {
+                    throw runtime_error("Possible infinite loop detected at line " + to_string(line));
+                }
+            }
+        } catch (...) {
+            interpreter.popFrame(); 
+            throw;
+        }
+        
+        interpreter.popFrame();
+        return 0; 
+    }
+
+    static GeneratorPtr iterableGenerator(const Value& value, int line) {
+        if (!holds_alternative<GeneratorPtr>(value)) {
+            throw runtime_error("Type error: cannot iterate over " + string(typeName(value.type())) +
+                                " at line " + to_string(line));
+        }
+        return get<GeneratorPtr>(value);
+    }
+
+    // 生成器在进入循环帧之前求值; 每次取到的值按赋值的规则写进循环变量.
+    // 迭代次数由生成器决定, 不做死循环计数
+    Value ForInNode::evaluate(Interpreter& interpreter) {
+        GeneratorPtr source = iterableGenerator(iterable->evaluate(interpreter), line);
+        interpreter.pushFrame(nullptr, frameSize);
+        try {
+            Value item;
+            while (source->next(item)) {
+                interpreter.assign(resolution, varName, item);
+                body->evaluate(interpreter);
+                if (interpreter.interrupted()) {
+                    Completion kind = interpreter.getCompletion();
+                    if (kind == Completion::BREAK) {
+                        interpreter.clearCompletion();
+                        break;
+                    } else if (kind == Completion::CONTINUE) {
+                        interpreter.clearCompletion();
+                        continue;
+                    }
+                    break;  // return 交给外层的函数调用处理
+                }
+            }
+        } catch (...) {
+            interpreter.popFrame();
+            throw;
+        }
+        interpreter.popFrame();
+        return 0;
+    }
+
+    Value ParallelForNode::evaluate(Interpreter& interpreter) {
+        interpreter.pushFrame(nullptr, frameSize);
+        try {
+            run(interpreter);
+        } catch (...) {
+            interpreter.popFrame();
+            throw;
+        }
+        interpreter.popFrame();
+        return 0;
+    }
+
+    /*
+    #  迭代次数在进入循环时算出, 切成 PARALLEL_CHUNKS 块; 每块从归约的单位元开始,
+    #  全部结束后按块的顺序合并到外层变量上, 所以结果与线程数无关.
+    #  发起线程用自己的解释器和原来的循环体, 其余线程用 WorkerContext 里的副本;
+    #  只有一个线程、池被占用、无法复制, 或者循环体调用的函数可能给全局变量赋值时
+    #  (赋值会落在副本上, 见 GlobalWriteAnalysis), 发起线程按顺序执行所有块
+    */
+    void ParallelForNode::run(Interpreter& interpreter) {
+        auto error = [this](const string& message) {
+            return runtime_error("Parallel for at line " + to_string(line) + ": " + message);
+        };
+
+        init->evaluate(interpreter);
+
+        vector<Value*> targets;
+        vector<Value> originals;
+        vector<Value> identities;
+        for (const auto& reduction : reductions) {
+            Value* target = interpreter.lookup(reduction.var.resolution, reduction.var.name);
+            if (!target) {
+                throw error("reduction variable '" + reduction.var.name + "' is not defined");
+            }
+            if (reduction.op == Reduce::ADD || reduction.op == Reduce::MUL) {
+                if (target->type() != Value::INT && target->type() != Value::FLOAT) {
+                    throw error("'" + reduction.var.name + "' must be int or float to reduce with + or *, got " +
+                                typeName(target->type()));
+                }
+                IntType unit = reduction.op == Reduce::ADD ? 0 : 1;
+                identities.push_back(target->type() == Value::INT ? Value(unit) : Value(static_cast<FloatType>(unit)));
+            } else {
+                identities.push_back(*target);  // min / max 以原值为起点, 重复合并不改变结果
+            }
+            targets.push_back(target);
+            originals.push_back(*target);
+        }
+
+        Value* counterSlot = interpreter.lookup(counter.resolution, counter.name);
+        auto* test = dynamic_cast<BinOpNode*>(condition.get());
+        auto* advance = dynamic_cast<AssignNode*>(update.get());
+        auto* stepExpr = advance ? dynamic_cast<BinOpNode*>(advance->expr.get()) : nullptr;
+        if (!counterSlot || !test || !stepExpr) {
+            throw error("unsupported loop header");
+        }
+        Value limitValue = test->right->evaluate(interpreter);
+        Value stepValue = stepExpr->right->evaluate(interpreter);
+        if (counterSlot->type() != Value::INT || limitValue.type() != Value::INT || stepValue.type() != Value::INT) {
+            throw error("counter, limit and step must be int");
+        }
+        IntType start = counterSlot->asInt();
+        IntType step = stepValue.asInt();
+        if (step <= 0) {
+            throw error("step must be positive");
+        }
+        IntType span = limitValue.asInt() - start + (test->op.type == TokenType::LT ? 0 : 1);
+        size_t count = span > 0 ? static_cast<size_t>((span + step - 1) / step) : 0;
+        if (count > static_cast<size_t>(MAX_DEAD_LOOP)) {
+            throw runtime_error("Possible infinite loop detected at line " + to_string(line));
+        }
+
+        size_t chunks = min(count, PARALLEL_CHUNKS);
+        size_t width = reductions.size();
+        vector<Value> partials(chunks * width);
+        auto runChunk = [&](Interpreter& runner, BlockNode& block, Value* slot,
+                            const vector<Value*>& vars, const vector<Value>& units, size_t chunk) {
+            for (size_t r = 0; r < width; r++) {
+                *vars[r] = units[r];
+            }
+            for (size_t k = count * chunk / chunks; k < count * (chunk + 1) / chunks; k++) {
+                *slot = start + static_cast<IntType>(k) * step;
+                runner.touchGlobals();  // 计数器可能是全局变量
+                block.evaluate(runner);
+                if (runner.interrupted()) {
+                    runner.clearCompletion();  // 只可能是 continue
+                }
+            }
+            for (size_t r = 0; r < width; r++) {
+                partials[chunk * width + r] = std::move(*vars[r]);
+            }
+        };
+
+        size_t wanted = min(interpreter.getThreads(), chunks);
+        vector<unique_ptr<WorkerContext>> contexts;
+        bool parallel = wanted > 1 && !writesGlobals && !WorkPool::inTask();
+        for (size_t p = 1; parallel && p < wanted; p++) {
+            contexts.push_back(make_unique<WorkerContext>());
+            parallel = contexts.back()->build(interpreter, *this, identities);
+        }
+        auto task = [&](size_t participant, size_t chunk) {
+            if (participant == 0) {
+                runChunk(interpreter, *body, counterSlot, targets, identities, chunk);
+            } else {
+                WorkerContext& context = *contexts[participant - 1];
+                runChunk(context.interpreter, *context.body, context.counter, context.reductions,
+                         context.identities, chunk);
+            }
+        };
+        try {
+            if (!parallel || !WorkPool::instance().run(chunks, wanted, task)) {
+                for (size_t chunk = 0; chunk < chunks; chunk++) {
+                    task(0, chunk);
+                }
+            }
+        } catch (...) {
+            for (size_t r = 0; r < width; r++) {
+                *targets[r] = originals[r];
+            }
+            interpreter.touchGlobals();
+            throw;
+        }
+
+        for (size_t r = 0; r < width; r++) {
+            Value result = originals[r];
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                const Value& part = partials[chunk * width + r];
+                switch (reductions[r].op) {
+                    case Reduce::ADD:
+                        result = binop::dispatch(TokenType::PLUS, line, result, part);
+                        break;
+                    case Reduce::MUL:
+                        result = binop::dispatch(TokenType::MULTIPLY, line, result, part);
+                        break;
+                    case Reduce::MIN:
+                        if (binop::dispatch(TokenType::LT, line, part, result).asBool()) {
+                            result = part;
+                        }
+                        break;
+                    case Reduce::MAX:
+                        if (binop::dispatch(TokenType::GT, line, part, result).asBool()) {
+                            result = part;
+                        }
+                        break;
+                }
+            }
+            *targets[r] = result;
+        }
+        *counterSlot = start + static_cast<IntType>(count) * step;
+        interpreter.touchGlobals();
+    }
+
+    /*
+    #  spawn: 按调用的规则找到函数、绑定实参; 能交给其他线程时复制函数和实参放进任务池.
+    #  只有一个线程、实参或全局变量里有生成器, 或者函数可能给全局变量赋值时
+    #  (赋值会落在副本上, 见 GlobalWriteAnalysis), 立即在当前线程执行
+    */
+    Value SpawnNode::evaluate(Interpreter& interpreter) {
+        const string& name = call->name;
+        auto error = [this](const string& message) {
+            return runtime_error("Spawn at line " + to_string(line) + ": " + message);
+        };
+        if (interpreter.isBuiltinFunction(name)) {
+            throw error(name + " is a builtin function; only user functions can be spawned");
+        }
+        Value* funcValue = interpreter.lookup(call->resolution, name);
+        if (!funcValue) {
+            throw runtime_error("Unknown function: " + name);
+        }
+        if (!holds_alternative<FunctionTypePtr>(*funcValue)) {
+            throw runtime_error(name + " is not a function");
+        }
+        FunctionTypePtr func = get<FunctionTypePtr>(*funcValue);
+        if (!func->body) {
+            throw error(name + " is a builtin function; only user functions can be spawned");
+        }
+        if (func->generator) {
+            throw error("generator " + name + " cannot be spawned");
+        }
+
+        auto frame = call->bindArguments(interpreter, *func);
+        auto task = makeRef<Task>(name);
+        size_t threads = interpreter.getThreads();
+        if (threads > 1 && !writesGlobals && task->bind(interpreter, name, *func, frame->slots)) {
+            interpreter.recycleFrame(std::move(frame));
+            TaskPool::instance().submit(task, threads);
+        } else {
+            // 在当前线程立即执行; 出错时与 Task::execute 一样恢复环境, 异常留给 join
+            task->claim();
+            auto mark = interpreter.checkpoint();
+            try {
+                Value value = invokeFunction(interpreter, std::move(func), std::move(frame));
+                task->complete(value);
+            } catch (const ProgramExit&) {
+                throw;  // exit() 结束整个程序, 不留给 join
+            } catch (...) {
+                interpreter.rewind(mark);
+                task->fail(current_exception());
+            }
+        }
+        return FuturePtr(task.get());
+    }
+
+    /*
+    #  实参放进被调函数的帧后照常调用; 出错时把环境恢复到执行前, 异常留给 join.
+    #  exit() 结束整个程序: 在 join 它的线程上执行时照常抛出 (等待同一任务的其他线程也收到);
+    #  工作线程上没有调用方能接住, 写出缓冲的输出后以同样的退出码结束进程
+    */
+    void Task::execute() {
+        TaskEnv& env = TaskEnv::enter(snapshot);
+        TaskEnv* outer = std::exchange(TaskEnv::current(), &env);
+        Interpreter& runner = env.interpreter;
+        auto mark = runner.checkpoint();
+        try {
+            FunctionTypePtr callee = global.empty() ? func : env.originals.at(global);
+            auto frame = runner.acquireFrame(runner.getGlobalFrame(), callee->frameSize);
+            for (size_t i = 0; i < args.size(); i++) {
+                frame->slots[i] = std::move(args[i]);
+            }
+            Value value = invokeFunction(runner, std::move(callee), std::move(frame));
+            complete(value);
+        } catch (const ProgramExit& request) {
+            TaskEnv::current() = outer;
+            TaskEnv::leave(env);
+            if (TaskPool::onWorker()) {
+                runner.getInnerMethod().output().flush();
+                cout.flush();
+                quick_exit(request.code);
+            }
+            fail(current_exception());
+            throw;
+        } catch (...) {
+            runner.rewind(mark);
+            fail(current_exception());
+        }
+        TaskEnv::current() = outer;
+        TaskEnv::leave(env);
+    }
+
+    Value IfNode::evaluate(Interpreter& interpreter) {
+        for (auto& branch : branches) {
+            if (branchTaken(interpreter, branch)) {
+                return branch.body->evaluate(interpreter);
+            }
+        }
+        if (elseBlock) {
+            return elseBlock->evaluate(interpreter);
+        }
+        return 0; 
+    }
+
+    Value BreakNode::evaluate(Interpreter& interpreter) {
+        interpreter.complete(Completion::BREAK, line);
+        return 0;
+    }
+
+    Value ContinueNode::evaluate(Interpreter& interpreter) {
+        interpreter.complete(Completion::CONTINUE, line);
+        return 0;
+    }
+
+    Value FunctionDefinitionNode::evaluate(Interpreter& interpreter) {
+        
+        shared_ptr<JitSource>& jitSource = interpreter.state(site).jitSource;
+        if (!jitSource && body && !generator && interpreter.getJit().isEnabled()) {
+            jitSource = JitLowering::lower(parameters, *body);
+        }
+        auto func = makeRef<FunctionType>(name, parameters, body);
+        func->frameSize = frameSize;
+        func->pure = pure;
+        func->generator = generator;
+        func->returnType = returnType;
+        func->jitSource = jitSource;
+        interpreter.assign(resolution, name, func);
+        
+        return StringType("");
+    }
+    Value YieldNode::evaluate(Interpreter& interpreter) {
+        throw runtime_error("yield outside of a generator at line " + to_string(line));
+    }
+
+    // 循环体执行完一遍 (或 continue) 后进入下一次迭代; 循环结束时返回 false
+    bool TreeGenerator::iterate(Cursor& cursor, bool counted) {
+        if (auto* whileNode = dynamic_cast<WhileNode*>(cursor.loop)) {
+            if (counted && ++cursor.loopCount > MAX_DEAD_LOOP) {
+                throw runtime_error("Possible infinite loop detected at line " + to_string(whileNode->line));
+            }
+            return loopCondition(interpreter, whileNode->condition.get(), whileNode->boolCondition,
+                                 whileNode->site, "while", whileNode->line);
+        } else if (auto* forNode = dynamic_cast<ForNode*>(cursor.loop)) {
+            if (forNode->update) {
+                forNode->update->evaluate(interpreter);
+            }
+            if (counted && ++cursor.loopCount > MAX_DEAD_LOOP) {
+                throw runtime_error("Possible infinite loop detected at line " + to_string(forNode->line));
+            }
+            return loopCondition(interpreter, forNode->condition.get(), forNode->boolCondition,
+                                 forNode->site, "for", forNode->line);
+        }
+        auto* forIn = static_cast<ForInNode*>(cursor.loop);
+        Value item;
+        if (!cursor.source->next(item)) {
+            return false;
+        }
+        interpreter.assign(forIn->resolution, forIn->varName, item);
+        return true;
+    }
+
+    /*
+    #  生成器的函数体: 块执行完时, 循环体的游标进入下一次迭代, 其余的直接弹出.
+    #  break / continue 弹到最近的循环, return 结束生成器 (返回值丢弃).
+    #  循环帧的压栈和弹栈与各循环节点的 evaluate 一致, 死循环计数也一样;
+    #  只是每次 yield 后重新计数, 不断产出值的循环由取值的一方决定何时结束
+    */
+    Steps TreeGenerator::run() {
+        bindDefaults(interpreter, *func, *interpreter.getCurrentFrame());
+
+        vector<Cursor> cursors;
+        cursors.emplace_back(func->body.get());
+        while (!cursors.empty()) {
+            Cursor& cursor = cursors.back();
+            if (cursor.next == cursor.block->statements.size()) {
+                if (!cursor.loop) {
+                    cursors.pop_back();
+                } else if (iterate(cursor, true)) {
+                    cursor.next = 0;
+                } else {
+                    interpreter.popFrame();
+                    cursors.pop_back();
+                }
+                continue;
+            }
+
+            ASTNode* stmt = cursor.block->statements[cursor.next++].get();
+            if (auto* yieldNode = dynamic_cast<YieldNode*>(stmt)) {
+                for (Cursor& open : cursors) {
+                    open.loopCount = 0;
+                }
+                co_yield yieldNode->expr->evaluate(interpreter);
+                continue;
+            }
+
+            if (!yields(stmt)) {
+                stmt->evaluate(interpreter);
+                if (!interpreter.interrupted()) {
+                    continue;
+                }
+                if (interpreter.getCompletion() == Completion::RETURN) {
+                    interpreter.takeReturnValue();
+                    co_return;
+                }
+                while (!cursors.empty() && !cursors.back().loop) {
+                    cursors.pop_back();
+                }
+                if (cursors.empty()) {
+                    interpreter.raiseStrayCompletion();
+                }
+                Cursor& loop = cursors.back();
+                bool stop = interpreter.getCompletion() == Completion::BREAK;
+                interpreter.clearCompletion();
+                if (stop || !iterate(loop, false)) {
+                    interpreter.popFrame();
+                    cursors.pop_back();
+                } else {
+                    loop.next = 0;
+                }
+                continue;
+            }
+
+            // 含 yield 的复合语句: 进入它的块, 由游标栈继续执行
+            if (auto* block = dynamic_cast<BlockNode*>(stmt)) {
+                cursors.emplace_back(block);
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(stmt)) {
+                BlockNode* taken = ifNode->elseBlock.get();
+                for (auto& branch : ifNode->branches) {
+                    if (branchTaken(interpreter, branch)) {
+                        taken = branch.body.get();
+                        break;
+                    }
+                }
+                if (taken) {
+                    cursors.emplace_back(taken);
+                }
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(stmt)) {
+                interpreter.pushFrame(nullptr, whileNode->frameSize);
+                if (loopCondition(interpreter, whileNode->condition.get(), whileNode->boolCondition,
+                                  whileNode->site, "while", whileNode->line)) {
+                    cursors.emplace_back(whileNode->body.get(), whileNode);
+                } else {
+                    interpreter.popFrame();
+                }
+            } else if (auto* forNode = dynamic_cast<ForNode*>(stmt)) {
+                interpreter.pushFrame(nullptr, forNode->frameSize);
+                if (forNode->init) {
+                    forNode->init->evaluate(interpreter);
+                }
+                if (loopCondition(interpreter, forNode->condition.get(), forNode->boolCondition,
+                                  forNode->site, "for", forNode->line)) {
+                    cursors.emplace_back(forNode->body.get(), forNode);
+                } else {
+                    interpreter.popFrame();
+                }
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(stmt)) {
+                Cursor loop(forIn->body.get(), forIn,
+                            iterableGenerator(forIn->iterable->evaluate(interpreter), forIn->line));
+                interpreter.pushFrame(nullptr, forIn->frameSize);
+                if (iterate(loop, false)) {
+                    cursors.push_back(std::move(loop));
+                } else {
+                    interpreter.popFrame();
+                }
+            }
+        }
+    }
+#endif
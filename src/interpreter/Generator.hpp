@@ -0,0 +1,131 @@
+#ifndef GENERATOR_HPP
+    #define GENERATOR_HPP
+
+    #include "../MiLang.hpp"
+    #include "Interpreter.hpp"
+    #include <coroutine>
+    #include <exception>
+
+    using namespace std;
+
+    /*
+    #  C++20 协程: 每次 next 执行到下一个 co_yield, 产出的值留在 promise 里
+    #  协程帧在创建时分配一次, 之后挂起和恢复都不再分配
+    */
+    class Steps {
+    public:
+        struct promise_type {
+            Value current;
+            exception_ptr error;
+
+            Steps get_return_object() { return Steps(coroutine_handle<promise_type>::from_promise(*this)); }
+            suspend_always initial_suspend() noexcept { return {}; }
+            suspend_always final_suspend() noexcept { return {}; }
+
+            suspend_always yield_value(Value value) {
+                current = std::move(value);
+                return {};
+            }
+
+            void return_void() {}
+            void unhandled_exception() { error = current_exception(); }
+        };
+
+        Steps() = default;
+        explicit Steps(coroutine_handle<promise_type> handle) : handle(handle) {}
+        Steps(Steps&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+        Steps& operator=(Steps&& other) noexcept {
+            if (this != &other) {
+                if (handle) {
+                    handle.destroy();
+                }
+                handle = std::exchange(other.handle, nullptr);
+            }
+            return *this;
+        }
+
+        ~Steps() {
+            if (handle) {
+                handle.destroy();
+            }
+        }
+
+        // 执行到下一个 co_yield 返回 true, 协程结束时返回 false; 协程里的异常在这里重新抛出
+        bool next() {
+            handle.resume();
+            if (exception_ptr error = std::exchange(handle.promise().error, nullptr)) {
+                rethrow_exception(error);
+            }
+            return !handle.done();
+        }
+
+        Value& value() { return handle.promise().current; }
+
+    private:
+        coroutine_handle<promise_type> handle;
+    };
+
+    /*
+    #  树遍历引擎的生成器
+    #
+    #  一个协程逐条执行函数体: 不含 yield 的语句照常求值, 含 yield 的 if / 循环 / 块
+    #  展开成游标栈, 所以挂起时 C++ 栈上没有任何求值中的节点.
+    #  挂起期间函数帧和循环帧保存在 frames 里, 恢复时放回解释器的帧栈顶.
+    #  参数的默认值和类型注解在第一次 next 时检查
+    */
+    class TreeGenerator : public GeneratorType {
+    public:
+        TreeGenerator(Interpreter& interpreter, FunctionTypePtr func, unique_ptr<Frame> frame)
+            : GeneratorType(func->name), interpreter(interpreter), func(std::move(func)) {
+            frames.push_back(std::move(frame));
+            steps = run();
+        }
+
+    protected:
+        bool resume(Value& out) override {
+            interpreter.enterCall();
+            size_t base = interpreter.frameDepth();
+            interpreter.restoreFrames(frames);
+            bool yielded = false;
+            try {
+                yielded = steps.next();
+            } catch (...) {
+                interpreter.unwindFrames(base);
+                interpreter.leaveCall();
+                throw;
+            }
+            if (yielded) {
+                interpreter.suspendFrames(base, frames);
+                out = std::move(steps.value());
+            } else {
+                interpreter.unwindFrames(base);
+            }
+            interpreter.leaveCall();
+            return yielded;
+        }
+
+    private:
+        // 游标栈的一层: 正在执行的块; 循环体的游标记下循环节点, 其余为 nullptr
+        struct Cursor {
+            BlockNode* block;
+            size_t next = 0;
+            ASTNode* loop = nullptr;
+            int loopCount = 0;
+            GeneratorPtr source;  // for-in 遍历的生成器
+
+            explicit Cursor(BlockNode* block, ASTNode* loop = nullptr, GeneratorPtr source = nullptr)
+                : block(block), loop(loop), source(std::move(source)) {}
+        };
+
+        Interpreter& interpreter;
+        FunctionTypePtr func;
+        vector<unique_ptr<Frame>> frames;
+        Steps steps;
+
+        // 以下定义在 evaluate.hpp, 与各节点的 evaluate 共用条件和参数的处理
+        Steps run();
+        bool iterate(Cursor& cursor, bool counted);
+    };
+
+#endif
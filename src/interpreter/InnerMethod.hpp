@@ -1,473 +1,595 @@
-#ifndef INNER_METHOD_HPP
-#define INNER_METHOD_HPP
-
-    #include "../MiLang.hpp"
-    #include "../colors.hpp"
-
-    using FuncVector = std::vector<
-        std::pair<
-            std::string,
-            std::function<Value(InnerMethod&, const std::vector<Value>&)>
-        >
-    >;
-
-    void printVariant(const std::variant<long long int, long double, std::string, bool, FunctionTypePtr>& var) {
-        std::visit([](const auto& value) {
-            using T = std::decay_t<decltype(value)>;
-            if constexpr (std::is_same_v<T, long long int>) {
-                std::cout << value;
-            } else if constexpr (std::is_same_v<T, long double>) {
-                std::cout << value;
-            } else if constexpr (std::is_same_v<T, std::string>) {
-                std::cout << value;
-            } else if constexpr (std::is_same_v<T, bool>) {
-                std::cout << std::boolalpha << value;
-            } else if constexpr (std::is_same_v<T, FunctionTypePtr>) {
-                std::cout << "FunctionType(" << value->name << ")";
-            }
-        }, var);
-    }
-
-    class InnerMethod {
-    private:
-        bool canCompareInternal(const Value& a, const Value& b) const {
-            if (holds_alternative<BoolType>(a) || holds_alternative<BoolType>(b)) {
-                return holds_alternative<BoolType>(a) && holds_alternative<BoolType>(b);
-            }
-
-            if (holds_alternative<StringType>(a) || holds_alternative<StringType>(b)) {
-                return holds_alternative<StringType>(a) && holds_alternative<StringType>(b);
-            }
-
-            return true;
-        }
-
-    public:
-        std::string getTypeName(const Value& val) {
-            if (holds_alternative<IntType>(val)) {
-                return "int";
-            } else if (holds_alternative<FloatType>(val)) {
-                return "float";
-            } else if (holds_alternative<StringType>(val)) {
-                return "string";
-            } else if (holds_alternative<BoolType>(val)) {
-                return "bool";
-            } else if (holds_alternative<NullType>(val)) {
-                return "Null";
-            } else if (holds_alternative<FunctionTypePtr>(val)) {
-                return "function";
-            }
-                return "unknown";
-        }
-
-        bool canCompare(const Value& a, const Value& b) const {
-            return canCompareInternal(a, b);
-        }
-
-        pair<FloatType, FloatType> convertToNumbers(const Value& a, const Value& b) {
-            FloatType aVal, bVal;
-
-            if (holds_alternative<IntType>(a)) {
-                aVal = static_cast<FloatType>(get<IntType>(a));
-            } else if (holds_alternative<FloatType>(a)) {
-                aVal = get<FloatType>(a);
-            } else {
-                throw runtime_error("Type error: Cannot perform math operation on string/boolean");
-            }
-
-            if (holds_alternative<IntType>(b)) {
-                bVal = static_cast<FloatType>(get<IntType>(b));
-            } else if (holds_alternative<FloatType>(b)) {
-                bVal = get<FloatType>(b);
-            } else {
-                throw runtime_error("Type error: Cannot perform math operation on string/boolean");
-            }
-
-            return {aVal, bVal};
-        }
-
-        std::string valueToString(const Value& val) {
-            if (holds_alternative<IntType>(val)) {
-                return to_string(get<IntType>(val));
-            } else if (holds_alternative<FloatType>(val)) {
-                float f = get<FloatType>(val);
-                if (f == floor(f)) {
-                    return to_string(static_cast<int>(f)) + ".0";
-                }
-                stringstream ss;
-                ss << fixed << setprecision(6) << f;
-                std::string str = ss.str();
-                str.erase(str.find_last_not_of('0') + 1, string::npos);
-                if (str.back() == '.') {
-                    str += '0';
-                }
-                return str;
-            } else if (holds_alternative<StringType>(val)) {
-                return get<StringType>(val);
-            } else if (holds_alternative<BoolType>(val)) {
-                return get<BoolType>(val) ? "True" : "False";
-            } else if (holds_alternative<FunctionTypePtr>(val)) {
-                return "<Function \"" + get<FunctionTypePtr>(val)->name + "\">";
-            } else if (holds_alternative<NullType>(val)) {
-                return "Null";
-            }
-            return "Error in \"valueToString\"";
-        }
-
-        Value intFunction(const vector<Value>& args) {
-            if (args.size() != 1) {
-                throw runtime_error("int() requires exactly one argument");
-            }
-
-            const Value& arg = args[0];
-            if (holds_alternative<IntType>(arg)) {
-                return arg;
-            } else if (holds_alternative<FloatType>(arg)) {
-                return IntType(floor(get<FloatType>(arg)));
-            } else if (holds_alternative<StringType>(arg)) {
-                std::string s = get<StringType>(arg);
-                try {
-                    size_t pos;
-                    int32_t num = stoi(s, &pos);
-                    if (pos == s.size()) {
-                        return IntType(num);
-                    }
-                    float f = stof(s, &pos);
-                    if (pos == s.size()) {
-                        return IntType(floor(f));
-                    }
-                } catch (...) {
-                    throw runtime_error("Cannot convert to integer: " + s);
-                }
-                throw runtime_error("Cannot convert to integer: " + s);
-            }
-            throw runtime_error("Unsupported type for int conversion");
-        }
-
-        Value floatFunction(const vector<Value>& args) {
-            if (args.size() != 1) {
-                throw runtime_error("float() requires exactly one argument");
-            }
-
-            const Value& arg = args[0];
-            if (holds_alternative<FloatType>(arg)) {
-                return arg;
-            } else if (holds_alternative<IntType>(arg)) {
-                return FloatType(get<IntType>(arg));
-            } else if (holds_alternative<StringType>(arg)) {
-                std::string s = get<StringType>(arg);
-                try {
-                    return FloatType(stof(s));
-                } catch (...) {
-                    throw runtime_error("Cannot convert to float: " + s);
-                }
-            }
-            throw runtime_error("Unsupported type for float conversion");
-        }
-
-        Value boolFunction(const vector<Value>& args) {
-            if (args.size() != 1) {
-                throw runtime_error("bool() requires exactly one argument");
-            }
-
-            const Value& arg = args[0];
-            if (holds_alternative<BoolType>(arg)) {
-                return arg;
-            } else if (holds_alternative<IntType>(arg)) {
-                return BoolType(get<IntType>(arg) != 0);
-            } else if (holds_alternative<FloatType>(arg)) {
-                return BoolType(get<FloatType>(arg) != 0.0f);
-            } else if (holds_alternative<StringType>(arg)) {
-                std::string s = get<StringType>(arg);
-                return BoolType(!s.empty() && s != "false" && s != "0");
-            }
-            return BoolType(false);
-        }
-
-        Value stringFunction(const vector<Value>& args) {
-            if (args.size() != 1) {
-                throw runtime_error("string() requires exactly one argument");
-            }
-
-            return StringType(this->valueToString(args[0]));
-        }
-
-        Value typeFunction(const vector<Value>& args) {
-            if (args.size() != 1) {
-                throw runtime_error("type() requires exactly one argument");
-            }
-
-            const Value& arg = args[0];
-            if (holds_alternative<FunctionTypePtr>(arg)) {
-                return StringType("<Function \"" + get<FunctionTypePtr>(arg)->name + "\">");
-            }
-            return StringType(getTypeName(arg));
-        }
-
-        Value receiveFunction(const vector<Value>& args) {
-            if (!args.empty() && holds_alternative<StringType>(args[0])) {
-                cout << get<StringType>(args[0]);
-            }
-
-            std::string input;
-            getline(cin, input);
-            return StringType(input);
-        }
-
-        int countPlaceholders(const string& s) {
-            int count = 0;
-            size_t pos = 0;
-
-            while (pos < s.size()) {
-                size_t start = s.find('{', pos);
-                if (start == string::npos) {
-                    break;
-                }
-
-                if (start + 1 < s.size() && s[start + 1] == '}') {
-                    count++;
-                    pos = start + 2;
-                } else {
-                    pos = start + 1;
-                }
-            }
-
-            return count;
-        }
-
-        Value writelnFunction(const vector<Value>& args, bool need_new_line = true) {
-            std::string name;
-            if (need_new_line) {
-                name = "writeln()";
-            } else {
-                name = "write()";
-            }
-            if (args.empty()) {
-                if (name == "writeln()") {cout << endl;}
-                return StringType("");
-            }
-
-            if (holds_alternative<StringType>(args[0])) {
-                std::string format = get<StringType>(args[0]);
-                vector<Value> params(args.begin() + 1, args.end());
-
-                int placeholderCount = countPlaceholders(format);
-
-                if (placeholderCount != 0 && placeholderCount != params.size()) {
-                   throw runtime_error(
-                        name + " placeholder count mismatch: " +
-                        to_string(placeholderCount) + " placeholders, " +
-                        to_string(params.size()) + " arguments"
-                   );
-                }
-
-                if (placeholderCount > 0) {
-                    size_t paramIndex = 0;
-                    size_t pos = 0;
-
-                    while (pos < format.size() && paramIndex < params.size()) {
-                        size_t start = format.find('{', pos);
-                        size_t end = format.find('}', start);
-
-                        if (start == string::npos || end == string::npos) {
-                            break;
-                        }
-
-                        cout << format.substr(pos, start - pos);
-                        cout << this->valueToString(params[paramIndex]);
-
-                        paramIndex++;
-                        pos = end + 1;
-                    }
-
-                    cout << format.substr(pos);
-                    if (need_new_line) cout << endl;
-                    return StringType("");
-                }
-            }
-
-            for (const auto& arg : args) {
-                cout << this->valueToString(arg);
-            }
-            if(need_new_line) {
-                cout << endl;
-            }
-            return StringType("");
-        }
-
-        Value printlnFunction(const vector<Value>& args, bool need_new_line = true) {
-            static const auto unescapeChar = [](char c) -> char {
-                switch (c) {
-                    case 'n': return '\n';
-                    case 't': return '\t';
-                    case 'r': return '\r';
-                    case 'e': return '\033'; 
-                    case 'a': return '\a';
-                    case 'b': return '\b';
-                    case 'f': return '\f';
-                    case 'v': return '\v';
-                    case '0': return '\0';
-                    default: return c;
-                }
-            };
-
-            auto outputWithEscape = [](const std::string& s) {
-                bool escaping = false;
-                for (char c : s) {
-                    if (escaping) {
-                        cout << unescapeChar(c);
-                        escaping = false;
-                    } else if (c == '\\') {
-                        escaping = true;
-                    } else {
-                        cout << c;
-                    }
-                }
-                
-                if (escaping) {
-                    cout << '\\';
-                }
-            };
-
-            auto countEmptyPlaceholders = [](const std::string& s) -> int {
-                int count = 0;
-                for (size_t i = 0; i < s.size(); ++i) {
-                    if (s[i] == '{' && i + 1 < s.size() && s[i + 1] == '}') {
-                        count++;
-                        i++; 
-                    }
-                }
-                return count;
-            };
-
-            if (args.empty()) {
-                if (need_new_line) cout << endl;
-                return StringType("");
-            }
-
-            
-            if (holds_alternative<StringType>(args[0])) {
-                const std::string& format = get<StringType>(args[0]);
-                const vector<Value> params(args.begin() + 1, args.end());
-                const int placeholderCount = countEmptyPlaceholders(format);
-
-                if (placeholderCount != 0 && placeholderCount != static_cast<int>(params.size())) {
-                    throw runtime_error(
-                        std::string(need_new_line ? "writeln()" : "write()") +
-                        " placeholder count mismatch: " +
-                        std::to_string(placeholderCount) +
-                        " placeholders, " +
-                        std::to_string(params.size()) +
-                        " arguments"
-                    );
-                }
-
-                if (placeholderCount > 0) {
-                    size_t paramIndex = 0;
-                    size_t pos = 0;
-                    bool escaping = false;
-
-                    while (pos < format.size()) {
-                        if (escaping) {
-                            cout << unescapeChar(format[pos]);
-                            escaping = false;
-                            pos++;
-                            continue;
-                        }
-
-                        if (format[pos] == '\\') {
-                            escaping = true;
-                            pos++;
-                            continue;
-                        }
-
-                        if (format[pos] == '{' && pos + 1 < format.size() && format[pos + 1] == '}') {
-                            
-                            outputWithEscape(format.substr(pos, pos - pos));
-
-                            if (paramIndex < params.size()) {
-                                if (holds_alternative<StringType>(params[paramIndex])) {
-                                    outputWithEscape(get<StringType>(params[paramIndex]));
-                                } else {
-                                    cout << this->valueToString(params[paramIndex]);
-                                }
-                                paramIndex++;
-                            }
-
-                            pos += 2; 
-                            continue;
-                        }
-
-                        if (format[pos] == '{' || format[pos] == '}') {
-                            size_t start = pos;
-                            size_t end = format.find_first_of("{}", pos + 1);
-
-                            if (end == string::npos) {
-                                
-                                outputWithEscape(format.substr(pos));
-                                break;
-                            }
-                            outputWithEscape(format.substr(pos, end - pos + 1));
-                            pos = end + 1;
-                            continue;
-                        }
-                        size_t nextSpecial = format.find_first_of("\\{}", pos);
-                        if (nextSpecial == string::npos) {
-                            
-                            outputWithEscape(format.substr(pos));
-                            break;
-                        }
-
-                        outputWithEscape(format.substr(pos, nextSpecial - pos));
-                        pos = nextSpecial;
-                    }
-
-                    if (need_new_line) cout << endl;
-                    return StringType("");
-                }
-            }
-
-            
-            for (const auto& arg : args) {
-                if (holds_alternative<StringType>(arg)) {
-                    outputWithEscape(get<StringType>(arg));
-                } else {
-                    cout << this->valueToString(arg);
-                }
-            }
-
-            if (need_new_line) cout << endl;
-            return StringType("");
-        }
-
-        Value cleanScreen(const vector<Value>& args) {
-            #ifdef _WIN32
-                system("cls");
-            #else
-                system("clear");
-            #endif
-            return StringType("");
-        }
-
-        Value exitFunction(const vector<Value>& args) {
-            cout << RESET << "Exit MiLang REPL" << endl;
-            #ifndef __GNUC__
-                quick_exit(0);
-            #else
-                exit(0);
-            #endif
-            return StringType("");
-        }
-
-        Value funcList(const vector<Value>& args, function<const FuncVector&()> getFuncList) {
-            auto data = getFuncList();
-            int count = 0;
-            for (const auto& [name, func] : data) {
-                count++;
-                cout << name << endl;
-            }
-            return StringType("");
-        }
-    };
-
+#ifndef INNER_METHOD_HPP
+#define INNER_METHOD_HPP
+
+    #include "../MiLang.hpp"
+    #include "../colors.hpp"
+    #include "Output.hpp"
+
+    using FuncVector = std::vector<std::pair<std::string, BuiltinFunction>>;
+
+    void printVariant(const std::variant<long long int, long double, std::string, bool, FunctionTypePtr>& var) {
+        std::visit([](const auto& value) {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<T, long long int>) {
+                std::cout << value;
+            } else if constexpr (std::is_same_v<T, long double>) {
+                std::cout << value;
+            } else if constexpr (std::is_same_v<T, std::string>) {
+                std::cout << value;
+            } else if constexpr (std::is_same_v<T, bool>) {
+                std::cout << std::boolalpha << value;
+            } else if constexpr (std::is_same_v<T, FunctionTypePtr>) {
+                std::cout << "FunctionType(" << value->name << ")";
+            }
+        }, var);
+    }
+
+    class InnerMethod {
+    private:
+        // 内置函数读写的流, 每个解释器各有一份, 默认是标准输入输出; 工作线程共用发起线程的输出
+        std::istream* in = &std::cin;
+        std::shared_ptr<OutputSink> out = OutputSink::standard();
+
+        bool canCompareInternal(const Value& a, const Value& b) const {
+            if (holds_alternative<BoolType>(a) || holds_alternative<BoolType>(b)) {
+                return holds_alternative<BoolType>(a) && holds_alternative<BoolType>(b);
+            }
+
+            if (holds_alternative<StringType>(a) || holds_alternative<StringType>(b)) {
+                return holds_alternative<StringType>(a) && holds_alternative<StringType>(b);
+            }
+
+            return true;
+        }
+
+    public:
+        void setInput(std::istream& input) { in = &input; }
+
+        void setOutput(std::ostream& output) { out = std::make_shared<OutputSink>(output); }
+
+        void shareOutput(const InnerMethod& other) { out = other.out; }
+
+        OutputSink& output() { return *out; }
+
+        std::string getTypeName(const Value& val) {
+            switch (val.type()) {
+                case Value::INT:      return "int";
+                case Value::FLOAT:    return "float";
+                case Value::STRING:   return "string";
+                case Value::BOOL:     return "bool";
+                case Value::NONE:     return "Null";
+                case Value::FUNCTION: return "function";
+                case Value::GENERATOR: return "generator";
+                case Value::FUTURE:   return "future";
+                case Value::COUNTER:  return "counter";
+                default:              return "unknown";
+            }
+        }
+
+        bool canCompare(const Value& a, const Value& b) const {
+            return canCompareInternal(a, b);
+        }
+
+        pair<FloatType, FloatType> convertToNumbers(const Value& a, const Value& b) {
+            return {toNumber(a), toNumber(b)};
+        }
+
+        FloatType toNumber(const Value& val) {
+            switch (val.type()) {
+                case Value::INT:   return static_cast<FloatType>(val.asInt());
+                case Value::FLOAT: return val.asFloat();
+                default:
+                    throw runtime_error("Type error: Cannot perform math operation on string/boolean");
+            }
+        }
+
+        std::string valueToString(const Value& val) {
+            switch (val.type()) {
+                case Value::INT:
+                    return to_string(val.asInt());
+                case Value::FLOAT: {
+                    FloatType f = val.asFloat();
+                    if (isnan(f)) {
+                        return "nan";
+                    }
+                    if (isinf(f)) {
+                        return f > 0 ? "inf" : "-inf";
+                    }
+                    stringstream ss;
+                    if (f == floor(f)) {
+                        // 整数值; 很大的数改用科学计数法, 有效数字取决于浮点档位
+                        if (fabs(f) < 1e16) {
+                            return to_string(static_cast<IntType>(f)) + ".0";
+                        }
+                        ss << setprecision(numeric_limits<FloatType>::digits10) << f;
+                        return ss.str();
+                    }
+                    ss << fixed << setprecision(6) << f;
+                    std::string str = ss.str();
+                    str.erase(str.find_last_not_of('0') + 1, string::npos);
+                    if (str.back() == '.') {
+                        str += '0';
+                    }
+                    return str;
+                }
+                case Value::STRING:
+                    return val.asString();
+                case Value::BOOL:
+                    return val.asBool() ? "True" : "False";
+                case Value::FUNCTION:
+                    return "<Function \"" + val.functionPtr()->name + "\">";
+                case Value::GENERATOR:
+                    return "<Generator \"" + val.generatorPtr()->name + "\">";
+                case Value::FUTURE:
+                    return "<Future \"" + val.futurePtr()->name + "\">";
+                case Value::COUNTER:
+                    return "<Counter " + to_string(val.counterPtr()->value.load()) + ">";
+                case Value::NONE:
+                    return "Null";
+                default:
+                    return "Error in \"valueToString\"";
+            }
+        }
+
+        /*
+        #  转换类内置函数对一个值的转换, 个数检查之后调用;
+        #  intrinsics pass 改写出的 ConvertNode 和字节码 CONVERT 直接调用这些
+        */
+        Value intOf(const Value& arg) {
+            if (holds_alternative<IntType>(arg)) {
+                return arg;
+            } else if (holds_alternative<FloatType>(arg)) {
+                return IntType(floor(get<FloatType>(arg)));
+            } else if (holds_alternative<StringType>(arg)) {
+                std::string s = get<StringType>(arg);
+                try {
+                    size_t pos;
+                    int32_t num = stoi(s, &pos);
+                    if (pos == s.size()) {
+                        return IntType(num);
+                    }
+                    FloatType f = stringToFloat(s, &pos);
+                    if (pos == s.size()) {
+                        return IntType(floor(f));
+                    }
+                } catch (...) {
+                    throw runtime_error("Cannot convert to integer: " + s);
+                }
+                throw runtime_error("Cannot convert to integer: " + s);
+            }
+            throw runtime_error("Unsupported type for int conversion");
+        }
+
+        Value floatOf(const Value& arg) {
+            if (holds_alternative<FloatType>(arg)) {
+                return arg;
+            } else if (holds_alternative<IntType>(arg)) {
+                return FloatType(get<IntType>(arg));
+            } else if (holds_alternative<StringType>(arg)) {
+                std::string s = get<StringType>(arg);
+                try {
+                    return stringToFloat(s);
+                } catch (...) {
+                    throw runtime_error("Cannot convert to float: " + s);
+                }
+            }
+            throw runtime_error("Unsupported type for float conversion");
+        }
+
+        Value boolOf(const Value& arg) {
+            if (holds_alternative<BoolType>(arg)) {
+                return arg;
+            } else if (holds_alternative<IntType>(arg)) {
+                return BoolType(get<IntType>(arg) != 0);
+            } else if (holds_alternative<FloatType>(arg)) {
+                return BoolType(get<FloatType>(arg) != 0.0);
+            } else if (holds_alternative<StringType>(arg)) {
+                const std::string& s = get<StringType>(arg);
+                return BoolType(!s.empty() && s != "false" && s != "0");
+            }
+            return BoolType(false);
+        }
+
+        Value stringOf(const Value& arg) {
+            if (holds_alternative<StringType>(arg)) {
+                return arg;
+            }
+            return StringType(this->valueToString(arg));
+        }
+
+        Value typeOf(const Value& arg) {
+            if (holds_alternative<FunctionTypePtr>(arg)) {
+                return StringType("<Function \"" + arg.functionPtr()->name + "\">");
+            }
+            return StringType(getTypeName(arg));
+        }
+
+        Value intFunction(BuiltinArgs args) {
+            if (args.size() != 1) {
+                throw runtime_error("int() requires exactly one argument");
+            }
+            return intOf(args[0]);
+        }
+
+        Value floatFunction(BuiltinArgs args) {
+            if (args.size() != 1) {
+                throw runtime_error("float() requires exactly one argument");
+            }
+            return floatOf(args[0]);
+        }
+
+        Value boolFunction(BuiltinArgs args) {
+            if (args.size() != 1) {
+                throw runtime_error("bool() requires exactly one argument");
+            }
+            return boolOf(args[0]);
+        }
+
+        Value stringFunction(BuiltinArgs args) {
+            if (args.size() != 1) {
+                throw runtime_error("string() requires exactly one argument");
+            }
+            return stringOf(args[0]);
+        }
+
+        Value typeFunction(BuiltinArgs args) {
+            if (args.size() != 1) {
+                throw runtime_error("type() requires exactly one argument");
+            }
+            return typeOf(args[0]);
+        }
+
+        // next(g): 生成器的下一个值, 已经结束时报错
+        Value nextFunction(BuiltinArgs args) {
+            if (args.size() != 1 || !holds_alternative<GeneratorPtr>(args[0])) {
+                throw runtime_error("next() requires exactly one generator argument");
+            }
+            GeneratorType* gen = args[0].generatorPtr();
+            Value value;
+            if (!gen->next(value)) {
+                throw runtime_error("Generator " + gen->name + " is exhausted");
+            }
+            return value;
+        }
+
+        // has_next(g): 生成器还有没有值; 为此会先执行到下一个 yield
+        Value hasNextFunction(BuiltinArgs args) {
+            if (args.size() != 1 || !holds_alternative<GeneratorPtr>(args[0])) {
+                throw runtime_error("has_next() requires exactly one generator argument");
+            }
+            return BoolType(args[0].generatorPtr()->hasNext());
+        }
+
+        // join(f): 等 spawn 的任务结束, 返回它的结果
+        Value joinFunction(BuiltinArgs args) {
+            if (args.size() != 1 || !holds_alternative<FuturePtr>(args[0])) {
+                throw runtime_error("join() requires exactly one future argument");
+            }
+            return args[0].futurePtr()->join();
+        }
+
+        // counter(n = 0): 可以在任务之间共享的原子计数器
+        Value counterFunction(BuiltinArgs args) {
+            if (args.size() > 1 || (args.size() == 1 && !holds_alternative<IntType>(args[0]))) {
+                throw runtime_error("counter() takes an optional int start value");
+            }
+            return CounterPtr(new CounterType(args.empty() ? 0 : args[0].asInt()));
+        }
+
+        // counter_add(c, n): 原子地加上 n, 返回相加后的值
+        Value counterAddFunction(BuiltinArgs args) {
+            if (args.size() != 2 || !holds_alternative<CounterPtr>(args[0]) || !holds_alternative<IntType>(args[1])) {
+                throw runtime_error("counter_add() requires a counter and an int");
+            }
+            return args[0].counterPtr()->value.fetch_add(args[1].asInt()) + args[1].asInt();
+        }
+
+        Value counterGetFunction(BuiltinArgs args) {
+            if (args.size() != 1 || !holds_alternative<CounterPtr>(args[0])) {
+                throw runtime_error("counter_get() requires exactly one counter argument");
+            }
+            return args[0].counterPtr()->value.load();
+        }
+
+        Value receiveFunction(BuiltinArgs args) {
+            if (!args.empty() && holds_alternative<StringType>(args[0])) {
+                out->write(get<StringType>(args[0]));
+            }
+            out->flush();
+
+            std::string input;
+            getline(*in, input);
+            return StringType(input);
+        }
+
+        int countPlaceholders(const string& s) {
+            int count = 0;
+            size_t pos = 0;
+
+            while (pos < s.size()) {
+                size_t start = s.find('{', pos);
+                if (start == string::npos) {
+                    break;
+                }
+
+                if (start + 1 < s.size() && s[start + 1] == '}') {
+                    count++;
+                    pos = start + 2;
+                } else {
+                    pos = start + 1;
+                }
+            }
+
+            return count;
+        }
+
+        Value writelnFunction(BuiltinArgs args, bool need_new_line = true) {
+            std::string name;
+            if (need_new_line) {
+                name = "writeln()";
+            } else {
+                name = "write()";
+            }
+            if (args.empty()) {
+                if (name == "writeln()") {out->write("\n");}
+                return StringType("");
+            }
+
+            std::string text;
+
+            if (holds_alternative<StringType>(args[0])) {
+                std::string format = get<StringType>(args[0]);
+                BuiltinArgs params = args.subspan(1);
+
+                int placeholderCount = countPlaceholders(format);
+
+                if (placeholderCount != 0 && placeholderCount != params.size()) {
+                   throw runtime_error(
+                        name + " placeholder count mismatch: " +
+                        to_string(placeholderCount) + " placeholders, " +
+                        to_string(params.size()) + " arguments"
+                   );
+                }
+
+                if (placeholderCount > 0) {
+                    size_t paramIndex = 0;
+                    size_t pos = 0;
+
+                    while (pos < format.size() && paramIndex < params.size()) {
+                        size_t start = format.find('{', pos);
+                        size_t end = format.find('}', start);
+
+                        if (start == string::npos || end == string::npos) {
+                            break;
+                        }
+
+                        text.append(format, pos, start - pos);
+                        text += this->valueToString(params[paramIndex]);
+
+                        paramIndex++;
+                        pos = end + 1;
+                    }
+
+                    text.append(format, pos);
+                    if (need_new_line) text += '\n';
+                    out->write(text);
+                    return StringType("");
+                }
+            }
+
+            for (const auto& arg : args) {
+                text += this->valueToString(arg);
+            }
+            if(need_new_line) {
+                text += '\n';
+            }
+            out->write(text);
+            return StringType("");
+        }
+
+        Value printlnFunction(BuiltinArgs args, bool need_new_line = true) {
+            static const auto unescapeChar = [](char c) -> char {
+                switch (c) {
+                    case 'n': return '\n';
+                    case 't': return '\t';
+                    case 'r': return '\r';
+                    case 'e': return '\033'; 
+                    case 'a': return '\a';
+                    case 'b': return '\b';
+                    case 'f': return '\f';
+                    case 'v': return '\v';
+                    case '0': return '\0';
+                    default: return c;
+                }
+            };
+
+            std::string text;
+            auto outputWithEscape = [&text](const std::string& s) {
+                bool escaping = false;
+                for (char c : s) {
+                    if (escaping) {
+                        text += unescapeChar(c);
+                        escaping = false;
+                    } else if (c == '\\') {
+                        escaping = true;
+                    } else {
+                        text += c;
+                    }
+                }
+                
+                if (escaping) {
+                    text += '\\';
+                }
+            };
+
+            auto countEmptyPlaceholders = [](const std::string& s) -> int {
+                int count = 0;
+                for (size_t i = 0; i < s.size(); ++i) {
+                    if (s[i] == '{' && i + 1 < s.size() && s[i + 1] == '}') {
+                        count++;
+                        i++; 
+                    }
+                }
+                return count;
+            };
+
+            if (args.empty()) {
+                if (need_new_line) out->write("\n");
+                return StringType("");
+            }
+
+            
+            if (holds_alternative<StringType>(args[0])) {
+                const std::string& format = get<StringType>(args[0]);
+                BuiltinArgs params = args.subspan(1);
+                const int placeholderCount = countEmptyPlaceholders(format);
+
+                if (placeholderCount != 0 && placeholderCount != static_cast<int>(params.size())) {
+                    throw runtime_error(
+                        std::string(need_new_line ? "writeln()" : "write()") +
+                        " placeholder count mismatch: " +
+                        std::to_string(placeholderCount) +
+                        " placeholders, " +
+                        std::to_string(params.size()) +
+                        " arguments"
+                    );
+                }
+
+                if (placeholderCount > 0) {
+                    size_t paramIndex = 0;
+                    size_t pos = 0;
+                    bool escaping = false;
+
+                    while (pos < format.size()) {
+                        if (escaping) {
+                            text += unescapeChar(format[pos]);
+                            escaping = false;
+                            pos++;
+                            continue;
+                        }
+
+                        if (format[pos] == '\\') {
+                            escaping = true;
+                            pos++;
+                            continue;
+                        }
+
+                        if (format[pos] == '{' && pos + 1 < format.size() && format[pos + 1] == '}') {
+                            
+                            outputWithEscape(format.substr(pos, pos - pos));
+
+                            if (paramIndex < params.size()) {
+                                if (holds_alternative<StringType>(params[paramIndex])) {
+                                    outputWithEscape(get<StringType>(params[paramIndex]));
+                                } else {
+                                    text += this->valueToString(params[paramIndex]);
+                                }
+                                paramIndex++;
+                            }
+
+                            pos += 2; 
+                            continue;
+                        }
+
+                        if (format[pos] == '{' || format[pos] == '}') {
+                            size_t start = pos;
+                            size_t end = format.find_first_of("{}", pos + 1);
+
+                            if (end == string::npos) {
+                                
+                                outputWithEscape(format.substr(pos));
+                                break;
+                            }
+                            outputWithEscape(format.substr(pos, end - pos + 1));
+                            pos = end + 1;
+                            continue;
+                        }
+                        size_t nextSpecial = format.find_first_of("\\{}", pos);
+                        if (nextSpecial == string::npos) {
+                            
+                            outputWithEscape(format.substr(pos));
+                            break;
+                        }
+
+                        outputWithEscape(format.substr(pos, nextSpecial - pos));
+                        pos = nextSpecial;
+                    }
+
+                    if (need_new_line) text += '\n';
+                    out->write(text);
+                    return StringType("");
+                }
+            }
+
+            
+            for (const auto& arg : args) {
+                if (holds_alternative<StringType>(arg)) {
+                    outputWithEscape(get<StringType>(arg));
+                } else {
+                    text += this->valueToString(arg);
+                }
+            }
+
+            if (need_new_line) text += '\n';
+            out->write(text);
+            return StringType("");
+        }
+
+        Value flushFunction(BuiltinArgs args) {
+            if (!args.empty()) {
+                throw runtime_error("flush() takes no arguments");
+            }
+            out->flush();
+            return StringType("");
+        }
+
+        Value cleanScreen(BuiltinArgs args) {
+            out->flush();
+            #ifdef _WIN32
+                system("cls");
+            #else
+                system("clear");
+            #endif
+            return StringType("");
+        }
+
+        Value exitFunction(BuiltinArgs args) {
+            out->write(std::string(RESET) + "Exit MiLang REPL\n");
+            out->flush();
+            throw ProgramExit{0};
+        }
+
+        Value funcList(BuiltinArgs args, function<const FuncVector&()> getFuncList) {
+            auto data = getFuncList();
+            int count = 0;
+            std::string text;
+            for (const auto& [name, func] : data) {
+                count++;
+                text += name + '\n';
+            }
+            out->write(text);
+            return StringType("");
+        }
+    };
+
+    // 定义在这里, 生成的 C++ 程序不包含 evaluate.hpp 也能使用
+    inline Value ConvertNode::apply(Kind kind, const Value& value, InnerMethod& inner) {
+        switch (kind) {
+            case INT:
+                return value.type() == Value::INT ? value : inner.intOf(value);
+            case FLOAT:
+                if (value.type() == Value::INT) {
+                    return static_cast<FloatType>(value.asInt());
+                }
+                return value.type() == Value::FLOAT ? value : inner.floatOf(value);
+            case BOOL:
+                return value.type() == Value::BOOL ? value : inner.boolOf(value);
+            case STRING:
+                return inner.stringOf(value);
+            case TYPE:
+                return inner.typeOf(value);
+        }
+        return value;
+    }
+
 #endif
\ No newline at end of file
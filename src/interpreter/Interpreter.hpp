@@ -1,129 +1,665 @@
-#ifndef INTERPRETER_HPP
-    #define INTERPRETER_HPP
-
-    #include "InnerMethod.hpp"
-    #include "../colors.hpp"
-    #include "../MiLang.hpp"
-
-    using FuncVector = std::vector<
-        std::pair<
-            std::string,
-            std::function<Value(InnerMethod&, const std::vector<Value>&)>
-        >
-    >;
-
-    class Interpreter {
-    private:
-        stack<unique_ptr<Frame>> frames;
-        using BuiltinFunction = function<Value(InnerMethod&, const vector<Value>&)>;
-        unordered_map<string, BuiltinFunction> builtinFunctions;
-        InnerMethod innermethod;
-        FuncVector funcList;
-
-    public:
-        Frame* getCurrentFrame() {
-            if (frames.empty()) {
-                throw runtime_error("No active frame");
-            }
-            return frames.top().get();
-        }
-
-    public:
-        Interpreter() {
-            frames.push(make_unique<Frame>());
-            const FuncVector funcs = {
-                {"int",     wrapIMFunc(&InnerMethod::intFunction)},
-                {"float",   wrapIMFunc(&InnerMethod::floatFunction)},
-                {"bool",    wrapIMFunc(&InnerMethod::boolFunction)},
-                {"string",  wrapIMFunc(&InnerMethod::stringFunction)},
-                {"type",    wrapIMFunc(&InnerMethod::typeFunction)},
-                {"receive", wrapIMFunc(&InnerMethod::receiveFunction)},
-                {"clear", wrapIMFunc(&InnerMethod::cleanScreen)},
-                {"exit", wrapIMFunc(&InnerMethod::exitFunction)},
-                {"writeln", wrapIMFuncWithArg(&InnerMethod::writelnFunction, true)},
-                {"write",   wrapIMFuncWithArg(&InnerMethod::writelnFunction, false)},
-                {"println", wrapIMFuncWithArg(&InnerMethod::printlnFunction, true)},
-                {"print",   wrapIMFuncWithArg(&InnerMethod::printlnFunction, false)},
-            };
-            this->funcList = funcs;
-
-            for (const auto& [name, func] : funcList) {
-                builtinFunctions[name] = func;
-
-                
-                auto funcType = std::make_shared<FunctionType>(name);
-                frames.top()->set(name, funcType);
-            }
-            auto getFuncList = [this]() -> const FuncVector& {
-                return this->funcList;
-            };
-            auto innerFunc = wrapIMFuncWithArg(&InnerMethod::funcList, getFuncList);
-            funcList.push_back({"inner", innerFunc});
-            builtinFunctions["inner"] = innerFunc;
-
-            
-            auto innerFuncType = std::make_shared<FunctionType>("inner");
-            frames.top()->set("inner", innerFuncType);
-
-        }
-
-        InnerMethod& getInnerMethod() { return innermethod; }
-
-        bool isBuiltinFunction(const std::string& name) const {
-            return builtinFunctions.find(name) != builtinFunctions.end();
-        }
-
-        bool getVariable(const string& name, Value& outValue) const {
-            if (frames.empty()) {
-                return false;
-            }
-            return frames.top()->find(name, outValue);
-        }
-
-        void setVariable(const string& name, const Value& value) {
-            if (frames.empty()) {
-                throw runtime_error("No Active Stack Frames.");
-            }
-            frames.top()->set(name, value);
-        }
-
-        void pushFrame(Frame* parent = nullptr) {
-            if (parent == nullptr && !frames.empty()) {
-                parent = frames.top().get();
-            }
-            auto newFrame = make_unique<Frame>(parent);
-
-            
-            if (parent) {
-                for (const auto& [varName, value] : parent->variables) {
-                    newFrame->set(varName, value);
-                }
-            }
-
-            frames.push(std::move(newFrame));
-        }
-
-        void popFrame() {
-            if (frames.size() > 1) { 
-                frames.pop();
-            }
-        }
-
-        Value execute(unique_ptr<ASTNode> node) {
-            return node->evaluate(*this);
-        }
-
-        Value callBuiltin(const string& name, const vector<Value>& args) {
-            auto it = builtinFunctions.find(name);
-            if (it == builtinFunctions.end()) {
-                throw runtime_error("Unknown function: " + name);
-            }
-            return it->second(innermethod, args);
-        }
-        Frame* getParentFrame() const {
-            if (frames.size() < 2) return nullptr;
-            return frames.top()->parent;
-        }
-    };
-
+#ifndef INTERPRETER_HPP
+    #define INTERPRETER_HPP
+
+    #include "InnerMethod.hpp"
+    #include "Memo.hpp"
+    #include "Native.hpp"
+    #include "Stack.hpp"
+    #include "../jit/Jit.hpp"
+    #include "../colors.hpp"
+    #include "../MiLang.hpp"
+    #include <map>
+    #include <deque>
+
+    using FuncVector = std::vector<std::pair<std::string, BuiltinFunction>>;
+
+    class TypeInference;
+    struct TaskSnapshot;
+    class Program;
+
+    // --stats 报告的一个特化点: 节点、当前状态和守卫失败次数
+    struct QuickSite {
+        string node;
+        string state;
+        uint32_t deopts = 0;
+    };
+
+    class Interpreter {
+    private:
+        vector<unique_ptr<Frame>> frames;
+        vector<unique_ptr<Frame>> framePool;  // 弹出的帧留着复用, 连同槽位的容量
+        Completion completion = Completion::NORMAL;
+        int completionLine = 0;
+        Value returnValue;
+        FunctionTypePtr tailCallee;
+        unique_ptr<Frame> tailFrame;
+        size_t callDepth = 0;
+        size_t maxDepth = TREE_MAX_DEPTH;
+        Frame* globalFrame;
+        InnerMethod innermethod;
+        FuncVector funcList;  // 内置函数表, 调用点和字节码记住函数在表里的下标
+        unordered_map<string, size_t> builtinIndex;
+        vector<string> natives;  // bind 注册的函数名, 并行执行的解释器从发起的解释器复制
+        bool memoEnabled = false;
+        size_t memoCapacity = MEMO_CAPACITY;
+        std::map<string, MemoCounters> memoCounters;  // 按函数名汇总, 供 memo_stats() 报告
+        Jit jit;
+        bool quickening = true;
+        size_t threads = 1;  // parallel for 最多用的线程数, 可用 --threads 修改
+        bool quickStats = false;
+        std::deque<QuickSite> quickSites;  // 节点保存记录的地址, 用 deque 保证地址不变
+        unique_ptr<NodeState[]> nodeStates;  // 按 NodeSite::index 存取, 见 state()
+        size_t nodeStateCount = 0;
+        shared_ptr<TypeInference> specializer;  // 按实参类型特化函数体, 只在从文件运行时设置
+        vector<string> specializationLog;       // --stats 时记录特化过的函数和类型组合
+        shared_ptr<const TaskSnapshot> spawnSnapshot;  // spawn 上次用的全局变量快照, 见 Task::bind
+        size_t spawnDepth = 0;
+        vector<const string*> writtenGlobals;  // 之后被写的全局变量, 指向全局帧里的键
+        bool globalsRewritten = false;         // 记录不下, 下次 spawn 重新复制全部
+
+        // state() 的慢路径: 表不够大时扩大到能放下已分配的所有编号, 表项属于别的 (已释放的) 节点或还没用过时清空
+        [[gnu::noinline]] NodeState& resetState(const NodeSite& site) {
+            if (site.index >= nodeStateCount) {
+                size_t count = max<size_t>({site.index + 1, nodeStateCount * 2, NodeSite::limit()});
+                auto grown = make_unique<NodeState[]>(count);
+                std::move(nodeStates.get(), nodeStates.get() + nodeStateCount, grown.get());
+                nodeStates = std::move(grown);
+                nodeStateCount = count;
+            }
+            NodeState& entry = nodeStates[site.index];
+            entry = NodeState();
+            entry.serial = site.serial;
+            return entry;
+        }
+
+        void registerBuiltin(const string& name, BuiltinFunction func) {
+            auto it = builtinIndex.find(name);
+            if (it == builtinIndex.end()) {
+                builtinIndex[name] = funcList.size();
+                funcList.push_back({name, std::move(func)});
+            } else {
+                funcList[it->second].second = std::move(func);
+            }
+            globalFrame->variables[name] = makeRef<FunctionType>(name);
+            touchGlobals();
+        }
+
+    public:
+        Frame* getCurrentFrame() {
+            if (frames.empty()) {
+                throw runtime_error("No active frame");
+            }
+            return frames.back().get();
+        }
+
+    public:
+        Interpreter() {
+            frames.push_back(make_unique<Frame>());
+            globalFrame = frames.back().get();
+            const FuncVector funcs = {
+                {"int",     wrapIMFunc(&InnerMethod::intFunction)},
+                {"float",   wrapIMFunc(&InnerMethod::floatFunction)},
+                {"bool",    wrapIMFunc(&InnerMethod::boolFunction)},
+                {"string",  wrapIMFunc(&InnerMethod::stringFunction)},
+                {"type",    wrapIMFunc(&InnerMethod::typeFunction)},
+                {"receive", wrapIMFunc(&InnerMethod::receiveFunction)},
+                {"clear", wrapIMFunc(&InnerMethod::cleanScreen)},
+                {"exit", wrapIMFunc(&InnerMethod::exitFunction)},
+                {"writeln", wrapIMFuncWithArg(&InnerMethod::writelnFunction, true)},
+                {"write",   wrapIMFuncWithArg(&InnerMethod::writelnFunction, false)},
+                {"println", wrapIMFuncWithArg(&InnerMethod::printlnFunction, true)},
+                {"print",   wrapIMFuncWithArg(&InnerMethod::printlnFunction, false)},
+                {"flush",   wrapIMFunc(&InnerMethod::flushFunction)},
+                {"next",    wrapIMFunc(&InnerMethod::nextFunction)},
+                {"has_next", wrapIMFunc(&InnerMethod::hasNextFunction)},
+                {"join",    wrapIMFunc(&InnerMethod::joinFunction)},
+                {"counter", wrapIMFunc(&InnerMethod::counterFunction)},
+                {"counter_add", wrapIMFunc(&InnerMethod::counterAddFunction)},
+                {"counter_get", wrapIMFunc(&InnerMethod::counterGetFunction)},
+            };
+            for (const auto& [name, func] : funcs) {
+                registerBuiltin(name, func);
+            }
+            auto getFuncList = [this]() -> const FuncVector& {
+                return this->funcList;
+            };
+            registerBuiltin("inner", wrapIMFuncWithArg(&InnerMethod::funcList, getFuncList));
+            registerBuiltin("memo_stats", [this](InnerMethod&, BuiltinArgs) -> Value {
+                return StringType(memoReport());
+            });
+            registerBuiltin("jit_stats", [this](InnerMethod&, BuiltinArgs) -> Value {
+                return StringType(jit.report());
+            });
+        }
+
+        /*
+        #  注册宿主程序的函数, 如 bind("hypot", &hypot2), 参数和返回值的对应见 Native.hpp.
+        #  在执行代码之前注册; 同名的内置函数被替换 (转换类的除外). 并行执行时各线程复制一份可调用对象同时调用
+        */
+        template<typename F>
+        void bind(const string& name, F&& fn) {
+            addBuiltin(name, makeNative(name, std::forward<F>(fn)));
+        }
+
+        // 同上, 函数在编译期已知: bind<&hypot2>("hypot")
+        template<auto Fn>
+        void bind(const string& name) {
+            addBuiltin(name, makeNative<Fn>(name));
+        }
+
+        InnerMethod& getInnerMethod() { return innermethod; }
+
+        // 内置函数读写的流; 同时运行的解释器各自设置, 互不干扰
+        void setInput(std::istream& input) { innermethod.setInput(input); }
+
+        void setOutput(std::ostream& output) { innermethod.setOutput(output); }
+
+        // 写出缓冲的输出; execute 返回时已经写出, 执行中途由宿主的函数调用
+        void flushOutput() { innermethod.output().flush(); }
+
+        const FuncVector& getFuncList() const { return funcList; }
+
+        bool isBuiltinFunction(const std::string& name) const {
+            return builtinIndex.count(name) > 0;
+        }
+
+        bool getVariable(const string& name, Value& outValue) const {
+            if (frames.empty()) {
+                return false;
+            }
+            return frames.back()->find(name, outValue);
+        }
+
+        void setVariable(const string& name, const Value& value) {
+            if (frames.empty()) {
+                throw runtime_error("No Active Stack Frames.");
+            }
+            frames.back()->set(name, value);
+            touchGlobals();  // 可能写到全局帧
+        }
+
+        Frame* getGlobalFrame() const { return globalFrame; }
+
+        // 只查 Resolver 给出的候选槽位, 都未绑定时返回 nullptr
+        Value* lookupSlots(const Resolution& resolution) {
+            Frame* frame = frames.back().get();
+            int32_t depth = 0;
+            for (const auto& ref : resolution.slots) {
+                for (; depth < ref.depth; depth++) {
+                    frame = frame->parent;
+                }
+                auto& slot = frame->slots[ref.slot];
+                if (slot.isBound()) {
+                    return &slot;
+                }
+            }
+            return nullptr;
+        }
+
+        /*
+        #  按 Resolver 给出的候选位置查找变量, 未找到时返回 nullptr
+        */
+        Value* lookup(const Resolution& resolution, const string& name) {
+            if (Value* slot = lookupSlots(resolution)) {
+                return slot;
+            }
+            if (resolution.global) {
+                auto it = globalFrame->variables.find(name);
+                if (it != globalFrame->variables.end()) {
+                    return &it->second;
+                }
+            }
+            return nullptr;
+        }
+
+        // 写回最近的已绑定变量, 都未绑定时在当前作用域创建
+        void assign(const Resolution& resolution, const string& name, const Value& value) {
+            if (Value* slot = lookupSlots(resolution)) {
+                *slot = value;
+                return;
+            }
+            auto it = resolution.global ? globalFrame->variables.find(name) : globalFrame->variables.end();
+            if (it != globalFrame->variables.end()) {
+                it->second = value;
+                globalWritten(it->first);
+            } else if (resolution.slots.empty()) {
+                auto created = globalFrame->variables.insert_or_assign(name, value).first;
+                globalWritten(created->first);
+            } else {
+                frames.back()->slots[resolution.slots.front().slot] = value;
+            }
+        }
+
+        /*
+        #  记下被写的全局变量, spawn 据此只复制快照之后变了的部分 (见 Task::bind);
+        #  还没有 spawn 过时不记录. 攒满时去掉重复的, 仍然太多就放弃记录
+        */
+        void globalWritten(const string& name) {
+            if (!spawnSnapshot || globalsRewritten) {
+                return;
+            }
+            writtenGlobals.push_back(&name);
+            if (writtenGlobals.size() >= SPAWN_WRITE_LOG) {
+                std::sort(writtenGlobals.begin(), writtenGlobals.end());
+                writtenGlobals.erase(std::unique(writtenGlobals.begin(), writtenGlobals.end()), writtenGlobals.end());
+                globalsRewritten = writtenGlobals.size() * 2 > SPAWN_WRITE_LOG;
+            }
+        }
+
+        // 不经 assign 写了全局变量 (parallel for 的计数器和归约变量、宿主的 setVariable) 之后调用
+        void touchGlobals() { globalsRewritten = true; }
+
+        // spawn 上次用的快照; 之后的写入没有记全, 或者调用深度不同 (快照带着深度) 时为 nullptr
+        shared_ptr<const TaskSnapshot> cachedSnapshot() const {
+            if (globalsRewritten || spawnDepth != callDepth) {
+                return nullptr;
+            }
+            return spawnSnapshot;
+        }
+
+        // 快照之后被写的全局变量, 可能有重复
+        const vector<const string*>& globalsWrittenSince() const { return writtenGlobals; }
+
+        void cacheSnapshot(shared_ptr<const TaskSnapshot> snapshot) {
+            spawnSnapshot = std::move(snapshot);
+            spawnDepth = callDepth;
+            writtenGlobals.clear();
+            globalsRewritten = false;
+        }
+
+        // 从帧池取一个空帧, 调用方可以先填好参数再压栈
+        unique_ptr<Frame> acquireFrame(Frame* parent, size_t slotCount) {
+            unique_ptr<Frame> frame;
+            if (framePool.empty()) {
+                frame = make_unique<Frame>(parent);
+            } else {
+                frame = std::move(framePool.back());
+                framePool.pop_back();
+                frame->parent = parent;
+            }
+            frame->slots.resize(slotCount, Value::unbound());
+            return frame;
+        }
+
+        void pushFrame(unique_ptr<Frame> frame) {
+            frames.push_back(std::move(frame));
+        }
+
+        void pushFrame(Frame* parent = nullptr, size_t slotCount = 0) {
+            if (parent == nullptr && !frames.empty()) {
+                parent = frames.back().get();
+            }
+            // 新帧只记住上一层, 外层变量在访问时沿链查找, 不再复制
+            pushFrame(acquireFrame(parent, slotCount));
+        }
+
+        void popFrame() {
+            if (frames.size() > 1) {
+                recycleFrame(std::move(frames.back()));
+                frames.pop_back();
+            }
+        }
+
+        // 没有压栈就用不到的帧 (例如命中了结果缓存) 直接放回池里
+        void recycleFrame(unique_ptr<Frame> frame) {
+            frame->slots.clear();
+            framePool.push_back(std::move(frame));
+        }
+
+        /*
+        #  生成器挂起时把自己的帧 (函数帧和循环帧) 从栈顶取下, 恢复时再放回栈顶;
+        #  帧之间只靠 parent 相连, 取下和放回不影响变量的查找
+        */
+        size_t frameDepth() const { return frames.size(); }
+
+        void restoreFrames(vector<unique_ptr<Frame>>& saved) {
+            for (auto& frame : saved) {
+                frames.push_back(std::move(frame));
+            }
+            saved.clear();
+        }
+
+        void suspendFrames(size_t base, vector<unique_ptr<Frame>>& saved) {
+            for (size_t i = base; i < frames.size(); i++) {
+                saved.push_back(std::move(frames[i]));
+            }
+            frames.resize(base);
+        }
+
+        void unwindFrames(size_t base) {
+            while (frames.size() > base) {
+                popFrame();
+            }
+        }
+
+        // 出错的任务不再执行下去: 回到执行前的帧、调用深度和控制流状态, 解释器留给下一个任务
+        struct Checkpoint {
+            size_t frames;
+            size_t calls;
+        };
+
+        Checkpoint checkpoint() const { return {frames.size(), callDepth}; }
+
+        void rewind(const Checkpoint& mark) {
+            unwindFrames(mark.frames);
+            callDepth = mark.calls;
+            completion = Completion::NORMAL;
+            returnValue = Value();
+            tailCallee.reset();
+            tailFrame.reset();
+        }
+
+        void enableMemo(size_t capacity) {
+            memoEnabled = true;
+            memoCapacity = capacity;
+        }
+
+        // 开启 --memo 时纯函数的结果缓存, 否则为 nullptr
+        MemoCache* memoFor(FunctionType& func) {
+            if (!memoEnabled || !func.pure) {
+                return nullptr;
+            }
+            if (!func.memo) {
+                func.memo = make_shared<MemoCache>(memoCapacity, memoCounters[func.name]);
+            }
+            return func.memo.get();
+        }
+
+        string memoReport() const {
+            if (!memoEnabled) {
+                return "memo: off (run with --memo)";
+            }
+            MemoCounters total;
+            stringstream ss;
+            ss << fixed << setprecision(1);
+            auto line = [&ss](const string& name, const MemoCounters& counters) {
+                uint64_t calls = counters.hits + counters.misses;
+                ss << name << ": " << counters.hits << " hits, " << counters.misses << " misses, "
+                   << counters.evictions << " evictions, "
+                   << (calls ? 100.0 * counters.hits / calls : 0.0) << "% hit rate";
+            };
+            for (const auto& [name, counters] : memoCounters) {
+                line(name, counters);
+                ss << "\n";
+                total.hits += counters.hits;
+                total.misses += counters.misses;
+                total.evictions += counters.evictions;
+            }
+            line("total", total);
+            return ss.str();
+        }
+
+        Jit& getJit() { return jit; }
+
+        // 树遍历引擎的调用: 参数在被调函数帧的槽里, 未绑定的槽为 Value::unbound()
+        bool jitCall(FunctionType& func, const Frame& callee, Value& result) {
+            return jit.call(func, callee.slots.data(), nullptr, globalFrame->variables.size(),
+                            [this](const string& name) { return globalFrame->variables.count(name) > 0; },
+                            result);
+        }
+
+        void setMaxDepth(size_t depth) { maxDepth = depth; }
+
+        void setQuickening(bool enabled) { quickening = enabled; }
+
+        void setThreads(size_t count) { threads = max<size_t>(count, 1); }
+
+        size_t getThreads() const { return threads; }
+
+        // parallel for 的工作线程沿用发起线程的设置, --stats 和按类型特化只在发起线程上
+        void inheritSettings(const Interpreter& parent) {
+            maxDepth = parent.maxDepth;
+            callDepth = parent.callDepth;
+            memoEnabled = parent.memoEnabled;
+            memoCapacity = parent.memoCapacity;
+            if (parent.jit.isEnabled()) {
+                jit.enable(parent.jit.getThreshold());
+            }
+            quickening = parent.quickening;
+            threads = parent.threads;
+            innermethod.shareOutput(parent.innermethod);
+            for (const auto& name : parent.natives) {
+                addBuiltin(name, parent.funcList[parent.builtinIndex.at(name)].second);
+            }
+        }
+
+        void enableQuickStats() { quickStats = true; }
+
+        /*
+        #  节点在这个解释器里的执行状态, 第一次用到时清空; 见 NodeSite.
+        #  表扩大时表项会移动: 返回的引用只能用到下一次执行其他节点之前, 之后重新取
+        */
+        NodeState& state(const NodeSite& site) {
+            if (site.index < nodeStateCount) [[likely]] {
+                NodeState& entry = nodeStates[site.index];
+                if (entry.serial == site.serial) [[likely]] {
+                    return entry;
+                }
+            }
+            return resetState(site);
+        }
+
+        /*
+        #  节点在观察状态下记录一次 key (类型组合或调用目标);
+        #  连续 QUICKEN_THRESHOLD 次相同时返回 true, 由节点选择特化版本.
+        #  describe 只在第一次登记 --stats 记录时调用
+        */
+        template<typename Describe>
+        bool observe(Quickening& quick, uintptr_t key, const Describe& describe) {
+            if (!quickening) {
+                specialize(quick, Quick::GENERIC, "Generic", describe);
+                return false;
+            }
+            if (quick.runs > 0 && quick.observed != key) {
+                quick.runs = 0;
+                if (++quick.deopts >= QUICKEN_MAX_DEOPTS) {
+                    specialize(quick, Quick::GENERIC, "Generic", describe);
+                    return false;
+                }
+            }
+            quick.observed = key;
+            return ++quick.runs >= QUICKEN_THRESHOLD;
+        }
+
+        template<typename Describe>
+        void specialize(Quickening& quick, Quick state, const string& name, const Describe& describe) {
+            quick.state = state;
+            quick.runs = 0;
+            if (!quickStats) {
+                return;
+            }
+            if (!quick.site) {
+                quickSites.push_back({describe(), "", 0});
+                quick.site = &quickSites.back();
+            }
+            quick.site->state = name;
+            quick.site->deopts = quick.deopts;
+        }
+
+        // 特化版本的守卫失败: 回到观察状态, 失败太多次后固定为通用路径
+        void deoptimize(Quickening& quick) {
+            quick.state = ++quick.deopts >= QUICKEN_MAX_DEOPTS ? Quick::GENERIC : Quick::WARMUP;
+            quick.runs = 0;
+            if (quick.site) {
+                quick.site->state = quick.state == Quick::GENERIC ? "Generic" : "Warmup";
+                quick.site->deopts = quick.deopts;
+            }
+        }
+
+        void setSpecializer(shared_ptr<TypeInference> types) { specializer = std::move(types); }
+
+        TypeInference* getSpecializer() const { return specializer.get(); }
+
+        void noteSpecialization(const FunctionType& func, const vector<Value::Type>& argTypes) {
+            if (!quickStats) {
+                return;
+            }
+            string entry = func.name + "(";
+            for (size_t i = 0; i < argTypes.size(); i++) {
+                entry += (i > 0 ? ", " : "") + string(argTypes[i] == Value::EMPTY ? "default" : typeName(argTypes[i]));
+            }
+            specializationLog.push_back(entry + ")");
+        }
+
+        string specializationReport() const {
+            if (!specializer) {
+                return "specialize: off";
+            }
+            stringstream ss;
+            ss << "specialize: " << specializationLog.size() << " bodies";
+            for (const auto& entry : specializationLog) {
+                ss << "\n  " << entry;
+            }
+            return ss.str();
+        }
+
+        string quickReport() const {
+            if (!quickening) {
+                return "quicken: off";
+            }
+            size_t generic = 0;
+            size_t warmup = 0;
+            for (const auto& site : quickSites) {
+                generic += site.state == "Generic";
+                warmup += site.state == "Warmup";
+            }
+            stringstream ss;
+            ss << "quicken: " << quickSites.size() << " sites, "
+               << quickSites.size() - generic - warmup << " specialized, "
+               << generic << " generic, " << warmup << " warming up";
+            for (const auto& site : quickSites) {
+                ss << "\n  " << site.node << ": " << site.state;
+                if (site.deopts > 0) {
+                    ss << " (" << site.deopts << " deopts)";
+                }
+            }
+            return ss.str();
+        }
+
+        void enterCall() {
+            if (++callDepth > maxDepth) {
+                callDepth--;
+                throw runtime_error("Maximum recursion depth exceeded (" + to_string(maxDepth) + ")");
+            }
+            if (stackExhausted()) {
+                size_t depth = callDepth--;
+                throw runtime_error("Maximum recursion depth exceeded (stack exhausted at depth " +
+                                    to_string(depth) + ")");
+            }
+        }
+
+        void leaveCall() { callDepth--; }
+
+        // break / continue / return 设置的控制流状态
+        void complete(Completion kind, int line) {
+            completion = kind;
+            completionLine = line;
+        }
+
+        void completeReturn(Value value, int line) {
+            returnValue = std::move(value);
+            complete(Completion::RETURN, line);
+        }
+
+        void completeTailCall(FunctionTypePtr func, unique_ptr<Frame> frame) {
+            tailCallee = std::move(func);
+            tailFrame = std::move(frame);
+            completion = Completion::TAIL_CALL;
+        }
+
+        FunctionTypePtr takeTailCall(unique_ptr<Frame>& frame) {
+            completion = Completion::NORMAL;
+            frame = std::move(tailFrame);
+            return std::move(tailCallee);
+        }
+
+        bool interrupted() const { return completion != Completion::NORMAL; }
+
+        Completion getCompletion() const { return completion; }
+
+        void clearCompletion() { completion = Completion::NORMAL; }
+
+        Value takeReturnValue() {
+            completion = Completion::NORMAL;
+            return std::move(returnValue);
+        }
+
+        // 没有被循环或函数调用接住的控制流状态, 报告为错误
+        void raiseStrayCompletion() {
+            Completion kind = completion;
+            completion = Completion::NORMAL;
+            if (kind == Completion::BREAK) {
+                throw runtime_error("Break outside of loop at line " + to_string(completionLine));
+            } else if (kind == Completion::CONTINUE) {
+                throw runtime_error("Continue outside of loop at line " + to_string(completionLine));
+            } else if (kind == Completion::RETURN) {
+                throw runtime_error("Return statement");
+            }
+        }
+
+        Value execute(unique_ptr<ASTNode> node) {
+            return execute(*node);
+        }
+
+        // 节点的执行状态在解释器里, 同一棵树可以同时由多个解释器执行
+        Value execute(ASTNode& node) {
+            OutputFlush flushAtEnd{innermethod.output()};
+            try {
+                Value result = node.evaluate(*this);
+                raiseStrayCompletion();
+                return result;
+            } catch (...) {
+                completion = Completion::NORMAL;
+                callDepth = 0;
+                tailCallee.reset();
+                tailFrame.reset();
+                // 出错时丢弃未弹出的帧, 交互模式下继续在全局作用域执行
+                while (frames.size() > 1) {
+                    popFrame();
+                }
+                throw;
+            }
+        }
+
+        // 执行编译好的程序, 定义在 Program.hpp
+        Value run(const Program& program);
+
+        Value callBuiltin(const string& name, BuiltinArgs args) {
+            int32_t index = findBuiltin(name);
+            if (index < 0) {
+                throw runtime_error("Unknown function: " + name);
+            }
+            return callBuiltin(index, args);
+        }
+
+        // 内置函数在表里的下标, 不是内置函数时为 -1; 表只会追加或原地替换, 下标可以由调用点缓存
+        int32_t findBuiltin(const string& name) const {
+            auto it = builtinIndex.find(name);
+            return it == builtinIndex.end() ? -1 : static_cast<int32_t>(it->second);
+        }
+
+        Value callBuiltin(size_t index, BuiltinArgs args) {
+            return funcList[index].second(innermethod, args);
+        }
+
+        /*
+        #  注册或替换一个宿主程序的函数.
+        #  int / float / bool / string / type 的调用在分析时改写成了 ConvertNode, 不能替换
+        */
+        void addBuiltin(const string& name, BuiltinFunction func) {
+            if (intrinsicKind(name)) {
+                throw runtime_error("bind: " + name + "() is an intrinsic and cannot be replaced");
+            }
+            if (find(natives.begin(), natives.end(), name) == natives.end()) {
+                natives.push_back(name);
+            }
+            registerBuiltin(name, std::move(func));
+        }
+
+        Frame* getParentFrame() const {
+            if (frames.size() < 2) return nullptr;
+            return frames.back()->parent;
+        }
+    };
+
 #endif
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef MEMO_HPP
+    #define MEMO_HPP
+
+    #include "../MiLang.hpp"
+    #include <list>
+
+    using namespace std;
+
+    struct MemoCounters {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+    // 参数槽的值; 没有传入、由默认值决定的参数记为未绑定
+    using MemoKey = std::vector<Value>;
+
+    struct MemoKeyHash {
+        size_t operator()(const MemoKey& key) const {
+            size_t seed = key.size();
+            for (const auto& value : key) {
+                size_t h = value.index();
+                switch (value.type()) {
+                    case Value::INT:      h ^= std::hash<IntType>()(value.asInt()); break;
+                    case Value::FLOAT:    h ^= std::hash<FloatType>()(value.asFloat()); break;
+                    case Value::STRING:   h ^= std::hash<StringType>()(value.asString()); break;
+                    case Value::BOOL:     h ^= value.asBool(); break;
+                    case Value::FUNCTION: h ^= std::hash<const void*>()(value.functionPtr()); break;
+                    case Value::GENERATOR: h ^= std::hash<const void*>()(value.generatorPtr()); break;
+                    case Value::FUTURE:   h ^= std::hash<const void*>()(value.futurePtr()); break;
+                    case Value::COUNTER:  h ^= std::hash<const void*>()(value.counterPtr()); break;
+                    default:              break;
+                }
+                seed ^= h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+            }
+            return seed;
+        }
+    };
+
+    struct MemoKeyEqual {
+        // 浮点数按值和符号比较: -0.0 与 0.0 的结果可能不同, NaN 与自身相等
+        static bool same(const Value& a, const Value& b) {
+            if (a.type() != b.type()) {
+                return false;
+            }
+            switch (a.type()) {
+                case Value::INT:      return a.asInt() == b.asInt();
+                case Value::FLOAT: {
+                    FloatType x = a.asFloat();
+                    FloatType y = b.asFloat();
+                    if (std::isnan(x) || std::isnan(y)) {
+                        return std::isnan(x) && std::isnan(y);
+                    }
+                    return x == y && std::signbit(x) == std::signbit(y);
+                }
+                case Value::STRING:   return a.asString() == b.asString();
+                case Value::BOOL:     return a.asBool() == b.asBool();
+                case Value::FUNCTION: return a.functionPtr() == b.functionPtr();
+                case Value::GENERATOR: return a.generatorPtr() == b.generatorPtr();
+                case Value::FUTURE:   return a.futurePtr() == b.futurePtr();
+                case Value::COUNTER:  return a.counterPtr() == b.counterPtr();
+                default:              return true;
+            }
+        }
+
+        bool operator()(const MemoKey& a, const MemoKey& b) const {
+            if (a.size() != b.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < a.size(); i++) {
+                if (!same(a[i], b[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    /*
+    #  纯函数的结果缓存, 容量固定, 满了淘汰最久未用的项
+    #  计数写进解释器里按函数名汇总的 MemoCounters
+    */
+    class MemoCache {
+    private:
+        struct Entry {
+            Value result;
+            std::list<const MemoKey*>::iterator position;
+        };
+
+        size_t capacity;
+        MemoCounters& counters;
+        std::unordered_map<MemoKey, Entry, MemoKeyHash, MemoKeyEqual> entries;
+        std::list<const MemoKey*> recent;  // 表头是最近用过的
+
+    public:
+        MemoCache(size_t capacity, MemoCounters& counters)
+            : capacity(capacity), counters(counters) {}
+
+        const Value* find(const MemoKey& key) {
+            auto it = entries.find(key);
+            if (it == entries.end()) {
+                counters.misses++;
+                return nullptr;
+            }
+            counters.hits++;
+            recent.splice(recent.begin(), recent, it->second.position);
+            return &it->second.result;
+        }
+
+        void insert(MemoKey key, const Value& result) {
+            auto [it, inserted] = entries.try_emplace(std::move(key), Entry{result, {}});
+            if (!inserted) {
+                return;
+            }
+            recent.push_front(&it->first);
+            it->second.position = recent.begin();
+            if (entries.size() > capacity) {
+                entries.erase(*recent.back());
+                recent.pop_back();
+                counters.evictions++;
+            }
+        }
+    };
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef NATIVE_HPP
+    #define NATIVE_HPP
+
+    #include <optional>
+    #include <string>
+    #include <string_view>
+    #include <tuple>
+    #include <type_traits>
+    #include <utility>
+    #include <vector>
+    #include "../MiLang.hpp"
+
+    using namespace std;
+
+    /*
+    #  类型化绑定: 宿主程序用普通的 C++ 函数注册内置函数, 见 Interpreter::bind 和 example/host.cpp
+    #
+    #  参数的类型决定接受的值: 整数类型接受 int (超出范围时报错), 浮点类型接受 int 和 float,
+    #  bool 接受 bool, string / const string& / string_view 接受 string, Value 接受任何值;
+    #  末尾的 optional<T> 参数可以不传. 返回值按同样的对应转换, void 返回 Null.
+    #  取实参、检查个数和类型的代码按签名在编译期展开, 不支持的类型在编译时报错.
+    #  bind<&fn> 注册的函数存成函数指针直接调用; 其余可调用对象经过 std::function, 开销与手写的内置函数相同
+    */
+    template<typename T>
+    struct NativeArg {
+        static_assert(sizeof(T) == 0, "bind: unsupported parameter type for a native function");
+    };
+
+    [[noreturn]] inline void nativeTypeError(const string& name, size_t index, const char* expected, const Value& value) {
+        throw runtime_error("Type error: " + name + "() argument " + to_string(index + 1) + " expects " + expected +
+                            ", got " + typeName(value.type()));
+    }
+
+    template<typename T>
+        requires (is_integral_v<T> && !is_same_v<T, bool> && !is_same_v<T, char>)
+    struct NativeArg<T> {
+        static T get(const string& name, BuiltinArgs args, size_t index) {
+            const Value& value = args[index];
+            if (value.type() != Value::INT) {
+                nativeTypeError(name, index, "int", value);
+            }
+            if (!in_range<T>(value.asInt())) {
+                throw runtime_error(name + "() argument " + to_string(index + 1) + " is out of range: " +
+                                    to_string(value.asInt()));
+            }
+            return static_cast<T>(value.asInt());
+        }
+    };
+
+    template<typename T>
+        requires is_floating_point_v<T>
+    struct NativeArg<T> {
+        static T get(const string& name, BuiltinArgs args, size_t index) {
+            const Value& value = args[index];
+            if (value.type() == Value::FLOAT) {
+                return static_cast<T>(value.asFloat());
+            }
+            if (value.type() != Value::INT) {
+                nativeTypeError(name, index, "float", value);
+            }
+            return static_cast<T>(value.asInt());
+        }
+    };
+
+    template<>
+    struct NativeArg<bool> {
+        static bool get(const string& name, BuiltinArgs args, size_t index) {
+            if (args[index].type() != Value::BOOL) {
+                nativeTypeError(name, index, "bool", args[index]);
+            }
+            return args[index].asBool();
+        }
+    };
+
+    // 字符串按引用传给函数, 不复制
+    template<>
+    struct NativeArg<StringType> {
+        static const StringType& get(const string& name, BuiltinArgs args, size_t index) {
+            if (args[index].type() != Value::STRING) {
+                nativeTypeError(name, index, "string", args[index]);
+            }
+            return args[index].asString();
+        }
+    };
+
+    template<>
+    struct NativeArg<string_view> {
+        static string_view get(const string& name, BuiltinArgs args, size_t index) {
+            return NativeArg<StringType>::get(name, args, index);
+        }
+    };
+
+    template<>
+    struct NativeArg<Value> {
+        static const Value& get(const string&, BuiltinArgs args, size_t index) { return args[index]; }
+    };
+
+    template<typename T>
+    struct NativeArg<optional<T>> {
+        static optional<T> get(const string& name, BuiltinArgs args, size_t index) {
+            if (index >= args.size()) {
+                return nullopt;
+            }
+            return NativeArg<T>::get(name, args, index);
+        }
+    };
+
+    template<typename T>
+    struct NativeOptional : false_type {};
+
+    template<typename T>
+    struct NativeOptional<optional<T>> : true_type {};
+
+    template<typename R>
+    Value nativeResult(R&& result) {
+        using T = remove_cvref_t<R>;
+        if constexpr (is_same_v<T, Value>) {
+            return std::forward<R>(result);
+        } else if constexpr (is_same_v<T, string_view>) {
+            return StringType(result);
+        } else {
+            static_assert(is_same_v<T, bool> || is_same_v<T, StringType> || is_same_v<T, const char*> ||
+                              (is_arithmetic_v<T> && !is_same_v<T, char>),
+                          "bind: unsupported return type for a native function");
+            return Value(std::forward<R>(result));
+        }
+    }
+
+    /*
+    #  一个签名的展开: Args 是去掉引用和 const 的参数类型.
+    #  必需的参数在前, optional 的在后, 个数不对时按内置函数的写法报错
+    */
+    template<typename R, typename... Args>
+    struct NativeSignature {
+        static constexpr size_t maxArgs = sizeof...(Args);
+        static constexpr size_t minArgs = [] {
+            constexpr bool optional[] = {NativeOptional<Args>::value..., false};
+            size_t count = 0;
+            while (count < maxArgs && !optional[count]) {
+                count++;
+            }
+            return count;
+        }();
+        static_assert(((NativeOptional<Args>::value ? 1 : 0) + ... + 0) == maxArgs - minArgs,
+                      "bind: optional parameters must come last");
+
+        static void checkCount(const string& name, size_t count) {
+            if (count >= minArgs && count <= maxArgs) {
+                return;
+            }
+            string expected = minArgs == maxArgs ? "exactly " + to_string(minArgs)
+                                                 : to_string(minArgs) + " to " + to_string(maxArgs);
+            throw runtime_error(name + "() requires " + expected + (maxArgs == 1 ? " argument" : " arguments"));
+        }
+
+        template<typename F>
+        static Value call(const string& name, F& fn, BuiltinArgs args) {
+            checkCount(name, args.size());
+            return unpack(name, fn, args, index_sequence_for<Args...>{});
+        }
+
+    private:
+        // 花括号里的实参按顺序求值, 报告的是第一个类型不对的参数
+        template<typename F, size_t... I>
+        static Value unpack(const string& name, F& fn, BuiltinArgs args, index_sequence<I...>) {
+            if constexpr (is_void_v<R>) {
+                apply(fn, tuple<decltype(NativeArg<Args>::get(name, args, I))...>{NativeArg<Args>::get(name, args, I)...});
+                return NullType();
+            } else {
+                return nativeResult(
+                    apply(fn, tuple<decltype(NativeArg<Args>::get(name, args, I))...>{NativeArg<Args>::get(name, args, I)...}));
+            }
+        }
+    };
+
+    // 从函数指针或 lambda 的 operator() 取出签名
+    template<typename F>
+    struct NativeTraits : NativeTraits<decltype(&F::operator())> {};
+
+    template<typename R, typename... Args>
+    struct NativeTraits<R (*)(Args...)> {
+        using Signature = NativeSignature<R, remove_cvref_t<Args>...>;
+    };
+
+    template<typename R, typename... Args>
+    struct NativeTraits<R (*)(Args...) noexcept> : NativeTraits<R (*)(Args...)> {};
+
+    template<typename C, typename R, typename... Args>
+    struct NativeTraits<R (C::*)(Args...) const> : NativeTraits<R (*)(Args...)> {};
+
+    template<typename C, typename R, typename... Args>
+    struct NativeTraits<R (C::*)(Args...)> : NativeTraits<R (*)(Args...)> {};
+
+    template<typename C, typename R, typename... Args>
+    struct NativeTraits<R (C::*)(Args...) const noexcept> : NativeTraits<R (*)(Args...)> {};
+
+    template<typename C, typename R, typename... Args>
+    struct NativeTraits<R (C::*)(Args...) noexcept> : NativeTraits<R (*)(Args...)> {};
+
+    // 可调用对象连同名字一起保存, 名字只在报错时使用
+    template<typename F>
+    BuiltinFunction makeNative(const string& name, F&& fn) {
+        using Callable = decay_t<F>;
+        using Signature = typename NativeTraits<Callable>::Signature;
+        return [name, fn = Callable(std::forward<F>(fn))](InnerMethod&, BuiltinArgs args) mutable {
+            return Signature::call(name, fn, args);
+        };
+    }
+
+    // 编译期已知的函数: 每个函数一个不带状态的包装, 存成函数指针, 调用直接展开在包装里
+    template<auto Fn>
+    Value nativeThunk(const string& name, InnerMethod&, BuiltinArgs args) {
+        using Signature = typename NativeTraits<decltype(Fn)>::Signature;
+        auto fn = Fn;
+        return Signature::call(name, fn, args);
+    }
+
+    template<auto Fn>
+    BuiltinFunction makeNative(const string& name) {
+        return BuiltinFunction(name, &nativeThunk<Fn>);
+    }
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef OUTPUT_HPP
+    #define OUTPUT_HPP
+
+    #include <cerrno>
+    #include <iostream>
+    #include <memory>
+    #include <mutex>
+    #include <string>
+    #include <string_view>
+    #ifdef _WIN32
+        #include <io.h>
+    #else
+        #include <sys/uio.h>
+        #include <unistd.h>
+    #endif
+
+    using namespace std;
+
+    inline constexpr size_t OUTPUT_BUFFER_SIZE = 64 * 1024;
+
+    /*
+    #  write / writeln / print / println 的输出. 每次调用先拼成一段文本再整体交给这里,
+    #  多个线程同时输出时一次调用的内容不会被打断
+    #
+    #  标准输出: 攒满 OUTPUT_BUFFER_SIZE 字节才用 write / writev 写出一次, 输出到终端时遇到换行就写出;
+    #  flush()、exit()、receive() 读输入之前和程序结束时写出剩下的内容.
+    #  宿主用 setOutput 设置的流: 每次调用直接写进流, 由流自己缓冲
+    */
+    class OutputSink {
+    private:
+        mutex lock;
+        ostream* stream = nullptr;  // 为 nullptr 时写标准输出的文件描述符
+        string buffer;
+        bool lineBuffered = false;
+
+        // 写出缓冲区和 tail 两段, 调用方持有锁; 写失败 (如管道已关闭) 时丢弃, 与 cout 一样不报错
+        void drain(string_view tail = {}) {
+            if (buffer.empty() && tail.empty()) {
+                return;
+            }
+            // 解释器外面经 cout 输出的内容 (提示符、报错前的标题) 先写出, 保持先后顺序
+            cout.flush();
+        #ifdef _WIN32
+            writeAll(buffer.data(), buffer.size());
+            writeAll(tail.data(), tail.size());
+        #else
+            iovec parts[2] = {{buffer.data(), buffer.size()}, {const_cast<char*>(tail.data()), tail.size()}};
+            iovec* part = parts;
+            int count = 2;
+            while (count > 0) {
+                ssize_t written = ::writev(STDOUT_FILENO, part, count);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    break;
+                }
+                size_t rest = static_cast<size_t>(written);
+                while (count > 0 && rest >= part->iov_len) {
+                    rest -= part->iov_len;
+                    part++;
+                    count--;
+                }
+                if (count > 0) {
+                    part->iov_base = static_cast<char*>(part->iov_base) + rest;
+                    part->iov_len -= rest;
+                }
+            }
+        #endif
+            buffer.clear();
+        }
+
+    #ifdef _WIN32
+        static void writeAll(const char* data, size_t size) {
+            while (size > 0) {
+                int written = _write(1, data, static_cast<unsigned>(min<size_t>(size, 1 << 30)));
+                if (written <= 0) {
+                    return;
+                }
+                data += written;
+                size -= written;
+            }
+        }
+    #endif
+
+    public:
+        OutputSink() {
+            buffer.reserve(OUTPUT_BUFFER_SIZE);
+        #ifdef _WIN32
+            lineBuffered = _isatty(1);
+        #else
+            lineBuffered = isatty(STDOUT_FILENO);
+        #endif
+        }
+
+        explicit OutputSink(ostream& stream) : stream(&stream) {}
+
+        OutputSink(const OutputSink&) = delete;
+        OutputSink& operator=(const OutputSink&) = delete;
+
+        ~OutputSink() { flush(); }
+
+        // 进程里的解释器默认共用这一个标准输出
+        static const shared_ptr<OutputSink>& standard() {
+            static const shared_ptr<OutputSink> sink = make_shared<OutputSink>();
+            return sink;
+        }
+
+        void write(string_view text) {
+            lock_guard<mutex> guard(lock);
+            if (stream) {
+                stream->write(text.data(), static_cast<streamsize>(text.size()));
+                return;
+            }
+            if (buffer.size() + text.size() > OUTPUT_BUFFER_SIZE) {
+                drain(text);  // 大段文本不复制进缓冲区, 与缓冲区一起写出
+                return;
+            }
+            buffer.append(text);
+            if (lineBuffered && text.find('\n') != string_view::npos) {
+                drain();
+            }
+        }
+
+        void flush() {
+            lock_guard<mutex> guard(lock);
+            if (stream) {
+                stream->flush();
+            } else {
+                drain();
+            }
+        }
+    };
+
+    // 执行结束 (包括出错) 时写出缓冲的输出, 宿主之后再往 cout / cerr 写也不会乱序
+    struct OutputFlush {
+        OutputSink& sink;
+        ~OutputFlush() { sink.flush(); }
+    };
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef STACK_HPP
+    #define STACK_HPP
+
+    #include <cstddef>
+    #include <cstdint>
+    #include <functional>
+    #include <stdexcept>
+    #include <string>
+    #ifdef _WIN32
+        #ifndef NOMINMAX
+            #define NOMINMAX
+        #endif
+        #ifndef WIN32_LEAN_AND_MEAN
+            #define WIN32_LEAN_AND_MEAN
+        #endif
+        #include <windows.h>
+    #elif defined(__unix__) || defined(__APPLE__)
+        #include <pthread.h>
+    #endif
+
+    using namespace std;
+
+    /*
+    #  树遍历引擎和 AOT 程序的每层调用都占用 C++ 栈.
+    #  调用前检查当前线程的栈还剩多少, 不够时报告递归太深, 而不是让进程因栈溢出崩溃;
+    #  --max-depth 只是额外的上限
+    */
+    inline constexpr size_t STACK_RESERVE = 256 * 1024;  // 留给一层调用之外的内置函数、报错等
+    inline constexpr size_t LARGE_STACK_SIZE = sizeof(void*) >= 8 ? size_t(1) << 30 : size_t(64) << 20;
+
+    // 当前线程的栈底 (最低可用地址) 加上 STACK_RESERVE; 取不到时为 0, 不检查
+    inline uintptr_t stackLimit() {
+        thread_local uintptr_t limit = [] {
+            uintptr_t low = 0;
+        #ifdef _WIN32
+            ULONG_PTR lowest = 0, highest = 0;
+            GetCurrentThreadStackLimits(&lowest, &highest);
+            low = lowest;
+        #elif defined(__APPLE__)
+            pthread_t self = pthread_self();
+            low = reinterpret_cast<uintptr_t>(pthread_get_stackaddr_np(self)) - pthread_get_stacksize_np(self);
+        #elif defined(__unix__)
+            pthread_attr_t attr;
+            if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+                void* addr = nullptr;
+                size_t size = 0;
+                if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+                    low = reinterpret_cast<uintptr_t>(addr);
+                }
+                pthread_attr_destroy(&attr);
+            }
+        #endif
+            return low == 0 ? 0 : low + STACK_RESERVE;
+        }();
+        return limit;
+    }
+
+    inline bool stackExhausted() {
+        char probe;
+        return reinterpret_cast<uintptr_t>(&probe) < stackLimit();
+    }
+
+    /*
+    #  在栈为 LARGE_STACK_SIZE 的线程里执行 body 并返回它的结果, 深递归不再受默认 8 MB 栈的限制.
+    #  栈空间按需提交, 不用到不占内存; 不能创建线程时在当前线程执行
+    */
+    inline int runOnLargeStack(const function<int()>& body) {
+    #if (defined(__unix__) || defined(__APPLE__)) && !defined(_WIN32)
+        struct Job {
+            const function<int()>& body;
+            int result = 0;
+        } job{body};
+        pthread_attr_t attr;
+        pthread_t thread;
+        if (pthread_attr_init(&attr) == 0) {
+            bool started = pthread_attr_setstacksize(&attr, LARGE_STACK_SIZE) == 0 &&
+                           pthread_create(&thread, &attr, [](void* arg) -> void* {
+                               auto* job = static_cast<Job*>(arg);
+                               job->result = job->body();
+                               return nullptr;
+                           }, &job) == 0;
+            pthread_attr_destroy(&attr);
+            if (started) {
+                pthread_join(thread, nullptr);
+                return job.result;
+            }
+        }
+    #endif
+        return body();
+    }
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef ASSEMBLER_HPP
+    #define ASSEMBLER_HPP
+
+    #include <cstdint>
+    #include <cstring>
+    #include <array>
+    #include <vector>
+    #include <stdexcept>
+
+    #if defined(__x86_64__) || defined(_M_X64)
+        #if defined(_WIN32)
+            #include <windows.h>
+            #define MI_JIT_SUPPORTED 1
+        #elif defined(__unix__) || defined(__APPLE__)
+            #include <sys/mman.h>
+            #define MI_JIT_SUPPORTED 1
+        #endif
+    #endif
+    #ifndef MI_JIT_SUPPORTED
+        #define MI_JIT_SUPPORTED 0
+    #endif
+
+    using namespace std;
+
+    /*
+    #  放进可执行内存页的机器码
+    #  先以可写方式映射、复制, 再改为只读可执行, 不同时可写可执行
+    */
+    class ExecutableCode {
+    private:
+        void* memory = nullptr;
+        size_t size = 0;
+
+    public:
+        explicit ExecutableCode(const vector<uint8_t>& bytes) : size(bytes.size()) {
+        #if MI_JIT_SUPPORTED && defined(_WIN32)
+            memory = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+            if (!memory) {
+                throw runtime_error("JIT: cannot allocate executable memory");
+            }
+            memcpy(memory, bytes.data(), size);
+            DWORD old;
+            VirtualProtect(memory, size, PAGE_EXECUTE_READ, &old);
+        #elif MI_JIT_SUPPORTED
+            memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) {
+                memory = nullptr;
+                throw runtime_error("JIT: cannot allocate executable memory");
+            }
+            memcpy(memory, bytes.data(), size);
+            if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+                munmap(memory, size);
+                memory = nullptr;
+                throw runtime_error("JIT: cannot make code executable");
+            }
+        #else
+            throw runtime_error("JIT: not supported on this platform");
+        #endif
+        }
+
+        ExecutableCode(const ExecutableCode&) = delete;
+        ExecutableCode& operator=(const ExecutableCode&) = delete;
+
+        ~ExecutableCode() {
+        #if MI_JIT_SUPPORTED && defined(_WIN32)
+            VirtualFree(memory, 0, MEM_RELEASE);
+        #elif MI_JIT_SUPPORTED
+            munmap(memory, size);
+        #endif
+        }
+
+        const void* data() const { return memory; }
+    };
+
+    /*
+    #  只覆盖 JIT 用到的 x86-64 指令
+    #
+    #  约定: rdi 指向 16 字节一格的槽数组, 所有内存操作数都是 [rdi + disp32];
+    #  整数和布尔在 rax / rcx 中计算; 浮点数在 long double 档位用 x87 栈,
+    #  double 档位用 SSE2 的 xmm0 / xmm1.
+    #  跳转目标用标签表示, 最后统一回填 rel32.
+    */
+    class Assembler {
+    public:
+        enum Reg : uint8_t { RAX = 0, RCX = 1, RDI = 7 };
+
+        // setcc / jcc 的条件码低 4 位
+        enum Cond : uint8_t {
+            O = 0x0, NO = 0x1, B = 0x2, AE = 0x3, E = 0x4, NE = 0x5, BE = 0x6, A = 0x7,
+            P = 0xA, NP = 0xB, L = 0xC, GE = 0xD, LE = 0xE, G = 0xF,
+        };
+
+        using Label = size_t;
+
+    private:
+        vector<uint8_t> code;
+        vector<int64_t> labels;                 // 标签位置, 未绑定为 -1
+        vector<pair<size_t, Label>> jumps;      // (rel32 的位置, 目标标签)
+        vector<pair<size_t, size_t>> constRefs; // (disp32 的位置, 常量下标)
+        vector<array<uint8_t, 16>> constants;  // 每个常量占 16 字节
+
+        void byte(uint8_t b) { code.push_back(b); }
+
+        void int32(int32_t value) {
+            uint8_t bytes[4];
+            memcpy(bytes, &value, 4);
+            code.insert(code.end(), bytes, bytes + 4);
+        }
+
+        void int64(int64_t value) {
+            uint8_t bytes[8];
+            memcpy(bytes, &value, 8);
+            code.insert(code.end(), bytes, bytes + 8);
+        }
+
+        // ModRM: [rdi + disp32], reg 字段为 r
+        void memory(uint8_t r, int32_t disp) {
+            byte(0x80 | (r << 3) | RDI);
+            int32(disp);
+        }
+
+        // ModRM: [rip + disp32], 指向常量池
+        template<typename T>
+        void constant(uint8_t r, T value) {
+            byte(0x05 | (r << 3));
+            array<uint8_t, 16> bytes = {};
+            memcpy(bytes.data(), &value, sizeof(T) < 16 ? sizeof(T) : 16);
+            constRefs.push_back({code.size(), constants.size()});
+            constants.push_back(bytes);
+            int32(0);
+        }
+
+        // SSE2 标量指令: 前缀, (REX.W), 0F, 操作码
+        void sse(uint8_t prefix, uint8_t opcode, bool wide = false) {
+            byte(prefix);
+            if (wide) {
+                byte(0x48);
+            }
+            byte(0x0F);
+            byte(opcode);
+        }
+
+    public:
+        Label newLabel() {
+            labels.push_back(-1);
+            return labels.size() - 1;
+        }
+
+        void bind(Label label) { labels[label] = static_cast<int64_t>(code.size()); }
+
+        void jmp(Label target) {
+            byte(0xE9);
+            jumps.push_back({code.size(), target});
+            int32(0);
+        }
+
+        void jcc(Cond cond, Label target) {
+            byte(0x0F);
+            byte(0x80 | cond);
+            jumps.push_back({code.size(), target});
+            int32(0);
+        }
+
+        void ret() { byte(0xC3); }
+        void pushRdi() { byte(0x57); }
+        void popRdi() { byte(0x5F); }
+        void movRdiRcx() { byte(0x48); byte(0x89); byte(0xCF); }
+
+        /* # 整数 */
+        void load(Reg r, int32_t disp) { byte(0x48); byte(0x8B); memory(r, disp); }
+        void store(int32_t disp, Reg r) { byte(0x48); byte(0x89); memory(r, disp); }
+        void movImm(Reg r, int64_t value) { byte(0x48); byte(0xB8 | r); int64(value); }
+        void movEaxImm(int32_t value) { byte(0xB8); int32(value); }
+        void storeImm(int32_t disp, int32_t value) { byte(0x48); byte(0xC7); memory(0, disp); int32(value); }
+        void movRcxRax() { byte(0x48); byte(0x89); byte(0xC1); }
+        void addRaxRcx() { byte(0x48); byte(0x01); byte(0xC8); }
+        void subRaxRcx() { byte(0x48); byte(0x29); byte(0xC8); }
+        void imulRaxRcx() { byte(0x48); byte(0x0F); byte(0xAF); byte(0xC1); }
+        void addRaxMem(int32_t disp) { byte(0x48); byte(0x03); memory(RAX, disp); }
+        void subRaxMem(int32_t disp) { byte(0x48); byte(0x2B); memory(RAX, disp); }
+        void imulRaxMem(int32_t disp) { byte(0x48); byte(0x0F); byte(0xAF); memory(RAX, disp); }
+        void cmpRaxRcx() { byte(0x48); byte(0x39); byte(0xC8); }
+        void cmpRaxMem(int32_t disp) { byte(0x48); byte(0x3B); memory(RAX, disp); }
+        void cmpMemImm(int32_t disp, int32_t value) { byte(0x48); byte(0x81); memory(7, disp); int32(value); }
+        void incMem(int32_t disp) { byte(0x48); byte(0xFF); memory(0, disp); }
+        void testRaxRax() { byte(0x48); byte(0x85); byte(0xC0); }
+        void negRax() { byte(0x48); byte(0xF7); byte(0xD8); }
+        void xorEax1() { byte(0x83); byte(0xF0); byte(0x01); }
+        void setcc(Cond cond, Reg r) { byte(0x0F); byte(0x90 | cond); byte(0xC0 | r); }
+        void andAlCl() { byte(0x20); byte(0xC8); }
+        void orAlCl() { byte(0x08); byte(0xC8); }
+        void movzxEaxAl() { byte(0x0F); byte(0xB6); byte(0xC0); }
+
+        /* # x87 */
+        void fldTword(int32_t disp) { byte(0xDB); memory(5, disp); }
+        void fstpTword(int32_t disp) { byte(0xDB); memory(7, disp); }
+        void fildQword(int32_t disp) { byte(0xDF); memory(5, disp); }
+        void fldz() { byte(0xD9); byte(0xEE); }
+        void fxch() { byte(0xD9); byte(0xC9); }
+        void fpop() { byte(0xDD); byte(0xD8); }                       // fstp st(0)
+        void faddp() { byte(0xDE); byte(0xC1); }                      // st1 = st1 + st0
+        void fmulp() { byte(0xDE); byte(0xC9); }                      // st1 = st1 * st0
+        void fsubp() { byte(0xDE); byte(0xE9); }                      // st1 = st1 - st0
+        void fsubrp() { byte(0xDE); byte(0xE1); }                     // st1 = st0 - st1
+        void fdivp() { byte(0xDE); byte(0xF9); }                      // st1 = st1 / st0
+        void fdivrp() { byte(0xDE); byte(0xF1); }                     // st1 = st0 / st1
+        void fucomip(uint8_t i) { byte(0xDF); byte(0xE8 + i); }       // 比较 st0 与 st(i), 弹出 st0
+
+        // 从常量池加载 (rip 相对寻址)
+        void fldConstant(long double value) { byte(0xDB); constant(5, value); }
+
+        /* # SSE2 (double) */
+        enum Xmm : uint8_t { XMM0 = 0, XMM1 = 1, XMM2 = 2 };
+
+        void movsdLoad(Xmm x, int32_t disp) { sse(0xF2, 0x10); memory(x, disp); }
+        void movsdStore(int32_t disp, Xmm x) { sse(0xF2, 0x11); memory(x, disp); }
+        void movsdConstant(Xmm x, double value) { sse(0xF2, 0x10); constant(x, value); }
+        void cvtsi2sdMem(Xmm x, int32_t disp) { sse(0xF2, 0x2A, true); memory(x, disp); }
+        void cvtsi2sdRax(Xmm x) { sse(0xF2, 0x2A, true); byte(0xC0 | (x << 3)); }
+        void movapd(Xmm dst, Xmm src) { sse(0x66, 0x28); byte(0xC0 | (dst << 3) | src); }
+        void xorpd(Xmm dst, Xmm src) { sse(0x66, 0x57); byte(0xC0 | (dst << 3) | src); }
+        void addsd(Xmm dst, Xmm src) { sse(0xF2, 0x58); byte(0xC0 | (dst << 3) | src); }
+        void mulsd(Xmm dst, Xmm src) { sse(0xF2, 0x59); byte(0xC0 | (dst << 3) | src); }
+        void subsd(Xmm dst, Xmm src) { sse(0xF2, 0x5C); byte(0xC0 | (dst << 3) | src); }
+        void divsd(Xmm dst, Xmm src) { sse(0xF2, 0x5E); byte(0xC0 | (dst << 3) | src); }
+        void ucomisd(Xmm a, Xmm b) { sse(0x66, 0x2E); byte(0xC0 | (a << 3) | b); }  // 按 a 与 b 的比较设置标志
+
+        // 回填跳转, 把常量池接在代码后面
+        vector<uint8_t> finish() {
+            for (auto [at, label] : jumps) {
+                if (labels[label] < 0) {
+                    throw runtime_error("JIT: unbound label");
+                }
+                int32_t rel = static_cast<int32_t>(labels[label] - static_cast<int64_t>(at + 4));
+                memcpy(&code[at], &rel, 4);
+            }
+            while (code.size() % 16) {
+                byte(0xCC);
+            }
+            size_t pool = code.size();
+            for (const auto& bytes : constants) {
+                code.insert(code.end(), bytes.begin(), bytes.end());
+            }
+            for (auto [at, index] : constRefs) {
+                int32_t rel = static_cast<int32_t>(pool + index * 16 - (at + 4));
+                memcpy(&code[at], &rel, 4);
+            }
+            return std::move(code);
+        }
+    };
+
+#endif
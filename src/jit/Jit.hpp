@@ -0,0 +1,849 @@
+#ifndef JIT_HPP
+    #define JIT_HPP
+
+    #include "../MiLang.hpp"
+    #include "Assembler.hpp"
+    #include <limits>
+
+    using namespace std;
+
+    /*
+    #  基线 JIT: 把只做数值运算的热点函数编译成 x86-64 机器码
+    #
+    #  函数定义时先降低为 JitSource (与引擎无关, 不依赖 AST 的生命周期);
+    #  调用次数达到阈值时, 按当时实参的类型 (int / float) 生成一份特化代码.
+    #  每次调用先检查实参类型 (类型守卫), 不符合就交回解释器执行.
+    #  机器码里没有副作用, 遇到除零、循环次数超限或执行到函数末尾时直接放弃 (bailout),
+    #  由解释器从头重新执行这次调用, 给出与原来一致的结果或错误.
+    */
+
+    struct JitExpr {
+        enum Kind : uint8_t { CONSTANT, VARIABLE, BINARY, NEGATE, NOT };
+
+        Kind kind;
+        Value constant;
+        int32_t var = -1;
+        TokenType op = TokenType::PLUS;
+        unique_ptr<JitExpr> left;
+        unique_ptr<JitExpr> right;  // 一元运算只用 left
+    };
+
+    struct JitStmt {
+        enum Kind : uint8_t { ASSIGN, RETURN, IF, LOOP, BREAK, CONTINUE };
+
+        Kind kind;
+        int32_t var = -1;
+        unique_ptr<JitExpr> expr;                 // ASSIGN / RETURN 的值, LOOP 的条件
+        vector<unique_ptr<JitExpr>> conditions;   // IF 的各分支条件
+        vector<vector<JitStmt>> bodies;           // IF 的分支 (多出的一个是 else), LOOP 的 [init, body, update]
+    };
+
+    struct JitSource {
+        size_t paramCount = 0;
+        vector<optional<Value>> defaults;  // 参数的字面量默认值
+        vector<string> locals;             // 非参数变量, 变量号为 paramCount + 下标
+        vector<JitStmt> body;
+    };
+
+    // 槽数组的一格, 放得下 long double
+    union alignas(16) JitSlot {
+        int64_t i;
+        FloatType f;
+    };
+
+    using JitEntry = int (*)(JitSlot* slots);
+
+    struct JitCode {
+        unique_ptr<ExecutableCode> memory;
+        JitEntry entry = nullptr;
+        vector<Value::Type> paramTypes;
+        size_t slotCount = 0;
+        size_t globalEpoch = SIZE_MAX;  // 上次确认局部变量名没有同名全局变量时的全局变量数
+        uint64_t runs = 0;
+        uint64_t failures = 0;          // 守卫失败和 bailout
+    };
+
+    struct JitCounters {
+        uint64_t compiled = 0;
+        uint64_t rejected = 0;
+        uint64_t guardFailures = 0;
+        uint64_t bailouts = 0;
+        uint64_t runs = 0;
+    };
+
+    /*
+    #  为一组参数类型推导变量类型并生成机器码, 不支持时返回 nullptr
+    #
+    #  每个变量在整个函数里只有一种类型; 表达式的值:
+    #  int / bool 在 rax, float 在 x87 栈顶 (long double) 或 xmm0 (double).
+    #  复杂的右操作数先把左操作数存进临时槽, 因此开始计算任何表达式时 x87 栈都是空的.
+    */
+    class JitCompiler {
+    private:
+        using Type = Value::Type;
+
+        const JitSource& source;
+        vector<optional<Type>> varTypes;
+        Assembler as;
+        Assembler::Label bail;
+        size_t firstTemp = 0;
+        size_t tempDepth = 0;
+        size_t maxTemp = 0;
+        size_t loopCounters = 0;
+        vector<pair<Assembler::Label, Assembler::Label>> loops;  // (continue, break)
+
+        static constexpr bool x87Float = numeric_limits<FloatType>::digits == 64;
+        static constexpr bool sseFloat = is_same_v<FloatType, double>;
+
+        struct Unsupported {};
+
+        [[noreturn]] static void unsupported() { throw Unsupported{}; }
+
+        static bool isArithmetic(TokenType op) {
+            return op == TokenType::PLUS || op == TokenType::MINUS || op == TokenType::MULTIPLY ||
+                   op == TokenType::DIVIDE;
+        }
+
+        static int32_t offset(size_t slot) { return static_cast<int32_t>(slot * sizeof(JitSlot)); }
+
+        size_t loopCounterSlot(size_t index) const { return source.paramCount + source.locals.size() + index; }
+
+        size_t pushTemp() {
+            size_t slot = firstTemp + tempDepth++;
+            maxTemp = max(maxTemp, tempDepth);
+            return slot;
+        }
+
+        void popTemp() { tempDepth--; }
+
+        /* # 类型推导 */
+        Type typeOf(const JitExpr& expr) const {
+            Type type = computeType(expr);
+            if (!x87Float && !sseFloat && type == Value::FLOAT) {
+                unsupported();  // 只为 80 位 x87 long double 和 double 生成浮点代码
+            }
+            return type;
+        }
+
+        Type computeType(const JitExpr& expr) const {
+            switch (expr.kind) {
+                case JitExpr::CONSTANT:
+                    return expr.constant.type();
+                case JitExpr::VARIABLE:
+                    if (!varTypes[expr.var]) {
+                        unsupported();
+                    }
+                    return *varTypes[expr.var];
+                case JitExpr::NEGATE: {
+                    Type type = typeOf(*expr.left);
+                    if (type == Value::BOOL) {
+                        unsupported();
+                    }
+                    return type;
+                }
+                case JitExpr::NOT:
+                    typeOf(*expr.left);
+                    return Value::BOOL;
+                default:
+                    break;
+            }
+            Type l = typeOf(*expr.left);
+            Type r = typeOf(*expr.right);
+            bool numeric = l != Value::BOOL && r != Value::BOOL;
+            if (isArithmetic(expr.op)) {
+                if (!numeric) {
+                    unsupported();
+                }
+                if (expr.op == TokenType::DIVIDE || l == Value::FLOAT || r == Value::FLOAT) {
+                    return Value::FLOAT;
+                }
+                return Value::INT;
+            }
+            if (!numeric && !(l == r && (expr.op == TokenType::EQ || expr.op == TokenType::NEQ))) {
+                unsupported();  // 解释器在这里会报类型错误
+            }
+            return Value::BOOL;
+        }
+
+        void inferTypes(const vector<JitStmt>& stmts) {
+            for (const auto& stmt : stmts) {
+                switch (stmt.kind) {
+                    case JitStmt::ASSIGN: {
+                        Type type = typeOf(*stmt.expr);
+                        if (varTypes[stmt.var] && *varTypes[stmt.var] != type) {
+                            unsupported();
+                        }
+                        varTypes[stmt.var] = type;
+                        break;
+                    }
+                    case JitStmt::RETURN:
+                        typeOf(*stmt.expr);
+                        break;
+                    case JitStmt::IF:
+                        for (size_t i = 0; i < stmt.bodies.size(); i++) {
+                            if (i < stmt.conditions.size()) {
+                                typeOf(*stmt.conditions[i]);
+                            }
+                            inferTypes(stmt.bodies[i]);
+                        }
+                        break;
+                    case JitStmt::LOOP:
+                        inferTypes(stmt.bodies[0]);
+                        typeOf(*stmt.expr);
+                        inferTypes(stmt.bodies[1]);
+                        inferTypes(stmt.bodies[2]);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        /* # 整数和布尔: 结果在 rax */
+        static bool isSimple(const JitExpr& expr) {
+            return expr.kind == JitExpr::CONSTANT || expr.kind == JitExpr::VARIABLE;
+        }
+
+        static int64_t constantBits(const Value& value) {
+            return value.type() == Value::BOOL ? value.asBool() : value.asInt();
+        }
+
+        void genInt(const JitExpr& expr) {
+            switch (expr.kind) {
+                case JitExpr::CONSTANT:
+                    as.movImm(Assembler::RAX, constantBits(expr.constant));
+                    return;
+                case JitExpr::VARIABLE:
+                    as.load(Assembler::RAX, offset(expr.var));
+                    return;
+                case JitExpr::NEGATE:
+                    genInt(*expr.left);
+                    as.negRax();
+                    return;
+                case JitExpr::NOT:
+                    genNot(*expr.left);
+                    return;
+                default:
+                    break;
+            }
+            if (!isArithmetic(expr.op)) {
+                genCompare(expr);
+                return;
+            }
+            genInt(*expr.left);
+            const JitExpr& right = *expr.right;
+            if (right.kind == JitExpr::VARIABLE) {
+                switch (expr.op) {
+                    case TokenType::PLUS:  as.addRaxMem(offset(right.var)); break;
+                    case TokenType::MINUS: as.subRaxMem(offset(right.var)); break;
+                    default:               as.imulRaxMem(offset(right.var)); break;
+                }
+                return;
+            }
+            if (right.kind == JitExpr::CONSTANT) {
+                as.movImm(Assembler::RCX, constantBits(right.constant));
+            } else {
+                size_t temp = pushTemp();
+                as.store(offset(temp), Assembler::RAX);
+                genInt(right);
+                as.movRcxRax();
+                as.load(Assembler::RAX, offset(temp));
+                popTemp();
+            }
+            switch (expr.op) {
+                case TokenType::PLUS:  as.addRaxRcx(); break;
+                case TokenType::MINUS: as.subRaxRcx(); break;
+                default:               as.imulRaxRcx(); break;
+            }
+        }
+
+        void genNot(const JitExpr& operand) {
+            Type type = typeOf(operand);
+            if (type == Value::BOOL) {
+                genInt(operand);
+                as.xorEax1();
+            } else if (type == Value::INT) {
+                genInt(operand);
+                as.testRaxRax();
+                as.setcc(Assembler::E, Assembler::RAX);
+                as.movzxEaxAl();
+            } else {
+                // x == 0.0, NaN 不等于 0
+                genFloat(operand);
+                testFloatZero();
+                as.setcc(Assembler::E, Assembler::RAX);
+                as.setcc(Assembler::NP, Assembler::RCX);
+                as.andAlCl();
+                as.movzxEaxAl();
+            }
+        }
+
+        void genCompare(const JitExpr& expr) {
+            Type l = typeOf(*expr.left);
+            Type r = typeOf(*expr.right);
+            if (l == Value::FLOAT || r == Value::FLOAT) {
+                genFloatCompare(expr);
+                return;
+            }
+            genInt(*expr.left);
+            const JitExpr& right = *expr.right;
+            if (right.kind == JitExpr::VARIABLE) {
+                as.cmpRaxMem(offset(right.var));
+            } else {
+                if (right.kind == JitExpr::CONSTANT) {
+                    as.movImm(Assembler::RCX, constantBits(right.constant));
+                } else {
+                    size_t temp = pushTemp();
+                    as.store(offset(temp), Assembler::RAX);
+                    genInt(right);
+                    as.movRcxRax();
+                    as.load(Assembler::RAX, offset(temp));
+                    popTemp();
+                }
+                as.cmpRaxRcx();
+            }
+            Assembler::Cond cond;
+            switch (expr.op) {
+                case TokenType::EQ:     cond = Assembler::E; break;
+                case TokenType::NEQ:    cond = Assembler::NE; break;
+                case TokenType::GT:     cond = Assembler::G; break;
+                case TokenType::LT:     cond = Assembler::L; break;
+                case TokenType::GTE:
+                case TokenType::NOT_LT: cond = Assembler::GE; break;
+                default:                cond = Assembler::LE; break;
+            }
+            as.setcc(cond, Assembler::RAX);
+            as.movzxEaxAl();
+        }
+
+        /* # 浮点数: long double 档位结果在 x87 栈顶, double 档位结果在 xmm0 */
+        void genFloat(const JitExpr& expr) {
+            if constexpr (x87Float) {
+                genX87(expr);
+            } else {
+                genSse(expr);
+            }
+        }
+
+        // 比较浮点结果与 0 并丢弃它: 相等时 ZF = 1, 无序 (NaN) 时 PF = 1
+        void testFloatZero() {
+            if constexpr (x87Float) {
+                as.fldz();
+                as.fucomip(1);
+                as.fpop();
+            } else {
+                as.xorpd(Assembler::XMM1, Assembler::XMM1);
+                as.ucomisd(Assembler::XMM0, Assembler::XMM1);
+            }
+        }
+
+        void storeFloat(size_t slot) {
+            if constexpr (x87Float) {
+                as.fstpTword(offset(slot));
+            } else {
+                as.movsdStore(offset(slot), Assembler::XMM0);
+            }
+        }
+
+        void genFloatCompare(const JitExpr& expr) {
+            if constexpr (x87Float) {
+                genX87Compare(expr);
+            } else {
+                genSseCompare(expr);
+            }
+            // 大于类的比较都换成 "above" 判断, 无序 (NaN) 时为假
+            switch (expr.op) {
+                case TokenType::EQ:
+                    as.setcc(Assembler::E, Assembler::RAX);
+                    as.setcc(Assembler::NP, Assembler::RCX);
+                    as.andAlCl();
+                    break;
+                case TokenType::NEQ:
+                    as.setcc(Assembler::NE, Assembler::RAX);
+                    as.setcc(Assembler::P, Assembler::RCX);
+                    as.orAlCl();
+                    break;
+                case TokenType::GT:
+                case TokenType::LT:
+                    as.setcc(Assembler::A, Assembler::RAX);
+                    break;
+                default:
+                    as.setcc(Assembler::AE, Assembler::RAX);
+                    break;
+            }
+            as.movzxEaxAl();
+        }
+
+        static bool isGreater(TokenType op) {
+            return op == TokenType::GT || op == TokenType::GTE || op == TokenType::NOT_LT;
+        }
+
+        /* # x87 (long double) */
+
+        // 把表达式的值作为浮点数压栈
+        void pushFloat(const JitExpr& expr) {
+            Type type = typeOf(expr);
+            if (type == Value::FLOAT) {
+                genX87(expr);
+                return;
+            }
+            if (expr.kind == JitExpr::CONSTANT) {
+                as.fldConstant(static_cast<FloatType>(expr.constant.asInt()));
+                return;
+            }
+            if (expr.kind == JitExpr::VARIABLE) {
+                as.fildQword(offset(expr.var));
+                return;
+            }
+            size_t temp = pushTemp();
+            genInt(expr);
+            as.store(offset(temp), Assembler::RAX);
+            as.fildQword(offset(temp));
+            popTemp();
+        }
+
+        void genX87(const JitExpr& expr) {
+            switch (expr.kind) {
+                case JitExpr::CONSTANT:
+                    as.fldConstant(expr.constant.asFloat());
+                    return;
+                case JitExpr::VARIABLE:
+                    as.fldTword(offset(expr.var));
+                    return;
+                case JitExpr::NEGATE:
+                    // 与解释器相同按 0 - x 计算, -(0.0) 得到 0.0
+                    genX87(*expr.left);
+                    as.fldz();
+                    as.fsubrp();
+                    return;
+                default:
+                    break;
+            }
+            // 结果为 float 的二元运算只有算术运算
+            pushFloat(*expr.left);
+            bool reversed = !isSimple(*expr.right);
+            size_t temp = 0;
+            if (reversed) {
+                temp = pushTemp();
+                as.fstpTword(offset(temp));
+                pushFloat(*expr.right);
+                as.fldTword(offset(temp));
+                popTemp();
+            } else {
+                pushFloat(*expr.right);
+            }
+            // 现在 st0 / st1 分别是右 / 左操作数, reversed 时相反
+            switch (expr.op) {
+                case TokenType::PLUS:
+                    as.faddp();
+                    break;
+                case TokenType::MINUS:
+                    reversed ? as.fsubrp() : as.fsubp();
+                    break;
+                case TokenType::MULTIPLY:
+                    as.fmulp();
+                    break;
+                default: {
+                    Assembler::Label ok = as.newLabel();
+                    as.fldz();
+                    as.fucomip(reversed ? 2 : 1);
+                    as.jcc(Assembler::P, ok);
+                    as.jcc(Assembler::NE, ok);
+                    as.fpop();
+                    as.fpop();
+                    as.jmp(bail);
+                    as.bind(ok);
+                    reversed ? as.fdivrp() : as.fdivp();
+                    break;
+                }
+            }
+        }
+
+        void genX87Compare(const JitExpr& expr) {
+            pushFloat(*expr.left);
+            if (isSimple(*expr.right)) {
+                pushFloat(*expr.right);
+            } else {
+                size_t temp = pushTemp();
+                as.fstpTword(offset(temp));
+                pushFloat(*expr.right);
+                as.fldTword(offset(temp));
+                popTemp();
+                as.fxch();
+            }
+            // st0 = 右, st1 = 左; 大于类的比较先交换
+            if (isGreater(expr.op)) {
+                as.fxch();
+            }
+            as.fucomip(1);
+            as.fpop();
+        }
+
+        /* # SSE2 (double) */
+
+        // 常量或变量直接放进 x, 整数先转换
+        void sseLoadSimple(const JitExpr& expr, Assembler::Xmm x) {
+            bool isFloat = typeOf(expr) == Value::FLOAT;
+            if (expr.kind == JitExpr::CONSTANT) {
+                as.movsdConstant(x, isFloat ? expr.constant.asFloat() : static_cast<FloatType>(expr.constant.asInt()));
+            } else if (isFloat) {
+                as.movsdLoad(x, offset(expr.var));
+            } else {
+                as.cvtsi2sdMem(x, offset(expr.var));
+            }
+        }
+
+        // 把表达式的值作为浮点数放进 xmm0
+        void sseToFloat(const JitExpr& expr) {
+            if (isSimple(expr)) {
+                sseLoadSimple(expr, Assembler::XMM0);
+            } else if (typeOf(expr) == Value::FLOAT) {
+                genSse(expr);
+            } else {
+                genInt(expr);
+                as.cvtsi2sdRax(Assembler::XMM0);
+            }
+        }
+
+        // 左操作数放进 xmm0, 右操作数放进 xmm1
+        void sseOperands(const JitExpr& left, const JitExpr& right) {
+            sseToFloat(left);
+            if (isSimple(right)) {
+                sseLoadSimple(right, Assembler::XMM1);
+                return;
+            }
+            size_t temp = pushTemp();
+            as.movsdStore(offset(temp), Assembler::XMM0);
+            sseToFloat(right);
+            as.movapd(Assembler::XMM1, Assembler::XMM0);
+            as.movsdLoad(Assembler::XMM0, offset(temp));
+            popTemp();
+        }
+
+        void genSse(const JitExpr& expr) {
+            switch (expr.kind) {
+                case JitExpr::CONSTANT:
+                case JitExpr::VARIABLE:
+                    sseLoadSimple(expr, Assembler::XMM0);
+                    return;
+                case JitExpr::NEGATE:
+                    // 与解释器相同按 0 - x 计算, -(0.0) 得到 0.0
+                    genSse(*expr.left);
+                    as.xorpd(Assembler::XMM1, Assembler::XMM1);
+                    as.subsd(Assembler::XMM1, Assembler::XMM0);
+                    as.movapd(Assembler::XMM0, Assembler::XMM1);
+                    return;
+                default:
+                    break;
+            }
+            sseOperands(*expr.left, *expr.right);
+            switch (expr.op) {
+                case TokenType::PLUS:
+                    as.addsd(Assembler::XMM0, Assembler::XMM1);
+                    break;
+                case TokenType::MINUS:
+                    as.subsd(Assembler::XMM0, Assembler::XMM1);
+                    break;
+                case TokenType::MULTIPLY:
+                    as.mulsd(Assembler::XMM0, Assembler::XMM1);
+                    break;
+                default: {
+                    Assembler::Label ok = as.newLabel();
+                    as.xorpd(Assembler::XMM2, Assembler::XMM2);
+                    as.ucomisd(Assembler::XMM1, Assembler::XMM2);
+                    as.jcc(Assembler::P, ok);
+                    as.jcc(Assembler::NE, ok);
+                    as.jmp(bail);
+                    as.bind(ok);
+                    as.divsd(Assembler::XMM0, Assembler::XMM1);
+                    break;
+                }
+            }
+        }
+
+        void genSseCompare(const JitExpr& expr) {
+            sseOperands(*expr.left, *expr.right);
+            // 大于类比较 左 > 右, 其余比较 右 > 左
+            if (isGreater(expr.op)) {
+                as.ucomisd(Assembler::XMM0, Assembler::XMM1);
+            } else {
+                as.ucomisd(Assembler::XMM1, Assembler::XMM0);
+            }
+        }
+
+        /* # 语句 */
+
+        // 条件为假时跳到 target, 真值规则与 if / while 相同
+        void genCondition(const JitExpr& expr, Assembler::Label target) {
+            if (typeOf(expr) == Value::FLOAT) {
+                Assembler::Label taken = as.newLabel();
+                genFloat(expr);
+                testFloatZero();
+                as.jcc(Assembler::P, taken);
+                as.jcc(Assembler::E, target);
+                as.bind(taken);
+            } else {
+                genInt(expr);
+                as.testRaxRax();
+                as.jcc(Assembler::E, target);
+            }
+        }
+
+        void genStore(const JitExpr& expr, size_t slot) {
+            if (typeOf(expr) == Value::FLOAT) {
+                genFloat(expr);
+                storeFloat(slot);
+            } else {
+                genInt(expr);
+                as.store(offset(slot), Assembler::RAX);
+            }
+        }
+
+        void genReturn(int tag) {
+            as.movEaxImm(tag);
+        #if defined(_WIN32)
+            as.popRdi();
+        #endif
+            as.ret();
+        }
+
+        void genBlock(const vector<JitStmt>& stmts) {
+            for (const auto& stmt : stmts) {
+                switch (stmt.kind) {
+                    case JitStmt::ASSIGN:
+                        genStore(*stmt.expr, stmt.var);
+                        break;
+                    case JitStmt::RETURN: {
+                        Type type = typeOf(*stmt.expr);
+                        genStore(*stmt.expr, 0);
+                        genReturn(static_cast<int>(type) + 1);
+                        break;
+                    }
+                    case JitStmt::IF: {
+                        Assembler::Label end = as.newLabel();
+                        for (size_t i = 0; i < stmt.bodies.size(); i++) {
+                            Assembler::Label next = as.newLabel();
+                            if (i < stmt.conditions.size()) {
+                                genCondition(*stmt.conditions[i], next);
+                            }
+                            genBlock(stmt.bodies[i]);
+                            as.jmp(end);
+                            as.bind(next);
+                        }
+                        as.bind(end);
+                        break;
+                    }
+                    case JitStmt::LOOP: {
+                        // 与解释器一致: continue 不计入循环次数
+                        size_t counter = loopCounterSlot(loopCounters++);
+                        Assembler::Label top = as.newLabel();
+                        Assembler::Label next = as.newLabel();
+                        Assembler::Label exit = as.newLabel();
+                        genBlock(stmt.bodies[0]);
+                        as.storeImm(offset(counter), 0);
+                        as.bind(top);
+                        genCondition(*stmt.expr, exit);
+                        loops.push_back({next, exit});
+                        genBlock(stmt.bodies[1]);
+                        loops.pop_back();
+                        as.incMem(offset(counter));
+                        as.cmpMemImm(offset(counter), MAX_DEAD_LOOP);
+                        as.jcc(Assembler::G, bail);
+                        as.bind(next);
+                        genBlock(stmt.bodies[2]);
+                        as.jmp(top);
+                        as.bind(exit);
+                        break;
+                    }
+                    case JitStmt::BREAK:
+                        as.jmp(loops.back().second);
+                        break;
+                    case JitStmt::CONTINUE:
+                        as.jmp(loops.back().first);
+                        break;
+                }
+            }
+        }
+
+        static size_t countLoops(const vector<JitStmt>& stmts) {
+            size_t count = 0;
+            for (const auto& stmt : stmts) {
+                for (const auto& body : stmt.bodies) {
+                    count += countLoops(body);
+                }
+                count += stmt.kind == JitStmt::LOOP;
+            }
+            return count;
+        }
+
+    public:
+        explicit JitCompiler(const JitSource& source) : source(source) {}
+
+        unique_ptr<JitCode> compile(const vector<Type>& paramTypes) {
+            try {
+                varTypes.assign(source.paramCount + source.locals.size(), nullopt);
+                for (size_t i = 0; i < paramTypes.size(); i++) {
+                    varTypes[i] = paramTypes[i];
+                }
+                inferTypes(source.body);
+
+                firstTemp = loopCounterSlot(countLoops(source.body));
+                bail = as.newLabel();
+            #if defined(_WIN32)
+                as.pushRdi();
+                as.movRdiRcx();
+            #endif
+                genBlock(source.body);
+                // 执行到函数末尾: 返回值取决于最后一条语句, 交给解释器
+                as.bind(bail);
+                genReturn(0);
+            } catch (const Unsupported&) {
+                return nullptr;
+            }
+
+            auto code = make_unique<JitCode>();
+            code->memory = make_unique<ExecutableCode>(as.finish());
+            code->entry = reinterpret_cast<JitEntry>(const_cast<void*>(code->memory->data()));
+            code->paramTypes = paramTypes;
+            code->slotCount = max<size_t>(firstTemp + maxTemp, 1);
+            return code;
+        }
+    };
+
+    /*
+    #  调用计数、编译、守卫与计数器
+    #  引擎提供全局变量的数量 (只增不减) 和按名字查询的方法:
+    #  函数里的局部变量若与全局变量同名, 赋值会写到全局变量上, 这种情况不走机器码
+    */
+    class Jit {
+    private:
+        bool enabled = false;
+        uint32_t threshold = JIT_THRESHOLD;
+        JitCounters counters;
+        vector<JitSlot> slots;
+
+        static constexpr uint64_t GIVE_UP_FAILURES = 100;
+
+        bool compile(FunctionType& func, const Value* args, const char* bound) {
+            const JitSource& source = *func.jitSource;
+            vector<Value::Type> types;
+            for (size_t i = 0; i < source.paramCount; i++) {
+                bool isBound = bound ? bound[i] : args[i].isBound();
+                Value::Type type = isBound ? args[i].type()
+                                 : source.defaults[i] ? source.defaults[i]->type() : Value::EMPTY;
+                if (type != Value::INT && type != Value::FLOAT) {
+                    return false;
+                }
+                types.push_back(type);
+            }
+            func.jitCode = JitCompiler(source).compile(types);
+            return func.jitCode != nullptr;
+        }
+
+        // 失败次数过多 (类型不稳定或经常 bailout) 时放弃这个函数
+        void failed(FunctionType& func) {
+            JitCode& code = *func.jitCode;
+            if (++code.failures > GIVE_UP_FAILURES && code.failures > code.runs) {
+                func.jitCode.reset();
+                func.jitSource.reset();
+            }
+        }
+
+    public:
+        void enable(uint32_t callThreshold) {
+            enabled = MI_JIT_SUPPORTED;
+            threshold = callThreshold;
+        }
+
+        bool isEnabled() const { return enabled; }
+
+        uint32_t getThreshold() const { return threshold; }
+
+        /*
+        #  args 是参数槽; bound 为 nullptr 时用 Value::isBound 判断是否已绑定
+        #  成功时写入 result 并返回 true, 否则由调用方照常执行
+        */
+        template<typename IsGlobal>
+        bool call(FunctionType& func, const Value* args, const char* bound, size_t globalEpoch,
+                  IsGlobal&& isGlobal, Value& result) {
+            if (!func.jitSource) {
+                return false;
+            }
+            // 与类型注解不符的实参由解释器转换 (int 传给 float) 或报错
+            for (size_t i = 0; i < func.parameters.size(); i++) {
+                Value::Type type = func.parameters[i].type;
+                if (type != Value::EMPTY && (bound ? bound[i] : args[i].isBound()) && args[i].type() != type) {
+                    return false;
+                }
+            }
+            if (!func.jitCode) {
+                if (++func.jitCalls < threshold) {
+                    return false;
+                }
+                if (!compile(func, args, bound)) {
+                    func.jitSource.reset();
+                    counters.rejected++;
+                    return false;
+                }
+                counters.compiled++;
+            }
+
+            JitCode& code = *func.jitCode;
+            const JitSource& source = *func.jitSource;
+            if (slots.size() < code.slotCount) {
+                slots.resize(code.slotCount);
+            }
+            for (size_t i = 0; i < source.paramCount; i++) {
+                bool isBound = bound ? bound[i] : args[i].isBound();
+                const Value* arg = isBound ? &args[i] : source.defaults[i] ? &*source.defaults[i] : nullptr;
+                if (!arg || arg->type() != code.paramTypes[i]) {
+                    counters.guardFailures++;
+                    failed(func);
+                    return false;
+                }
+                if (arg->type() == Value::INT) {
+                    slots[i].i = arg->asInt();
+                } else {
+                    slots[i].f = arg->asFloat();
+                }
+            }
+            if (code.globalEpoch != globalEpoch) {
+                for (const auto& name : source.locals) {
+                    if (isGlobal(name)) {
+                        counters.guardFailures++;
+                        failed(func);
+                        return false;
+                    }
+                }
+                code.globalEpoch = globalEpoch;
+            }
+
+            int tag = code.entry(slots.data());
+            if (tag == 0) {
+                counters.bailouts++;
+                failed(func);
+                return false;
+            }
+            code.runs++;
+            counters.runs++;
+            switch (static_cast<Value::Type>(tag - 1)) {
+                case Value::INT:   result = IntType(slots[0].i); break;
+                case Value::FLOAT: result = FloatType(slots[0].f); break;
+                default:           result = BoolType(slots[0].i != 0); break;
+            }
+            return true;
+        }
+
+        string report() const {
+            if (!enabled) {
+                return MI_JIT_SUPPORTED ? "jit: off (run with --jit)" : "jit: not supported on this platform";
+            }
+            stringstream ss;
+            ss << "jit: " << counters.compiled << " compiled, " << counters.rejected << " rejected, "
+               << counters.runs << " native calls, " << counters.guardFailures << " guard failures, "
+               << counters.bailouts << " bailouts";
+            return ss.str();
+        }
+    };
+
+#endif
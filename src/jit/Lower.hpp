@@ -0,0 +1,249 @@
+#ifndef JIT_LOWER_HPP
+    #define JIT_LOWER_HPP
+
+    #include "../MiLang.hpp"
+    #include "../parser/Parser.hpp"
+    #include "Jit.hpp"
+    #include <unordered_set>
+
+    using namespace std;
+
+    /*
+    #  把函数体降低为 JitSource, 含不支持的结构时返回 nullptr
+    #
+    #  支持: 数字和布尔字面量, 参数和局部变量, + - * / 与比较, 一元 - 和 !,
+    #  赋值、return、if / elif / else、while、for、break、continue.
+    #  变量只能在一定已赋值之后读取 (否则解释器会去找全局变量);
+    #  循环里第一次赋值的变量属于循环作用域, 循环结束后不算已赋值.
+    */
+    class JitLowering {
+    private:
+        JitSource& source;
+        unordered_map<string, int32_t> vars;
+        unordered_set<int32_t> assigned;  // 一定已赋值的变量
+        int loopDepth = 0;
+
+        struct Unsupported {};
+
+        [[noreturn]] static void unsupported() { throw Unsupported{}; }
+
+        int32_t variable(const string& name) {
+            auto it = vars.find(name);
+            if (it != vars.end()) {
+                return it->second;
+            }
+            int32_t var = static_cast<int32_t>(source.paramCount + source.locals.size());
+            source.locals.push_back(name);
+            vars[name] = var;
+            return var;
+        }
+
+        static bool isSupportedOperator(TokenType op) {
+            switch (op) {
+                case TokenType::PLUS:
+                case TokenType::MINUS:
+                case TokenType::MULTIPLY:
+                case TokenType::DIVIDE:
+                case TokenType::EQ:
+                case TokenType::NEQ:
+                case TokenType::GT:
+                case TokenType::LT:
+                case TokenType::GTE:
+                case TokenType::LTE:
+                case TokenType::NOT_GT:
+                case TokenType::NOT_LT:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        unique_ptr<JitExpr> lowerExpr(ASTNode* node) {
+            auto expr = make_unique<JitExpr>();
+            if (auto* number = dynamic_cast<NumberNode*>(node)) {
+                expr->kind = JitExpr::CONSTANT;
+                expr->constant = number->value();
+            } else if (auto* boolean = dynamic_cast<BooleanNode*>(node)) {
+                expr->kind = JitExpr::CONSTANT;
+                expr->constant = boolean->value;
+            } else if (auto* var = dynamic_cast<VariableNode*>(node)) {
+                auto it = vars.find(var->name);
+                if (it == vars.end() || !assigned.count(it->second)) {
+                    unsupported();
+                }
+                expr->kind = JitExpr::VARIABLE;
+                expr->var = it->second;
+            } else if (auto* binop = dynamic_cast<BinOpNode*>(node)) {
+                if (!isSupportedOperator(binop->op.type)) {
+                    unsupported();
+                }
+                expr->kind = JitExpr::BINARY;
+                expr->op = binop->op.type;
+                expr->left = lowerExpr(binop->left.get());
+                expr->right = lowerExpr(binop->right.get());
+            } else if (auto* unary = dynamic_cast<UnaryOpNode*>(node)) {
+                if (unary->op.type == TokenType::MINUS) {
+                    expr->kind = JitExpr::NEGATE;
+                } else if (unary->op.type == TokenType::NOT) {
+                    expr->kind = JitExpr::NOT;
+                } else {
+                    unsupported();
+                }
+                expr->left = lowerExpr(unary->expr.get());
+            } else {
+                unsupported();
+            }
+            return expr;
+        }
+
+        // 返回 false 表示这段语句之后不可达 (return / break / continue)
+        bool lowerBlock(ASTNode* node, vector<JitStmt>& out) {
+            if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                for (auto& stmt : block->statements) {
+                    if (!lowerStatement(stmt.get(), out)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            return lowerStatement(node, out);
+        }
+
+        bool lowerStatement(ASTNode* node, vector<JitStmt>& out) {
+            JitStmt stmt;
+            if (dynamic_cast<BlockNode*>(node)) {
+                return lowerBlock(node, out);
+            } else if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                stmt.kind = JitStmt::ASSIGN;
+                stmt.expr = lowerExpr(assign->expr.get());
+                stmt.var = variable(assign->varName);
+                assigned.insert(stmt.var);
+            } else if (auto* ret = dynamic_cast<ReturnNode*>(node)) {
+                if (!ret->expr) {
+                    unsupported();
+                }
+                stmt.kind = JitStmt::RETURN;
+                stmt.expr = lowerExpr(ret->expr.get());
+                out.push_back(std::move(stmt));
+                return false;
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                stmt.kind = JitStmt::IF;
+                // 分支之后一定已赋值的变量: 各个可达分支的交集, 没有 else 时包括不进入任何分支
+                unordered_set<int32_t> before = assigned;
+                optional<unordered_set<int32_t>> after;
+                auto merge = [&after, this](bool reachable) {
+                    if (!reachable) {
+                        return;
+                    }
+                    if (!after) {
+                        after = assigned;
+                        return;
+                    }
+                    for (auto it = after->begin(); it != after->end();) {
+                        it = assigned.count(*it) ? next(it) : after->erase(it);
+                    }
+                };
+                for (auto& branch : ifNode->branches) {
+                    assigned = before;
+                    stmt.conditions.push_back(lowerExpr(branch.condition.get()));
+                    stmt.bodies.emplace_back();
+                    merge(lowerBlock(branch.body.get(), stmt.bodies.back()));
+                }
+                assigned = before;
+                if (ifNode->elseBlock) {
+                    stmt.bodies.emplace_back();
+                    merge(lowerBlock(ifNode->elseBlock.get(), stmt.bodies.back()));
+                } else {
+                    merge(true);
+                }
+                out.push_back(std::move(stmt));
+                if (!after) {
+                    return false;
+                }
+                assigned = *after;
+                return true;
+            } else if (dynamic_cast<ParallelForNode*>(node)) {
+                unsupported();  // 留给解释器分给工作线程
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                lowerLoop(nullptr, whileNode->condition.get(), whileNode->body.get(), nullptr, stmt);
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                lowerLoop(forNode->init.get(), forNode->condition.get(), forNode->body.get(),
+                          forNode->update.get(), stmt);
+            } else if (dynamic_cast<BreakNode*>(node)) {
+                if (loopDepth == 0) {
+                    unsupported();
+                }
+                stmt.kind = JitStmt::BREAK;
+                out.push_back(std::move(stmt));
+                return false;
+            } else if (dynamic_cast<ContinueNode*>(node)) {
+                if (loopDepth == 0) {
+                    unsupported();
+                }
+                stmt.kind = JitStmt::CONTINUE;
+                out.push_back(std::move(stmt));
+                return false;
+            } else {
+                unsupported();
+            }
+            out.push_back(std::move(stmt));
+            return true;
+        }
+
+        void lowerLoop(ASTNode* init, ASTNode* condition, ASTNode* body, ASTNode* update, JitStmt& stmt) {
+            if (!condition) {
+                unsupported();
+            }
+            stmt.kind = JitStmt::LOOP;
+            stmt.bodies.resize(3);
+            unordered_set<int32_t> before = assigned;
+            if (init) {
+                lowerStatement(init, stmt.bodies[0]);
+            }
+            unordered_set<int32_t> entry = assigned;
+            stmt.expr = lowerExpr(condition);
+            loopDepth++;
+            lowerBlock(body, stmt.bodies[1]);
+            loopDepth--;
+            // continue 会跳过循环体的剩余部分, 更新语句只能依赖进入循环前的赋值
+            assigned = entry;
+            if (update) {
+                lowerStatement(update, stmt.bodies[2]);
+            }
+            assigned = before;
+        }
+
+    public:
+        explicit JitLowering(JitSource& source) : source(source) {}
+
+        static shared_ptr<JitSource> lower(const vector<Parameter>& parameters, BlockNode& body) {
+            auto source = make_shared<JitSource>();
+            source->paramCount = parameters.size();
+            JitLowering lowering(*source);
+            try {
+                for (size_t i = 0; i < parameters.size(); i++) {
+                    const auto& param = parameters[i];
+                    if (lowering.vars.count(param.name)) {
+                        return nullptr;
+                    }
+                    lowering.vars[param.name] = static_cast<int32_t>(i);
+                    lowering.assigned.insert(static_cast<int32_t>(i));
+                    optional<Value> value;
+                    if (param.hasDefault) {
+                        auto* number = dynamic_cast<NumberNode*>(param.defaultValue.get());
+                        if (!number || (param.type != Value::EMPTY && number->type() != param.type)) {
+                            return nullptr;
+                        }
+                        value = number->value();
+                    }
+                    source->defaults.push_back(value);
+                }
+                lowering.lowerBlock(&body, source->body);
+            } catch (const Unsupported&) {
+                return nullptr;
+            }
+            return source;
+        }
+    };
+
+#endif
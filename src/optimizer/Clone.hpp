@@ -0,0 +1,185 @@
+#ifndef CLONE_HPP
+    #define CLONE_HPP
+
+    #include "../MiLang.hpp"
+    #include "../parser/Parser.hpp"
+    #include "../binop/BinOp.hpp"
+
+    using namespace std;
+
+    /*
+    #  复制语法树, 用于按实参类型特化函数体、parallel for 的工作线程和 Interpreter::run
+    #
+    #  保留 Resolver 的结果和 TypeInference 换上的节点, 运行时的类型反馈从头开始.
+    #  只读原来的树, 多个线程可以同时从同一棵树复制.
+    #  definitions 为 false 时函数定义不复制: 遇到时 failed 为 true, 调用方放弃这次复制
+    */
+    class TreeCloner {
+    private:
+        bool definitions;
+        bool failed = false;
+
+        template<binop::Op OP, binop::Op... REST>
+        unique_ptr<ASTNode> cloneIntBinOp(const BinOpNode& node) {
+            if (dynamic_cast<const IntBinOpNode<OP>*>(&node)) {
+                return make_unique<IntBinOpNode<OP>>(clone(node.left.get()), node.op, clone(node.right.get()));
+            }
+            if constexpr (sizeof...(REST) > 0) {
+                return cloneIntBinOp<REST...>(node);
+            } else {
+                return nullptr;
+            }
+        }
+
+        unique_ptr<ASTNode> cloneBinOp(const BinOpNode& node) {
+            if (auto* typed = dynamic_cast<const TypedBinOpNode*>(&node)) {
+                return make_unique<TypedBinOpNode>(clone(node.left.get()), node.op, clone(node.right.get()),
+                                                   typed->kernel);
+            }
+            if (auto intNode = cloneIntBinOp<binop::ADD, binop::SUB, binop::MUL, binop::EQ, binop::NEQ,
+                                             binop::GT, binop::LT, binop::GTE, binop::LTE>(node)) {
+                return intNode;
+            }
+            return make_unique<BinOpNode>(clone(node.left.get()), node.op, clone(node.right.get()));
+        }
+
+        unique_ptr<CallNode> cloneCall(const CallNode& call) {
+            vector<unique_ptr<ASTNode>> positional;
+            for (auto& arg : call.positionalArguments) {
+                positional.push_back(clone(arg.get()));
+            }
+            NamedArguments named;
+            for (auto& [argName, arg] : call.namedArguments) {
+                named.emplace_back(argName, clone(arg.get()));
+            }
+            auto copy = make_unique<CallNode>(call.name, std::move(positional), std::move(named));
+            copy->resolution = call.resolution;
+            copy->tailCall = call.tailCall;
+            copy->line = call.line;
+            return copy;
+        }
+
+        unique_ptr<ASTNode> cloneDefinition(const FunctionDefinitionNode& def) {
+            vector<Parameter> parameters = def.parameters;
+            for (auto& param : parameters) {
+                if (param.hasDefault) {
+                    param.defaultValue = clone(param.defaultValue.get());
+                }
+            }
+            auto copy = make_unique<FunctionDefinitionNode>(def.name, parameters, cloneBlock(def.body.get()));
+            copy->resolution = def.resolution;
+            copy->frameSize = def.frameSize;
+            copy->pure = def.pure;
+            copy->generator = def.generator;
+            copy->returnType = def.returnType;
+            return copy;
+        }
+
+    public:
+        explicit TreeCloner(bool definitions = false) : definitions(definitions) {}
+
+        bool ok() const { return !failed; }
+
+        unique_ptr<BlockNode> cloneBlock(const BlockNode* block) {
+            if (!block) {
+                return nullptr;
+            }
+            vector<unique_ptr<ASTNode>> statements;
+            for (auto& stmt : block->statements) {
+                statements.push_back(clone(stmt.get()));
+            }
+            auto copy = make_unique<BlockNode>(std::move(statements));
+            copy->yields = block->yields;
+            return copy;
+        }
+
+        unique_ptr<ASTNode> clone(const ASTNode* node) {
+            if (!node) {
+                return nullptr;
+            }
+            if (auto* number = dynamic_cast<const NumberNode*>(node)) {
+                return number->isFloat ? make_unique<NumberNode>(number->floatValue)
+                                       : make_unique<NumberNode>(number->intValue);
+            } else if (auto* str = dynamic_cast<const StringNode*>(node)) {
+                return make_unique<StringNode>(str->value);
+            } else if (auto* boolean = dynamic_cast<const BooleanNode*>(node)) {
+                return make_unique<BooleanNode>(boolean->value);
+            } else if (dynamic_cast<const NullNode*>(node)) {
+                return make_unique<NullNode>();
+            } else if (auto* var = dynamic_cast<const VariableNode*>(node)) {
+                auto copy = make_unique<VariableNode>(var->name);
+                copy->resolution = var->resolution;
+                copy->line = var->line;
+                return copy;
+            } else if (auto* call = dynamic_cast<const CallNode*>(node)) {
+                return cloneCall(*call);
+            } else if (auto* spawn = dynamic_cast<const SpawnNode*>(node)) {
+                auto copy = make_unique<SpawnNode>(cloneCall(*spawn->call), spawn->line);
+                copy->writesGlobals = spawn->writesGlobals;
+                return copy;
+            } else if (auto* convert = dynamic_cast<const ConvertNode*>(node)) {
+                return make_unique<ConvertNode>(convert->kind, cloneCall(*convert->call));
+            } else if (auto* assign = dynamic_cast<const AssignNode*>(node)) {
+                auto copy = make_unique<AssignNode>(assign->varName, clone(assign->expr.get()));
+                copy->resolution = assign->resolution;
+                return copy;
+            } else if (auto* binop = dynamic_cast<const BinOpNode*>(node)) {
+                return cloneBinOp(*binop);
+            } else if (auto* unary = dynamic_cast<const UnaryOpNode*>(node)) {
+                return make_unique<UnaryOpNode>(unary->op, clone(unary->expr.get()));
+            } else if (auto* block = dynamic_cast<const BlockNode*>(node)) {
+                return cloneBlock(block);
+            } else if (auto* ret = dynamic_cast<const ReturnNode*>(node)) {
+                return make_unique<ReturnNode>(clone(ret->expr.get()), ret->line);
+            } else if (auto* yieldNode = dynamic_cast<const YieldNode*>(node)) {
+                return make_unique<YieldNode>(clone(yieldNode->expr.get()), yieldNode->line);
+            } else if (auto* whileNode = dynamic_cast<const WhileNode*>(node)) {
+                auto copy = make_unique<WhileNode>(clone(whileNode->condition.get()),
+                                                   cloneBlock(whileNode->body.get()), whileNode->line);
+                copy->frameSize = whileNode->frameSize;
+                copy->boolCondition = whileNode->boolCondition;
+                return copy;
+            } else if (auto* parallel = dynamic_cast<const ParallelForNode*>(node)) {
+                auto copy = make_unique<ParallelForNode>(clone(parallel->init.get()), clone(parallel->condition.get()),
+                                                         clone(parallel->update.get()),
+                                                         cloneBlock(parallel->body.get()), parallel->line);
+                copy->frameSize = parallel->frameSize;
+                copy->boolCondition = parallel->boolCondition;
+                copy->counter = parallel->counter;
+                copy->reductions = parallel->reductions;
+                copy->assigned = parallel->assigned;
+                copy->writesGlobals = parallel->writesGlobals;
+                return copy;
+            } else if (auto* forNode = dynamic_cast<const ForNode*>(node)) {
+                auto copy = make_unique<ForNode>(clone(forNode->init.get()), clone(forNode->condition.get()),
+                                                 clone(forNode->update.get()), cloneBlock(forNode->body.get()),
+                                                 forNode->line);
+                copy->frameSize = forNode->frameSize;
+                copy->boolCondition = forNode->boolCondition;
+                return copy;
+            } else if (auto* forIn = dynamic_cast<const ForInNode*>(node)) {
+                auto copy = make_unique<ForInNode>(forIn->varName, clone(forIn->iterable.get()),
+                                                   cloneBlock(forIn->body.get()), forIn->line);
+                copy->resolution = forIn->resolution;
+                copy->frameSize = forIn->frameSize;
+                return copy;
+            } else if (auto* ifNode = dynamic_cast<const IfNode*>(node)) {
+                vector<IfNode::Branch> branches;
+                for (auto& branch : ifNode->branches) {
+                    branches.push_back({clone(branch.condition.get()), cloneBlock(branch.body.get()),
+                                        branch.boolCondition, branch.line, {}});
+                }
+                return make_unique<IfNode>(std::move(branches), cloneBlock(ifNode->elseBlock.get()));
+            } else if (auto* breakNode = dynamic_cast<const BreakNode*>(node)) {
+                return make_unique<BreakNode>(breakNode->line);
+            } else if (auto* continueNode = dynamic_cast<const ContinueNode*>(node)) {
+                return make_unique<ContinueNode>(continueNode->line);
+            } else if (auto* def = dynamic_cast<const FunctionDefinitionNode*>(node); def && definitions) {
+                return cloneDefinition(*def);
+            }
+            failed = true;
+            return nullptr;
+        }
+    };
+
+#endif
@@ -0,0 +1,619 @@
+#ifndef OPTIMIZER_HPP
+    #define OPTIMIZER_HPP
+
+    #include "../MiLang.hpp"
+    #include "../parser/Parser.hpp"
+    #include "../binop/BinOp.hpp"
+    #include "../resolver/Resolver.hpp"
+    #include <unordered_set>
+
+    using namespace std;
+
+    /*
+    #  语法树优化: 在 Parser::parseProgram 之后、Resolver 之前执行
+    #
+    #  每个 pass 只改写自己认得的节点, 改写失败 (例如折叠时会报错的 1 / 0)
+    #  就保留原节点, 让错误仍然在运行时、在原来的位置出现.
+    #  PassManager 按顺序运行开启的 pass, 直到整棵树不再变化.
+    */
+
+    // 字面量节点的值; 不是字面量时返回 nullopt
+    inline optional<Value> literalValue(ASTNode* node) {
+        if (auto* number = dynamic_cast<NumberNode*>(node)) {
+            return number->value();
+        } else if (auto* str = dynamic_cast<StringNode*>(node)) {
+            return Value(str->value);
+        } else if (auto* boolean = dynamic_cast<BooleanNode*>(node)) {
+            return Value(boolean->value);
+        } else if (dynamic_cast<NullNode*>(node)) {
+            return Value(NullType());
+        }
+        return nullopt;
+    }
+
+    inline unique_ptr<ASTNode> makeLiteral(const Value& value) {
+        switch (value.type()) {
+            case Value::INT:    return make_unique<NumberNode>(value.asInt());
+            case Value::FLOAT:  return make_unique<NumberNode>(value.asFloat());
+            case Value::STRING: return make_unique<StringNode>(value.asString());
+            case Value::BOOL:   return make_unique<BooleanNode>(value.asBool());
+            case Value::NONE:   return make_unique<NullNode>();
+            default:            return nullptr;
+        }
+    }
+
+    // 条件取值的规则与 if / while 相同; null 等会报错的值不折叠
+    inline optional<bool> literalTruth(ASTNode* node) {
+        auto value = literalValue(node);
+        if (!value) {
+            return nullopt;
+        }
+        switch (value->type()) {
+            case Value::INT:    return value->asInt() != 0;
+            case Value::FLOAT:  return value->asFloat() != 0.0;
+            case Value::BOOL:   return value->asBool();
+            case Value::STRING: return !value->asString().empty();
+            default:            return nullopt;
+        }
+    }
+
+    class OptimizationPass {
+    public:
+        virtual ~OptimizationPass() = default;
+        virtual const char* name() const = 0;
+
+        // 返回替换节点, 不改写时返回 nullptr
+        virtual unique_ptr<ASTNode> rewrite(ASTNode& node) { return nullptr; }
+
+        // 直接修改块内的语句列表, 有改动时返回 true
+        virtual bool rewriteBlock(BlockNode& block) { return false; }
+
+        // 后序遍历: 先改写子节点, 再改写节点本身
+        bool run(BlockNode& program) {
+            changed = false;
+            visitBlock(program);
+            return changed;
+        }
+
+    private:
+        bool changed = false;
+
+        template<typename Ptr>
+        void visit(Ptr& slot) {
+            if (!slot) {
+                return;
+            }
+            visitChildren(*slot);
+            if (auto replacement = rewrite(*slot)) {
+                slot = std::move(replacement);
+                changed = true;
+            }
+        }
+
+        void visitBlock(BlockNode& block) {
+            for (auto& stmt : block.statements) {
+                visit(stmt);
+            }
+            if (rewriteBlock(block)) {
+                changed = true;
+            }
+        }
+
+        void visitChildren(ASTNode& node) {
+            if (auto* binop = dynamic_cast<BinOpNode*>(&node)) {
+                visit(binop->left);
+                visit(binop->right);
+            } else if (auto* unary = dynamic_cast<UnaryOpNode*>(&node)) {
+                visit(unary->expr);
+            } else if (auto* assign = dynamic_cast<AssignNode*>(&node)) {
+                visit(assign->expr);
+            } else if (auto* call = dynamic_cast<CallNode*>(&node)) {
+                for (auto& arg : call->positionalArguments) {
+                    visit(arg);
+                }
+                for (auto& [argName, arg] : call->namedArguments) {
+                    visit(arg);
+                }
+            } else if (auto* block = dynamic_cast<BlockNode*>(&node)) {
+                visitBlock(*block);
+            } else if (auto* ret = dynamic_cast<ReturnNode*>(&node)) {
+                visit(ret->expr);
+            } else if (auto* yieldNode = dynamic_cast<YieldNode*>(&node)) {
+                visit(yieldNode->expr);
+            } else if (auto* spawn = dynamic_cast<SpawnNode*>(&node)) {
+                visitChildren(*spawn->call);  // 调用本身留给任务执行, 只化简实参
+            } else if (auto* convert = dynamic_cast<ConvertNode*>(&node)) {
+                visit(convert->call->positionalArguments[0]);
+            } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(&node)) {
+                for (auto& param : def->parameters) {
+                    visit(param.defaultValue);
+                }
+                visitBlock(*def->body);
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(&node)) {
+                visit(whileNode->condition);
+                visitBlock(*whileNode->body);
+            } else if (auto* forNode = dynamic_cast<ForNode*>(&node)) {
+                visit(forNode->init);
+                visit(forNode->condition);
+                visit(forNode->update);
+                visitBlock(*forNode->body);
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(&node)) {
+                visit(forIn->iterable);
+                visitBlock(*forIn->body);
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(&node)) {
+                for (auto& branch : ifNode->branches) {
+                    visit(branch.condition);
+                    visitBlock(*branch.body);
+                }
+                if (ifNode->elseBlock) {
+                    visitBlock(*ifNode->elseBlock);
+                }
+            }
+        }
+    };
+
+    // -x 在语法分析时是 0 - x, 改成一元取负
+    class UnaryMinusPass : public OptimizationPass {
+    public:
+        const char* name() const override { return "unary-minus"; }
+
+        unique_ptr<ASTNode> rewrite(ASTNode& node) override {
+            auto* binop = dynamic_cast<BinOpNode*>(&node);
+            if (!binop || binop->op.type != TokenType::MINUS) {
+                return nullptr;
+            }
+            auto zero = literalValue(binop->left.get());
+            if (!zero || !holds_alternative<IntType>(*zero) || get<IntType>(*zero) != 0) {
+                return nullptr;
+            }
+            return make_unique<UnaryOpNode>(Token(TokenType::MINUS, "-", binop->op.line), std::move(binop->right));
+        }
+    };
+
+    // 操作数都是字面量的二元、一元运算
+    class ConstantFoldingPass : public OptimizationPass {
+    private:
+        InnerMethod innermethod;
+
+    public:
+        const char* name() const override { return "constant-folding"; }
+
+        unique_ptr<ASTNode> rewrite(ASTNode& node) override {
+            try {
+                if (auto* binop = dynamic_cast<BinOpNode*>(&node)) {
+                    auto left = literalValue(binop->left.get());
+                    auto right = literalValue(binop->right.get());
+                    if (left && right) {
+                        return makeLiteral(binop::dispatch(binop->op.type, binop->op.line, *left, *right));
+                    }
+                } else if (auto* unary = dynamic_cast<UnaryOpNode*>(&node)) {
+                    if (auto operand = literalValue(unary->expr.get())) {
+                        return makeLiteral(UnaryOpNode::apply(unary->op.type, *operand, innermethod));
+                    }
+                }
+            } catch (const exception&) {
+                // 留到运行时报错
+            }
+            return nullptr;
+        }
+    };
+
+    // 程序里被赋值或定义过的名字, 包括参数和 for-in 的变量; 同名的内置函数调用不做改写
+    inline void collectShadowedNames(ASTNode* node, unordered_set<string>& shadowed) {
+        if (!node) {
+            return;
+        }
+        vector<string> names;
+        collectDeclarations(node, names);
+        shadowed.insert(names.begin(), names.end());
+        if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+            for (const auto& param : def->parameters) {
+                shadowed.insert(param.name);
+            }
+            collectShadowedNames(def->body.get(), shadowed);
+        } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+            for (auto& stmt : block->statements) {
+                collectShadowedNames(stmt.get(), shadowed);
+            }
+        } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+            collectShadowedNames(whileNode->body.get(), shadowed);
+        } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+            collectShadowedNames(forNode->init.get(), shadowed);
+            collectShadowedNames(forNode->update.get(), shadowed);
+            collectShadowedNames(forNode->body.get(), shadowed);
+        } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+            shadowed.insert(forIn->varName);
+            collectShadowedNames(forIn->body.get(), shadowed);
+        } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+            for (auto& branch : ifNode->branches) {
+                collectShadowedNames(branch.body.get(), shadowed);
+            }
+            collectShadowedNames(ifNode->elseBlock.get(), shadowed);
+        }
+    }
+
+    // 参数都是字面量的纯内置函数: int("5"), type(1) ...
+    class PureBuiltinPass : public OptimizationPass {
+    private:
+        using Builtin = Value (InnerMethod::*)(BuiltinArgs);
+
+        InnerMethod innermethod;
+        unordered_map<string, Builtin> builtins = {
+            {"int",    &InnerMethod::intFunction},
+            {"float",  &InnerMethod::floatFunction},
+            {"bool",   &InnerMethod::boolFunction},
+            {"string", &InnerMethod::stringFunction},
+            {"type",   &InnerMethod::typeFunction},
+        };
+        unordered_set<string> shadowed;
+
+    public:
+        explicit PureBuiltinPass(BlockNode& program) {
+            collectShadowedNames(&program, shadowed);
+        }
+
+        const char* name() const override { return "pure-builtins"; }
+
+        unique_ptr<ASTNode> rewrite(ASTNode& node) override {
+            auto* call = dynamic_cast<CallNode*>(&node);
+            if (auto* convert = dynamic_cast<ConvertNode*>(&node)) {
+                call = convert->call.get();
+            }
+            if (!call || !call->namedArguments.empty() || shadowed.count(call->name)) {
+                return nullptr;
+            }
+            auto it = builtins.find(call->name);
+            if (it == builtins.end()) {
+                return nullptr;
+            }
+            vector<Value> args;
+            for (auto& arg : call->positionalArguments) {
+                auto value = literalValue(arg.get());
+                if (!value) {
+                    return nullptr;
+                }
+                args.push_back(*value);
+            }
+            try {
+                return makeLiteral((innermethod.*(it->second))(args));
+            } catch (const exception&) {
+                return nullptr;
+            }
+        }
+    };
+
+    /*
+    #  一个位置实参的 int / float / bool / string / type 调用改写成 ConvertNode,
+    #  执行时不查内置函数表、不建实参数组. 名字被程序赋值或定义过时不改写
+    */
+    class IntrinsicPass : public OptimizationPass {
+    private:
+        unordered_set<string> shadowed;
+
+    public:
+        explicit IntrinsicPass(BlockNode& program) {
+            collectShadowedNames(&program, shadowed);
+        }
+
+        const char* name() const override { return "intrinsics"; }
+
+        unique_ptr<ASTNode> rewrite(ASTNode& node) override {
+            auto* call = dynamic_cast<CallNode*>(&node);
+            if (!call || call->positionalArguments.size() != 1 || !call->namedArguments.empty() ||
+                shadowed.count(call->name)) {
+                return nullptr;
+            }
+            auto kind = intrinsicKind(call->name);
+            if (!kind) {
+                return nullptr;
+            }
+            auto copy = make_unique<CallNode>(call->name, std::move(call->positionalArguments));
+            copy->line = call->line;
+            return make_unique<ConvertNode>(*kind, std::move(copy));
+        }
+    };
+
+    /*
+    #  代数化简, 只做对所有可能的运行时类型都成立的恒等式:
+    #  e - 0, e * 1, 1 * e     e 为数值
+    #  e + 0, 0 + e            e 为整数 (浮点数 -0.0 + 0 为 0.0)
+    #  e == true, e != false   e 为布尔值, e == false / e != true 改为 !e
+    #  !!e                     e 为布尔值
+    */
+    class AlgebraicPass : public OptimizationPass {
+    private:
+        enum class Kind { UNKNOWN, INT, NUMBER, BOOL };
+
+        static Kind kindOf(ASTNode* node) {
+            if (auto value = literalValue(node)) {
+                switch (value->type()) {
+                    case Value::INT:   return Kind::INT;
+                    case Value::FLOAT: return Kind::NUMBER;
+                    case Value::BOOL:  return Kind::BOOL;
+                    default:           return Kind::UNKNOWN;
+                }
+            }
+            if (auto* unary = dynamic_cast<UnaryOpNode*>(node)) {
+                if (unary->op.type == TokenType::NOT) {
+                    return Kind::BOOL;
+                }
+                return kindOf(unary->expr.get()) == Kind::INT ? Kind::INT : Kind::NUMBER;
+            }
+            auto* binop = dynamic_cast<BinOpNode*>(node);
+            if (!binop) {
+                return Kind::UNKNOWN;
+            }
+            switch (binop->op.type) {
+                case TokenType::PLUS:
+                case TokenType::MINUS:
+                case TokenType::MULTIPLY:
+                    // 整数与整数的结果仍是整数, 其余情况是数值或者报错
+                    if (kindOf(binop->left.get()) == Kind::INT && kindOf(binop->right.get()) == Kind::INT) {
+                        return Kind::INT;
+                    }
+                    return Kind::NUMBER;
+                case TokenType::DIVIDE:
+                case TokenType::POWER:
+                case TokenType::PYPOWER:
+                    return Kind::NUMBER;
+                default:
+                    return Kind::BOOL;
+            }
+        }
+
+        static bool isInt(ASTNode* node, IntType expected) {
+            auto value = literalValue(node);
+            return value && holds_alternative<IntType>(*value) && get<IntType>(*value) == expected;
+        }
+
+        static optional<bool> boolLiteral(ASTNode* node) {
+            auto value = literalValue(node);
+            if (value && holds_alternative<BoolType>(*value)) {
+                return get<BoolType>(*value);
+            }
+            return nullopt;
+        }
+
+        static bool numeric(Kind kind) {
+            return kind == Kind::INT || kind == Kind::NUMBER;
+        }
+
+    public:
+        const char* name() const override { return "algebraic"; }
+
+        unique_ptr<ASTNode> rewrite(ASTNode& node) override {
+            if (auto* unary = dynamic_cast<UnaryOpNode*>(&node)) {
+                auto* inner = dynamic_cast<UnaryOpNode*>(unary->expr.get());
+                if (unary->op.type == TokenType::NOT && inner && inner->op.type == TokenType::NOT &&
+                    kindOf(inner->expr.get()) == Kind::BOOL) {
+                    return std::move(inner->expr);
+                }
+                return nullptr;
+            }
+
+            auto* binop = dynamic_cast<BinOpNode*>(&node);
+            if (!binop) {
+                return nullptr;
+            }
+            ASTNode* left = binop->left.get();
+            ASTNode* right = binop->right.get();
+            switch (binop->op.type) {
+                case TokenType::PLUS:
+                    if (isInt(right, 0) && kindOf(left) == Kind::INT) {
+                        return std::move(binop->left);
+                    }
+                    if (isInt(left, 0) && kindOf(right) == Kind::INT) {
+                        return std::move(binop->right);
+                    }
+                    break;
+                case TokenType::MINUS:
+                    if (isInt(right, 0) && numeric(kindOf(left))) {
+                        return std::move(binop->left);
+                    }
+                    break;
+                case TokenType::MULTIPLY:
+                    if (isInt(right, 1) && numeric(kindOf(left))) {
+                        return std::move(binop->left);
+                    }
+                    if (isInt(left, 1) && numeric(kindOf(right))) {
+                        return std::move(binop->right);
+                    }
+                    break;
+                case TokenType::EQ:
+                case TokenType::NEQ: {
+                    bool leftIsLiteral = boolLiteral(left).has_value();
+                    auto literal = leftIsLiteral ? boolLiteral(left) : boolLiteral(right);
+                    auto& other = leftIsLiteral ? binop->right : binop->left;
+                    if (!literal || kindOf(other.get()) != Kind::BOOL) {
+                        break;
+                    }
+                    if (*literal == (binop->op.type == TokenType::EQ)) {
+                        return std::move(other);
+                    }
+                    return make_unique<UnaryOpNode>(Token(TokenType::NOT, "!", binop->op.line), std::move(other));
+                }
+                default:
+                    break;
+            }
+            return nullptr;
+        }
+    };
+
+    // 条件为字面量的 if 分支和 while 循环
+    class DeadBranchPass : public OptimizationPass {
+    public:
+        const char* name() const override { return "dead-branches"; }
+
+        unique_ptr<ASTNode> rewrite(ASTNode& node) override {
+            if (auto* whileNode = dynamic_cast<WhileNode*>(&node)) {
+                auto truth = literalTruth(whileNode->condition.get());
+                if (truth && !*truth) {
+                    return make_unique<NumberNode>(IntType(0));  // 与不执行的 while 的值相同
+                }
+                return nullptr;
+            }
+
+            auto* ifNode = dynamic_cast<IfNode*>(&node);
+            if (!ifNode) {
+                return nullptr;
+            }
+            bool foldable = false;
+            for (auto& branch : ifNode->branches) {
+                foldable = foldable || literalTruth(branch.condition.get()).has_value();
+            }
+            if (!foldable) {
+                return nullptr;
+            }
+            vector<IfNode::Branch> live;
+            for (auto& branch : ifNode->branches) {
+                auto truth = literalTruth(branch.condition.get());
+                if (!truth) {
+                    live.push_back(std::move(branch));
+                } else if (*truth) {
+                    // 之后的分支都不会执行, 这个分支成为 else
+                    ifNode->elseBlock = std::move(branch.body);
+                    break;
+                }
+            }
+            if (live.empty()) {
+                if (ifNode->elseBlock) {
+                    return std::move(ifNode->elseBlock);
+                }
+                return make_unique<NumberNode>(IntType(0));
+            }
+            return make_unique<IfNode>(std::move(live), std::move(ifNode->elseBlock));
+        }
+
+        /*
+        #  if 分支不产生新作用域, 嵌套的块可以展开;
+        #  块的值是最后一条语句的值, 所以只删去不在末尾的字面量语句
+        */
+        bool rewriteBlock(BlockNode& block) override {
+            bool changed = false;
+            vector<unique_ptr<ASTNode>> statements;
+            for (size_t i = 0; i < block.statements.size(); i++) {
+                auto& stmt = block.statements[i];
+                bool last = i + 1 == block.statements.size();
+                auto* nested = dynamic_cast<BlockNode*>(stmt.get());
+                if (nested && !(last && nested->statements.empty())) {
+                    for (auto& inner : nested->statements) {
+                        statements.push_back(std::move(inner));
+                    }
+                    changed = true;
+                } else if (!last && literalValue(stmt.get())) {
+                    changed = true;
+                } else {
+                    statements.push_back(std::move(stmt));
+                }
+            }
+            block.statements = std::move(statements);
+            return changed;
+        }
+    };
+
+    // return / break / continue 之后的语句
+    class UnreachablePass : public OptimizationPass {
+    public:
+        const char* name() const override { return "unreachable"; }
+
+        bool rewriteBlock(BlockNode& block) override {
+            for (size_t i = 0; i + 1 < block.statements.size(); i++) {
+                ASTNode* stmt = block.statements[i].get();
+                if (dynamic_cast<ReturnNode*>(stmt) || dynamic_cast<BreakNode*>(stmt) ||
+                    dynamic_cast<ContinueNode*>(stmt)) {
+                    block.statements.resize(i + 1);
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    class PassManager {
+    private:
+        static constexpr int MAX_ROUNDS = 8;
+        vector<string> enabled;
+
+    public:
+        static const vector<string>& passNames() {
+            static const vector<string> names = {
+                "unary-minus", "constant-folding", "pure-builtins", "algebraic", "dead-branches", "unreachable",
+                "intrinsics", "types", "quicken", "specialize",
+            };
+            return names;
+        }
+
+        static bool isPass(const string& name) {
+            const auto& names = passNames();
+            return find(names.begin(), names.end(), name) != names.end();
+        }
+
+        explicit PassManager(int level = 1) {
+            setLevel(level);
+        }
+
+        // -O0 不做优化; -O1 为默认; -O2 加上代数化简和内置函数折叠
+        void setLevel(int level) {
+            enabled.clear();
+            if (level >= 1) {
+                enabled = {"unary-minus", "constant-folding", "dead-branches", "unreachable", "intrinsics", "types",
+                           "quicken", "specialize"};
+            }
+            if (level >= 2) {
+                enabled.push_back("pure-builtins");
+                enabled.push_back("algebraic");
+            }
+        }
+
+        void enable(const string& name) {
+            if (!isEnabled(name)) {
+                enabled.push_back(name);
+            }
+        }
+
+        void disable(const string& name) {
+            enabled.erase(remove(enabled.begin(), enabled.end(), name), enabled.end());
+        }
+
+        bool isEnabled(const string& name) const {
+            return find(enabled.begin(), enabled.end(), name) != enabled.end();
+        }
+
+        void run(BlockNode& program) {
+            vector<unique_ptr<OptimizationPass>> pipeline;
+            for (const auto& name : passNames()) {
+                if (!isEnabled(name)) {
+                    continue;
+                }
+                if (name == "unary-minus") {
+                    pipeline.push_back(make_unique<UnaryMinusPass>());
+                } else if (name == "constant-folding") {
+                    pipeline.push_back(make_unique<ConstantFoldingPass>());
+                } else if (name == "pure-builtins") {
+                    pipeline.push_back(make_unique<PureBuiltinPass>(program));
+                } else if (name == "algebraic") {
+                    pipeline.push_back(make_unique<AlgebraicPass>());
+                } else if (name == "dead-branches") {
+                    pipeline.push_back(make_unique<DeadBranchPass>());
+                } else if (name == "unreachable") {
+                    pipeline.push_back(make_unique<UnreachablePass>());
+                } else if (name == "intrinsics") {
+                    pipeline.push_back(make_unique<IntrinsicPass>(program));
+                }
+                // types 需要 Resolver 的结果, 由 TypeInference 在 Resolver 之后单独执行;
+                // quicken 和 specialize 是树遍历引擎在运行时做的特化, 不改写语法树
+            }
+
+            for (int round = 0; round < MAX_ROUNDS; round++) {
+                bool changed = false;
+                for (auto& pass : pipeline) {
+                    changed |= pass->run(program);
+                }
+                if (!changed) {
+                    break;
+                }
+            }
+        }
+    };
+
+#endif
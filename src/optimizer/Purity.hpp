@@ -0,0 +1,439 @@
+#ifndef PURITY_HPP
+    #define PURITY_HPP
+
+    #include "../MiLang.hpp"
+    #include "../parser/Parser.hpp"
+    #include "../resolver/Resolver.hpp"
+    #include <unordered_set>
+
+    using namespace std;
+
+    /*
+    #  纯函数分析, 为 --memo 标记可以缓存结果的函数
+    #
+    #  只考虑顶层定义、名字只定义一次且从不被赋值的函数. 纯函数的函数体:
+    #  - 只调用 int/float/bool/string/type 和其他纯函数, 不调用参数或局部变量里的函数;
+    #  - 只读参数、局部变量和纯函数本身, 不读其他全局变量;
+    #  - 赋值的名字不会落到全局变量上 (没有同名的全局变量);
+    #  - 不在函数体内定义函数, 不遍历生成器; 生成器函数本身每次调用都返回新对象, 不是纯函数.
+    #  先假设所有候选都是纯函数, 反复剔除违反规则的, 直到不再变化.
+    */
+    class PurityAnalysis {
+    private:
+        struct Candidate {
+            FunctionDefinitionNode* def;
+            unordered_set<string> locals;  // 参数和函数体里赋值的名字
+            bool pure = true;
+        };
+
+        function<bool(const string&)> isExternalGlobal;  // 之前的输入里已经存在的全局变量
+        unordered_set<string> globals;                   // 顶层赋值或定义的名字
+        unordered_set<string> assigned;                  // 任何地方被赋值过的名字
+        unordered_map<string, int> definitions;
+        unordered_map<string, Candidate> candidates;
+
+        static bool isPureBuiltin(const string& name) {
+            return name == "int" || name == "float" || name == "bool" || name == "string" || name == "type";
+        }
+
+        bool isGlobal(const string& name) const {
+            return globals.count(name) || (isExternalGlobal && isExternalGlobal(name));
+        }
+
+        bool isPureFunction(const string& name) const {
+            auto it = candidates.find(name);
+            return it != candidates.end() && it->second.pure;
+        }
+
+        void collectGlobals(ASTNode* node) {
+            vector<string> names;
+            collectDeclarations(node, names);
+            globals.insert(names.begin(), names.end());
+            if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                for (auto& stmt : block->statements) {
+                    collectGlobals(stmt.get());
+                }
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                collectGlobals(whileNode->body.get());
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                collectGlobals(forNode->init.get());
+                collectGlobals(forNode->body.get());
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                collectGlobals(forIn->body.get());
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                for (auto& branch : ifNode->branches) {
+                    collectGlobals(branch.body.get());
+                }
+                if (ifNode->elseBlock) {
+                    collectGlobals(ifNode->elseBlock.get());
+                }
+            }
+        }
+
+        // 记录所有赋值和函数定义, 包括函数体内的
+        void collectAssignments(ASTNode* node) {
+            if (!node) {
+                return;
+            }
+            if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                assigned.insert(assign->varName);
+                collectAssignments(assign->expr.get());
+            } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+                definitions[def->name]++;
+                collectAssignments(def->body.get());
+            } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                for (auto& stmt : block->statements) {
+                    collectAssignments(stmt.get());
+                }
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                collectAssignments(whileNode->body.get());
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                collectAssignments(forNode->init.get());
+                collectAssignments(forNode->update.get());
+                collectAssignments(forNode->body.get());
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                assigned.insert(forIn->varName);
+                collectAssignments(forIn->body.get());
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                for (auto& branch : ifNode->branches) {
+                    collectAssignments(branch.body.get());
+                }
+                collectAssignments(ifNode->elseBlock.get());
+            }
+        }
+
+        // 函数体里赋值的名字, 包括循环体内的
+        static void collectLocals(ASTNode* node, unordered_set<string>& locals) {
+            vector<string> names;
+            collectDeclarations(node, names);
+            locals.insert(names.begin(), names.end());
+            if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                for (auto& stmt : block->statements) {
+                    collectLocals(stmt.get(), locals);
+                }
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                collectLocals(whileNode->body.get(), locals);
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                collectLocals(forNode->init.get(), locals);
+                collectLocals(forNode->update.get(), locals);
+                collectLocals(forNode->body.get(), locals);
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                locals.insert(forIn->varName);
+                collectLocals(forIn->body.get(), locals);
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                for (auto& branch : ifNode->branches) {
+                    collectLocals(branch.body.get(), locals);
+                }
+                if (ifNode->elseBlock) {
+                    collectLocals(ifNode->elseBlock.get(), locals);
+                }
+            }
+        }
+
+        bool check(ASTNode* node, const Candidate& fn) const {
+            if (!node) {
+                return true;
+            }
+            if (auto* var = dynamic_cast<VariableNode*>(node)) {
+                return fn.locals.count(var->name) || isPureFunction(var->name);
+            } else if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                return !isGlobal(assign->varName) && check(assign->expr.get(), fn);
+            } else if (auto* binop = dynamic_cast<BinOpNode*>(node)) {
+                return check(binop->left.get(), fn) && check(binop->right.get(), fn);
+            } else if (auto* unary = dynamic_cast<UnaryOpNode*>(node)) {
+                return check(unary->expr.get(), fn);
+            } else if (auto* call = dynamic_cast<CallNode*>(node)) {
+                if (fn.locals.count(call->name)) {
+                    return false;
+                }
+                if (!isPureFunction(call->name) && !isPureBuiltin(call->name)) {
+                    return false;
+                }
+                for (auto& arg : call->positionalArguments) {
+                    if (!check(arg.get(), fn)) {
+                        return false;
+                    }
+                }
+                for (auto& [argName, arg] : call->namedArguments) {
+                    if (!check(arg.get(), fn)) {
+                        return false;
+                    }
+                }
+                return true;
+            } else if (auto* convert = dynamic_cast<ConvertNode*>(node)) {
+                return check(convert->argument(), fn);
+            } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                for (auto& stmt : block->statements) {
+                    if (!check(stmt.get(), fn)) {
+                        return false;
+                    }
+                }
+                return true;
+            } else if (auto* ret = dynamic_cast<ReturnNode*>(node)) {
+                return check(ret->expr.get(), fn);
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                return check(whileNode->condition.get(), fn) && check(whileNode->body.get(), fn);
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                return check(forNode->init.get(), fn) && check(forNode->condition.get(), fn) &&
+                       check(forNode->update.get(), fn) && check(forNode->body.get(), fn);
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                for (auto& branch : ifNode->branches) {
+                    if (!check(branch.condition.get(), fn) || !check(branch.body.get(), fn)) {
+                        return false;
+                    }
+                }
+                return check(ifNode->elseBlock.get(), fn);
+            } else if (dynamic_cast<FunctionDefinitionNode*>(node) || dynamic_cast<ForInNode*>(node) ||
+                       dynamic_cast<YieldNode*>(node) || dynamic_cast<SpawnNode*>(node)) {
+                return false;
+            }
+            // 字面量, break, continue
+            return true;
+        }
+
+        bool checkFunction(const Candidate& fn) const {
+            for (const auto& param : fn.def->parameters) {
+                if (param.hasDefault && !check(param.defaultValue.get(), fn)) {
+                    return false;
+                }
+            }
+            return check(fn.def->body.get(), fn);
+        }
+
+    public:
+        explicit PurityAnalysis(function<bool(const string&)> isExternalGlobal = nullptr)
+            : isExternalGlobal(std::move(isExternalGlobal)) {}
+
+        void run(BlockNode& program) {
+            collectGlobals(&program);
+            collectAssignments(&program);
+
+            for (auto& stmt : program.statements) {
+                auto* def = dynamic_cast<FunctionDefinitionNode*>(stmt.get());
+                if (!def || def->generator || definitions[def->name] != 1 || assigned.count(def->name) ||
+                    (isExternalGlobal && isExternalGlobal(def->name))) {
+                    continue;
+                }
+                Candidate fn{def, {}, true};
+                for (const auto& param : def->parameters) {
+                    fn.locals.insert(param.name);
+                }
+                collectLocals(def->body.get(), fn.locals);
+                candidates.emplace(def->name, std::move(fn));
+            }
+
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (auto& [name, fn] : candidates) {
+                    if (fn.pure && !checkFunction(fn)) {
+                        fn.pure = false;
+                        changed = true;
+                    }
+                }
+            }
+
+            for (auto& [name, fn] : candidates) {
+                fn.def->pure = fn.pure;
+            }
+        }
+    };
+
+    /*
+    #  找出调用时可能给全局变量赋值的函数, 标记调用了这样的函数的 parallel for 和 spawn
+    #
+    #  工作线程在全局变量的副本上执行, 函数对全局变量的赋值随副本丢弃, 结果会随 --threads 变化;
+    #  标记过的循环和任务在发起的线程上按顺序执行, 与 --threads=1 的结果相同.
+    #  函数体给参数以外的全局名字赋值, 或者调用了可能赋值的函数, 就算作可能赋值.
+    #  调用的名字不是内置函数、也不是顶层只定义一次且从不被赋值的函数时 (参数或变量里的函数,
+    #  之前的输入里定义的函数) 无法确定, 同样算作可能赋值.
+    #  先假设所有函数都不赋值, 反复加入可能赋值的, 直到不再变化
+    */
+    class GlobalWriteAnalysis {
+    private:
+        using Names = unordered_set<string>;
+
+        function<bool(const string&)> isBuiltin;
+        function<bool(const string&)> isExternalGlobal;
+        Names globals;   // 顶层 (含 if 分支) 赋值或定义的名字
+        unordered_map<string, FunctionDefinitionNode*> functions;
+        Names writers;   // 可能给全局变量赋值的函数
+
+        // 依次交给 visit 的直接子节点; 函数定义的函数体不在其中
+        template<typename Visit>
+        static bool anyChild(ASTNode* node, const Visit& visit) {
+            if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                return visit(assign->expr.get());
+            } else if (auto* binop = dynamic_cast<BinOpNode*>(node)) {
+                return visit(binop->left.get()) || visit(binop->right.get());
+            } else if (auto* unary = dynamic_cast<UnaryOpNode*>(node)) {
+                return visit(unary->expr.get());
+            } else if (auto* call = dynamic_cast<CallNode*>(node)) {
+                for (auto& arg : call->positionalArguments) {
+                    if (visit(arg.get())) {
+                        return true;
+                    }
+                }
+                for (auto& [argName, arg] : call->namedArguments) {
+                    if (visit(arg.get())) {
+                        return true;
+                    }
+                }
+            } else if (auto* convert = dynamic_cast<ConvertNode*>(node)) {
+                return visit(convert->argument());
+            } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                for (auto& stmt : block->statements) {
+                    if (visit(stmt.get())) {
+                        return true;
+                    }
+                }
+            } else if (auto* ret = dynamic_cast<ReturnNode*>(node)) {
+                return visit(ret->expr.get());
+            } else if (auto* yieldNode = dynamic_cast<YieldNode*>(node)) {
+                return visit(yieldNode->expr.get());
+            } else if (auto* spawn = dynamic_cast<SpawnNode*>(node)) {
+                return visit(spawn->call.get());
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                return visit(whileNode->condition.get()) || visit(whileNode->body.get());
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                return visit(forNode->init.get()) || visit(forNode->condition.get()) ||
+                       visit(forNode->update.get()) || visit(forNode->body.get());
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                return visit(forIn->iterable.get()) || visit(forIn->body.get());
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                for (auto& branch : ifNode->branches) {
+                    if (visit(branch.condition.get()) || visit(branch.body.get())) {
+                        return true;
+                    }
+                }
+                return visit(ifNode->elseBlock.get());
+            }
+            return false;
+        }
+
+        bool isGlobal(const string& name, const Names& params) const {
+            return !params.count(name) && (globals.count(name) || (isExternalGlobal && isExternalGlobal(name)));
+        }
+
+        bool mayWrite(const string& callee, const Names& params) const {
+            if (params.count(callee)) {
+                return true;
+            }
+            if (functions.count(callee)) {
+                return writers.count(callee) > 0;
+            }
+            return !(isBuiltin && isBuiltin(callee));
+        }
+
+        // 执行 node 时可能给全局变量赋值; params 是所在函数的参数
+        bool writes(ASTNode* node, const Names& params) const {
+            if (!node || dynamic_cast<FunctionDefinitionNode*>(node)) {
+                return false;  // 定义函数不执行函数体
+            }
+            if (auto* assign = dynamic_cast<AssignNode*>(node); assign && isGlobal(assign->varName, params)) {
+                return true;
+            }
+            if (auto* forIn = dynamic_cast<ForInNode*>(node); forIn && isGlobal(forIn->varName, params)) {
+                return true;
+            }
+            if (auto* call = dynamic_cast<CallNode*>(node); call && mayWrite(call->name, params)) {
+                return true;
+            }
+            return anyChild(node, [&](ASTNode* child) { return writes(child, params); });
+        }
+
+        static Names parameterNames(const FunctionDefinitionNode& def) {
+            Names names;
+            for (const auto& param : def.parameters) {
+                names.insert(param.name);
+            }
+            return names;
+        }
+
+        bool functionWrites(const FunctionDefinitionNode& def) const {
+            Names params = parameterNames(def);
+            for (const auto& param : def.parameters) {
+                if (param.hasDefault && writes(param.defaultValue.get(), params)) {
+                    return true;
+                }
+            }
+            return writes(def.body.get(), params);
+        }
+
+        // 所有赋值的名字和函数定义的次数, 包括函数体内的
+        static void collect(ASTNode* node, Names& assigned, unordered_map<string, int>& definitions) {
+            if (!node) {
+                return;
+            }
+            if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                assigned.insert(assign->varName);
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                assigned.insert(forIn->varName);
+            } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+                definitions[def->name]++;
+                collect(def->body.get(), assigned, definitions);
+            }
+            anyChild(node, [&](ASTNode* child) {
+                collect(child, assigned, definitions);
+                return false;
+            });
+        }
+
+        void mark(ASTNode* node, const Names& params) {
+            if (!node) {
+                return;
+            }
+            if (auto* parallel = dynamic_cast<ParallelForNode*>(node)) {
+                // 循环体直接赋值的只有计数器、归约变量和循环里的新名字 (其余由 Resolver 报错), 只看调用
+                Names locals = params;
+                locals.insert(parallel->counter.name);
+                for (const auto& reduction : parallel->reductions) {
+                    locals.insert(reduction.var.name);
+                }
+                locals.insert(parallel->assigned.begin(), parallel->assigned.end());
+                parallel->writesGlobals = writes(parallel->body.get(), locals);
+            } else if (auto* spawn = dynamic_cast<SpawnNode*>(node)) {
+                spawn->writesGlobals = mayWrite(spawn->call->name, params);
+            } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+                mark(def->body.get(), parameterNames(*def));
+            }
+            anyChild(node, [&](ASTNode* child) {
+                mark(child, params);
+                return false;
+            });
+        }
+
+    public:
+        GlobalWriteAnalysis(function<bool(const string&)> isBuiltin, function<bool(const string&)> isExternalGlobal)
+            : isBuiltin(std::move(isBuiltin)), isExternalGlobal(std::move(isExternalGlobal)) {}
+
+        void run(BlockNode& program) {
+            vector<string> names;
+            collectDeclarations(&program, names);
+            globals.insert(names.begin(), names.end());
+            Names assigned;
+            unordered_map<string, int> definitions;
+            collect(&program, assigned, definitions);
+            for (auto& stmt : program.statements) {
+                auto* def = dynamic_cast<FunctionDefinitionNode*>(stmt.get());
+                if (def && definitions[def->name] == 1 && !assigned.count(def->name) &&
+                    !(isExternalGlobal && isExternalGlobal(def->name))) {
+                    functions[def->name] = def;
+                }
+            }
+
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (auto& [name, def] : functions) {
+                    if (!writers.count(name) && functionWrites(*def)) {
+                        writers.insert(name);
+                        changed = true;
+                    }
+                }
+            }
+            mark(&program, {});
+        }
+    };
+
+#endif
@@ -0,0 +1,424 @@
+#ifndef TYPES_HPP
+    #define TYPES_HPP
+
+    #include "../MiLang.hpp"
+    #include "../parser/Parser.hpp"
+    #include "../binop/BinOp.hpp"
+    #include "../resolver/Resolver.hpp"
+    #include <unordered_set>
+
+    using namespace std;
+
+    /*
+    #  类型推断: 证明变量和表达式只有一种类型, 把证明了的节点换成不检查类型的版本
+    #
+    #  在 Resolver 之后执行, 只用于从文件运行的完整程序 (REPL 之后的输入可能新建同名的全局变量).
+    #  一个名字的类型是所有可能写进它的值的类型的并:
+    #  - 函数里的名字: 函数里对它的赋值, 参数按注解 (没有注解时可以是任何类型);
+    #    同名的全局变量存在时, 赋值可能落到全局变量上, 读取也可能读到全局变量, 再并上全局变量的类型;
+    #  - 全局变量: 整个程序里对它的赋值; 函数定义和内置函数是任意类型.
+    #  调用 int/float/bool/string/type 和带返回值注解的函数时, 结果的类型是确定的.
+    #  从 "还没有值" 开始反复扫描, 直到不再变化, 然后:
+    #  - 两侧类型都确定的二元运算换成 IntBinOpNode / TypedBinOpNode;
+    #  - 条件一定是 bool 的 while / for / if 不再判断条件的类型.
+    */
+    class TypeInference {
+    private:
+        // 还没有值 (EMPTY) < int / float / bool / string < 任意类型 (借用 NONE 表示)
+        static constexpr Value::Type UNKNOWN = Value::EMPTY;
+        static constexpr Value::Type ANY = Value::NONE;
+
+        struct Scope {
+            unordered_map<string, Value::Type> locals;  // 参数和函数体里赋值的名字
+        };
+
+        function<bool(const string&)> isBuiltin;
+        unordered_set<string> globalNames;  // 顶层赋值或定义的名字
+        unordered_map<string, Value::Type> globals;
+        unordered_map<FunctionDefinitionNode*, Scope> scopes;
+        unordered_map<string, int> definitions;
+        unordered_set<string> assigned;
+        unordered_map<string, Value::Type> functions;  // 顶层只定义一次、从不被赋值的函数的返回值注解
+        bool changed = false;
+
+        static Value::Type join(Value::Type a, Value::Type b) {
+            if (a == UNKNOWN) {
+                return b;
+            }
+            if (b == UNKNOWN || a == b) {
+                return a;
+            }
+            return ANY;
+        }
+
+        static bool isProven(Value::Type type) {
+            return type != UNKNOWN && type != ANY;
+        }
+
+        bool isGlobal(const string& name) const {
+            return globalNames.count(name) || isBuiltin(name);
+        }
+
+        void widen(Value::Type& type, Value::Type with) {
+            Value::Type joined = join(type, with);
+            if (joined != type) {
+                type = joined;
+                changed = true;
+            }
+        }
+
+        Value::Type read(Scope* scope, const string& name) {
+            Value::Type type = UNKNOWN;
+            if (scope) {
+                auto it = scope->locals.find(name);
+                if (it != scope->locals.end()) {
+                    type = it->second;
+                }
+            }
+            if (isGlobal(name)) {
+                auto it = globals.find(name);
+                type = join(type, isBuiltin(name) ? ANY : it == globals.end() ? UNKNOWN : it->second);
+            }
+            return type;
+        }
+
+        void write(Scope* scope, const string& name, Value::Type type) {
+            if (scope) {
+                widen(scope->locals[name], type);
+            }
+            if (!scope || isGlobal(name)) {
+                widen(globals[name], type);
+            }
+        }
+
+        // 记录作用域、全局变量名、定义次数和被赋值的名字
+        void collect(ASTNode* node, Scope* scope) {
+            if (!node) {
+                return;
+            }
+            if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                assigned.insert(assign->varName);
+                if (scope) {
+                    scope->locals.emplace(assign->varName, UNKNOWN);
+                } else {
+                    globalNames.insert(assign->varName);
+                }
+            } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+                definitions[def->name]++;
+                if (scope) {
+                    scope->locals.emplace(def->name, UNKNOWN);
+                } else {
+                    globalNames.insert(def->name);
+                }
+                Scope& inner = scopes[def];
+                for (const auto& param : def->parameters) {
+                    inner.locals.emplace(param.name, param.type == Value::EMPTY ? ANY : param.type);
+                }
+                collect(def->body.get(), &inner);
+            } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                for (auto& stmt : block->statements) {
+                    collect(stmt.get(), scope);
+                }
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                collect(whileNode->body.get(), scope);
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                collect(forNode->init.get(), scope);
+                collect(forNode->condition.get(), scope);
+                collect(forNode->update.get(), scope);
+                collect(forNode->body.get(), scope);
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                assigned.insert(forIn->varName);
+                if (scope) {
+                    scope->locals.emplace(forIn->varName, UNKNOWN);
+                } else {
+                    globalNames.insert(forIn->varName);
+                }
+                collect(forIn->body.get(), scope);
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                for (auto& branch : ifNode->branches) {
+                    collect(branch.body.get(), scope);
+                }
+                collect(ifNode->elseBlock.get(), scope);
+            }
+        }
+
+        static Value::Type binaryType(TokenType type, Value::Type left, Value::Type right) {
+            if (left == UNKNOWN || right == UNKNOWN) {
+                return UNKNOWN;
+            }
+            binop::Op op = binop::opRows[static_cast<size_t>(type)];
+            if (op == binop::NONE) {
+                return ANY;
+            }
+            if (op > binop::POW) {
+                return Value::BOOL;  // 比较要么得到 bool, 要么报错
+            }
+            if (!binop::isNumeric(left) || !binop::isNumeric(right)) {
+                return ANY;
+            }
+            if (left == Value::INT && right == Value::INT && op <= binop::MUL) {
+                return Value::INT;
+            }
+            return Value::FLOAT;
+        }
+
+        static Value::Type convertType(ConvertNode::Kind kind) {
+            switch (kind) {
+                case ConvertNode::INT:   return Value::INT;
+                case ConvertNode::FLOAT: return Value::FLOAT;
+                case ConvertNode::BOOL:  return Value::BOOL;
+                default:                 return Value::STRING;
+            }
+        }
+
+        Value::Type callType(CallNode* call, Scope* scope) {
+            const string& name = call->name;
+            if (isBuiltin(name)) {
+                // 调用点上内置函数优先于同名的变量
+                if (name == "int") {
+                    return Value::INT;
+                } else if (name == "float") {
+                    return Value::FLOAT;
+                } else if (name == "bool") {
+                    return Value::BOOL;
+                } else if (name == "string" || name == "type" || name == "receive") {
+                    return Value::STRING;
+                }
+                return ANY;
+            }
+            if (scope && scope->locals.count(name)) {
+                return ANY;
+            }
+            auto it = functions.find(name);
+            if (it != functions.end() && it->second != Value::EMPTY) {
+                return it->second;  // 返回时已经检查过
+            }
+            return ANY;
+        }
+
+        Value::Type typeOf(ASTNode* node, Scope* scope) {
+            if (auto* number = dynamic_cast<NumberNode*>(node)) {
+                return number->type();
+            } else if (dynamic_cast<StringNode*>(node)) {
+                return Value::STRING;
+            } else if (dynamic_cast<BooleanNode*>(node)) {
+                return Value::BOOL;
+            } else if (auto* var = dynamic_cast<VariableNode*>(node)) {
+                return read(scope, var->name);
+            } else if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                return typeOf(assign->expr.get(), scope);
+            } else if (auto* unary = dynamic_cast<UnaryOpNode*>(node)) {
+                Value::Type operand = typeOf(unary->expr.get(), scope);
+                if (operand == UNKNOWN) {
+                    return UNKNOWN;
+                }
+                if (unary->op.type == TokenType::NOT) {
+                    return Value::BOOL;
+                }
+                return binop::isNumeric(operand) ? operand : ANY;
+            } else if (auto* binop = dynamic_cast<BinOpNode*>(node)) {
+                return binaryType(binop->op.type, typeOf(binop->left.get(), scope), typeOf(binop->right.get(), scope));
+            } else if (auto* call = dynamic_cast<CallNode*>(node)) {
+                return callType(call, scope);
+            } else if (auto* convert = dynamic_cast<ConvertNode*>(node)) {
+                return convertType(convert->kind);
+            }
+            return ANY;
+        }
+
+        // 只有语句 (和 for 的三个部分) 会赋值
+        void scan(ASTNode* node, Scope* scope) {
+            if (!node) {
+                return;
+            }
+            if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                write(scope, assign->varName, typeOf(assign->expr.get(), scope));
+            } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+                write(scope, def->name, ANY);
+                scan(def->body.get(), &scopes[def]);
+            } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                for (auto& stmt : block->statements) {
+                    scan(stmt.get(), scope);
+                }
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                scan(whileNode->body.get(), scope);
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                scan(forNode->init.get(), scope);
+                scan(forNode->condition.get(), scope);
+                scan(forNode->update.get(), scope);
+                scan(forNode->body.get(), scope);
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                write(scope, forIn->varName, ANY);  // 生成器产出的值可以是任何类型
+                scan(forIn->body.get(), scope);
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                for (auto& branch : ifNode->branches) {
+                    scan(branch.body.get(), scope);
+                }
+                scan(ifNode->elseBlock.get(), scope);
+            }
+        }
+
+        template<binop::Op OP>
+        static unique_ptr<ASTNode> intNode(BinOpNode& node) {
+            return make_unique<IntBinOpNode<OP>>(std::move(node.left), node.op, std::move(node.right));
+        }
+
+        // 一定会报错的组合保留原节点, 错误仍在运行时出现
+        unique_ptr<ASTNode> typedBinOp(BinOpNode& node, Scope* scope) {
+            Value::Type left = typeOf(node.left.get(), scope);
+            Value::Type right = typeOf(node.right.get(), scope);
+            binop::Op op = binop::opRows[static_cast<size_t>(node.op.type)];
+            if (!isProven(left) || !isProven(right) || op == binop::NONE) {
+                return nullptr;
+            }
+            if (left == Value::INT && right == Value::INT) {
+                switch (op) {
+                    case binop::ADD: return intNode<binop::ADD>(node);
+                    case binop::SUB: return intNode<binop::SUB>(node);
+                    case binop::MUL: return intNode<binop::MUL>(node);
+                    case binop::EQ:  return intNode<binop::EQ>(node);
+                    case binop::NEQ: return intNode<binop::NEQ>(node);
+                    case binop::GT:  return intNode<binop::GT>(node);
+                    case binop::LT:  return intNode<binop::LT>(node);
+                    case binop::GTE: return intNode<binop::GTE>(node);
+                    case binop::LTE: return intNode<binop::LTE>(node);
+                    default: break;
+                }
+            }
+            binop::Kernel kernel = binop::kernels[(op * binop::TYPE_COUNT + left) * binop::TYPE_COUNT + right];
+            if (!kernel) {
+                return nullptr;
+            }
+            return make_unique<TypedBinOpNode>(std::move(node.left), node.op, std::move(node.right), kernel);
+        }
+
+        void specializeBlock(BlockNode* block, Scope* scope) {
+            if (!block) {
+                return;
+            }
+            for (auto& stmt : block->statements) {
+                specialize(stmt, scope);
+            }
+        }
+
+        template<typename Ptr>
+        void specialize(Ptr& slot, Scope* scope) {
+            ASTNode* node = slot.get();
+            if (!node) {
+                return;
+            }
+            if (auto* binop = dynamic_cast<BinOpNode*>(node)) {
+                specialize(binop->left, scope);
+                specialize(binop->right, scope);
+                if (auto typed = typedBinOp(*binop, scope)) {
+                    slot = std::move(typed);
+                }
+            } else if (auto* unary = dynamic_cast<UnaryOpNode*>(node)) {
+                specialize(unary->expr, scope);
+            } else if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                specialize(assign->expr, scope);
+            } else if (auto* call = dynamic_cast<CallNode*>(node)) {
+                for (auto& arg : call->positionalArguments) {
+                    specialize(arg, scope);
+                }
+                for (auto& [argName, arg] : call->namedArguments) {
+                    specialize(arg, scope);
+                }
+            } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                specializeBlock(block, scope);
+            } else if (auto* ret = dynamic_cast<ReturnNode*>(node)) {
+                specialize(ret->expr, scope);
+            } else if (auto* yieldNode = dynamic_cast<YieldNode*>(node)) {
+                specialize(yieldNode->expr, scope);
+            } else if (auto* convert = dynamic_cast<ConvertNode*>(node)) {
+                // 实参已经是目标类型时转换什么也不做, 直接换成实参
+                auto& arg = convert->call->positionalArguments[0];
+                specialize(arg, scope);
+                if (convert->kind != ConvertNode::TYPE && typeOf(arg.get(), scope) == convertType(convert->kind)) {
+                    auto operand = std::move(arg);
+                    slot = std::move(operand);
+                }
+            } else if (auto* spawn = dynamic_cast<SpawnNode*>(node)) {
+                for (auto& arg : spawn->call->positionalArguments) {
+                    specialize(arg, scope);
+                }
+                for (auto& [argName, arg] : spawn->call->namedArguments) {
+                    specialize(arg, scope);
+                }
+            } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+                Scope* inner = &scopes[def];
+                for (auto& param : def->parameters) {
+                    specialize(param.defaultValue, inner);
+                }
+                specializeBlock(def->body.get(), inner);
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                specialize(whileNode->condition, scope);
+                whileNode->boolCondition = typeOf(whileNode->condition.get(), scope) == Value::BOOL;
+                specializeBlock(whileNode->body.get(), scope);
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                specialize(forNode->init, scope);
+                specialize(forNode->condition, scope);
+                forNode->boolCondition = typeOf(forNode->condition.get(), scope) == Value::BOOL;
+                specialize(forNode->update, scope);
+                specializeBlock(forNode->body.get(), scope);
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                specialize(forIn->iterable, scope);
+                specializeBlock(forIn->body.get(), scope);
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                for (auto& branch : ifNode->branches) {
+                    specialize(branch.condition, scope);
+                    branch.boolCondition = typeOf(branch.condition.get(), scope) == Value::BOOL;
+                    specializeBlock(branch.body.get(), scope);
+                }
+                specializeBlock(ifNode->elseBlock.get(), scope);
+            }
+        }
+
+    public:
+        explicit TypeInference(function<bool(const string&)> isBuiltin)
+            : isBuiltin(std::move(isBuiltin)) {}
+
+        // rewrite 为 false 时只分析, 结果留给运行时的 specializeBody
+        void run(BlockNode& program, bool rewrite = true) {
+            collect(&program, nullptr);
+            for (auto& stmt : program.statements) {
+                auto* def = dynamic_cast<FunctionDefinitionNode*>(stmt.get());
+                if (def && definitions[def->name] == 1 && !assigned.count(def->name) && !isBuiltin(def->name)) {
+                    functions[def->name] = def->returnType;
+                }
+            }
+
+            do {
+                changed = false;
+                scan(&program, nullptr);
+            } while (changed);
+
+            if (rewrite) {
+                specializeBlock(&program, nullptr);
+            }
+        }
+
+        /*
+        #  按一次调用的实参类型特化函数体的副本, 在 run 分析过整个程序之后由解释器调用.
+        #  参数的类型是注解, 没有注解时是这次的实参类型 (没有传入、用默认值的参数是任意类型);
+        #  全局变量的类型沿用整个程序的分析结果. 副本里不能有函数定义
+        */
+        void specializeBody(const vector<Parameter>& parameters, const vector<Value::Type>& argTypes, BlockNode& body) {
+            Scope scope;
+            for (size_t i = 0; i < parameters.size(); i++) {
+                Value::Type type = parameters[i].type;
+                if (type == Value::EMPTY) {
+                    type = argTypes[i] == Value::EMPTY ? ANY : argTypes[i];
+                }
+                scope.locals[parameters[i].name] = type;
+            }
+            collect(&body, &scope);
+            do {
+                changed = false;
+                scan(&body, &scope);
+            } while (changed);
+            specializeBlock(&body, &scope);
+        }
+    };
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef POOL_HPP
+    #define POOL_HPP
+
+    #include <atomic>
+    #include <condition_variable>
+    #include <cstdint>
+    #include <exception>
+    #include <functional>
+    #include <memory>
+    #include <mutex>
+    #include <system_error>
+    #include <thread>
+
+    using namespace std;
+
+    /*
+    #  parallel for 的线程池
+    #
+    #  线程在第一次需要时创建, 之后一直等待下一个任务.
+    #  一个任务把下标 [0, count) 平均分给各参与者, 发起任务的线程是 0 号参与者;
+    #  自己的区间取完后, 从剩余最多的区间偷走后一半. 每个区间一把锁, 任何时候最多持有一把.
+    #  同时只执行一个任务: 池已被占用 (另一个线程正在用, 或在任务里嵌套) 时 run 返回 false,
+    #  由调用方自己按顺序执行
+    */
+    class WorkPool {
+    public:
+        using Task = function<void(size_t participant, size_t index)>;
+
+    private:
+        struct Range {
+            mutex lock;
+            size_t begin = 0;
+            size_t end = 0;
+        };
+
+        mutex jobLock;
+        mutex stateLock;
+        condition_variable wake;
+        condition_variable done;
+        size_t spawned = 0;       // 已创建的工作线程数, 第 k 个线程是 k 号参与者
+        uint64_t generation = 0;  // 每个任务加一, 工作线程据此醒来
+        size_t participants = 0;
+        size_t running = 0;       // 当前任务里还没结束的工作线程数
+        const Task* task = nullptr;
+        unique_ptr<Range[]> ranges;
+
+        atomic<bool> cancelled{false};
+        mutex failureLock;
+        size_t failedIndex = SIZE_MAX;
+        exception_ptr failure;  // 出错的下标里最小的那个的异常
+
+        static bool& insideTask() {
+            static thread_local bool inside = false;
+            return inside;
+        }
+
+        bool steal(size_t self, size_t& index) {
+            while (true) {
+                size_t victim = SIZE_MAX;
+                size_t most = 0;
+                for (size_t p = 0; p < participants; p++) {
+                    if (p == self) {
+                        continue;
+                    }
+                    lock_guard<mutex> guard(ranges[p].lock);
+                    if (ranges[p].end - ranges[p].begin > most) {
+                        most = ranges[p].end - ranges[p].begin;
+                        victim = p;
+                    }
+                }
+                if (victim == SIZE_MAX) {
+                    return false;
+                }
+                size_t begin, end;
+                {
+                    Range& range = ranges[victim];
+                    lock_guard<mutex> guard(range.lock);
+                    if (range.begin >= range.end) {
+                        continue;  // 刚被取完, 重新挑
+                    }
+                    end = range.end;
+                    begin = range.begin + (range.end - range.begin) / 2;
+                    range.end = begin;
+                }
+                Range& own = ranges[self];
+                lock_guard<mutex> guard(own.lock);
+                own.begin = begin + 1;
+                own.end = end;
+                index = begin;
+                return true;
+            }
+        }
+
+        bool take(size_t self, size_t& index) {
+            {
+                Range& own = ranges[self];
+                lock_guard<mutex> guard(own.lock);
+                if (own.begin < own.end) {
+                    index = own.begin++;
+                    return true;
+                }
+            }
+            return steal(self, index);
+        }
+
+        void work(size_t self) {
+            size_t index;
+            while (!cancelled.load(memory_order_relaxed) && take(self, index)) {
+                try {
+                    (*task)(self, index);
+                } catch (...) {
+                    lock_guard<mutex> guard(failureLock);
+                    if (index < failedIndex) {
+                        failedIndex = index;
+                        failure = current_exception();
+                    }
+                    cancelled = true;
+                }
+            }
+        }
+
+        void loop(size_t self, uint64_t seen) {
+            insideTask() = true;
+            while (true) {
+                {
+                    unique_lock<mutex> guard(stateLock);
+                    wake.wait(guard, [&] { return generation != seen; });
+                    seen = generation;
+                    if (self >= participants) {
+                        continue;
+                    }
+                }
+                work(self);
+                lock_guard<mutex> guard(stateLock);
+                if (--running == 0) {
+                    done.notify_all();
+                }
+            }
+        }
+
+        WorkPool() = default;
+
+    public:
+        // 不析构: 进程退出时工作线程可能还在等待任务
+        static WorkPool& instance() {
+            static WorkPool* pool = new WorkPool();
+            return *pool;
+        }
+
+        // 当前线程正在执行某个任务, 这时嵌套的 parallel for 按顺序执行
+        static bool inTask() { return insideTask(); }
+
+        /*
+        #  用最多 wanted 个参与者执行 task(participant, index), index 取遍 [0, count);
+        #  返回 false 表示没有执行, 调用方自己执行. 任务抛出异常时不再分配新的下标,
+        #  等所有参与者停下后重新抛出
+        */
+        bool run(size_t count, size_t wanted, const Task& body) {
+            if (insideTask() || !jobLock.try_lock()) {
+                return false;
+            }
+            lock_guard<mutex> job(jobLock, adopt_lock);
+            wanted = min(wanted, count);
+            {
+                lock_guard<mutex> guard(stateLock);
+                try {
+                    for (; spawned + 1 < wanted; spawned++) {
+                        thread(&WorkPool::loop, this, spawned + 1, generation).detach();
+                    }
+                } catch (const system_error&) {
+                    // 创建不了更多线程时用已有的
+                }
+                participants = min(wanted, spawned + 1);
+                if (participants < 2) {
+                    return false;
+                }
+                ranges = make_unique<Range[]>(participants);
+                for (size_t p = 0; p < participants; p++) {
+                    ranges[p].begin = count * p / participants;
+                    ranges[p].end = count * (p + 1) / participants;
+                }
+                task = &body;
+                running = participants - 1;
+                cancelled = false;
+                failedIndex = SIZE_MAX;
+                failure = nullptr;
+                generation++;
+            }
+            wake.notify_all();
+
+            insideTask() = true;
+            work(0);
+            insideTask() = false;
+            {
+                unique_lock<mutex> guard(stateLock);
+                done.wait(guard, [this] { return running == 0; });
+                task = nullptr;
+            }
+            if (failure) {
+                rethrow_exception(failure);
+            }
+            return true;
+        }
+    };
+
+#endif
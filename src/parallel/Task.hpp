@@ -0,0 +1,404 @@
+#ifndef TASK_HPP
+    #define TASK_HPP
+
+    #include <atomic>
+    #include <condition_variable>
+    #include <deque>
+    #include <exception>
+    #include <memory>
+    #include <mutex>
+    #include <system_error>
+    #include <thread>
+
+    #include "../MiLang.hpp"
+    #include "../interpreter/Interpreter.hpp"
+    #include "Worker.hpp"
+
+    using namespace std;
+
+    /*
+    #  spawn 时复制的全局变量, 建好后只读
+    #
+    #  base 是某一时刻全部全局变量的深拷贝 (连同解释器的设置), changes 是之后被写过的全局变量的副本.
+    #  同一个解释器接连 spawn 时, 只变了少数几个全局变量的新快照沿用 base, 只复制 changes
+    */
+    struct TaskSnapshot {
+        shared_ptr<const Interpreter> base;
+        unordered_map<string, Value> changes;
+    };
+
+    /*
+    #  spawn 的任务在其中执行的解释器, 每个线程按快照各建一个
+    #
+    #  快照在任务里再 spawn 时沿用同一份. 线程从快照复制出自己的全局帧;
+    #  可能给全局变量赋值的函数不交给其他线程 (见 SpawnNode::evaluate), 全局帧在任务里不变.
+    #  join 等待时会在同一线程上嵌套执行别的任务, 正在使用的环境不会被换掉
+    */
+    class TaskEnv {
+    private:
+        static vector<unique_ptr<TaskEnv>>& threadEnvs() {
+            static thread_local vector<unique_ptr<TaskEnv>> envs;
+            return envs;
+        }
+
+        void store(ValueIsolator& isolator, const string& name, const Value& value) {
+            Value copy = isolator.isolate(value);
+            if (copy.type() == Value::FUNCTION) {
+                originals[name] = copy.asFunction();
+            } else {
+                originals.erase(name);
+            }
+            interpreter.getGlobalFrame()->variables.insert_or_assign(name, std::move(copy));
+        }
+
+        /*
+        #  换到同一个 base 上更新的快照: 只复制 changes. 旧快照改过的名字新快照都改过时才能换,
+        #  否则有的名字要回到 base 的值或者删掉, 已经缓存在节点里的全局变量地址会失效
+        */
+        bool advance(const shared_ptr<const TaskSnapshot>& next) {
+            if (next->base != snapshot->base) {
+                return false;
+            }
+            for (const auto& [name, value] : snapshot->changes) {
+                if (!next->changes.count(name)) {
+                    return false;
+                }
+            }
+            ValueIsolator isolator;
+            for (const auto& [name, value] : next->changes) {
+                store(isolator, name, value);
+            }
+            snapshot = next;
+            return true;
+        }
+
+    public:
+        shared_ptr<const TaskSnapshot> snapshot;
+        Interpreter interpreter;
+        unordered_map<string, FunctionTypePtr> originals;  // 从快照复制来的全局函数, 不随任务的赋值改变
+        size_t active = 0;  // 正在这个环境里执行的任务数
+
+        explicit TaskEnv(shared_ptr<const TaskSnapshot> source) : snapshot(std::move(source)) {
+            interpreter.inheritSettings(*snapshot->base);
+            ValueIsolator isolator;
+            for (const auto& [name, value] : snapshot->base->getGlobalFrame()->variables) {
+                if (!snapshot->changes.count(name)) {
+                    store(isolator, name, value);
+                }
+            }
+            for (const auto& [name, value] : snapshot->changes) {
+                store(isolator, name, value);
+            }
+        }
+
+        // 当前线程上执行 snapshot 的任务用的环境; 优先更新不在使用的旧环境, 换不了时重建
+        static TaskEnv& enter(const shared_ptr<const TaskSnapshot>& snapshot) {
+            auto& envs = threadEnvs();
+            for (auto& env : envs) {
+                if (env->snapshot == snapshot) {
+                    env->active++;
+                    return *env;
+                }
+            }
+            for (auto& env : envs) {
+                if (env->active == 0 && env->advance(snapshot)) {
+                    env->active++;
+                    return *env;
+                }
+            }
+            erase_if(envs, [](const unique_ptr<TaskEnv>& env) { return env->active == 0; });
+            envs.push_back(make_unique<TaskEnv>(snapshot));
+            envs.back()->active++;
+            return *envs.back();
+        }
+
+        static void leave(TaskEnv& env) { env.active--; }
+
+        // 当前线程正在执行的任务的环境, 不在任务里时为 nullptr
+        static TaskEnv*& current() {
+            static thread_local TaskEnv* env = nullptr;
+            return env;
+        }
+    };
+
+    /*
+    #  spawn 创建的任务, 同时就是它的 future
+    #
+    #  执行任务的线程 (工作线程, 或者 join 它的线程) 先把状态从 QUEUED 改成 RUNNING,
+    #  所以每个任务只执行一次; 被 join 抢先执行的任务仍留在队列里, 取到时跳过.
+    #  函数和实参在 spawn 时复制, 结果在任务结束时复制, 之后只被读取
+    */
+    class Task : public FutureType {
+    public:
+        enum State : int { QUEUED, RUNNING, DONE };
+
+        shared_ptr<const TaskSnapshot> snapshot;
+        string global;         // 函数是快照里的全局函数时只记名字, 执行的线程用自己环境里的副本
+        FunctionTypePtr func;  // 否则是函数的副本
+        vector<Value> args;    // 按参数的顺序, 未传入的参数为 unbound
+
+        explicit Task(const string& name) : FutureType(name) {}
+
+        /*
+        #  准备在其他线程上执行: 选定快照, 复制函数和实参 (slots 的前几个槽).
+        #  在任务里 spawn 时沿用所在环境的快照, 否则用发起的解释器上次的快照 (见 snapshotOf).
+        #  有不能复制的值 (挂起的生成器) 时返回 false, 由调用方在当前线程执行
+        */
+        bool bind(Interpreter& spawner, const string& callee, FunctionType& target, const vector<Value>& slots) {
+            ValueIsolator isolator;
+            TaskEnv* env = TaskEnv::current();
+            if (env && &env->interpreter == &spawner) {
+                snapshot = env->snapshot;
+                auto it = env->originals.find(callee);
+                if (it != env->originals.end() && it->second.get() == &target) {
+                    global = callee;
+                }
+            } else {
+                snapshot = snapshotOf(spawner, isolator);
+                if (!snapshot) {
+                    return false;
+                }
+                auto it = spawner.getGlobalFrame()->variables.find(callee);
+                if (it != spawner.getGlobalFrame()->variables.end() && it->second.type() == Value::FUNCTION &&
+                    it->second.functionPtr() == &target) {
+                    global = callee;
+                }
+            }
+            if (global.empty()) {
+                func = isolator.cloneFunction(&target);
+            }
+            for (size_t i = 0; i < target.parameters.size(); i++) {
+                args.push_back(isolator.isolate(slots[i]));
+            }
+            return isolator.ok();
+        }
+
+        bool claim() {
+            int expected = QUEUED;
+            return state.compare_exchange_strong(expected, RUNNING, memory_order_acquire);
+        }
+
+        // 在当前线程的任务环境里执行, 定义在 evaluate.hpp
+        void execute();
+
+        void complete(const Value& value) {
+            ValueIsolator isolator;
+            result = isolator.isolate(value);
+            if (!isolator.ok()) {
+                result = Value();
+                error = make_exception_ptr(runtime_error("spawn: " + name + " returned a generator, "
+                                                         "which cannot leave its task"));
+            }
+            finish();
+        }
+
+        // 字节码引擎按顺序执行 spawn, 没有其他线程: 结果不复制, 原样交给 join
+        void completeLocal(Value value) {
+            result = std::move(value);
+            local = true;
+            finish();
+        }
+
+        void fail(exception_ptr failure) {
+            error = std::move(failure);
+            finish();
+        }
+
+        Value join() override;
+
+    private:
+        atomic<int> state{QUEUED};
+        Value result;
+        bool local = false;
+        exception_ptr error;
+
+        /*
+        #  spawner 当前全局变量的快照. 上次的快照之后没有写过全局变量时直接沿用;
+        #  写过的少 (不到全局变量的四分之一) 时沿用 base, 复制上次的 changes 和新写的变量;
+        #  否则复制全部. 有不能复制的值时返回 nullptr
+        */
+        static shared_ptr<const TaskSnapshot> snapshotOf(Interpreter& spawner, ValueIsolator& isolator) {
+            shared_ptr<const TaskSnapshot> last = spawner.cachedSnapshot();
+            const auto& written = spawner.globalsWrittenSince();
+            if (last && written.empty()) {
+                return last;
+            }
+            auto next = make_shared<TaskSnapshot>();
+            if (last && (last->changes.size() + written.size()) * 4 <= last->base->getGlobalFrame()->variables.size()) {
+                next->base = last->base;
+                for (const auto& [name, value] : last->changes) {
+                    next->changes[name] = isolator.isolate(value);
+                }
+                const auto& globals = spawner.getGlobalFrame()->variables;
+                for (const string* name : written) {
+                    next->changes.insert_or_assign(*name, isolator.isolate(globals.at(*name)));
+                }
+            } else {
+                auto base = make_shared<Interpreter>();
+                base->inheritSettings(spawner);
+                Frame* frame = base->getGlobalFrame();
+                for (const auto& [name, value] : spawner.getGlobalFrame()->variables) {
+                    frame->variables[name] = isolator.isolate(value);
+                }
+                next->base = std::move(base);
+            }
+            if (!isolator.ok()) {
+                return nullptr;
+            }
+            spawner.cacheSnapshot(next);
+            return next;
+        }
+
+        void finish() {
+            func.reset();
+            args.clear();
+            snapshot.reset();
+            state.store(DONE, memory_order_release);
+            state.notify_all();
+        }
+    };
+
+    using TaskPtr = Ref<Task>;
+
+    /*
+    #  spawn 的任务池: 每个工作线程一个双端队列, 0 号队列由池外的线程 (主线程、parallel for 的线程) 共用
+    #
+    #  线程把 spawn 的任务压在自己队列的尾部, 也从尾部取, 刚 spawn 的任务用到的数据还在缓存里;
+    #  自己的队列空了就从别的队列头部偷走最早的任务, 分治时那通常是最大的一块.
+    #  工作线程在第一次需要时创建, 连同发起线程不超过 spawn 时的 --threads, 没有任务时睡眠.
+    #  join 在等待期间也执行队列里的任务, 嵌套的 spawn / join 不会让所有线程都卡在等待上
+    */
+    class TaskPool {
+    private:
+        struct Queue {
+            mutex lock;
+            deque<TaskPtr> tasks;
+        };
+
+        Queue queues[MAX_TASK_THREADS + 1];
+        mutex startLock;
+        atomic<size_t> started{0};   // 已创建的工作线程数, 第 k 个线程使用 k 号队列
+        atomic<size_t> queued{0};    // 各队列里的任务总数, 包括已被 join 抢先执行的
+        atomic<size_t> sleeping{0};
+        mutex sleepLock;
+        condition_variable wake;
+
+        static size_t& self() {
+            static thread_local size_t index = 0;
+            return index;
+        }
+
+        TaskPtr take() {
+            size_t own = self();
+            {
+                Queue& queue = queues[own];
+                lock_guard<mutex> guard(queue.lock);
+                if (!queue.tasks.empty()) {
+                    TaskPtr task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                    queued--;
+                    return task;
+                }
+            }
+            size_t count = started.load() + 1;
+            for (size_t k = 1; k < count; k++) {
+                Queue& victim = queues[(own + k) % count];
+                lock_guard<mutex> guard(victim.lock);
+                if (!victim.tasks.empty()) {
+                    TaskPtr task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    queued--;
+                    return task;
+                }
+            }
+            return nullptr;
+        }
+
+        void loop(size_t index) {
+            self() = index;
+            while (true) {
+                if (!runOne()) {
+                    unique_lock<mutex> guard(sleepLock);
+                    sleeping++;
+                    wake.wait(guard, [this] { return queued.load() > 0; });
+                    sleeping--;
+                }
+            }
+        }
+
+        void startWorkers(size_t wanted) {
+            wanted = min(wanted, MAX_TASK_THREADS);
+            if (started.load() >= wanted) {
+                return;
+            }
+            lock_guard<mutex> guard(startLock);
+            try {
+                for (size_t k = started.load(); k < wanted; k++) {
+                    thread(&TaskPool::loop, this, k + 1).detach();
+                    started++;
+                }
+            } catch (const system_error&) {
+                // 创建不了更多线程时用已有的
+            }
+        }
+
+        TaskPool() = default;
+
+    public:
+        // 不析构: 进程退出时工作线程可能还在等待任务
+        static TaskPool& instance() {
+            static TaskPool* pool = new TaskPool();
+            return *pool;
+        }
+
+        // 把任务放进当前线程的队列, 需要时先创建工作线程
+        void submit(TaskPtr task, size_t threads) {
+            startWorkers(threads - 1);
+            {
+                Queue& queue = queues[self()];
+                lock_guard<mutex> guard(queue.lock);
+                queue.tasks.push_back(std::move(task));
+                queued++;
+            }
+            if (sleeping.load() > 0) {
+                lock_guard<mutex> guard(sleepLock);
+                wake.notify_one();
+            }
+        }
+
+        // 当前线程是池里的工作线程
+        static bool onWorker() { return self() != 0; }
+
+        // 取一个任务在当前线程执行; 所有队列都空时返回 false
+        bool runOne() {
+            while (TaskPtr task = take()) {
+                if (task->claim()) {
+                    task->execute();
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    // 还没开始的任务由 join 的线程自己执行; 正在别处执行时先帮忙执行队列里的任务, 没有可做的再睡眠
+    inline Value Task::join() {
+        if (claim()) {
+            execute();
+        }
+        while (state.load(memory_order_acquire) != DONE) {
+            if (!TaskPool::instance().runOne()) {
+                state.wait(RUNNING, memory_order_acquire);
+            }
+        }
+        if (error) {
+            rethrow_exception(error);
+        }
+        if (local) {
+            return result;
+        }
+        ValueIsolator isolator;
+        return isolator.isolate(result);
+    }
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef WORKER_HPP
+    #define WORKER_HPP
+
+    #include "../MiLang.hpp"
+    #include "../interpreter/Interpreter.hpp"
+    #include "../optimizer/Clone.hpp"
+
+    using namespace std;
+
+    /*
+    #  把值复制成只属于另一个线程的副本: 字符串和装箱的浮点数复制,
+    #  函数连同函数体复制, 同一个函数的多个名字共用一个副本; future 和计数器本来就是共享的.
+    #  只读取源值, 不改动它的引用计数, 所以源值可以同时被多个线程复制.
+    #  挂起的生成器属于原来的解释器, 不能复制, 遇到时 ok() 为 false
+    */
+    class ValueIsolator {
+    private:
+        TreeCloner cloner{true};
+        unordered_map<FunctionType*, FunctionTypePtr> functions;
+        bool copyable = true;
+
+    public:
+        FunctionTypePtr cloneFunction(FunctionType* func) {
+            auto it = functions.find(func);
+            if (it != functions.end()) {
+                return it->second;
+            }
+            FunctionTypePtr copy;
+            if (!func->body) {
+                copy = makeRef<FunctionType>(func->name);  // 内置函数
+            } else {
+                vector<Parameter> parameters = func->parameters;
+                for (auto& param : parameters) {
+                    if (param.hasDefault) {
+                        param.defaultValue = cloner.clone(param.defaultValue.get());
+                    }
+                }
+                copy = makeRef<FunctionType>(func->name, parameters, cloner.cloneBlock(func->body.get()));
+                copy->frameSize = func->frameSize;
+                copy->pure = func->pure;
+                copy->generator = func->generator;
+                copy->returnType = func->returnType;
+                copy->jitSource = func->jitSource;  // 编译后只读, 机器码由各线程自己生成
+                copy->specializable = func->specializable;
+            }
+            functions[func] = copy;
+            return copy;
+        }
+
+        Value isolate(const Value& value) {
+            switch (value.type()) {
+                case Value::STRING:   return StringType(value.asString());
+                case Value::FLOAT:    return value.asFloat();
+                case Value::FUNCTION: return cloneFunction(value.functionPtr());
+                case Value::GENERATOR:
+                    copyable = false;
+                    return NullType();
+                default:              return value;
+            }
+        }
+
+        unique_ptr<BlockNode> cloneBlock(const BlockNode* block) { return cloner.cloneBlock(block); }
+
+        bool ok() const { return cloner.ok() && copyable; }
+    };
+
+    /*
+    #  parallel for 在工作线程上的执行环境
+    #
+    #  值的引用计数不是原子的, 语法树节点执行时记录类型反馈, 函数带有调用计数和结果缓存,
+    #  所以每个工作线程有自己的解释器、全局帧和外层帧的深拷贝, 以及循环体和函数体的副本,
+    #  不与其他线程共享可变的状态. 副本由发起线程在任务开始前建好.
+    #  循环体调用的函数可能给全局变量赋值时不用副本, 由发起线程按顺序执行 (见 GlobalWriteAnalysis)
+    */
+    class WorkerContext {
+    private:
+        ValueIsolator isolator;
+
+        Value isolate(const Value& value) { return isolator.isolate(value); }
+
+    public:
+        Interpreter interpreter;
+        unique_ptr<BlockNode> body;
+        Value* counter = nullptr;
+        vector<Value*> reductions;
+        vector<Value> identities;
+
+        /*
+        #  复制 parent 的全局帧和从当前帧 (parallel for 的循环帧) 向外的各层帧;
+        #  循环体或函数体里有无法复制的节点、外层有生成器时返回 false, 由发起线程自己执行
+        */
+        bool build(Interpreter& parent, ParallelForNode& loop, const vector<Value>& parentIdentities) {
+            interpreter.inheritSettings(parent);
+            Frame* global = interpreter.getGlobalFrame();
+            for (const auto& [name, value] : parent.getGlobalFrame()->variables) {
+                global->variables[name] = isolate(value);
+            }
+            vector<Frame*> chain;
+            for (Frame* frame = parent.getCurrentFrame(); frame != parent.getGlobalFrame(); frame = frame->parent) {
+                chain.push_back(frame);
+            }
+            Frame* outer = global;
+            for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+                auto copy = make_unique<Frame>(outer);
+                for (const auto& [name, value] : (*it)->variables) {
+                    copy->variables[name] = isolate(value);
+                }
+                copy->slots.reserve((*it)->slots.size());
+                for (const auto& slot : (*it)->slots) {
+                    copy->slots.push_back(isolate(slot));
+                }
+                outer = copy.get();
+                interpreter.pushFrame(std::move(copy));
+            }
+
+            body = isolator.cloneBlock(loop.body.get());
+            if (!isolator.ok()) {
+                return false;
+            }
+            counter = interpreter.lookup(loop.counter.resolution, loop.counter.name);
+            for (size_t r = 0; r < loop.reductions.size(); r++) {
+                const auto& var = loop.reductions[r].var;
+                reductions.push_back(interpreter.lookup(var.resolution, var.name));
+                identities.push_back(isolate(parentIdentities[r]));
+            }
+            return counter != nullptr;
+        }
+    };
+
+#endif
@@ -1,605 +1,844 @@
-#ifndef PARSER_HPP
-    #define PARSER_HPP
-
-    #include "../MiLang.hpp"
-    #include "../lexer/Lexer.hpp"
-    #include "tokenTools.cpp"
-
-    using namespace std;
-
-    struct UnaryOpNode : ASTNode {
-        Token op;
-        unique_ptr<ASTNode> expr;
-
-        UnaryOpNode(Token op, unique_ptr<ASTNode> expr)
-            : op(op), expr(std::move(expr)) {}
-
-        Value evaluate(Interpreter& interpreter) override {
-            Value val = expr->evaluate(interpreter);
-            InnerMethod& innermethod = interpreter.getInnerMethod();
-
-            if (op.type == TokenType::NOT) {
-                if (holds_alternative<IntType>(val)) {
-                    return get<IntType>(val) == 0;
-                } else if (holds_alternative<FloatType>(val)) {
-                    return get<FloatType>(val) == 0.0;
-                } else if (holds_alternative<BoolType>(val)) {
-                    return !get<BoolType>(val);
-                } else if (holds_alternative<StringType>(val)) {
-                    return get<StringType>(val).empty();
-                }
-                throw runtime_error("Type error: Cannot apply '!' to type " + innermethod.getTypeName(val));
-            }
-            throw runtime_error("Unknown unary operator");
-        }
-    };
-
-    class Parser {
-    private:
-        Lexer& lexer;
-        Token currentToken;
-
-        int precedence(TokenType type) {
-            switch (type) {
-                case TokenType::NOT: return 5;
-                case TokenType::POWER: return 4;
-                case TokenType::PYPOWER: return 4;
-                case TokenType::MULTIPLY:
-                case TokenType::DIVIDE: return 3;
-                case TokenType::PLUS:
-                case TokenType::MINUS: return 2;
-
-                case TokenType::EQ:
-                case TokenType::NEQ:
-                case TokenType::GT:
-                case TokenType::LT:
-                case TokenType::GTE:
-                case TokenType::LTE:
-                case TokenType::NOT_GT:
-                case TokenType::NOT_LT: return 1;
-                default: return 0;
-            }
-        }
-
-        bool isRightAssociative(TokenType type) {
-            if (type == TokenType::POWER) {return true;}
-            if (type == TokenType::PYPOWER) {return true;}
-            return false;
-        }
-
-        void error(const string& message) {
-            throw runtime_error("Parse error (line " + to_string(currentToken.line) + ", current token: " + TokenTypePrint(currentToken.type) + "): " + message);
-        }
-
-        void eat(TokenType type) {
-            if (currentToken.type == type) {
-                currentToken = lexer.getNextToken();
-            } else {
-                error("Expected token type " + TokenTypePrint(type) +
-                     ", got " + TokenTypePrint(currentToken.type));
-                cout <<"Expected token type " + TokenTypePrint(type) +
-                      ", got " + TokenTypePrint(currentToken.type) << endl;
-            }
-        }
-
-        unique_ptr<ASTNode> parseFactor() {
-            Token token = currentToken;
-
-            switch (token.type) {
-                case TokenType::INTEGER: {
-                    IntType value = stoi(token.value);
-                    eat(TokenType::INTEGER);
-                    if (currentToken.type == TokenType::LPAREN) {
-                        error("Missing multiplication operator; use " + token.value + " * (...) instead");
-                    }
-                    return make_unique<NumberNode>(value);
-                }
-
-                case TokenType::FLOAT: {
-                    FloatType value = stof(token.value);
-                    eat(TokenType::FLOAT);
-                    if (currentToken.type == TokenType::LPAREN) {
-                        error("Missing multiplication operator; use " + token.value + " * (...) instead");
-                    }
-                    return make_unique<NumberNode>(value);
-                }
-                case TokenType::STRING: {
-                    StringType value = token.value;
-                    eat(TokenType::STRING);
-                    return make_unique<StringNode>(value);
-                }
-                case TokenType::BOOLEAN: {
-                    BoolType value = (token.value == "true");
-                    eat(TokenType::BOOLEAN);
-                    return make_unique<BooleanNode>(value);
-                }
-                case TokenType::NULL_TYPE: {
-                    eat(TokenType::NULL_TYPE);
-                    return make_unique<NullNode>();
-                }
-                case TokenType::NOT: {
-                    eat(TokenType::NOT);
-                    auto expr = parseFactor();
-                    return make_unique<UnaryOpNode>(
-                        Token(TokenType::NOT, "!", token.line),
-                        std::move(expr)
-                    );
-
-                }
-
-                case TokenType::IDENTIFIER: {
-                    std::string id = token.value;
-                    eat(TokenType::IDENTIFIER);
-
-                    if (currentToken.type == TokenType::LPAREN) {
-                        eat(TokenType::LPAREN);
-                        vector<unique_ptr<ASTNode>> positionalArgs;
-                        std::unordered_map<std::string, std::unique_ptr<ASTNode>> namedArgs;
-                        bool hasNamedArgs = false;
-
-                        if (currentToken.type != TokenType::RPAREN) {
-                            
-                            if (currentToken.type == TokenType::IDENTIFIER) {
-                                
-                                Token nextToken = lexer.peekNextToken();
-
-                                
-                                if (nextToken.type == TokenType::ASSIGN) {
-                                    hasNamedArgs = true;
-                                    std::string paramName = currentToken.value;
-                                    eat(TokenType::IDENTIFIER);
-                                    eat(TokenType::ASSIGN);
-                                    auto expr = parseExpression();
-                                    namedArgs[paramName] = std::move(expr);
-                                } else {
-                                    
-                                    positionalArgs.push_back(parseExpression());
-                                }
-                            } else {
-                                
-                                positionalArgs.push_back(parseExpression());
-                            }
-
-                            
-                            while (currentToken.type == TokenType::COMMA) {
-                                eat(TokenType::COMMA);
-
-                                if (currentToken.type == TokenType::IDENTIFIER) {
-                                    
-                                    Token nextToken = lexer.peekNextToken();
-
-                                    
-                                    if (nextToken.type == TokenType::ASSIGN) {
-                                        hasNamedArgs = true;
-                                        std::string paramName = currentToken.value;
-                                        eat(TokenType::IDENTIFIER);
-                                        eat(TokenType::ASSIGN);
-                                        auto expr = parseExpression();
-                                        namedArgs[paramName] = std::move(expr);
-                                    } else {
-                                        if (hasNamedArgs) {
-                                            error("Positional argument cannot follow named argument");
-                                        }
-                                        positionalArgs.push_back(parseExpression());
-                                    }
-                                } else {
-                                    
-                                    if (hasNamedArgs) {
-                                        error("Positional argument cannot follow named argument");
-                                    }
-                                    positionalArgs.push_back(parseExpression());
-                                }
-                            }
-                        }
-
-                        eat(TokenType::RPAREN);
-
-                        if (hasNamedArgs) {
-                            return make_unique<CallNode>(id, std::move(positionalArgs), std::move(namedArgs));
-                        } else {
-                            return make_unique<CallNode>(id, std::move(positionalArgs));
-                        }
-                    } else {
-                        if (currentToken.type == TokenType::LPAREN) {
-                            error("Missing multiplication operator; use " + id + " * (...) instead");
-                        }
-                        return make_unique<VariableNode>(id);
-                    }
-                }
-                case TokenType::LPAREN: {
-                    eat(TokenType::LPAREN);
-                    auto expr = parseExpression();
-                    eat(TokenType::RPAREN);
-                    return expr;
-                }
-                case TokenType::MINUS: {
-                    eat(TokenType::MINUS);
-                    auto factor = parseFactor();
-                    return make_unique<BinOpNode>(
-                        make_unique<NumberNode>(static_cast<IntType>(0)),
-                        Token(TokenType::MINUS, "-", token.line),
-                        std::move(factor)
-                    );
-                }
-
-                default:
-                    error("Invalid token at start of expression");
-                    return nullptr;
-            }
-        }
-
-        unique_ptr<ASTNode> parseExpression() {
-            vector<unique_ptr<ASTNode>> output;
-            vector<Token> opStack;
-
-            output.push_back(parseFactor());
-
-            while (true) {
-                TokenType currentType = currentToken.type;
-                if (!(currentType == TokenType::PLUS ||
-                      currentType == TokenType::MINUS ||
-                      currentType == TokenType::MULTIPLY ||
-                      currentType == TokenType::DIVIDE ||
-                      currentType == TokenType::POWER ||
-                      currentType == TokenType::PYPOWER ||
-                      currentType == TokenType::EQ ||
-                      currentType == TokenType::NEQ ||
-                      currentType == TokenType::GT ||
-                      currentType == TokenType::LT ||
-                      currentType == TokenType::GTE ||
-                      currentType == TokenType::LTE ||
-                      currentType == TokenType::NOT_GT ||
-                      currentType == TokenType::NOT_LT)) {
-                    break;
-                }
-
-                Token currentOp = currentToken;
-
-                while (!opStack.empty()) {
-                    Token topOp = opStack.back();
-
-                    if (
-                        (!isRightAssociative(currentOp.type) &&
-                         precedence(currentOp.type) <= precedence(topOp.type)) ||
-                        (isRightAssociative(currentOp.type) &&
-                         precedence(currentOp.type) < precedence(topOp.type))) {
-
-                        opStack.pop_back();
-
-                        auto right = std::move(output.back());
-                        output.pop_back();
-                        auto left = std::move(output.back());
-                        output.pop_back();
-
-                        output.push_back(make_unique<BinOpNode>(std::move(left), topOp, std::move(right)));
-                    } else {
-                        break;
-                    }
-                }
-
-                opStack.push_back(currentOp);
-                eat(currentOp.type);
-                output.push_back(parseFactor());
-            }
-
-            while (!opStack.empty()) {
-                Token op = opStack.back();
-                opStack.pop_back();
-
-                auto right = std::move(output.back());
-                output.pop_back();
-                auto left = std::move(output.back());
-                output.pop_back();
-
-                output.push_back(make_unique<BinOpNode>(std::move(left), op, std::move(right)));
-            }
-
-            if (output.size() != 1) {
-                error("Malformed expression");
-            }
-
-            return std::move(output[0]);
-        }
-
-        unique_ptr<ASTNode> parseAssignment() {
-            std::string varName = currentToken.value;
-            eat(TokenType::IDENTIFIER);
-            eat(TokenType::ASSIGN);
-            auto expr = parseExpression();
-            return make_unique<AssignNode>(varName, std::move(expr));
-        }
-        
-        unique_ptr<BlockNode> parseBlock() {
-            vector<unique_ptr<ASTNode>> statements;
-
-            while (currentToken.type != TokenType::DEDENT &&
-                   currentToken.type != TokenType::EOF_TOKEN) {
-
-                statements.push_back(parseStatement());
-            }
-
-            if (currentToken.type == TokenType::DEDENT) {
-                eat(TokenType::DEDENT);
-            }
-
-            return make_unique<BlockNode>(std::move(statements));
-        }
-
-        unique_ptr<WhileNode> parseWhileStatement() {
-            int line = currentToken.line;
-            eat(TokenType::WHILE);
-
-            unique_ptr<ASTNode> condition = parseExpression();
-
-            eat(TokenType::COLON);
-
-
-            if (currentToken.type != TokenType::INDENT) {
-                error("Expected indentation after 'while' statement");
-            }
-            eat(TokenType::INDENT);
-
-
-            auto body = parseBlock();
-
-            return make_unique<WhileNode>(std::move(condition), std::move(body), line);
-        }
-
-        unique_ptr<ASTNode> parseExpressionOrAssignment() {
-            if (currentToken.type == TokenType::IDENTIFIER) {
-                size_t pos = lexer.getPos();
-                char currentChar = lexer.getCurrentChar();
-                int currentLine = currentToken.line;
-
-                Token nextToken = lexer.getNextToken();
-                bool isAssignment = (nextToken.type == TokenType::ASSIGN);
-
-                lexer.setPos(pos);
-                lexer.setCurrentChar(currentChar);
-                currentToken = Token(TokenType::IDENTIFIER, currentToken.value, currentLine);
-
-                if (isAssignment) {
-                    return parseAssignment();
-                }
-            }
-            return parseExpression();
-        }
-
-
-        unique_ptr<ForNode> parseForStatement() {
-            int line = currentToken.line;
-            eat(TokenType::FOR);
-
-            eat(TokenType::LPAREN);
-
-
-            unique_ptr<ASTNode> init;
-            if (currentToken.type != TokenType::SEMICOLON) {
-                init = parseExpressionOrAssignment();
-            }
-            eat(TokenType::SEMICOLON);
-
-
-            unique_ptr<ASTNode> condition;
-            if (currentToken.type != TokenType::SEMICOLON) {
-                condition = parseExpressionOrAssignment();
-            } else {
-
-                condition = make_unique<BooleanNode>(true);
-            }
-            eat(TokenType::SEMICOLON);
-
-
-            unique_ptr<ASTNode> update;
-            if (currentToken.type != TokenType::RPAREN) {
-                update = parseExpressionOrAssignment();
-            }
-            eat(TokenType::RPAREN);
-
-            eat(TokenType::COLON);
-
-
-            if (currentToken.type != TokenType::INDENT) {
-                error("Expected indentation after 'for' statement");
-            }
-            eat(TokenType::INDENT);
-
-
-            auto body = parseBlock();
-
-            return make_unique<ForNode>(std::move(init), std::move(condition),
-                                       std::move(update), std::move(body), line);
-        }
-
-        unique_ptr<IfNode> parseIfStatement() {
-            vector<IfNode::Branch> branches;
-
-
-            eat(TokenType::IF);
-            auto condition = parseExpression();
-            eat(TokenType::COLON);
-
-
-            if (currentToken.type != TokenType::INDENT) {
-                error("Expected indentation after 'if' statement");
-            }
-            eat(TokenType::INDENT);
-
-            auto ifBody = parseBlock();
-            branches.push_back({std::move(condition), std::move(ifBody)});
-
-
-            while (currentToken.type == TokenType::ELIF) {
-                eat(TokenType::ELIF);
-                auto elifCondition = parseExpression();
-                eat(TokenType::COLON);
-
-                if (currentToken.type != TokenType::INDENT) {
-                    error("Expected indentation after 'elif' statement");
-                }
-                eat(TokenType::INDENT);
-
-                auto elifBody = parseBlock();
-                branches.push_back({std::move(elifCondition), std::move(elifBody)});
-            }
-
-
-            unique_ptr<BlockNode> elseBlock = nullptr;
-            if (currentToken.type == TokenType::ELSE) {
-                eat(TokenType::ELSE);
-                eat(TokenType::COLON);
-
-                if (currentToken.type != TokenType::INDENT) {
-                    error("Expected indentation after 'else' statement");
-                }
-                eat(TokenType::INDENT);
-
-                elseBlock = parseBlock();
-            }
-
-            return make_unique<IfNode>(std::move(branches), std::move(elseBlock));
-        }
-
-
-
-        unique_ptr<ASTNode> parseFunctionDefinition() {
-            eat(TokenType::DEF);
-
-
-            std::string name = currentToken.value;
-            eat(TokenType::IDENTIFIER);
-
-
-            eat(TokenType::LPAREN);
-            std::vector<Parameter> parameters;
-
-            if (currentToken.type != TokenType::RPAREN) {
-
-                std::string paramName = currentToken.value;
-                eat(TokenType::IDENTIFIER);
-
-
-                std::unique_ptr<ASTNode> defaultValue = nullptr;
-                if (currentToken.type == TokenType::ASSIGN) {
-                    eat(TokenType::ASSIGN);
-                    defaultValue = parseExpression();
-                    parameters.emplace_back(paramName, std::move(defaultValue));
-                } else {
-                    parameters.emplace_back(paramName);
-                }
-
-
-                while (currentToken.type == TokenType::COMMA) {
-                    eat(TokenType::COMMA);
-
-                    paramName = currentToken.value;
-                    eat(TokenType::IDENTIFIER);
-
-
-                    defaultValue = nullptr;
-                    if (currentToken.type == TokenType::ASSIGN) {
-                        eat(TokenType::ASSIGN);
-                        defaultValue = parseExpression();
-                        parameters.emplace_back(paramName, std::move(defaultValue));
-                    } else {
-                        parameters.emplace_back(paramName);
-                    }
-                }
-            }
-            eat(TokenType::RPAREN);
-
-
-            eat(TokenType::COLON);
-
-            if (currentToken.type != TokenType::INDENT) {
-                error("Expected indentation after function definition");
-            }
-            eat(TokenType::INDENT);
-
-            auto body = parseBlock();
-
-            return make_unique<FunctionDefinitionNode>(name, parameters, std::move(body));
-        }
-
-        unique_ptr<ASTNode> parseReturnStatement() {
-            int line = currentToken.line;
-            eat(TokenType::RETURN);
-
-            auto expr = parseExpression();
-            return make_unique<ReturnNode>(std::move(expr), line);
-        }
-
-        unique_ptr<ASTNode> parseStatement() {
-            switch (currentToken.type) {
-                case TokenType::IDENTIFIER: {
-                    std::string varName = currentToken.value;
-
-                    size_t pos = lexer.getPos();
-                    char currentChar = lexer.getCurrentChar();
-                    int currentLine = currentToken.line;
-
-                    Token nextToken = lexer.getNextToken();
-                    bool isAssignment = (nextToken.type == TokenType::ASSIGN);
-
-                    lexer.setPos(pos);
-                    lexer.setCurrentChar(currentChar);
-                    currentToken = Token(TokenType::IDENTIFIER, varName, currentLine);
-
-                    if (isAssignment) {
-                        return parseAssignment();
-                    } else {
-                        return parseExpression();
-                    }
-                }
-                case TokenType::DEF: {
-                    return parseFunctionDefinition();
-                }
-                case TokenType::RETURN: {
-                    return parseReturnStatement();
-                }
-                case TokenType::WHILE: {
-                    return parseWhileStatement();
-                }
-                case TokenType::FOR: {
-                    return parseForStatement();
-                }
-                case TokenType::IF: {
-                    return parseIfStatement();
-                }
-                case TokenType::BREAK: {
-                    int line = currentToken.line;
-                    eat(TokenType::BREAK);
-                    return make_unique<BreakNode>(line);
-                }
-                case TokenType::CONTINUE: {
-                    int line = currentToken.line;
-                    eat(TokenType::CONTINUE);
-                    return make_unique<ContinueNode>(line);
-                }
-
-                default:
-                    return parseExpression();
-            }
-        }
-
-    public:
-        Parser(Lexer& lexer) : lexer(lexer), currentToken(lexer.getNextToken()) {}
-
-        unique_ptr<BlockNode> parseProgram() {
-            vector<unique_ptr<ASTNode>> statements;
-
-            while (currentToken.type != TokenType::EOF_TOKEN) {
-                if (currentToken.type == TokenType::INDENT) {
-                    error("Unexpected indentation");
-                } else if (currentToken.type == TokenType::DEDENT) {
-                    error("Unexpected dedentation");
-                } else {
-                    statements.push_back(parseStatement());
-                }
-            }
-
-            return make_unique<BlockNode>(std::move(statements));
-        }
-    };
-
+#ifndef PARSER_HPP
+    #define PARSER_HPP
+
+    #include "../MiLang.hpp"
+    #include "../lexer/Lexer.hpp"
+    #include "../binop/Kernels.hpp"
+    #include "tokenTools.cpp"
+    #include <unordered_set>
+
+    using namespace std;
+
+    struct UnaryOpNode : ASTNode {
+        Token op;
+        unique_ptr<ASTNode> expr;
+
+        UnaryOpNode(Token op, unique_ptr<ASTNode> expr)
+            : op(op), expr(std::move(expr)) {}
+
+        Value evaluate(Interpreter& interpreter) override {
+            return apply(op.type, expr->evaluate(interpreter), interpreter.getInnerMethod());
+        }
+
+        // 优化器折叠常量时也用这里的规则
+        static Value apply(TokenType type, const Value& val, InnerMethod& innermethod) {
+            return binop::unary(type, val, innermethod);
+        }
+    };
+
+    class Parser {
+    private:
+        Lexer& lexer;
+        Token currentToken;
+        bool inFunction = false;  // 正在解析函数体, 只有这时允许 yield
+        bool yielded = false;     // 当前函数体里出现过 yield
+
+        int precedence(TokenType type) {
+            switch (type) {
+                case TokenType::NOT: return 5;
+                case TokenType::POWER: return 4;
+                case TokenType::PYPOWER: return 4;
+                case TokenType::MULTIPLY:
+                case TokenType::DIVIDE: return 3;
+                case TokenType::PLUS:
+                case TokenType::MINUS: return 2;
+
+                case TokenType::EQ:
+                case TokenType::NEQ:
+                case TokenType::GT:
+                case TokenType::LT:
+                case TokenType::GTE:
+                case TokenType::LTE:
+                case TokenType::NOT_GT:
+                case TokenType::NOT_LT: return 1;
+                default: return 0;
+            }
+        }
+
+        bool isRightAssociative(TokenType type) {
+            if (type == TokenType::POWER) {return true;}
+            if (type == TokenType::PYPOWER) {return true;}
+            return false;
+        }
+
+        void error(const string& message) {
+            throw runtime_error("Parse error (line " + to_string(currentToken.line) + ", current token: " + TokenTypePrint(currentToken.type) + "): " + message);
+        }
+
+        void eat(TokenType type) {
+            if (currentToken.type == type) {
+                currentToken = lexer.getNextToken();
+            } else {
+                error("Expected token type " + TokenTypePrint(type) +
+                     ", got " + TokenTypePrint(currentToken.type));
+                cout <<"Expected token type " + TokenTypePrint(type) +
+                      ", got " + TokenTypePrint(currentToken.type) << endl;
+            }
+        }
+
+        unique_ptr<ASTNode> parseFactor() {
+            Token token = currentToken;
+
+            switch (token.type) {
+                case TokenType::INTEGER: {
+                    IntType value = stoi(token.value);
+                    eat(TokenType::INTEGER);
+                    if (currentToken.type == TokenType::LPAREN) {
+                        error("Missing multiplication operator; use " + token.value + " * (...) instead");
+                    }
+                    return make_unique<NumberNode>(value);
+                }
+
+                case TokenType::FLOAT: {
+                    FloatType value = stringToFloat(token.value);
+                    eat(TokenType::FLOAT);
+                    if (currentToken.type == TokenType::LPAREN) {
+                        error("Missing multiplication operator; use " + token.value + " * (...) instead");
+                    }
+                    return make_unique<NumberNode>(value);
+                }
+                case TokenType::STRING: {
+                    StringType value = token.value;
+                    eat(TokenType::STRING);
+                    return make_unique<StringNode>(value);
+                }
+                case TokenType::BOOLEAN: {
+                    BoolType value = (token.value == "true");
+                    eat(TokenType::BOOLEAN);
+                    return make_unique<BooleanNode>(value);
+                }
+                case TokenType::NULL_TYPE: {
+                    eat(TokenType::NULL_TYPE);
+                    return make_unique<NullNode>();
+                }
+                case TokenType::NOT: {
+                    eat(TokenType::NOT);
+                    auto expr = parseFactor();
+                    return make_unique<UnaryOpNode>(
+                        Token(TokenType::NOT, "!", token.line),
+                        std::move(expr)
+                    );
+
+                }
+
+                case TokenType::IDENTIFIER: {
+                    std::string id = token.value;
+                    eat(TokenType::IDENTIFIER);
+
+                    // spawn 与 parallel 一样只在这个位置是关键字, 其余地方仍可作变量名
+                    if (id == "spawn" && currentToken.type == TokenType::IDENTIFIER) {
+                        auto target = parseFactor();
+                        if (!dynamic_cast<CallNode*>(target.get())) {
+                            error("spawn expects a function call");
+                        }
+                        unique_ptr<CallNode> call(static_cast<CallNode*>(target.release()));
+                        return make_unique<SpawnNode>(std::move(call), token.line);
+                    }
+
+                    if (currentToken.type == TokenType::LPAREN) {
+                        eat(TokenType::LPAREN);
+                        vector<unique_ptr<ASTNode>> positionalArgs;
+                        NamedArguments namedArgs;
+                        bool hasNamedArgs = false;
+                        // 同名的命名实参后一个覆盖前一个, 位置保持第一次出现的地方
+                        auto addNamed = [&namedArgs](const std::string& paramName, unique_ptr<ASTNode> expr) {
+                            for (auto& namedArg : namedArgs) {
+                                if (namedArg.first == paramName) {
+                                    namedArg.second = std::move(expr);
+                                    return;
+                                }
+                            }
+                            namedArgs.emplace_back(paramName, std::move(expr));
+                        };
+
+                        if (currentToken.type != TokenType::RPAREN) {
+                            
+                            if (currentToken.type == TokenType::IDENTIFIER) {
+                                
+                                Token nextToken = lexer.peekNextToken();
+
+                                
+                                if (nextToken.type == TokenType::ASSIGN) {
+                                    hasNamedArgs = true;
+                                    std::string paramName = currentToken.value;
+                                    eat(TokenType::IDENTIFIER);
+                                    eat(TokenType::ASSIGN);
+                                    auto expr = parseExpression();
+                                    addNamed(paramName, std::move(expr));
+                                } else {
+                                    
+                                    positionalArgs.push_back(parseExpression());
+                                }
+                            } else {
+                                
+                                positionalArgs.push_back(parseExpression());
+                            }
+
+                            
+                            while (currentToken.type == TokenType::COMMA) {
+                                eat(TokenType::COMMA);
+
+                                if (currentToken.type == TokenType::IDENTIFIER) {
+                                    
+                                    Token nextToken = lexer.peekNextToken();
+
+                                    
+                                    if (nextToken.type == TokenType::ASSIGN) {
+                                        hasNamedArgs = true;
+                                        std::string paramName = currentToken.value;
+                                        eat(TokenType::IDENTIFIER);
+                                        eat(TokenType::ASSIGN);
+                                        auto expr = parseExpression();
+                                        addNamed(paramName, std::move(expr));
+                                    } else {
+                                        if (hasNamedArgs) {
+                                            error("Positional argument cannot follow named argument");
+                                        }
+                                        positionalArgs.push_back(parseExpression());
+                                    }
+                                } else {
+                                    
+                                    if (hasNamedArgs) {
+                                        error("Positional argument cannot follow named argument");
+                                    }
+                                    positionalArgs.push_back(parseExpression());
+                                }
+                            }
+                        }
+
+                        eat(TokenType::RPAREN);
+
+                        unique_ptr<CallNode> call;
+                        if (hasNamedArgs) {
+                            call = make_unique<CallNode>(id, std::move(positionalArgs), std::move(namedArgs));
+                        } else {
+                            call = make_unique<CallNode>(id, std::move(positionalArgs));
+                        }
+                        call->line = token.line;
+                        return call;
+                    } else {
+                        if (currentToken.type == TokenType::LPAREN) {
+                            error("Missing multiplication operator; use " + id + " * (...) instead");
+                        }
+                        auto var = make_unique<VariableNode>(id);
+                        var->line = token.line;
+                        return var;
+                    }
+                }
+                case TokenType::LPAREN: {
+                    eat(TokenType::LPAREN);
+                    auto expr = parseExpression();
+                    eat(TokenType::RPAREN);
+                    return expr;
+                }
+                case TokenType::MINUS: {
+                    eat(TokenType::MINUS);
+                    auto factor = parseFactor();
+                    return make_unique<BinOpNode>(
+                        make_unique<NumberNode>(static_cast<IntType>(0)),
+                        Token(TokenType::MINUS, "-", token.line),
+                        std::move(factor)
+                    );
+                }
+
+                default:
+                    error("Invalid token at start of expression");
+                    return nullptr;
+            }
+        }
+
+        unique_ptr<ASTNode> parseExpression() {
+            vector<unique_ptr<ASTNode>> output;
+            vector<Token> opStack;
+
+            output.push_back(parseFactor());
+
+            while (true) {
+                TokenType currentType = currentToken.type;
+                if (!(currentType == TokenType::PLUS ||
+                      currentType == TokenType::MINUS ||
+                      currentType == TokenType::MULTIPLY ||
+                      currentType == TokenType::DIVIDE ||
+                      currentType == TokenType::POWER ||
+                      currentType == TokenType::PYPOWER ||
+                      currentType == TokenType::EQ ||
+                      currentType == TokenType::NEQ ||
+                      currentType == TokenType::GT ||
+                      currentType == TokenType::LT ||
+                      currentType == TokenType::GTE ||
+                      currentType == TokenType::LTE ||
+                      currentType == TokenType::NOT_GT ||
+                      currentType == TokenType::NOT_LT)) {
+                    break;
+                }
+
+                Token currentOp = currentToken;
+
+                while (!opStack.empty()) {
+                    Token topOp = opStack.back();
+
+                    if (
+                        (!isRightAssociative(currentOp.type) &&
+                         precedence(currentOp.type) <= precedence(topOp.type)) ||
+                        (isRightAssociative(currentOp.type) &&
+                         precedence(currentOp.type) < precedence(topOp.type))) {
+
+                        opStack.pop_back();
+
+                        auto right = std::move(output.back());
+                        output.pop_back();
+                        auto left = std::move(output.back());
+                        output.pop_back();
+
+                        output.push_back(make_unique<BinOpNode>(std::move(left), topOp, std::move(right)));
+                    } else {
+                        break;
+                    }
+                }
+
+                opStack.push_back(currentOp);
+                eat(currentOp.type);
+                output.push_back(parseFactor());
+            }
+
+            while (!opStack.empty()) {
+                Token op = opStack.back();
+                opStack.pop_back();
+
+                auto right = std::move(output.back());
+                output.pop_back();
+                auto left = std::move(output.back());
+                output.pop_back();
+
+                output.push_back(make_unique<BinOpNode>(std::move(left), op, std::move(right)));
+            }
+
+            if (output.size() != 1) {
+                error("Malformed expression");
+            }
+
+            return std::move(output[0]);
+        }
+
+        unique_ptr<ASTNode> parseAssignment() {
+            std::string varName = currentToken.value;
+            eat(TokenType::IDENTIFIER);
+            eat(TokenType::ASSIGN);
+            auto expr = parseExpression();
+            return make_unique<AssignNode>(varName, std::move(expr));
+        }
+        
+        unique_ptr<BlockNode> parseBlock() {
+            vector<unique_ptr<ASTNode>> statements;
+
+            while (currentToken.type != TokenType::DEDENT &&
+                   currentToken.type != TokenType::EOF_TOKEN) {
+
+                statements.push_back(parseStatement());
+            }
+
+            if (currentToken.type == TokenType::DEDENT) {
+                eat(TokenType::DEDENT);
+            }
+
+            auto block = make_unique<BlockNode>(std::move(statements));
+            for (const auto& stmt : block->statements) {
+                block->yields = block->yields || yields(stmt.get());
+            }
+            return block;
+        }
+
+        unique_ptr<WhileNode> parseWhileStatement() {
+            int line = currentToken.line;
+            eat(TokenType::WHILE);
+
+            unique_ptr<ASTNode> condition = parseExpression();
+
+            eat(TokenType::COLON);
+
+
+            if (currentToken.type != TokenType::INDENT) {
+                error("Expected indentation after 'while' statement");
+            }
+            eat(TokenType::INDENT);
+
+
+            auto body = parseBlock();
+
+            return make_unique<WhileNode>(std::move(condition), std::move(body), line);
+        }
+
+        unique_ptr<ASTNode> parseExpressionOrAssignment() {
+            if (currentToken.type == TokenType::IDENTIFIER) {
+                size_t pos = lexer.getPos();
+                char currentChar = lexer.getCurrentChar();
+                int currentLine = currentToken.line;
+
+                Token nextToken = lexer.getNextToken();
+                bool isAssignment = (nextToken.type == TokenType::ASSIGN);
+
+                lexer.setPos(pos);
+                lexer.setCurrentChar(currentChar);
+                currentToken = Token(TokenType::IDENTIFIER, currentToken.value, currentLine);
+
+                if (isAssignment) {
+                    return parseAssignment();
+                }
+            }
+            return parseExpression();
+        }
+
+
+        unique_ptr<ASTNode> parseForStatement(bool parallel = false) {
+            int line = currentToken.line;
+            eat(TokenType::FOR);
+
+            eat(TokenType::LPAREN);
+
+            // for (x in gen): 变量名后面紧跟 in
+            if (!parallel && currentToken.type == TokenType::IDENTIFIER) {
+                Token nextToken = lexer.peekNextToken();
+                if (nextToken.type == TokenType::IDENTIFIER && nextToken.value == "in") {
+                    return parseForInStatement(line);
+                }
+            }
+
+
+            unique_ptr<ASTNode> init;
+            if (currentToken.type != TokenType::SEMICOLON) {
+                init = parseExpressionOrAssignment();
+            }
+            eat(TokenType::SEMICOLON);
+
+
+            unique_ptr<ASTNode> condition;
+            if (currentToken.type != TokenType::SEMICOLON) {
+                condition = parseExpressionOrAssignment();
+            } else {
+
+                condition = make_unique<BooleanNode>(true);
+            }
+            eat(TokenType::SEMICOLON);
+
+
+            unique_ptr<ASTNode> update;
+            if (currentToken.type != TokenType::RPAREN) {
+                update = parseExpressionOrAssignment();
+            }
+            eat(TokenType::RPAREN);
+
+            vector<ParallelForNode::Reduction> reductions;
+            if (parallel && currentToken.type == TokenType::IDENTIFIER && currentToken.value == "reduce") {
+                reductions = parseReductions();
+            }
+
+            eat(TokenType::COLON);
+
+
+            if (currentToken.type != TokenType::INDENT) {
+                error("Expected indentation after 'for' statement");
+            }
+            eat(TokenType::INDENT);
+
+
+            auto body = parseBlock();
+
+            if (!parallel) {
+                return make_unique<ForNode>(std::move(init), std::move(condition),
+                                           std::move(update), std::move(body), line);
+            }
+            auto node = make_unique<ParallelForNode>(std::move(init), std::move(condition),
+                                                     std::move(update), std::move(body), line);
+            node->reductions = std::move(reductions);
+            checkParallelFor(*node);
+            return node;
+        }
+
+        unique_ptr<ForInNode> parseForInStatement(int line) {
+            std::string varName = currentToken.value;
+            eat(TokenType::IDENTIFIER);
+            eat(TokenType::IDENTIFIER);  // in
+            auto iterable = parseExpression();
+            eat(TokenType::RPAREN);
+            eat(TokenType::COLON);
+
+            if (currentToken.type != TokenType::INDENT) {
+                error("Expected indentation after 'for' statement");
+            }
+            eat(TokenType::INDENT);
+
+            auto body = parseBlock();
+            return make_unique<ForInNode>(varName, std::move(iterable), std::move(body), line);
+        }
+
+        // reduce(+: total, *: product, min: low, max: high)
+        vector<ParallelForNode::Reduction> parseReductions() {
+            vector<ParallelForNode::Reduction> reductions;
+            eat(TokenType::IDENTIFIER);
+            eat(TokenType::LPAREN);
+            while (true) {
+                ParallelForNode::Reduce op = ParallelForNode::Reduce::ADD;
+                if (currentToken.type == TokenType::PLUS) {
+                    op = ParallelForNode::Reduce::ADD;
+                } else if (currentToken.type == TokenType::MULTIPLY) {
+                    op = ParallelForNode::Reduce::MUL;
+                } else if (currentToken.type == TokenType::IDENTIFIER && currentToken.value == "min") {
+                    op = ParallelForNode::Reduce::MIN;
+                } else if (currentToken.type == TokenType::IDENTIFIER && currentToken.value == "max") {
+                    op = ParallelForNode::Reduce::MAX;
+                } else {
+                    error("Expected reduction operator (+, *, min or max)");
+                }
+                eat(currentToken.type);
+                eat(TokenType::COLON);
+                if (currentToken.type != TokenType::IDENTIFIER) {
+                    error("Expected variable name in reduce(...)");
+                }
+                reductions.push_back({op, {currentToken.value, {}}});
+                eat(TokenType::IDENTIFIER);
+                if (currentToken.type != TokenType::COMMA) {
+                    break;
+                }
+                eat(TokenType::COMMA);
+            }
+            eat(TokenType::RPAREN);
+            return reductions;
+        }
+
+        [[noreturn]] static void parallelError(int line, const string& message) {
+            throw runtime_error("Parse error (line " + to_string(line) + "): parallel for " + message);
+        }
+
+        /*
+        #  parallel for 只接受 i = a; i < b (或 <=, !>); i = i + step 形式的头部,
+        #  迭代次数在进入循环时就能算出. 循环体里不能 return, 不能定义函数,
+        #  不能在循环这一层 break, 也不能给计数器赋值
+        */
+        void checkParallelFor(ParallelForNode& node) {
+            auto* init = dynamic_cast<AssignNode*>(node.init.get());
+            if (!init) {
+                parallelError(node.line, "needs a counter initialisation such as 'i = 0'");
+            }
+            const string& counter = init->varName;
+            auto isCounter = [&counter](ASTNode* expr) {
+                auto* var = dynamic_cast<VariableNode*>(expr);
+                return var && var->name == counter;
+            };
+            auto* condition = dynamic_cast<BinOpNode*>(node.condition.get());
+            if (!condition || !isCounter(condition->left.get()) ||
+                (condition->op.type != TokenType::LT && condition->op.type != TokenType::LTE &&
+                 condition->op.type != TokenType::NOT_GT)) {
+                parallelError(node.line, "condition must be '" + counter + " < limit' or '" + counter + " <= limit'");
+            }
+            auto* update = dynamic_cast<AssignNode*>(node.update.get());
+            auto* step = update ? dynamic_cast<BinOpNode*>(update->expr.get()) : nullptr;
+            if (!update || update->varName != counter || !step || step->op.type != TokenType::PLUS ||
+                !isCounter(step->left.get())) {
+                parallelError(node.line, "update must be '" + counter + " = " + counter + " + step'");
+            }
+            node.counter.name = counter;
+
+            unordered_set<string> seen = {counter};
+            for (const auto& reduction : node.reductions) {
+                if (!seen.insert(reduction.var.name).second) {
+                    parallelError(node.line, "reduces '" + reduction.var.name + "' twice or reduces its counter");
+                }
+            }
+            vector<string> assigned;
+            checkParallelBody(node.body.get(), 0, node.line, assigned);
+            for (const auto& name : assigned) {
+                if (name == counter) {
+                    parallelError(node.line, "body must not assign its counter '" + counter + "'");
+                }
+                if (seen.insert(name).second) {
+                    node.assigned.push_back(name);
+                }
+            }
+        }
+
+        void checkParallelBody(ASTNode* node, int loopDepth, int line, vector<string>& assigned) {
+            if (!node) {
+                return;
+            }
+            if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                assigned.push_back(assign->varName);
+            } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                for (auto& stmt : block->statements) {
+                    checkParallelBody(stmt.get(), loopDepth, line, assigned);
+                }
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                for (auto& branch : ifNode->branches) {
+                    checkParallelBody(branch.body.get(), loopDepth, line, assigned);
+                }
+                checkParallelBody(ifNode->elseBlock.get(), loopDepth, line, assigned);
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                checkParallelBody(whileNode->body.get(), loopDepth + 1, line, assigned);
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                checkParallelBody(forNode->init.get(), loopDepth + 1, line, assigned);
+                checkParallelBody(forNode->update.get(), loopDepth + 1, line, assigned);
+                checkParallelBody(forNode->body.get(), loopDepth + 1, line, assigned);
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                assigned.push_back(forIn->varName);
+                checkParallelBody(forIn->body.get(), loopDepth + 1, line, assigned);
+            } else if (dynamic_cast<ReturnNode*>(node)) {
+                parallelError(line, "body must not return");
+            } else if (dynamic_cast<YieldNode*>(node)) {
+                parallelError(line, "body must not yield");
+            } else if (dynamic_cast<FunctionDefinitionNode*>(node)) {
+                parallelError(line, "body must not define functions");
+            } else if (dynamic_cast<BreakNode*>(node) && loopDepth == 0) {
+                parallelError(line, "body must not break out of the parallel loop");
+            }
+        }
+
+        unique_ptr<IfNode> parseIfStatement() {
+            vector<IfNode::Branch> branches;
+            int line = currentToken.line;
+
+
+            eat(TokenType::IF);
+            auto condition = parseExpression();
+            eat(TokenType::COLON);
+
+
+            if (currentToken.type != TokenType::INDENT) {
+                error("Expected indentation after 'if' statement");
+            }
+            eat(TokenType::INDENT);
+
+            auto ifBody = parseBlock();
+            branches.push_back({std::move(condition), std::move(ifBody), false, line, {}});
+
+
+            while (currentToken.type == TokenType::ELIF) {
+                line = currentToken.line;
+                eat(TokenType::ELIF);
+                auto elifCondition = parseExpression();
+                eat(TokenType::COLON);
+
+                if (currentToken.type != TokenType::INDENT) {
+                    error("Expected indentation after 'elif' statement");
+                }
+                eat(TokenType::INDENT);
+
+                auto elifBody = parseBlock();
+                branches.push_back({std::move(elifCondition), std::move(elifBody), false, line, {}});
+            }
+
+
+            unique_ptr<BlockNode> elseBlock = nullptr;
+            if (currentToken.type == TokenType::ELSE) {
+                eat(TokenType::ELSE);
+                eat(TokenType::COLON);
+
+                if (currentToken.type != TokenType::INDENT) {
+                    error("Expected indentation after 'else' statement");
+                }
+                eat(TokenType::INDENT);
+
+                elseBlock = parseBlock();
+            }
+
+            return make_unique<IfNode>(std::move(branches), std::move(elseBlock));
+        }
+
+
+
+        unique_ptr<ASTNode> parseFunctionDefinition() {
+            eat(TokenType::DEF);
+
+
+            std::string name = currentToken.value;
+            eat(TokenType::IDENTIFIER);
+
+
+            eat(TokenType::LPAREN);
+            std::vector<Parameter> parameters;
+
+            if (currentToken.type != TokenType::RPAREN) {
+
+                std::string paramName = currentToken.value;
+                eat(TokenType::IDENTIFIER);
+                Value::Type type = parseOptionalAnnotation(TokenType::COLON);
+
+
+                std::unique_ptr<ASTNode> defaultValue = nullptr;
+                if (currentToken.type == TokenType::ASSIGN) {
+                    eat(TokenType::ASSIGN);
+                    defaultValue = parseExpression();
+                    parameters.emplace_back(paramName, std::move(defaultValue));
+                } else {
+                    parameters.emplace_back(paramName);
+                }
+                parameters.back().type = type;
+
+
+                while (currentToken.type == TokenType::COMMA) {
+                    eat(TokenType::COMMA);
+
+                    paramName = currentToken.value;
+                    eat(TokenType::IDENTIFIER);
+                    type = parseOptionalAnnotation(TokenType::COLON);
+
+
+                    defaultValue = nullptr;
+                    if (currentToken.type == TokenType::ASSIGN) {
+                        eat(TokenType::ASSIGN);
+                        defaultValue = parseExpression();
+                        parameters.emplace_back(paramName, std::move(defaultValue));
+                    } else {
+                        parameters.emplace_back(paramName);
+                    }
+                    parameters.back().type = type;
+                }
+            }
+            eat(TokenType::RPAREN);
+            Value::Type returnType = parseOptionalAnnotation(TokenType::ARROW);
+
+
+            eat(TokenType::COLON);
+
+            if (currentToken.type != TokenType::INDENT) {
+                error("Expected indentation after function definition");
+            }
+            eat(TokenType::INDENT);
+
+            bool savedInFunction = inFunction;
+            bool savedYielded = yielded;
+            inFunction = true;
+            yielded = false;
+            auto body = parseBlock();
+            bool generator = yielded;
+            inFunction = savedInFunction;
+            yielded = savedYielded;
+
+            if (generator && returnType != Value::EMPTY) {
+                error("Generator " + name + " cannot declare a return type");
+            }
+            auto def = make_unique<FunctionDefinitionNode>(name, parameters, std::move(body));
+            def->returnType = returnType;
+            def->generator = generator;
+            return def;
+        }
+
+        // 类型注解 x: int 或 -> float; 没有 marker 时返回 EMPTY
+        Value::Type parseOptionalAnnotation(TokenType marker) {
+            if (currentToken.type != marker) {
+                return Value::EMPTY;
+            }
+            eat(marker);
+            std::string type = currentToken.value;
+            eat(TokenType::IDENTIFIER);
+            if (type == "int") {
+                return Value::INT;
+            } else if (type == "float") {
+                return Value::FLOAT;
+            } else if (type == "bool") {
+                return Value::BOOL;
+            } else if (type == "string") {
+                return Value::STRING;
+            }
+            error("Unknown type '" + type + "' (expected int, float, bool or string)");
+            return Value::EMPTY;
+        }
+
+        unique_ptr<ASTNode> parseReturnStatement() {
+            int line = currentToken.line;
+            eat(TokenType::RETURN);
+
+            auto expr = parseExpression();
+            return make_unique<ReturnNode>(std::move(expr), line);
+        }
+
+        unique_ptr<ASTNode> parseYieldStatement() {
+            int line = currentToken.line;
+            if (!inFunction) {
+                error("'yield' outside of a function");
+            }
+            eat(TokenType::YIELD);
+
+            auto expr = parseExpression();
+            yielded = true;
+            return make_unique<YieldNode>(std::move(expr), line);
+        }
+
+        unique_ptr<ASTNode> parseStatement() {
+            switch (currentToken.type) {
+                case TokenType::IDENTIFIER: {
+                    std::string varName = currentToken.value;
+
+                    size_t pos = lexer.getPos();
+                    char currentChar = lexer.getCurrentChar();
+                    int currentLine = currentToken.line;
+
+                    Token nextToken = lexer.getNextToken();
+                    bool isAssignment = (nextToken.type == TokenType::ASSIGN);
+
+                    lexer.setPos(pos);
+                    lexer.setCurrentChar(currentChar);
+                    currentToken = Token(TokenType::IDENTIFIER, varName, currentLine);
+
+                    if (isAssignment) {
+                        return parseAssignment();
+                    } else if (varName == "parallel" && nextToken.type == TokenType::FOR) {
+                        eat(TokenType::IDENTIFIER);
+                        return parseForStatement(true);
+                    } else {
+                        return parseExpression();
+                    }
+                }
+                case TokenType::DEF: {
+                    return parseFunctionDefinition();
+                }
+                case TokenType::RETURN: {
+                    return parseReturnStatement();
+                }
+                case TokenType::YIELD: {
+                    return parseYieldStatement();
+                }
+                case TokenType::WHILE: {
+                    return parseWhileStatement();
+                }
+                case TokenType::FOR: {
+                    return parseForStatement();
+                }
+                case TokenType::IF: {
+                    return parseIfStatement();
+                }
+                case TokenType::BREAK: {
+                    int line = currentToken.line;
+                    eat(TokenType::BREAK);
+                    return make_unique<BreakNode>(line);
+                }
+                case TokenType::CONTINUE: {
+                    int line = currentToken.line;
+                    eat(TokenType::CONTINUE);
+                    return make_unique<ContinueNode>(line);
+                }
+
+                default:
+                    return parseExpression();
+            }
+        }
+
+    public:
+        Parser(Lexer& lexer) : lexer(lexer), currentToken(lexer.getNextToken()) {}
+
+        unique_ptr<BlockNode> parseProgram() {
+            vector<unique_ptr<ASTNode>> statements;
+
+            while (currentToken.type != TokenType::EOF_TOKEN) {
+                if (currentToken.type == TokenType::INDENT) {
+                    error("Unexpected indentation");
+                } else if (currentToken.type == TokenType::DEDENT) {
+                    error("Unexpected dedentation");
+                } else {
+                    statements.push_back(parseStatement());
+                }
+            }
+
+            return make_unique<BlockNode>(std::move(statements));
+        }
+    };
+
 #endif
\ No newline at end of file
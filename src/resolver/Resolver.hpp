@@ -0,0 +1,239 @@
+#ifndef RESOLVER_HPP
+    #define RESOLVER_HPP
+
+    #include "../MiLang.hpp"
+    #include "../parser/Parser.hpp"
+    #include <unordered_set>
+    #include <functional>
+
+    using namespace std;
+
+    /*
+    #  收集某个作用域内直接赋值的名字;
+    #  if 分支不产生新作用域, 循环和函数体各自收集
+    */
+    inline void collectDeclarations(ASTNode* node, std::vector<std::string>& names) {
+        if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+            names.push_back(assign->varName);
+        } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+            names.push_back(def->name);
+        } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+            for (auto& stmt : block->statements) {
+                collectDeclarations(stmt.get(), names);
+            }
+        } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+            for (auto& branch : ifNode->branches) {
+                collectDeclarations(branch.body.get(), names);
+            }
+            if (ifNode->elseBlock) {
+                collectDeclarations(ifNode->elseBlock.get(), names);
+            }
+        }
+    }
+
+    /*
+    #  在执行前把变量名解析成 (层数, 槽位)
+    #
+    #  每个函数和循环对应一个作用域, 运行时对应一个帧;
+    #  函数帧的上一层是全局帧, 全局变量仍按名字存取.
+    #  循环内赋值的名字在循环作用域里也占一个槽, 外层已有同名变量时写回外层,
+    #  因此一次引用可能有多个候选槽, 运行时取第一个已绑定的.
+    #  parallel for 的循环体给外层的名字赋值时在这里报错, 各引擎接受的程序相同
+    */
+    class Resolver {
+    private:
+        struct Scope {
+            Scope* parent;
+            std::unordered_map<std::string, int32_t> slots;
+            std::unordered_set<std::string> definite;  // 一定已绑定的名字 (函数参数)
+        };
+
+        Scope* current = nullptr;  // 为 nullptr 时处于全局作用域
+        std::unordered_set<std::string> globals;                      // 顶层 (含 if 分支) 赋值或定义的名字
+        std::function<bool(const std::string&)> isExternalGlobal;     // 之前的输入里已经存在的全局变量
+        bool inFunction = false;
+        bool tailCalls = false;  // 带返回类型注解的函数要在自己的帧里检查返回值, 生成器没有返回值, 都不做尾调用
+
+        static int32_t declare(Scope& scope, const std::string& name) {
+            auto it = scope.slots.find(name);
+            if (it != scope.slots.end()) {
+                return it->second;
+            }
+            int32_t slot = static_cast<int32_t>(scope.slots.size());
+            scope.slots[name] = slot;
+            return slot;
+        }
+
+        Resolution locate(const std::string& name) const {
+            Resolution resolution;
+            int32_t depth = 0;
+            for (Scope* scope = current; scope; scope = scope->parent, depth++) {
+                auto it = scope->slots.find(name);
+                if (it == scope->slots.end()) {
+                    continue;
+                }
+                if (scope->definite.count(name)) {
+                    // 外层槽一定已绑定, 内层同名槽永远不会被写入
+                    resolution.slots = {{depth, it->second}};
+                    resolution.global = false;
+                    return resolution;
+                }
+                resolution.slots.push_back({depth, it->second});
+            }
+            return resolution;
+        }
+
+        // 从循环作用域向外能找到的名字: 外层循环、所在函数的槽, 或者全局变量
+        bool definedOutside(const std::string& name) const {
+            for (Scope* scope = current->parent; scope; scope = scope->parent) {
+                if (scope->slots.count(name)) {
+                    return true;
+                }
+            }
+            return globals.count(name) || (isExternalGlobal && isExternalGlobal(name));
+        }
+
+        // inScope 在循环作用域里、解析循环各部分之前调用
+        template<typename Loop>
+        void resolveLoop(Loop& loop, std::initializer_list<ASTNode*> parts,
+                         const std::function<void()>& inScope = nullptr) {
+            Scope scope{current, {}, {}};
+            std::vector<std::string> names;
+            for (ASTNode* part : parts) {
+                if (part) {
+                    collectDeclarations(part, names);
+                }
+            }
+            for (const auto& name : names) {
+                declare(scope, name);
+            }
+            current = &scope;
+            if (inScope) {
+                inScope();
+            }
+            for (ASTNode* part : parts) {
+                resolve(part);
+            }
+            current = scope.parent;
+            loop.frameSize = static_cast<int32_t>(scope.slots.size());
+        }
+
+        void resolveFunction(FunctionDefinitionNode& def) {
+            Scope scope{nullptr, {}, {}};
+            for (const auto& param : def.parameters) {
+                declare(scope, param.name);
+                scope.definite.insert(param.name);
+            }
+            std::vector<std::string> names;
+            collectDeclarations(def.body.get(), names);
+            for (const auto& name : names) {
+                declare(scope, name);
+            }
+
+            Scope* saved = current;
+            bool savedInFunction = inFunction;
+            bool savedTailCalls = tailCalls;
+            current = &scope;
+            inFunction = true;
+            tailCalls = def.returnType == Value::EMPTY && !def.generator;
+            for (const auto& param : def.parameters) {
+                if (param.hasDefault) {
+                    resolve(param.defaultValue.get());
+                }
+            }
+            resolve(def.body.get());
+            current = saved;
+            inFunction = savedInFunction;
+            tailCalls = savedTailCalls;
+            def.frameSize = static_cast<int32_t>(scope.slots.size());
+        }
+
+    public:
+        explicit Resolver(std::function<bool(const std::string&)> isExternalGlobal = nullptr)
+            : isExternalGlobal(std::move(isExternalGlobal)) {}
+
+        void resolve(ASTNode* node) {
+            if (!node) {
+                return;
+            }
+            if (auto* var = dynamic_cast<VariableNode*>(node)) {
+                var->resolution = locate(var->name);
+            } else if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                resolve(assign->expr.get());
+                assign->resolution = locate(assign->varName);
+            } else if (auto* binop = dynamic_cast<BinOpNode*>(node)) {
+                resolve(binop->left.get());
+                resolve(binop->right.get());
+            } else if (auto* unary = dynamic_cast<UnaryOpNode*>(node)) {
+                resolve(unary->expr.get());
+            } else if (auto* call = dynamic_cast<CallNode*>(node)) {
+                call->resolution = locate(call->name);
+                for (auto& arg : call->positionalArguments) {
+                    resolve(arg.get());
+                }
+                for (auto& [argName, arg] : call->namedArguments) {
+                    resolve(arg.get());
+                }
+            } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                for (auto& stmt : block->statements) {
+                    resolve(stmt.get());
+                }
+            } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+                def->resolution = locate(def->name);
+                resolveFunction(*def);
+            } else if (auto* yieldNode = dynamic_cast<YieldNode*>(node)) {
+                resolve(yieldNode->expr.get());
+            } else if (auto* spawn = dynamic_cast<SpawnNode*>(node)) {
+                resolve(spawn->call.get());
+            } else if (auto* convert = dynamic_cast<ConvertNode*>(node)) {
+                resolve(convert->argument());
+            } else if (auto* ret = dynamic_cast<ReturnNode*>(node)) {
+                resolve(ret->expr.get());
+                if (auto* call = dynamic_cast<CallNode*>(ret->expr.get()); call && inFunction && tailCalls) {
+                    call->tailCall = true;
+                }
+            } else if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                resolveLoop(*whileNode, {whileNode->condition.get(), whileNode->body.get()});
+            } else if (auto* parallel = dynamic_cast<ParallelForNode*>(node)) {
+                resolveLoop(*parallel, {parallel->init.get(), parallel->condition.get(),
+                                        parallel->update.get(), parallel->body.get()}, [this, parallel] {
+                    parallel->counter.resolution = locate(parallel->counter.name);
+                    for (auto& reduction : parallel->reductions) {
+                        reduction.var.resolution = locate(reduction.var.name);
+                    }
+                    for (const auto& name : parallel->assigned) {
+                        if (definedOutside(name)) {
+                            throw std::runtime_error("Parallel for at line " + std::to_string(parallel->line) +
+                                                     ": the body assigns '" + name + "', which is defined outside "
+                                                     "the loop; list it in reduce(...) or use a new name");
+                        }
+                    }
+                });
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                resolveLoop(*forNode, {forNode->init.get(), forNode->condition.get(),
+                                       forNode->update.get(), forNode->body.get()});
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                // 生成器在进入循环之前求值, 循环变量属于循环作用域
+                resolve(forIn->iterable.get());
+                resolveLoop(*forIn, {forIn->body.get()}, [this, forIn] {
+                    declare(*current, forIn->varName);
+                    forIn->resolution = locate(forIn->varName);
+                });
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                for (auto& branch : ifNode->branches) {
+                    resolve(branch.condition.get());
+                    resolve(branch.body.get());
+                }
+                resolve(ifNode->elseBlock.get());
+            }
+        }
+
+        void resolve(ASTNode& program) {
+            std::vector<std::string> names;
+            collectDeclarations(&program, names);
+            globals.insert(names.begin(), names.end());
+            resolve(&program);
+        }
+    };
+
+#endif
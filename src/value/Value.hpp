@@ -0,0 +1,394 @@
+#ifndef VALUE_HPP
+    #define VALUE_HPP
+
+    #include <cstdint>
+    #include <string>
+    #include <variant>
+    #include <utility>
+    #include <type_traits>
+    #include <new>
+    #include <cstddef>
+
+    using IntType = intmax_t;
+
+    /*
+    #  浮点数档位: 默认 double (SSE2, 直接放进 Value 的载荷);
+    #  用 -DMI_LONG_DOUBLE 编译时为 long double (x86 上是 80 位 x87, 需要装箱).
+    #  解析、打印、转换和比较都跟随 FloatType, 不再经过 float
+    */
+    #ifdef MI_LONG_DOUBLE
+    using FloatType = long double;
+    #else
+    using FloatType = double;
+    #endif
+    using StringType = std::string;
+    using BoolType = bool;
+    using NullType = std::monostate;
+
+    // 按当前档位的精度解析浮点数, 语义同 std::stod
+    inline FloatType stringToFloat(const std::string& text, std::size_t* pos = nullptr) {
+    #ifdef MI_LONG_DOUBLE
+        return std::stold(text, pos);
+    #else
+        return std::stod(text, pos);
+    #endif
+    }
+
+    struct FunctionType;
+    struct GeneratorType;
+    struct FutureType;
+    struct CounterType;
+
+    // 这几个类型定义在 MiLang.hpp, 它们的 retain / release 在那里实现
+    inline void retain(FunctionType* func);
+    inline void release(FunctionType* func);
+    inline void retain(GeneratorType* gen);
+    inline void release(GeneratorType* gen);
+    inline void retain(FutureType* future);
+    inline void release(FutureType* future);
+    inline void retain(CounterType* counter);
+    inline void release(CounterType* counter);
+
+    /*
+    #  引用计数的智能指针, 计数由被指向类型的 retain / release 维护
+    #  被指向的类型需要一个 refs 成员, 初始为 0; 解释器在单线程内使用的对象计数不是原子的,
+    #  只有 future 和计数器在线程之间共享, 它们的计数是原子的
+    */
+    template<typename T>
+    class Ref {
+    private:
+        T* ptr = nullptr;
+
+    public:
+        Ref() = default;
+        Ref(std::nullptr_t) {}
+        explicit Ref(T* raw) : ptr(raw) { retain(ptr); }
+        Ref(const Ref& other) : ptr(other.ptr) { retain(ptr); }
+        Ref(Ref&& other) noexcept : ptr(other.ptr) { other.ptr = nullptr; }
+        ~Ref() { release(ptr); }
+
+        Ref& operator=(Ref other) noexcept {
+            std::swap(ptr, other.ptr);
+            return *this;
+        }
+
+        T* get() const { return ptr; }
+        T* operator->() const { return ptr; }
+        T& operator*() const { return *ptr; }
+        explicit operator bool() const { return ptr != nullptr; }
+        bool operator==(const Ref& other) const { return ptr == other.ptr; }
+
+        void reset() { Ref().swap(*this); }
+        void swap(Ref& other) noexcept { std::swap(ptr, other.ptr); }
+
+        // 交出所有权, 调用方负责之后 release
+        T* detach() {
+            T* raw = ptr;
+            ptr = nullptr;
+            return raw;
+        }
+
+        // 接管一个已经计过数的指针
+        static Ref adopt(T* raw) {
+            Ref ref;
+            ref.ptr = raw;
+            return ref;
+        }
+    };
+
+    template<typename T, typename... Args>
+    Ref<T> makeRef(Args&&... args) {
+        return Ref<T>(new T(std::forward<Args>(args)...));
+    }
+
+    // 装在堆上的值: 字符串, 以及放不进 8 字节的浮点数
+    template<typename T>
+    struct Boxed {
+        uint32_t refs = 0;
+        T value;
+
+        explicit Boxed(T value) : value(std::move(value)) {}
+    };
+
+    template<typename T>
+    inline void retain(Boxed<T>* box) {
+        if (box) {
+            box->refs++;
+        }
+    }
+
+    template<typename T>
+    inline void release(Boxed<T>* box) {
+        if (box && --box->refs == 0) {
+            delete box;
+        }
+    }
+
+    using FunctionTypePtr = Ref<FunctionType>;
+    using GeneratorPtr = Ref<GeneratorType>;
+    using FuturePtr = Ref<FutureType>;
+    using CounterPtr = Ref<CounterType>;
+
+    /*
+    #  16 字节的带标签值: 8 字节载荷 + 类型标签
+    #
+    #  整数、布尔、空值直接放在载荷里; 字符串、函数、生成器、future 和计数器是引用计数的指针;
+    #  FloatType 放得进 8 字节时 (double 档位) 直接存放, 否则 (long double) 装箱.
+    #  类型的编号与原先 variant 的下标一致, 通过 holds_alternative / get 访问.
+    #  EMPTY 只用于帧里尚未绑定的槽, 不会出现在表达式的结果里.
+    */
+    class Value {
+    public:
+        enum Type : uint8_t {
+            INT,
+            FLOAT,
+            STRING,
+            BOOL,
+            FUNCTION,
+            NONE,
+            GENERATOR,
+            FUTURE,
+            COUNTER,
+            EMPTY,
+        };
+
+        static constexpr bool inlineFloat = sizeof(FloatType) <= sizeof(IntType);
+        using StringBox = Boxed<StringType>;
+        using FloatBox = Boxed<FloatType>;
+
+    private:
+        union {
+            IntType i;
+            BoolType b;
+            double d;  // FloatType 放得进 8 字节时使用
+            FloatBox* fb;
+            StringBox* s;
+            FunctionType* fn;
+            GeneratorType* gen;
+            FutureType* fut;
+            CounterType* ctr;
+        };
+        Type tag;
+
+        // 需要引用计数的类型, 按标签取位判断, 拷贝和析构时只做一次测试
+        static constexpr uint32_t countedTags =
+            (1u << STRING) | (1u << FUNCTION) | (1u << GENERATOR) | (1u << FUTURE) | (1u << COUNTER) |
+            (inlineFloat ? 0u : 1u << FLOAT);
+
+        bool counted() const {
+            return (countedTags >> tag) & 1u;
+        }
+
+        void retainPayload() const {
+            if (!counted()) {
+                return;
+            }
+            if (tag == STRING) {
+                retain(s);
+            } else if (tag == FUNCTION) {
+                retain(fn);
+            } else if (!inlineFloat && tag == FLOAT) {
+                retain(fb);
+            } else {
+                retainObject();
+            }
+        }
+
+        void releasePayload() {
+            if (!counted()) {
+                return;
+            }
+            if (tag == STRING) {
+                release(s);
+            } else if (tag == FUNCTION) {
+                release(fn);
+            } else if (!inlineFloat && tag == FLOAT) {
+                release(fb);
+            } else {
+                releaseObject();
+            }
+        }
+
+        // 生成器、future 和计数器: 原子操作和虚析构不内联进每一处 Value 的拷贝和析构
+        [[gnu::noinline]] void retainObject() const {
+            if (tag == GENERATOR) {
+                retain(gen);
+            } else if (tag == FUTURE) {
+                retain(fut);
+            } else {
+                retain(ctr);
+            }
+        }
+
+        [[gnu::noinline]] void releaseObject() {
+            if (tag == GENERATOR) {
+                release(gen);
+            } else if (tag == FUTURE) {
+                release(fut);
+            } else {
+                release(ctr);
+            }
+        }
+
+        struct EmptyTag {};
+        explicit Value(EmptyTag) : i(0), tag(EMPTY) {}
+
+    public:
+        Value() : i(0), tag(INT) {}
+
+        template<typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+        Value(T value) : i(static_cast<IntType>(value)), tag(INT) {}
+
+        template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+        Value(T value) : tag(FLOAT) {
+            if constexpr (inlineFloat) {
+                d = static_cast<double>(value);
+            } else {
+                fb = new FloatBox(static_cast<FloatType>(value));
+                fb->refs = 1;
+            }
+        }
+
+        Value(BoolType value) : b(value), tag(BOOL) {}
+        Value(NullType) : i(0), tag(NONE) {}
+
+        Value(StringType value) : s(new StringBox(std::move(value))), tag(STRING) { s->refs = 1; }
+        Value(const char* value) : Value(StringType(value)) {}
+
+        Value(FunctionTypePtr value) : fn(value.detach()), tag(fn ? FUNCTION : NONE) {}
+        Value(GeneratorPtr value) : gen(value.detach()), tag(gen ? GENERATOR : NONE) {}
+        Value(FuturePtr value) : fut(value.detach()), tag(fut ? FUTURE : NONE) {}
+        Value(CounterPtr value) : ctr(value.detach()), tag(ctr ? COUNTER : NONE) {}
+
+        static Value unbound() { return Value(EmptyTag{}); }
+
+        Value(const Value& other) : i(other.i), tag(other.tag) {
+            retainPayload();
+        }
+
+        Value(Value&& other) noexcept : i(other.i), tag(other.tag) {
+            other.tag = INT;
+        }
+
+        Value& operator=(const Value& other) {
+            if (this != &other) {
+                other.retainPayload();
+                releasePayload();
+                i = other.i;
+                tag = other.tag;
+            }
+            return *this;
+        }
+
+        Value& operator=(Value&& other) noexcept {
+            if (this != &other) {
+                releasePayload();
+                i = other.i;
+                tag = other.tag;
+                other.tag = INT;
+            }
+            return *this;
+        }
+
+        ~Value() {
+            if (counted()) {
+                releasePayload();
+            }
+        }
+
+        Type type() const { return tag; }
+        size_t index() const { return tag; }
+        bool isBound() const { return tag != EMPTY; }
+
+        IntType& intRef() { return i; }
+        IntType asInt() const { return i; }
+        BoolType asBool() const { return b; }
+
+        FloatType asFloat() const {
+            if constexpr (inlineFloat) {
+                return static_cast<FloatType>(d);
+            } else {
+                return fb->value;
+            }
+        }
+
+        const StringType& asString() const { return s->value; }
+
+        FunctionTypePtr asFunction() const {
+            retain(fn);
+            return FunctionTypePtr::adopt(fn);
+        }
+
+        FunctionType* functionPtr() const { return fn; }
+
+        GeneratorPtr asGenerator() const {
+            retain(gen);
+            return GeneratorPtr::adopt(gen);
+        }
+
+        GeneratorType* generatorPtr() const { return gen; }
+
+        FutureType* futurePtr() const { return fut; }
+
+        CounterType* counterPtr() const { return ctr; }
+    };
+
+    static_assert(sizeof(Value) == 16, "Value must stay a 16-byte tag + payload");
+    static_assert(alignof(Value) == 8, "Value payload must be 8-byte aligned");
+    static_assert(std::is_nothrow_move_constructible_v<Value>, "moving a Value must not throw");
+
+    template<typename T> struct ValueTag;
+    template<> struct ValueTag<IntType>         { static constexpr Value::Type tag = Value::INT; };
+    template<> struct ValueTag<FloatType>       { static constexpr Value::Type tag = Value::FLOAT; };
+    template<> struct ValueTag<StringType>      { static constexpr Value::Type tag = Value::STRING; };
+    template<> struct ValueTag<BoolType>        { static constexpr Value::Type tag = Value::BOOL; };
+    template<> struct ValueTag<FunctionTypePtr> { static constexpr Value::Type tag = Value::FUNCTION; };
+    template<> struct ValueTag<NullType>        { static constexpr Value::Type tag = Value::NONE; };
+    template<> struct ValueTag<GeneratorPtr>    { static constexpr Value::Type tag = Value::GENERATOR; };
+    template<> struct ValueTag<FuturePtr>       { static constexpr Value::Type tag = Value::FUTURE; };
+    template<> struct ValueTag<CounterPtr>      { static constexpr Value::Type tag = Value::COUNTER; };
+
+    // 与 std::variant 相同的访问方式, 类型不符时抛出 bad_variant_access
+    template<typename T>
+    inline bool holds_alternative(const Value& value) {
+        return value.type() == ValueTag<T>::tag;
+    }
+
+    template<typename T>
+    inline decltype(auto) get(const Value& value) {
+        if (value.type() != ValueTag<T>::tag) {
+            throw std::bad_variant_access();
+        }
+        if constexpr (std::is_same_v<T, IntType>) {
+            return value.asInt();
+        } else if constexpr (std::is_same_v<T, FloatType>) {
+            return value.asFloat();
+        } else if constexpr (std::is_same_v<T, StringType>) {
+            return value.asString();
+        } else if constexpr (std::is_same_v<T, BoolType>) {
+            return value.asBool();
+        } else if constexpr (std::is_same_v<T, FunctionTypePtr>) {
+            return value.asFunction();
+        } else if constexpr (std::is_same_v<T, GeneratorPtr>) {
+            return value.asGenerator();
+        } else if constexpr (std::is_same_v<T, FuturePtr>) {
+            retain(value.futurePtr());
+            return FuturePtr::adopt(value.futurePtr());
+        } else if constexpr (std::is_same_v<T, CounterPtr>) {
+            retain(value.counterPtr());
+            return CounterPtr::adopt(value.counterPtr());
+        } else {
+            return NullType();
+        }
+    }
+
+    // 可写的整数引用, 供循环计数等原地自增使用
+    template<typename T, std::enable_if_t<std::is_same_v<T, IntType>, int> = 0>
+    inline IntType& get(Value& value) {
+        if (value.type() != Value::INT) {
+            throw std::bad_variant_access();
+        }
+        return value.intRef();
+    }
+
+#endif
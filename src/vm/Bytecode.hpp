@@ -0,0 +1,135 @@
+#ifndef BYTECODE_HPP
+    #define BYTECODE_HPP
+
+    #include "../MiLang.hpp"
+
+    using namespace std;
+
+    /*
+    #  指令表: X(名称, 操作数个数)
+    #  每条指令占 1 + N 个 int32_t, 操作数紧跟在操作码之后
+    */
+    #define MI_OPCODES(X)                \
+        X(CONST,                1)       \
+        X(POP,                  0)       \
+        X(LOAD_LOCAL,           1)       \
+        X(LOAD_SLOT,            2)       \
+        X(LOAD_GLOBAL,          1)       \
+        X(LOAD_REF,             1)       \
+        X(STORE_LOCAL,          1)       \
+        X(STORE_SLOT,           2)       \
+        X(STORE_GLOBAL,         1)       \
+        X(STORE_REF,            1)       \
+        X(ADD,                  1)       \
+        X(SUB,                  1)       \
+        X(MUL,                  1)       \
+        X(BINARY,               2)       \
+        X(LESS,                 1)       \
+        X(NOT,                  0)       \
+        X(NEGATE,               0)       \
+        X(JUMP,                 1)       \
+        X(JUMP_IF_FALSE,        3)       \
+        X(JUMP_IF_BOUND,        2)       \
+        X(COMPARE_JUMP,         5)       \
+        X(SLOT_LESS_CONST_JUMP, 6)       \
+        X(SLOTS_COMPARE_JUMP,   8)       \
+        X(SLOT_ADD_CONST,       4)       \
+        X(LOAD_CALLEE,          1)       \
+        X(CALL,                 1)       \
+        X(TAIL_CALL,            1)       \
+        X(CALL_BUILTIN,         2)       \
+        X(CONVERT,              1)       \
+        X(MAKE_FUNCTION,        1)       \
+        X(STORE_RESULT,         0)       \
+        X(SET_RESULT,           1)       \
+        X(RETURN,               0)       \
+        X(RETURN_RESULT,        0)       \
+        X(CHECK_TYPE,           2)       \
+        X(CHECK_RESULT,         2)       \
+        X(CLEAR_SLOTS,          2)       \
+        X(LOOP_TICK,            2)       \
+        X(ITER_START,           1)       \
+        X(FOR_NEXT,             1)       \
+        X(YIELD,                0)       \
+        X(FINISH,               0)       \
+        X(MAKE_FUTURE,          2)       \
+        X(THROW,                1)       \
+        X(HALT,                 0)
+
+    enum class OpCode : int32_t {
+        #define MI_OPCODE_ENUM(name, operands) name,
+        MI_OPCODES(MI_OPCODE_ENUM)
+        #undef MI_OPCODE_ENUM
+        COUNT
+    };
+
+    constexpr int opcodeOperands[] = {
+        #define MI_OPCODE_OPERANDS(name, operands) operands,
+        MI_OPCODES(MI_OPCODE_OPERANDS)
+        #undef MI_OPCODE_OPERANDS
+    };
+
+    // 条件跳转的来源, 用于生成与树遍历解释器一致的报错信息
+    enum class ConditionKind : int32_t {
+        WHILE,
+        FOR,
+        IF,
+    };
+
+    /*
+    #  一次变量引用的候选位置
+    #  slots 由内向外排列, 运行时取第一个已绑定的槽;
+    #  都未绑定时回落到全局变量 global (为 -1 表示不可能是全局变量)
+    */
+    struct VarRef {
+        std::string name;
+        std::vector<int32_t> slots;
+        int32_t global;
+    };
+
+    // 调用点: 位置参数个数与命名参数名 (按求值顺序压栈)
+    struct CallSite {
+        std::string name;
+        int32_t positionalCount;
+        std::vector<std::string> namedArguments;
+        mutable BindingPlan plan;  // 虚拟机执行时计算
+    };
+
+    // 全局变量名 -> 下标, 由虚拟机持有, 编译器与虚拟机共用
+    struct GlobalTable {
+        std::unordered_map<std::string, int32_t> index;
+        std::vector<std::string> names;
+
+        int32_t intern(const std::string& name) {
+            auto it = index.find(name);
+            if (it != index.end()) {
+                return it->second;
+            }
+            names.push_back(name);
+            return index[name] = static_cast<int32_t>(names.size() - 1);
+        }
+    };
+
+    struct Chunk {
+        std::string name;
+        std::vector<int32_t> code;
+        std::vector<Value> constants;
+        std::vector<VarRef> refs;
+        std::vector<CallSite> callSites;
+        std::vector<FunctionTypePtr> functions;
+        int32_t numSlots = 0;
+
+        size_t emit(OpCode op, std::initializer_list<int32_t> operands = {}) {
+            size_t at = code.size();
+            code.push_back(static_cast<int32_t>(op));
+            code.insert(code.end(), operands.begin(), operands.end());
+            return at;
+        }
+
+        int32_t addConstant(const Value& value) {
+            constants.push_back(value);
+            return static_cast<int32_t>(constants.size() - 1);
+        }
+    };
+
+#endif
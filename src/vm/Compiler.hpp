@@ -0,0 +1,583 @@
+#ifndef COMPILER_HPP
+    #define COMPILER_HPP
+
+    #include "../MiLang.hpp"
+    #include "../parser/Parser.hpp"
+    #include "../interpreter/Interpreter.hpp"
+    #include "../resolver/Resolver.hpp"
+    #include "../jit/Lower.hpp"
+    #include "Bytecode.hpp"
+    #include <unordered_set>
+    #include <limits>
+
+    using namespace std;
+
+    /*
+    #  把 Parser::parseProgram 得到的语法树编译成字节码
+    #
+    #  作用域规则与树遍历解释器一致: 循环体有自己的作用域,
+    #  赋值时写回最近的已存在变量, 不存在时才在当前作用域创建.
+    #  函数体只能看到自己的局部变量和全局变量 (词法作用域).
+    */
+    class Compiler {
+    private:
+        struct Scope {
+            Scope* parent;
+            std::unordered_map<std::string, int32_t> slots;
+            std::unordered_set<std::string> definite;  // 一定已绑定的名字 (函数参数)
+        };
+
+        struct LoopContext {
+            std::vector<size_t> breaks;
+            std::vector<size_t> continues;
+            int32_t counter = -1;  // 死循环计数的槽位, for-in 不计数
+        };
+
+        struct FunctionState {
+            Chunk* chunk;
+            Scope* scope;  // 为 nullptr 时处于全局作用域
+            bool isMain;
+            std::vector<LoopContext> loops;
+            Value::Type returnType = Value::EMPTY;  // -> 类型注解
+            bool generator = false;
+        };
+
+        Interpreter& interpreter;
+        GlobalTable& globals;
+        FunctionState* current = nullptr;
+
+        Chunk& chunk() { return *current->chunk; }
+
+        size_t here() { return chunk().code.size(); }
+
+        void patch(size_t operand, size_t target) {
+            chunk().code[operand] = static_cast<int32_t>(target);
+        }
+
+        int32_t constant(const Value& value) {
+            return chunk().addConstant(value);
+        }
+
+        int32_t allocateSlot() {
+            return chunk().numSlots++;
+        }
+
+        void declare(Scope& scope, const std::string& name) {
+            if (scope.slots.find(name) == scope.slots.end()) {
+                scope.slots[name] = allocateSlot();
+            }
+        }
+
+        VarRef resolve(const std::string& name) {
+            VarRef ref{name, {}, -1};
+            for (Scope* scope = current->scope; scope; scope = scope->parent) {
+                auto it = scope->slots.find(name);
+                if (it == scope->slots.end()) {
+                    continue;
+                }
+                if (scope->definite.count(name)) {
+                    // 外层槽一定已绑定, 内层同名槽永远不会被写入
+                    ref.slots = {it->second};
+                    return ref;
+                }
+                ref.slots.push_back(it->second);
+            }
+            ref.global = globals.intern(name);
+            return ref;
+        }
+
+        void emitLoad(const std::string& name) {
+            VarRef ref = resolve(name);
+            if (ref.slots.empty()) {
+                chunk().emit(OpCode::LOAD_GLOBAL, {ref.global});
+            } else if (ref.slots.size() == 1 && ref.global < 0) {
+                chunk().emit(OpCode::LOAD_LOCAL, {ref.slots[0]});
+            } else if (ref.slots.size() == 1) {
+                chunk().emit(OpCode::LOAD_SLOT, {ref.slots[0], ref.global});
+            } else {
+                chunk().refs.push_back(std::move(ref));
+                chunk().emit(OpCode::LOAD_REF, {static_cast<int32_t>(chunk().refs.size() - 1)});
+            }
+        }
+
+        void emitStore(const std::string& name) {
+            VarRef ref = resolve(name);
+            if (ref.slots.empty()) {
+                chunk().emit(OpCode::STORE_GLOBAL, {ref.global});
+            } else if (ref.slots.size() == 1 && ref.global < 0) {
+                chunk().emit(OpCode::STORE_LOCAL, {ref.slots[0]});
+            } else if (ref.slots.size() == 1) {
+                chunk().emit(OpCode::STORE_SLOT, {ref.slots[0], ref.global});
+            } else {
+                chunk().refs.push_back(std::move(ref));
+                chunk().emit(OpCode::STORE_REF, {static_cast<int32_t>(chunk().refs.size() - 1)});
+            }
+        }
+
+        static bool isComparison(TokenType type) {
+            switch (type) {
+                case TokenType::EQ:
+                case TokenType::NEQ:
+                case TokenType::GT:
+                case TokenType::LT:
+                case TokenType::GTE:
+                case TokenType::LTE:
+                case TokenType::NOT_GT:
+                case TokenType::NOT_LT:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        static bool isIntLiteral(ASTNode* node) {
+            auto* number = dynamic_cast<NumberNode*>(node);
+            return number && !number->isFloat;
+        }
+
+        // 单槽变量: 返回 {槽, 全局下标}; 否则返回 {-1, -1}
+        std::pair<int32_t, int32_t> singleSlot(const std::string& name) {
+            VarRef ref = resolve(name);
+            if (ref.slots.size() != 1) {
+                return {-1, -1};
+            }
+            return {ref.slots[0], ref.global};
+        }
+
+        void compileExpression(ASTNode* node) {
+            if (auto* number = dynamic_cast<NumberNode*>(node)) {
+                chunk().emit(OpCode::CONST, {constant(number->value())});
+            } else if (auto* str = dynamic_cast<StringNode*>(node)) {
+                chunk().emit(OpCode::CONST, {constant(str->value)});
+            } else if (auto* boolean = dynamic_cast<BooleanNode*>(node)) {
+                chunk().emit(OpCode::CONST, {constant(boolean->value)});
+            } else if (dynamic_cast<NullNode*>(node)) {
+                chunk().emit(OpCode::CONST, {constant(NullType())});
+            } else if (auto* var = dynamic_cast<VariableNode*>(node)) {
+                emitLoad(var->name);
+            } else if (auto* binop = dynamic_cast<BinOpNode*>(node)) {
+                compileExpression(binop->left.get());
+                compileExpression(binop->right.get());
+                switch (binop->op.type) {
+                    case TokenType::PLUS:
+                        chunk().emit(OpCode::ADD, {binop->op.line});
+                        break;
+                    case TokenType::MINUS:
+                        chunk().emit(OpCode::SUB, {binop->op.line});
+                        break;
+                    case TokenType::MULTIPLY:
+                        chunk().emit(OpCode::MUL, {binop->op.line});
+                        break;
+                    case TokenType::LT:
+                        chunk().emit(OpCode::LESS, {binop->op.line});
+                        break;
+                    default:
+                        chunk().emit(OpCode::BINARY, {static_cast<int32_t>(binop->op.type), binop->op.line});
+                        break;
+                }
+            } else if (auto* unary = dynamic_cast<UnaryOpNode*>(node)) {
+                compileExpression(unary->expr.get());
+                chunk().emit(unary->op.type == TokenType::MINUS ? OpCode::NEGATE : OpCode::NOT);
+            } else if (auto* call = dynamic_cast<CallNode*>(node)) {
+                compileCall(*call);
+            } else if (auto* convert = dynamic_cast<ConvertNode*>(node)) {
+                compileExpression(convert->argument());
+                chunk().emit(OpCode::CONVERT, {static_cast<int32_t>(convert->kind)});
+            } else if (auto* spawn = dynamic_cast<SpawnNode*>(node)) {
+                // 与 parallel for 一样按顺序执行: 由 MAKE_FUTURE 立即调用, 结果包装成已经完成的 future
+                if (interpreter.isBuiltinFunction(spawn->call->name)) {
+                    chunk().emit(OpCode::THROW, {constant(StringType(
+                        "Spawn at line " + to_string(spawn->line) + ": " + spawn->call->name +
+                        " is a builtin function; only user functions can be spawned"))});
+                } else {
+                    compileCall(*spawn->call, spawn->line);
+                }
+            } else if (auto* assign = dynamic_cast<AssignNode*>(node)) {
+                compileAssignment(*assign);
+            } else if (auto* def = dynamic_cast<FunctionDefinitionNode*>(node)) {
+                chunk().functions.push_back(compileFunction(def->name, def->parameters, def->returnType, *def->body,
+                                                            def->generator));
+                chunk().functions.back()->pure = def->pure;
+                if (interpreter.getJit().isEnabled() && !def->generator) {
+                    chunk().functions.back()->jitSource = JitLowering::lower(def->parameters, *def->body);
+                }
+                chunk().emit(OpCode::MAKE_FUNCTION, {static_cast<int32_t>(chunk().functions.size() - 1)});
+                emitStore(def->name);
+            } else {
+                throw runtime_error("Compile error: unsupported expression");
+            }
+        }
+
+        void compileAssignment(AssignNode& assign) {
+            // x = x + k / x = x - k 融合成一条原地加法
+            auto* binop = dynamic_cast<BinOpNode*>(assign.expr.get());
+            if (binop && (binop->op.type == TokenType::PLUS || binop->op.type == TokenType::MINUS)) {
+                auto* var = dynamic_cast<VariableNode*>(binop->left.get());
+                if (var && var->name == assign.varName && isIntLiteral(binop->right.get())) {
+                    IntType k = static_cast<NumberNode*>(binop->right.get())->intValue;
+                    auto [slot, global] = singleSlot(assign.varName);
+                    if (slot >= 0 && k != std::numeric_limits<IntType>::min()) {
+                        if (binop->op.type == TokenType::MINUS) {
+                            k = -k;
+                        }
+                        chunk().emit(OpCode::SLOT_ADD_CONST, {slot, global, constant(k), binop->op.line});
+                        return;
+                    }
+                }
+            }
+            compileExpression(assign.expr.get());
+            emitStore(assign.varName);
+        }
+
+        // spawnLine >= 0 时是 spawn 的调用, 用 MAKE_FUTURE 代替 CALL
+        void compileCall(CallNode& call, int spawnLine = -1) {
+            // 内置函数在编译时换成内置函数表的下标
+            int32_t builtin = interpreter.findBuiltin(call.name);
+            if (builtin >= 0) {
+                for (auto& arg : call.positionalArguments) {
+                    compileExpression(arg.get());
+                }
+                chunk().emit(OpCode::CALL_BUILTIN, {builtin, static_cast<int32_t>(call.positionalArguments.size())});
+                return;
+            }
+
+            VarRef callee = resolve(call.name);
+            chunk().refs.push_back(std::move(callee));
+            chunk().emit(OpCode::LOAD_CALLEE, {static_cast<int32_t>(chunk().refs.size() - 1)});
+
+            CallSite site{call.name, static_cast<int32_t>(call.positionalArguments.size()), {}, {}};
+            for (auto& arg : call.positionalArguments) {
+                compileExpression(arg.get());
+            }
+            for (auto& [paramName, arg] : call.namedArguments) {
+                site.namedArguments.push_back(paramName);
+                compileExpression(arg.get());
+            }
+            chunk().callSites.push_back(std::move(site));
+            int32_t siteIndex = static_cast<int32_t>(chunk().callSites.size() - 1);
+            if (spawnLine >= 0) {
+                chunk().emit(OpCode::MAKE_FUTURE, {siteIndex, spawnLine});
+            } else {
+                chunk().emit(call.tailCall ? OpCode::TAIL_CALL : OpCode::CALL, {siteIndex});
+            }
+        }
+
+        // 编译条件并在条件为假时跳转, 返回待回填的跳转目标位置
+        size_t compileConditionJump(ASTNode* condition, ConditionKind kind, int line) {
+            auto* binop = dynamic_cast<BinOpNode*>(condition);
+            if (binop && isComparison(binop->op.type)) {
+                auto* var = dynamic_cast<VariableNode*>(binop->left.get());
+                if (binop->op.type == TokenType::LT && var && isIntLiteral(binop->right.get())) {
+                    auto [slot, global] = singleSlot(var->name);
+                    if (slot >= 0) {
+                        auto* number = static_cast<NumberNode*>(binop->right.get());
+                        size_t at = chunk().emit(OpCode::SLOT_LESS_CONST_JUMP, {
+                            slot, global, constant(number->value()), 0, static_cast<int32_t>(kind), line
+                        });
+                        return at + 4;
+                    }
+                }
+                auto* rightVar = dynamic_cast<VariableNode*>(binop->right.get());
+                if (var && rightVar) {
+                    auto [leftSlot, leftGlobal] = singleSlot(var->name);
+                    auto [rightSlot, rightGlobal] = singleSlot(rightVar->name);
+                    if (leftSlot >= 0 && rightSlot >= 0) {
+                        size_t at = chunk().emit(OpCode::SLOTS_COMPARE_JUMP, {
+                            static_cast<int32_t>(binop->op.type), leftSlot, leftGlobal, rightSlot, rightGlobal,
+                            0, static_cast<int32_t>(kind), line
+                        });
+                        return at + 6;
+                    }
+                }
+                compileExpression(binop->left.get());
+                compileExpression(binop->right.get());
+                size_t at = chunk().emit(OpCode::COMPARE_JUMP, {
+                    static_cast<int32_t>(binop->op.type), binop->op.line, 0, static_cast<int32_t>(kind), line
+                });
+                return at + 3;
+            }
+            compileExpression(condition);
+            size_t at = chunk().emit(OpCode::JUMP_IF_FALSE, {0, static_cast<int32_t>(kind), line});
+            return at + 1;
+        }
+
+        /*
+        #  live 表示语句块的值会被用到 (函数体/程序的最后一条语句及其 if 分支),
+        #  其余语句的值直接丢弃, 不写入结果寄存器
+        */
+        void compileBlock(BlockNode& block, bool live) {
+            if (block.statements.empty() && live) {
+                chunk().emit(OpCode::SET_RESULT, {constant(Value())});
+            }
+            for (size_t i = 0; i < block.statements.size(); i++) {
+                compileStatement(block.statements[i].get(), live && i + 1 == block.statements.size());
+            }
+        }
+
+        // 循环作用域: 为循环体内赋值的名字 (和 for-in 的循环变量) 以及迭代计数器分配槽位, 进入循环时清空
+        int32_t enterLoopScope(Scope& scope, std::initializer_list<ASTNode*> parts, const std::string& variable = "") {
+            std::vector<std::string> names;
+            if (!variable.empty()) {
+                names.push_back(variable);
+            }
+            for (ASTNode* part : parts) {
+                if (part) {
+                    collectDeclarations(part, names);
+                }
+            }
+            int32_t first = chunk().numSlots;
+            for (const auto& name : names) {
+                declare(scope, name);
+            }
+            int32_t counter = allocateSlot();
+            chunk().emit(OpCode::CLEAR_SLOTS, {first, chunk().numSlots - first});
+            current->scope = &scope;
+            current->loops.push_back({{}, {}, counter});
+            return counter;
+        }
+
+        void leaveLoopScope(Scope& scope, size_t continueTarget, size_t breakTarget, bool live) {
+            for (size_t operand : current->loops.back().continues) {
+                patch(operand, continueTarget);
+            }
+            for (size_t operand : current->loops.back().breaks) {
+                patch(operand, breakTarget);
+            }
+            current->loops.pop_back();
+            current->scope = scope.parent;
+            if (live) {
+                chunk().emit(OpCode::SET_RESULT, {constant(IntType(0))});
+            }
+        }
+
+        void compileWhile(WhileNode& node, bool live) {
+            Scope scope{current->scope, {}, {}};
+            int32_t counter = enterLoopScope(scope, {node.body.get()});
+
+            size_t loopStart = here();
+            size_t exitJump = compileConditionJump(node.condition.get(), ConditionKind::WHILE, node.line);
+            compileBlock(*node.body, false);
+            chunk().emit(OpCode::LOOP_TICK, {counter, node.line});
+            chunk().emit(OpCode::JUMP, {static_cast<int32_t>(loopStart)});
+
+            patch(exitJump, here());
+            leaveLoopScope(scope, loopStart, here(), live);
+        }
+
+        void compileFor(ForNode& node, bool live) {
+            Scope scope{current->scope, {}, {}};
+            int32_t counter = enterLoopScope(scope, {node.init.get(), node.update.get(), node.body.get()});
+
+            if (node.init) {
+                compileExpression(node.init.get());
+                chunk().emit(OpCode::POP);
+            }
+            size_t loopStart = here();
+            size_t exitJump = compileConditionJump(node.condition.get(), ConditionKind::FOR, node.line);
+            compileBlock(*node.body, false);
+            if (node.update) {
+                compileExpression(node.update.get());
+                chunk().emit(OpCode::POP);
+            }
+            chunk().emit(OpCode::LOOP_TICK, {counter, node.line});
+            chunk().emit(OpCode::JUMP, {static_cast<int32_t>(loopStart)});
+
+            // continue 执行更新表达式, 但不计入死循环计数
+            size_t continueTarget = loopStart;
+            if (node.update && !current->loops.back().continues.empty()) {
+                continueTarget = here();
+                compileExpression(node.update.get());
+                chunk().emit(OpCode::POP);
+                chunk().emit(OpCode::JUMP, {static_cast<int32_t>(loopStart)});
+            }
+
+            patch(exitJump, here());
+            leaveLoopScope(scope, continueTarget, here(), live);
+        }
+
+        /*
+        #  for (x in gen): 生成器在循环期间留在操作数栈上, FOR_NEXT 每次取一个值;
+        #  取完时和 break 一样跳到出口, 由出口的 POP 弹掉生成器.
+        #  迭代次数由生成器决定, 与树遍历引擎一样不做死循环计数
+        */
+        void compileForIn(ForInNode& node, bool live) {
+            compileExpression(node.iterable.get());
+            chunk().emit(OpCode::ITER_START, {node.line});
+
+            Scope scope{current->scope, {}, {}};
+            enterLoopScope(scope, {node.body.get()}, node.varName);
+            current->loops.back().counter = -1;
+
+            size_t loopStart = here();
+            size_t exitJump = chunk().emit(OpCode::FOR_NEXT, {0}) + 1;
+            emitStore(node.varName);
+            chunk().emit(OpCode::POP);
+            compileBlock(*node.body, false);
+            chunk().emit(OpCode::JUMP, {static_cast<int32_t>(loopStart)});
+
+            size_t exit = here();
+            patch(exitJump, exit);
+            chunk().emit(OpCode::POP);
+            leaveLoopScope(scope, loopStart, exit, live);
+        }
+
+        void compileIf(IfNode& node, bool live) {
+            std::vector<size_t> endJumps;
+            for (auto& branch : node.branches) {
+                size_t nextJump = compileConditionJump(branch.condition.get(), ConditionKind::IF, 0);
+                compileBlock(*branch.body, live);
+                endJumps.push_back(chunk().emit(OpCode::JUMP, {0}) + 1);
+                patch(nextJump, here());
+            }
+            if (node.elseBlock) {
+                compileBlock(*node.elseBlock, live);
+            } else if (live) {
+                chunk().emit(OpCode::SET_RESULT, {constant(IntType(0))});
+            }
+            for (size_t operand : endJumps) {
+                patch(operand, here());
+            }
+        }
+
+        void compileStatement(ASTNode* node, bool live) {
+            if (auto* whileNode = dynamic_cast<WhileNode*>(node)) {
+                compileWhile(*whileNode, live);
+            } else if (auto* forNode = dynamic_cast<ForNode*>(node)) {
+                compileFor(*forNode, live);
+            } else if (auto* forIn = dynamic_cast<ForInNode*>(node)) {
+                compileForIn(*forIn, live);
+            } else if (auto* ifNode = dynamic_cast<IfNode*>(node)) {
+                compileIf(*ifNode, live);
+            } else if (auto* block = dynamic_cast<BlockNode*>(node)) {
+                compileBlock(*block, live);
+            } else if (auto* ret = dynamic_cast<ReturnNode*>(node)) {
+                compileExpression(ret->expr.get());
+                auto* call = dynamic_cast<CallNode*>(ret->expr.get());
+                if (current->isMain) {
+                    chunk().emit(OpCode::POP);
+                    chunk().emit(OpCode::THROW, {constant(StringType("Return statement"))});
+                } else if (current->generator) {
+                    // 生成器的返回值被丢弃, return 只结束迭代
+                    chunk().emit(OpCode::POP);
+                    chunk().emit(OpCode::FINISH);
+                } else if (!call || !call->tailCall || interpreter.isBuiltinFunction(call->name)) {
+                    if (current->returnType != Value::EMPTY) {
+                        chunk().emit(OpCode::CHECK_TYPE, {current->returnType,
+                                                          constant(StringType("return value of " + chunk().name))});
+                    }
+                    chunk().emit(OpCode::RETURN);  // TAIL_CALL 自己结束当前帧
+                }
+            } else if (auto* yield = dynamic_cast<YieldNode*>(node)) {
+                // 与树遍历引擎一样, 外层循环在 yield 之后重新计数
+                for (const auto& loop : current->loops) {
+                    if (loop.counter >= 0) {
+                        chunk().emit(OpCode::CLEAR_SLOTS, {loop.counter, 1});
+                    }
+                }
+                compileExpression(yield->expr.get());
+                chunk().emit(OpCode::YIELD);
+            } else if (auto* brk = dynamic_cast<BreakNode*>(node)) {
+                if (current->loops.empty()) {
+                    chunk().emit(OpCode::THROW, {constant(StringType("Break outside of loop at line " + to_string(brk->line)))});
+                } else {
+                    current->loops.back().breaks.push_back(chunk().emit(OpCode::JUMP, {0}) + 1);
+                }
+            } else if (auto* cont = dynamic_cast<ContinueNode*>(node)) {
+                if (current->loops.empty()) {
+                    chunk().emit(OpCode::THROW, {constant(StringType("Continue outside of loop at line " + to_string(cont->line)))});
+                } else {
+                    current->loops.back().continues.push_back(chunk().emit(OpCode::JUMP, {0}) + 1);
+                }
+            } else if (dynamic_cast<FunctionDefinitionNode*>(node)) {
+                compileExpression(node);
+                chunk().emit(OpCode::POP);
+                if (live) {
+                    chunk().emit(OpCode::SET_RESULT, {constant(StringType(""))});
+                }
+            } else {
+                compileExpression(node);
+                chunk().emit(live ? OpCode::STORE_RESULT : OpCode::POP);
+            }
+        }
+
+    public:
+        Compiler(Interpreter& interpreter, GlobalTable& globals)
+            : interpreter(interpreter), globals(globals) {}
+
+        std::shared_ptr<Chunk> compileProgram(BlockNode& program) {
+            auto main = std::make_shared<Chunk>();
+            main->name = "<main>";
+            FunctionState state{main.get(), nullptr, true, {}};
+            FunctionState* enclosing = current;
+            current = &state;
+            compileBlock(program, true);
+            chunk().emit(OpCode::HALT);
+            current = enclosing;
+            return main;
+        }
+
+        FunctionTypePtr compileFunction(const std::string& name,
+                                                      const std::vector<Parameter>& parameters,
+                                                      Value::Type returnType,
+                                                      BlockNode& body,
+                                                      bool generator = false) {
+            auto function = makeRef<FunctionType>(name);
+            function->parameters = parameters;
+            function->returnType = returnType;
+            function->generator = generator;
+            function->chunk = std::make_shared<Chunk>();
+            function->chunk->name = name;
+
+            Scope scope{nullptr, {}, {}};
+            FunctionState state{function->chunk.get(), &scope, false, {}, returnType, generator};
+            FunctionState* enclosing = current;
+            current = &state;
+
+            // 参数占用前 N 个槽, 与调用时压栈的实参位置一致
+            for (const auto& param : parameters) {
+                scope.slots[param.name] = allocateSlot();
+                scope.definite.insert(param.name);
+            }
+            std::vector<std::string> names;
+            collectDeclarations(&body, names);
+            for (const auto& local : names) {
+                declare(scope, local);
+            }
+
+            // 默认值在被调函数的作用域中求值; 带类型注解的参数在入口检查一次
+            for (size_t i = 0; i < parameters.size(); i++) {
+                int32_t slot = static_cast<int32_t>(i);
+                if (parameters[i].hasDefault) {
+                    size_t skip = chunk().emit(OpCode::JUMP_IF_BOUND, {slot, 0}) + 2;
+                    compileExpression(parameters[i].defaultValue.get());
+                    chunk().emit(OpCode::STORE_LOCAL, {slot});
+                    chunk().emit(OpCode::POP);
+                    patch(skip, here());
+                }
+                if (parameters[i].type != Value::EMPTY) {
+                    chunk().emit(OpCode::LOAD_LOCAL, {slot});
+                    chunk().emit(OpCode::CHECK_TYPE, {parameters[i].type,
+                                                      constant(StringType("parameter '" + parameters[i].name + "' of " + name))});
+                    chunk().emit(OpCode::STORE_LOCAL, {slot});
+                    chunk().emit(OpCode::POP);
+                }
+            }
+
+            if (generator) {
+                // 生成器在 YIELD 处挂起, 执行到函数体末尾时结束
+                compileBlock(body, false);
+                chunk().emit(OpCode::FINISH);
+            } else {
+                compileBlock(body, true);
+                if (returnType != Value::EMPTY) {
+                    chunk().emit(OpCode::CHECK_RESULT, {returnType, constant(StringType("return value of " + name))});
+                }
+                chunk().emit(OpCode::RETURN_RESULT);
+            }
+
+            current = enclosing;
+            return function;
+        }
+    };
+
+#endif
@@ -0,0 +1,1091 @@
+#ifndef VM_HPP
+    #define VM_HPP
+
+    #include "../MiLang.hpp"
+    #include "../binop/BinOp.hpp"
+    #include "../interpreter/Interpreter.hpp"
+    #include "Bytecode.hpp"
+    #include "Compiler.hpp"
+    #include "../parallel/Task.hpp"
+
+    using namespace std;
+
+    #if defined(__GNUC__) || defined(__clang__)
+        #define MI_THREADED_DISPATCH 1
+    #else
+        #define MI_THREADED_DISPATCH 0
+    #endif
+
+    /*
+    #  基于栈的字节码虚拟机
+    #
+    #  每个调用帧的局部变量槽位于值栈底部 [base, base + numSlots),
+    #  其上是操作数; 槽是否已绑定记录在 bound 中 (下标与值栈一致).
+    #  用户函数之间的调用不占用 C++ 栈, 调用帧和值栈都在堆上按需增长,
+    #  递归深度只受 maxDepth 限制.
+    */
+    class VM {
+    private:
+        struct CallFrame {
+            const Chunk* chunk;
+            size_t ip;
+            size_t base;
+            Value result;
+            bool memo = false;  // 返回时把结果写进 pendingMemo 顶部对应的缓存
+            bool spawned = false;  // spawn 调用的函数, 在嵌套的 dispatch 里执行, 返回时退出那一层
+        };
+
+        // 未命中缓存、正在执行的纯函数调用; 与带 memo 标记的帧一一对应
+        struct PendingMemo {
+            FunctionTypePtr func;
+            MemoKey key;
+        };
+
+        /*
+        #  字节码的生成器: 挂起时把自己那一帧的槽和操作数 (for-in 的生成器) 搬出值栈,
+        #  恢复时放回栈顶, 从保存的 ip 继续执行到下一条 YIELD 或 FINISH
+        */
+        class Generator : public GeneratorType {
+        public:
+            Generator(VM& vm, FunctionTypePtr func, std::vector<Value> slots, std::vector<char> slotBound)
+                : GeneratorType(func->name), vm(vm), func(std::move(func)),
+                  slots(std::move(slots)), slotBound(std::move(slotBound)) {}
+
+        protected:
+            bool resume(Value& out) override {
+                return vm.resumeGenerator(*this, out);
+            }
+
+        private:
+            friend class VM;
+
+            VM& vm;
+            FunctionTypePtr func;
+            std::vector<Value> slots;
+            std::vector<char> slotBound;
+            size_t ip = 0;
+        };
+
+        Interpreter& interpreter;
+        GlobalTable globalTable;
+        std::vector<Value> globals;
+        std::vector<char> globalBound;
+        size_t boundGlobals = 0;  // 已绑定的全局变量数, 只增不减
+
+        std::vector<Value> stack;
+        std::vector<char> bound;
+        std::vector<CallFrame> frames;
+        std::vector<PendingMemo> pendingMemo;
+        size_t maxDepth = VM_MAX_DEPTH;
+        bool suspended = false;  // dispatch 因 YIELD 返回时为 true, 因 FINISH 返回时为 false
+
+        void syncGlobals() {
+            globals.resize(globalTable.names.size());
+            globalBound.resize(globalTable.names.size(), false);
+        }
+
+        void allocateSlots(size_t base, size_t count, size_t boundCount = 0) {
+            stack.resize(base + count);
+            if (bound.size() < stack.size()) {
+                bound.resize(stack.size());
+            }
+            std::fill(bound.begin() + base, bound.begin() + base + boundCount, true);
+            std::fill(bound.begin() + base + boundCount, bound.begin() + base + count, false);
+        }
+
+        Value pop() {
+            Value value = std::move(stack.back());
+            stack.pop_back();
+            return value;
+        }
+
+        [[noreturn]] void undefinedVariable(const std::string& name) {
+            throw runtime_error("Undefined variable: " + name);
+        }
+
+        bool truthy(const Value& value, ConditionKind kind, int line) {
+            if (holds_alternative<BoolType>(value)) {
+                return get<BoolType>(value);
+            } else if (holds_alternative<IntType>(value)) {
+                return get<IntType>(value) != 0;
+            } else if (holds_alternative<FloatType>(value)) {
+                return get<FloatType>(value) != 0.0;
+            } else if (holds_alternative<StringType>(value)) {
+                return !get<StringType>(value).empty();
+            }
+            switch (kind) {
+                case ConditionKind::WHILE:
+                    throw runtime_error("Type error in while condition at line " + to_string(line));
+                case ConditionKind::FOR:
+                    throw runtime_error("Type error in for condition at line " + to_string(line));
+                default:
+                    throw runtime_error("Type error in if condition");
+            }
+        }
+
+        Value binary(TokenType type, int line, const Value& left, const Value& right) {
+            return binop::dispatch(type, line, left, right);
+        }
+
+        // 比较后按条件语义取真值, 两边都是整数时不经过分派表
+        bool compare(TokenType type, int opLine, const Value& left, const Value& right, ConditionKind kind, int line) {
+            if (holds_alternative<IntType>(left) && holds_alternative<IntType>(right)) {
+                IntType a = get<IntType>(left);
+                IntType b = get<IntType>(right);
+                switch (type) {
+                    case TokenType::EQ:     return a == b;
+                    case TokenType::NEQ:    return a != b;
+                    case TokenType::GT:     return a > b;
+                    case TokenType::LT:     return a < b;
+                    case TokenType::GTE:
+                    case TokenType::NOT_LT: return a >= b;
+                    default:                return a <= b;
+                }
+            }
+            return truthy(binary(type, opLine, left, right), kind, line);
+        }
+
+        Value* findVariable(size_t base, const VarRef& ref) {
+            for (int32_t slot : ref.slots) {
+                if (bound[base + slot]) {
+                    return &stack[base + slot];
+                }
+            }
+            if (ref.global >= 0 && globalBound[ref.global]) {
+                return &globals[ref.global];
+            }
+            return nullptr;
+        }
+
+        void storeVariable(size_t base, const VarRef& ref, const Value& value) {
+            if (Value* target = findVariable(base, ref)) {
+                *target = value;
+            } else if (!ref.slots.empty()) {
+                stack[base + ref.slots[0]] = value;
+                bound[base + ref.slots[0]] = true;
+            } else {
+                bindGlobal(ref.global, value);
+            }
+        }
+
+        void bindGlobal(int32_t global, const Value& value) {
+            globals[global] = value;
+            if (!globalBound[global]) {
+                globalBound[global] = true;
+                boundGlobals++;
+            }
+        }
+
+        // 单槽变量的读取位置: 槽已绑定取槽, 否则取全局变量
+        Value* slotOrGlobal(size_t base, int32_t slot, int32_t global) {
+            if (bound[base + slot]) {
+                return &stack[base + slot];
+            }
+            if (global >= 0 && globalBound[global]) {
+                return &globals[global];
+            }
+            return nullptr;
+        }
+
+        /*
+        #  实参从栈顶移出再调用: 内置函数 (如 next) 可能回到虚拟机里执行, 栈会增长、移动.
+        #  实参不多时移到栈上的数组里, 不在堆上分配
+        */
+        Value callBuiltin(size_t builtin, size_t argc) {
+            if (argc <= BUILTIN_INLINE_ARGS) {
+                Value args[BUILTIN_INLINE_ARGS];
+                std::move(stack.end() - argc, stack.end(), args);
+                stack.resize(stack.size() - argc);
+                return interpreter.callBuiltin(builtin, BuiltinArgs(args, argc));
+            }
+            std::vector<Value> args(std::make_move_iterator(stack.end() - argc),
+                                    std::make_move_iterator(stack.end()));
+            stack.resize(stack.size() - argc);
+            return interpreter.callBuiltin(builtin, args);
+        }
+
+        // 保存在变量里的内置函数, 按名字查表
+        Value callBuiltin(const std::string& name, size_t argc) {
+            int32_t builtin = interpreter.findBuiltin(name);
+            if (builtin < 0) {
+                throw runtime_error("Unknown function: " + name);
+            }
+            return callBuiltin(static_cast<size_t>(builtin), argc);
+        }
+
+        // 类型注解的检查; what 是描述被检查的值的字符串常量
+        void checkType(Value& value, int32_t type, int32_t what) {
+            if (!conformsTo(value, static_cast<Value::Type>(type))) {
+                annotationError(value, static_cast<Value::Type>(type), frames.back().chunk->constants[what].asString());
+            }
+        }
+
+        /*
+        #  把实参放进被调函数的参数槽, 按调用点的绑定方案直接移动;
+        #  没有方案 (调用不合法) 时逐项检查, 报错信息与 CallNode::evaluate 保持一致
+        */
+        void bindArguments(const FunctionType& func, const CallSite& site, size_t base) {
+            BindingPlan& plan = site.plan;
+            if (!plan.matches(func) && !planBinding(func, site)) {
+                bindChecked(func, site, base);
+                return;
+            }
+
+            size_t positional = site.positionalCount;
+            size_t numSlots = func.chunk->numSlots;
+            if (plan.namedSlots.empty()) {
+                allocateSlots(base, numSlots, positional);
+                return;
+            }
+            size_t namedCount = plan.namedSlots.size();
+            Value named[BUILTIN_INLINE_ARGS];
+            std::vector<Value> spill;
+            Value* values = named;
+            if (namedCount > BUILTIN_INLINE_ARGS) {
+                spill.resize(namedCount);
+                values = spill.data();
+            }
+            std::move(stack.begin() + base + positional, stack.end(), values);
+            allocateSlots(base, numSlots, positional);
+            for (size_t i = 0; i < namedCount; i++) {
+                stack[base + plan.namedSlots[i]] = std::move(values[i]);
+                bound[base + plan.namedSlots[i]] = true;
+            }
+        }
+
+        static bool planBinding(const FunctionType& func, const CallSite& site) {
+            std::vector<const std::string*> names;
+            names.reserve(site.namedArguments.size());
+            for (const auto& name : site.namedArguments) {
+                names.push_back(&name);
+            }
+            return site.plan.build(func, site.positionalCount, names);
+        }
+
+        void bindChecked(const FunctionType& func, const CallSite& site, size_t base) {
+            const auto& params = func.parameters;
+            size_t positional = site.positionalCount;
+            size_t maxArgs = params.size();
+            size_t minArgs = 0;
+            for (const auto& param : params) {
+                if (!param.hasDefault) {
+                    minArgs++;
+                }
+            }
+
+            if (positional > maxArgs) {
+                throw runtime_error("Too many positional arguments for function " + site.name +
+                                   ": expected at most " + std::to_string(maxArgs) +
+                                   ", got " + std::to_string(positional));
+            }
+
+            size_t numSlots = func.chunk->numSlots;
+            if (site.namedArguments.empty()) {
+                if (positional < minArgs) {
+                    throw runtime_error("Not enough arguments for function " + site.name +
+                                       ": expected at least " + std::to_string(minArgs) +
+                                       ", got " + std::to_string(positional));
+                }
+                allocateSlots(base, numSlots, positional);
+                return;
+            }
+
+            if (positional < minArgs) {
+                size_t providedRequired = positional;
+                for (const auto& param : params) {
+                    if (!param.hasDefault &&
+                        std::find(site.namedArguments.begin(), site.namedArguments.end(), param.name) != site.namedArguments.end()) {
+                        providedRequired++;
+                    }
+                }
+                if (providedRequired < minArgs) {
+                    throw runtime_error("Not enough arguments for function " + site.name +
+                                       ": expected at least " + std::to_string(minArgs) +
+                                       ", got " + std::to_string(providedRequired));
+                }
+            }
+
+            std::vector<Value> named(std::make_move_iterator(stack.begin() + base + positional),
+                                     std::make_move_iterator(stack.end()));
+            allocateSlots(base, numSlots, positional);
+            for (size_t i = 0; i < named.size(); i++) {
+                const std::string& paramName = site.namedArguments[i];
+                size_t paramIndex = 0;
+                while (paramIndex < params.size() && params[paramIndex].name != paramName) {
+                    paramIndex++;
+                }
+                if (paramIndex == params.size()) {
+                    throw runtime_error("Unknown parameter '" + paramName + "' for function " + site.name);
+                }
+                if (paramIndex < positional) {
+                    throw runtime_error("Parameter '" + paramName + "' already set by positional argument");
+                }
+                stack[base + paramIndex] = std::move(named[i]);
+                bound[base + paramIndex] = true;
+            }
+            for (size_t i = positional; i < params.size(); i++) {
+                if (!bound[base + i] && !params[i].hasDefault) {
+                    throw runtime_error("Missing argument for parameter: " + params[i].name);
+                }
+            }
+        }
+
+        /*
+        #  纯函数调用查结果缓存, 实参已经绑定在 base 开始的参数槽里
+        #  命中时把结果放在被调函数的位置并返回 true; 未命中时记下键, 等返回时写入
+        */
+        bool memoLookup(FunctionType& func, MemoCache& memo, size_t base) {
+            MemoKey key;
+            key.reserve(func.parameters.size());
+            for (size_t i = 0; i < func.parameters.size(); i++) {
+                key.push_back(bound[base + i] ? stack[base + i] : Value::unbound());
+            }
+            if (const Value* cached = memo.find(key)) {
+                Value result = *cached;
+                stack.resize(base);
+                stack.back() = std::move(result);
+                return true;
+            }
+            pendingMemo.push_back({FunctionTypePtr(&func), std::move(key)});
+            return false;
+        }
+
+        // 编译过的函数直接执行机器码, 结果放在被调函数的位置; 守卫失败时返回 false
+        bool jitCall(FunctionType& func, size_t base) {
+            Value result;
+            if (!interpreter.getJit().call(func, stack.data() + base, bound.data() + base, boundGlobals,
+                                           [this](const string& name) { return hasGlobal(name); }, result)) {
+                return false;
+            }
+            if (func.returnType != Value::EMPTY && !conformsTo(result, func.returnType)) {
+                annotationError(result, func.returnType, "return value of " + func.name);
+            }
+            stack.resize(base);
+            stack.back() = std::move(result);
+            return true;
+        }
+
+        void memoStore(const Value& result) {
+            PendingMemo& pending = pendingMemo.back();
+            pending.func->memo->insert(std::move(pending.key), result);
+            pendingMemo.pop_back();
+        }
+
+        // 调用生成器函数: 实参已经绑定在 base 开始的槽里, 连同槽一起搬进生成器, 函数体要到第一次 next 才执行
+        Value makeGenerator(FunctionType& func, size_t base) {
+            Value gen = GeneratorPtr(new Generator(*this, FunctionTypePtr(&func),
+                                                   std::vector<Value>(std::make_move_iterator(stack.begin() + base),
+                                                                      std::make_move_iterator(stack.end())),
+                                                   std::vector<char>(bound.begin() + base, bound.begin() + stack.size())));
+            stack.resize(base);
+            return gen;
+        }
+
+        /*
+        #  执行 spawn 的函数, 实参已经绑定在 base 开始的槽里; 返回结果, 栈上留下被调函数的位置.
+        #  出错时把栈和帧恢复到调用前再抛出
+        */
+        Value spawnCall(FunctionType& func, size_t base) {
+            size_t frameBase = frames.size();
+            size_t memoBase = pendingMemo.size();
+            try {
+                if (frames.size() > maxDepth) {
+                    throw runtime_error("Maximum recursion depth exceeded (" + to_string(maxDepth) + ")");
+                }
+                if (!jitCall(func, base)) {
+                    frames.push_back({func.chunk.get(), 0, base, Value(), false, true});
+                    dispatch();
+                }
+            } catch (...) {
+                stack.resize(base);
+                frames.resize(frameBase);
+                pendingMemo.resize(memoBase);
+                throw;
+            }
+            return std::move(stack.back());
+        }
+
+        bool resumeGenerator(Generator& gen, Value& out) {
+            if (frames.size() > maxDepth) {
+                throw runtime_error("Maximum recursion depth exceeded (" + to_string(maxDepth) + ")");
+            }
+            size_t stackBase = stack.size();
+            size_t frameBase = frames.size();
+            size_t memoBase = pendingMemo.size();
+
+            stack.insert(stack.end(), std::make_move_iterator(gen.slots.begin()), std::make_move_iterator(gen.slots.end()));
+            if (bound.size() < stack.size()) {
+                bound.resize(stack.size());
+            }
+            std::copy(gen.slotBound.begin(), gen.slotBound.end(), bound.begin() + stackBase);
+            frames.push_back({gen.func->chunk.get(), gen.ip, stackBase, Value()});
+
+            Value value;
+            try {
+                value = dispatch();
+            } catch (...) {
+                stack.resize(stackBase);
+                frames.resize(frameBase);
+                pendingMemo.resize(memoBase);
+                throw;
+            }
+            if (suspended) {
+                gen.ip = frames.back().ip;
+                gen.slots.assign(std::make_move_iterator(stack.begin() + stackBase), std::make_move_iterator(stack.end()));
+                gen.slotBound.assign(bound.begin() + stackBase, bound.begin() + stack.size());
+                out = std::move(value);
+            } else {
+                gen.slots.clear();
+                gen.slotBound.clear();
+            }
+            stack.resize(stackBase);
+            frames.pop_back();
+            return suspended;
+        }
+
+        Value run(const Chunk& main) {
+            size_t stackBase = stack.size();
+            size_t frameBase = frames.size();
+            size_t memoBase = pendingMemo.size();
+            try {
+                frames.push_back({&main, 0, stack.size(), Value()});
+                allocateSlots(stack.size(), main.numSlots);
+                return dispatch();
+            } catch (...) {
+                stack.resize(stackBase);
+                frames.resize(frameBase);
+                pendingMemo.resize(memoBase);
+                throw;
+            }
+        }
+
+        /*
+        #  从栈顶帧保存的 ip 开始执行, 到 HALT (主程序) 或 YIELD / FINISH (生成器) 返回.
+        #  内置函数里的 next 会重入 dispatch 执行另一个生成器, 可能让 frames 重新分配,
+        #  所以调用内置函数和取 for-in 的下一个值之后要重新取 frame
+        */
+        Value dispatch() {
+            CallFrame* frame = &frames.back();
+            const Chunk* chunk = frame->chunk;
+            const int32_t* code = chunk->code.data();
+            size_t ip = frame->ip;
+            size_t base = frame->base;
+
+            #define VM_OPERAND(n) (code[ip + (n)])
+            #define VM_NEXT(n) ip += 1 + (n)
+            #define VM_ENTER_FRAME()              \
+                frame = &frames.back();           \
+                chunk = frame->chunk;             \
+                code = chunk->code.data();        \
+                ip = frame->ip;                   \
+                base = frame->base
+
+        #if MI_THREADED_DISPATCH
+            static const void* dispatchTable[] = {
+                #define MI_OPCODE_LABEL(name, operands) &&op_##name,
+                MI_OPCODES(MI_OPCODE_LABEL)
+                #undef MI_OPCODE_LABEL
+            };
+            #define VM_DISPATCH() goto *dispatchTable[code[ip]]
+            #define VM_CASE(name) op_##name:
+            VM_DISPATCH();
+        #else
+            #define VM_DISPATCH() continue
+            #define VM_CASE(name) case OpCode::name:
+            for (;;) switch (static_cast<OpCode>(code[ip])) {
+        #endif
+
+            VM_CASE(CONST) {
+                stack.push_back(chunk->constants[VM_OPERAND(1)]);
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(POP) {
+                stack.pop_back();
+                VM_NEXT(0);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(LOAD_LOCAL) {
+                stack.push_back(stack[base + VM_OPERAND(1)]);
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(LOAD_SLOT) {
+                Value* value = slotOrGlobal(base, VM_OPERAND(1), VM_OPERAND(2));
+                if (!value) {
+                    undefinedVariable(globalTable.names[VM_OPERAND(2)]);
+                }
+                stack.push_back(*value);
+                VM_NEXT(2);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(LOAD_GLOBAL) {
+                int32_t global = VM_OPERAND(1);
+                if (!globalBound[global]) {
+                    undefinedVariable(globalTable.names[global]);
+                }
+                stack.push_back(globals[global]);
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(LOAD_REF) {
+                const VarRef& ref = chunk->refs[VM_OPERAND(1)];
+                Value* value = findVariable(base, ref);
+                if (!value) {
+                    undefinedVariable(ref.name);
+                }
+                stack.push_back(*value);
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(STORE_LOCAL) {
+                stack[base + VM_OPERAND(1)] = stack.back();
+                bound[base + VM_OPERAND(1)] = true;
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(STORE_SLOT) {
+                int32_t slot = VM_OPERAND(1);
+                int32_t global = VM_OPERAND(2);
+                if (!bound[base + slot] && globalBound[global]) {
+                    globals[global] = stack.back();
+                } else {
+                    stack[base + slot] = stack.back();
+                    bound[base + slot] = true;
+                }
+                VM_NEXT(2);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(STORE_GLOBAL) {
+                bindGlobal(VM_OPERAND(1), stack.back());
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(STORE_REF) {
+                storeVariable(base, chunk->refs[VM_OPERAND(1)], stack.back());
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(ADD) {
+                Value& left = stack[stack.size() - 2];
+                const Value& right = stack.back();
+                if (holds_alternative<IntType>(left) && holds_alternative<IntType>(right)) {
+                    get<IntType>(left) += get<IntType>(right);
+                } else {
+                    left = binary(TokenType::PLUS, VM_OPERAND(1), left, right);
+                }
+                stack.pop_back();
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(SUB) {
+                Value& left = stack[stack.size() - 2];
+                const Value& right = stack.back();
+                if (holds_alternative<IntType>(left) && holds_alternative<IntType>(right)) {
+                    get<IntType>(left) -= get<IntType>(right);
+                } else {
+                    left = binary(TokenType::MINUS, VM_OPERAND(1), left, right);
+                }
+                stack.pop_back();
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(MUL) {
+                Value& left = stack[stack.size() - 2];
+                const Value& right = stack.back();
+                if (holds_alternative<IntType>(left) && holds_alternative<IntType>(right)) {
+                    get<IntType>(left) *= get<IntType>(right);
+                } else {
+                    left = binary(TokenType::MULTIPLY, VM_OPERAND(1), left, right);
+                }
+                stack.pop_back();
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(BINARY) {
+                Value& left = stack[stack.size() - 2];
+                left = binary(static_cast<TokenType>(VM_OPERAND(1)), VM_OPERAND(2), left, stack.back());
+                stack.pop_back();
+                VM_NEXT(2);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(LESS) {
+                Value& left = stack[stack.size() - 2];
+                const Value& right = stack.back();
+                if (holds_alternative<IntType>(left) && holds_alternative<IntType>(right)) {
+                    left = BoolType(get<IntType>(left) < get<IntType>(right));
+                } else {
+                    left = binary(TokenType::LT, VM_OPERAND(1), left, right);
+                }
+                stack.pop_back();
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(NOT) {
+                Value& value = stack.back();
+                if (holds_alternative<IntType>(value)) {
+                    value = BoolType(get<IntType>(value) == 0);
+                } else if (holds_alternative<FloatType>(value)) {
+                    value = BoolType(get<FloatType>(value) == 0.0);
+                } else if (holds_alternative<BoolType>(value)) {
+                    value = BoolType(!get<BoolType>(value));
+                } else if (holds_alternative<StringType>(value)) {
+                    value = BoolType(get<StringType>(value).empty());
+                } else {
+                    throw runtime_error("Type error: Cannot apply '!' to type " +
+                                        interpreter.getInnerMethod().getTypeName(value));
+                }
+                VM_NEXT(0);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(NEGATE) {
+                Value& value = stack.back();
+                if (holds_alternative<IntType>(value)) {
+                    value.intRef() = IntType(0) - value.asInt();
+                } else {
+                    value = UnaryOpNode::apply(TokenType::MINUS, value, interpreter.getInnerMethod());
+                }
+                VM_NEXT(0);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(JUMP) {
+                ip = VM_OPERAND(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(JUMP_IF_FALSE) {
+                bool condition = truthy(stack.back(), static_cast<ConditionKind>(VM_OPERAND(2)), VM_OPERAND(3));
+                stack.pop_back();
+                if (condition) {
+                    VM_NEXT(3);
+                } else {
+                    ip = VM_OPERAND(1);
+                }
+                VM_DISPATCH();
+            }
+
+            VM_CASE(JUMP_IF_BOUND) {
+                if (bound[base + VM_OPERAND(1)]) {
+                    ip = VM_OPERAND(2);
+                } else {
+                    VM_NEXT(2);
+                }
+                VM_DISPATCH();
+            }
+
+            VM_CASE(COMPARE_JUMP) {
+                const Value& left = stack[stack.size() - 2];
+                const Value& right = stack.back();
+                bool condition = compare(static_cast<TokenType>(VM_OPERAND(1)), VM_OPERAND(2), left, right,
+                                         static_cast<ConditionKind>(VM_OPERAND(4)), VM_OPERAND(5));
+                stack.resize(stack.size() - 2);
+                if (condition) {
+                    VM_NEXT(5);
+                } else {
+                    ip = VM_OPERAND(3);
+                }
+                VM_DISPATCH();
+            }
+
+            VM_CASE(SLOTS_COMPARE_JUMP) {
+                const Value* left = slotOrGlobal(base, VM_OPERAND(2), VM_OPERAND(3));
+                if (!left) {
+                    undefinedVariable(globalTable.names[VM_OPERAND(3)]);
+                }
+                const Value* right = slotOrGlobal(base, VM_OPERAND(4), VM_OPERAND(5));
+                if (!right) {
+                    undefinedVariable(globalTable.names[VM_OPERAND(5)]);
+                }
+                if (compare(static_cast<TokenType>(VM_OPERAND(1)), VM_OPERAND(8), *left, *right,
+                            static_cast<ConditionKind>(VM_OPERAND(7)), VM_OPERAND(8))) {
+                    VM_NEXT(8);
+                } else {
+                    ip = VM_OPERAND(6);
+                }
+                VM_DISPATCH();
+            }
+
+            VM_CASE(SLOT_LESS_CONST_JUMP) {
+                const Value* value = slotOrGlobal(base, VM_OPERAND(1), VM_OPERAND(2));
+                if (!value) {
+                    undefinedVariable(globalTable.names[VM_OPERAND(2)]);
+                }
+                const Value& limit = chunk->constants[VM_OPERAND(3)];
+                bool condition;
+                if (holds_alternative<IntType>(*value)) {
+                    condition = get<IntType>(*value) < get<IntType>(limit);
+                } else {
+                    condition = truthy(binary(TokenType::LT, VM_OPERAND(6), *value, limit),
+                                       static_cast<ConditionKind>(VM_OPERAND(5)), VM_OPERAND(6));
+                }
+                if (condition) {
+                    VM_NEXT(6);
+                } else {
+                    ip = VM_OPERAND(4);
+                }
+                VM_DISPATCH();
+            }
+
+            VM_CASE(SLOT_ADD_CONST) {
+                Value* value = slotOrGlobal(base, VM_OPERAND(1), VM_OPERAND(2));
+                if (!value) {
+                    undefinedVariable(globalTable.names[VM_OPERAND(2)]);
+                }
+                const Value& step = chunk->constants[VM_OPERAND(3)];
+                if (holds_alternative<IntType>(*value)) {
+                    get<IntType>(*value) += get<IntType>(step);
+                } else {
+                    *value = binary(TokenType::PLUS, VM_OPERAND(4), *value, step);
+                }
+                stack.push_back(*value);
+                VM_NEXT(4);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(LOAD_CALLEE) {
+                const VarRef& ref = chunk->refs[VM_OPERAND(1)];
+                Value* value = findVariable(base, ref);
+                if (!value) {
+                    throw runtime_error("Unknown function: " + ref.name);
+                }
+                stack.push_back(*value);
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(CALL) {
+                const CallSite& site = chunk->callSites[VM_OPERAND(1)];
+                size_t argc = site.positionalCount + site.namedArguments.size();
+                size_t calleeAt = stack.size() - argc - 1;
+                if (!holds_alternative<FunctionTypePtr>(stack[calleeAt])) {
+                    throw runtime_error(site.name + " is not a function");
+                }
+                // 栈上的被调函数值保证它存活; 计算跳转离开作用域时不会析构局部对象, 这里只用裸指针
+                FunctionType* func = stack[calleeAt].functionPtr();
+
+                if (!func->chunk && !func->body) {
+                    // 保存在变量里的内置函数, 只接受位置参数
+                    stack.resize(stack.size() - site.namedArguments.size());
+                    Value result = callBuiltin(func->name, site.positionalCount);
+                    stack.back() = std::move(result);
+                    frame = &frames.back();
+                    VM_NEXT(1);
+                    VM_DISPATCH();
+                }
+                if (!func->chunk) {
+                    Compiler compiler(interpreter, globalTable);
+                    func->chunk = compiler.compileFunction(func->name, func->parameters, func->returnType, *func->body,
+                                                           func->generator)->chunk;
+                    syncGlobals();
+                }
+                if (func->generator) {
+                    bindArguments(*func, site, calleeAt + 1);
+                    Value gen = makeGenerator(*func, calleeAt + 1);
+                    stack.back() = std::move(gen);
+                    VM_NEXT(1);
+                    VM_DISPATCH();
+                }
+
+                if (frames.size() > maxDepth) {
+                    throw runtime_error("Maximum recursion depth exceeded (" + to_string(maxDepth) + ")");
+                }
+                bindArguments(*func, site, calleeAt + 1);
+                VM_NEXT(1);
+                if (MemoCache* memo = interpreter.memoFor(*func)) {
+                    if (memoLookup(*func, *memo, calleeAt + 1)) {
+                        VM_DISPATCH();
+                    }
+                    if (jitCall(*func, calleeAt + 1)) {
+                        memoStore(stack.back());
+                        VM_DISPATCH();
+                    }
+                    frame->ip = ip;
+                    frames.push_back({func->chunk.get(), 0, calleeAt + 1, Value(), true});
+                } else {
+                    if (jitCall(*func, calleeAt + 1)) {
+                        VM_DISPATCH();
+                    }
+                    frame->ip = ip;
+                    frames.push_back({func->chunk.get(), 0, calleeAt + 1, Value()});
+                }
+                VM_ENTER_FRAME();
+                VM_DISPATCH();
+            }
+
+            VM_CASE(TAIL_CALL) {
+                // return f(...): 实参绑定好后挪到当前帧的位置, 复用这一帧
+                const CallSite& site = chunk->callSites[VM_OPERAND(1)];
+                size_t argc = site.positionalCount + site.namedArguments.size();
+                size_t calleeAt = stack.size() - argc - 1;
+                if (!holds_alternative<FunctionTypePtr>(stack[calleeAt])) {
+                    throw runtime_error(site.name + " is not a function");
+                }
+                // 栈上的被调函数值保证它存活; 计算跳转离开作用域时不会析构局部对象, 这里只用裸指针
+                FunctionType* func = stack[calleeAt].functionPtr();
+
+                if (!func->chunk && !func->body) {
+                    stack.resize(stack.size() - site.namedArguments.size());
+                    Value result = callBuiltin(func->name, site.positionalCount);
+                    frame = &frames.back();
+                    frame->result = std::move(result);
+                    goto return_result;
+                }
+                if (!func->chunk) {
+                    Compiler compiler(interpreter, globalTable);
+                    func->chunk = compiler.compileFunction(func->name, func->parameters, func->returnType, *func->body,
+                                                           func->generator)->chunk;
+                    syncGlobals();
+                }
+
+                bindArguments(*func, site, calleeAt + 1);
+                if (func->generator) {
+                    frame->result = makeGenerator(*func, calleeAt + 1);
+                    goto return_result;
+                }
+                if (jitCall(*func, calleeAt + 1)) {
+                    frame->result = pop();
+                    goto return_result;
+                }
+                size_t numSlots = func->chunk->numSlots;
+                std::move(stack.begin() + calleeAt, stack.begin() + calleeAt + numSlots + 1, stack.begin() + base - 1);
+                std::copy(bound.begin() + calleeAt + 1, bound.begin() + calleeAt + numSlots + 1, bound.begin() + base);
+                stack.resize(base + numSlots);
+                frame->chunk = func->chunk.get();
+                frame->ip = 0;
+                VM_ENTER_FRAME();
+                VM_DISPATCH();
+            }
+
+            VM_CASE(CALL_BUILTIN) {
+                stack.push_back(callBuiltin(static_cast<size_t>(VM_OPERAND(1)), VM_OPERAND(2)));
+                frame = &frames.back();
+                VM_NEXT(2);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(CONVERT) {
+                Value& value = stack.back();
+                value = ConvertNode::apply(static_cast<ConvertNode::Kind>(VM_OPERAND(1)), value,
+                                           interpreter.getInnerMethod());
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(MAKE_FUNCTION) {
+                stack.push_back(chunk->functions[VM_OPERAND(1)]);
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(STORE_RESULT) {
+                frame->result = pop();
+                VM_NEXT(0);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(SET_RESULT) {
+                frame->result = chunk->constants[VM_OPERAND(1)];
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(RETURN) {
+                frame->result = pop();
+                goto return_result;
+            }
+
+            VM_CASE(RETURN_RESULT) {
+            return_result:
+                if (frame->memo) {
+                    memoStore(frame->result);
+                }
+                stack.resize(base);
+                stack.back() = std::move(frame->result);
+                if (frame->spawned) {
+                    frames.pop_back();
+                    return Value();
+                }
+                frames.pop_back();
+                VM_ENTER_FRAME();
+                VM_DISPATCH();
+            }
+
+            VM_CASE(CHECK_TYPE) {
+                checkType(stack.back(), VM_OPERAND(1), VM_OPERAND(2));
+                VM_NEXT(2);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(CHECK_RESULT) {
+                checkType(frame->result, VM_OPERAND(1), VM_OPERAND(2));
+                VM_NEXT(2);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(CLEAR_SLOTS) {
+                auto first = bound.begin() + base + VM_OPERAND(1);
+                std::fill(first, first + VM_OPERAND(2), false);
+                VM_NEXT(2);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(LOOP_TICK) {
+                size_t counter = base + VM_OPERAND(1);
+                if (!bound[counter]) {
+                    stack[counter] = IntType(0);
+                    bound[counter] = true;
+                }
+                if (++get<IntType>(stack[counter]) > MAX_DEAD_LOOP) {
+                    throw runtime_error("Possible infinite loop detected at line " + to_string(VM_OPERAND(2)));
+                }
+                VM_NEXT(2);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(ITER_START) {
+                if (!holds_alternative<GeneratorPtr>(stack.back())) {
+                    throw runtime_error("Type error: cannot iterate over " + string(typeName(stack.back().type())) +
+                                        " at line " + to_string(VM_OPERAND(1)));
+                }
+                VM_NEXT(1);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(FOR_NEXT) {
+                // 栈上的生成器值保证它存活; next 可能让值栈重新分配, 这里只用裸指针
+                GeneratorType* gen = stack.back().generatorPtr();
+                Value item;
+                bool more = gen->next(item);
+                frame = &frames.back();
+                if (more) {
+                    stack.push_back(std::move(item));
+                    VM_NEXT(1);
+                } else {
+                    ip = VM_OPERAND(1);
+                }
+                VM_DISPATCH();
+            }
+
+            VM_CASE(YIELD) {
+                frame->ip = ip + 1;
+                suspended = true;
+                return pop();
+            }
+
+            VM_CASE(FINISH) {
+                suspended = false;
+                return Value();
+            }
+
+            VM_CASE(MAKE_FUTURE) {
+                // spawn f(...): 检查和绑定实参的错误在 spawn 处报告, 函数体里的错误记在 future 上, 到 join 才抛出
+                const CallSite& site = chunk->callSites[VM_OPERAND(1)];
+                size_t argc = site.positionalCount + site.namedArguments.size();
+                size_t calleeAt = stack.size() - argc - 1;
+                if (!holds_alternative<FunctionTypePtr>(stack[calleeAt])) {
+                    throw runtime_error(site.name + " is not a function");
+                }
+                FunctionType* func = stack[calleeAt].functionPtr();
+                std::string spawnAt = "Spawn at line " + to_string(VM_OPERAND(2)) + ": ";
+                if (!func->chunk && !func->body) {
+                    throw runtime_error(spawnAt + site.name + " is a builtin function; only user functions can be spawned");
+                }
+                if (func->generator) {
+                    throw runtime_error(spawnAt + "generator " + site.name + " cannot be spawned");
+                }
+                if (!func->chunk) {
+                    Compiler compiler(interpreter, globalTable);
+                    func->chunk = compiler.compileFunction(func->name, func->parameters, func->returnType, *func->body,
+                                                           func->generator)->chunk;
+                    syncGlobals();
+                }
+                bindArguments(*func, site, calleeAt + 1);
+
+                auto task = makeRef<Task>(site.name);
+                task->claim();
+                frame->ip = ip;
+                try {
+                    task->completeLocal(spawnCall(*func, calleeAt + 1));
+                } catch (const ProgramExit&) {
+                    throw;  // exit() 结束整个程序, 不留给 join
+                } catch (...) {
+                    task->fail(current_exception());
+                }
+                stack.back() = FuturePtr(task.get());
+                frame = &frames.back();
+                VM_NEXT(2);
+                VM_DISPATCH();
+            }
+
+            VM_CASE(THROW) {
+                throw runtime_error(get<StringType>(chunk->constants[VM_OPERAND(1)]));
+            }
+
+            VM_CASE(HALT) {
+                Value result = std::move(frame->result);
+                stack.resize(base);
+                frames.pop_back();
+                return result;
+            }
+
+        #if !MI_THREADED_DISPATCH
+                default:
+                    throw runtime_error("Unknown opcode");
+            }
+        #endif
+
+            #undef VM_CASE
+            #undef VM_DISPATCH
+            #undef VM_ENTER_FRAME
+            #undef VM_NEXT
+            #undef VM_OPERAND
+        }
+
+    public:
+        explicit VM(Interpreter& interpreter) : interpreter(interpreter) {
+            for (const auto& [name, func] : interpreter.getFuncList()) {
+                Value value;
+                if (interpreter.getVariable(name, value)) {
+                    globals.resize(globalTable.intern(name) + 1);
+                    globals.back() = value;
+                }
+            }
+            globalBound.assign(globals.size(), true);
+            boundGlobals = globals.size();
+        }
+
+        void setMaxDepth(size_t depth) { maxDepth = depth; }
+
+        bool hasGlobal(const std::string& name) const {
+            auto it = globalTable.index.find(name);
+            return it != globalTable.index.end() && static_cast<size_t>(it->second) < globalBound.size() &&
+                   globalBound[it->second];
+        }
+
+        Value execute(BlockNode& program) {
+            OutputFlush flushAtEnd{interpreter.getInnerMethod().output()};
+            Compiler compiler(interpreter, globalTable);
+            auto chunk = compiler.compileProgram(program);
+            syncGlobals();
+            return run(*chunk);
+        }
+    };
+
+#endif